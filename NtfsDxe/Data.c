@@ -28,6 +28,16 @@ Revision History
 //
 EFI_LOCK NtfsFsLock = EFI_INITIALIZE_LOCK_VARIABLE(TPL_CALLBACK);
 
+//
+// NtfsVolumeStatsProtocol - counters installed next to each file system
+//
+EFI_GUID gNtfsVolumeStatsProtocolGuid = NTFS_VOLUME_STATS_PROTOCOL_GUID;
+
+//
+// NtfsFileExtentsProtocol - file extents installed next to each file system
+//
+EFI_GUID gNtfsFileExtentsProtocolGuid = NTFS_FILE_EXTENTS_PROTOCOL_GUID;
+
 //
 // Filesystem interface functions
 //
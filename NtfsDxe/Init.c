@@ -116,6 +116,12 @@ Returns:
   Volume->ReadOnly                    = BlockIo->Media->ReadOnly;
   Volume->VolumeInterface.Revision    = EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION;
   Volume->VolumeInterface.OpenVolume  = NtfsOpenVolume;
+  Volume->StatsInterface.Revision     = NTFS_VOLUME_STATS_PROTOCOL_REVISION;
+  Volume->StatsInterface.GetStats     = NtfsGetVolumeStats;
+  Volume->StatsInterface.Reset        = NtfsResetVolumeStats;
+  Volume->StatsInterface.GetTrace     = NtfsGetVolumeTrace;
+  Volume->ExtentsInterface.Revision   = NTFS_FILE_EXTENTS_PROTOCOL_REVISION;
+  Volume->ExtentsInterface.GetExtents = NtfsGetFileExtents;
 
   
   //InitializeListHead (&Volume->CheckRef);
@@ -162,6 +168,10 @@ Returns:
                   &Volume->Handle,
                   &gEfiSimpleFileSystemProtocolGuid,
                   &Volume->VolumeInterface,
+                  &gNtfsVolumeStatsProtocolGuid,
+                  &Volume->StatsInterface,
+                  &gNtfsFileExtentsProtocolGuid,
+                  &Volume->ExtentsInterface,
                   NULL
                   );
   if (EFI_ERROR (Status)) {
@@ -218,6 +228,10 @@ Returns:
                     Volume->Handle,
                     &gEfiSimpleFileSystemProtocolGuid,
                     &Volume->VolumeInterface,
+                    &gNtfsVolumeStatsProtocolGuid,
+                    &Volume->StatsInterface,
+                    &gNtfsFileExtentsProtocolGuid,
+                    &Volume->ExtentsInterface,
                     NULL
                     );
 
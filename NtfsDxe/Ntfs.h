@@ -42,6 +42,8 @@ Revision History
 #include <Library/UefiRuntimeServicesTableLib.h>
 
 #include "NtfsFileSystem.h"
+#include "NtfsVolumeStats.h"
+#include "NtfsFileExtents.h"
 #include "ntfs/volume.h"
 #include "ntfs/inode.h"
 #include "ntfs/ntfsinternal.h"
@@ -65,6 +67,10 @@ Revision History
 
 #define VOLUME_FROM_VOL_INTERFACE(a) CR (a, NTFS_VOLUME, VolumeInterface, NTFS_VOLUME_SIGNATURE);
 
+#define VOLUME_FROM_STATS_INTERFACE(a) CR (a, NTFS_VOLUME, StatsInterface, NTFS_VOLUME_SIGNATURE)
+
+#define VOLUME_FROM_EXTENTS_INTERFACE(a) CR (a, NTFS_VOLUME, ExtentsInterface, NTFS_VOLUME_SIGNATURE)
+
 #define ODIR_FROM_DIRCACHELINK(a)    CR (a, NTFS_ODIR, DirCacheLink, NTFS_ODIR_SIGNATURE)
 
 #define OFILE_FROM_CHECKLINK(a)      CR (a, NTFS_OFILE, CheckLink, NTFS_OFILE_SIGNATURE)
@@ -284,6 +290,8 @@ typedef struct _NTFS_VOLUME {
 	BOOLEAN                         DiskError;
 
 	EFI_SIMPLE_FILE_SYSTEM_PROTOCOL VolumeInterface;
+	NTFS_VOLUME_STATS_PROTOCOL      StatsInterface;
+	NTFS_FILE_EXTENTS_PROTOCOL      ExtentsInterface;
 
 	//
 	// If opened, the parent handle and BlockIo interface
@@ -797,6 +805,43 @@ UINTN EFIAPI CreateFileName(CHAR8 *Destination, CHAR8 *Path, CHAR8 *FileName);
 // ReadWrite.c
 //
 
+//
+// NtfsStats.c
+//
+EFI_STATUS
+EFIAPI
+NtfsGetVolumeStats (
+  IN     NTFS_VOLUME_STATS_PROTOCOL  *This,
+  IN OUT NTFS_VOLUME_STATS           *Stats
+  );
+
+EFI_STATUS
+EFIAPI
+NtfsResetVolumeStats (
+  IN  NTFS_VOLUME_STATS_PROTOCOL  *This
+  );
+
+EFI_STATUS
+EFIAPI
+NtfsGetVolumeTrace (
+  IN     NTFS_VOLUME_STATS_PROTOCOL  *This,
+  IN OUT UINTN                       *BufferSize,
+  OUT    VOID                        *Buffer
+  );
+
+//
+// NtfsExtents.c
+//
+EFI_STATUS
+EFIAPI
+NtfsGetFileExtents (
+  IN     NTFS_FILE_EXTENTS_PROTOCOL  *This,
+  IN     EFI_FILE_PROTOCOL           *File,
+  IN     UINT64                      Offset,
+  IN OUT UINTN                       *ExtentCount,
+  OUT    NTFS_FILE_EXTENT            *Extents
+  );
+
 //
 // DirectoryManage.c
 //
@@ -61,6 +61,13 @@ Returns:
 	} else if (IFile->Type == FSW_EFI_FILE_TYPE_DIR) {	// unimplemented!
 		//Print(L"FSW_EFI_FILE_TYPE_DIR.\n\r");
 		Status = EFI_SUCCESS;
+		if (IFile->dirState != NULL)
+		{	// release the entries and the cursor and unlink the state from
+			// the open directories of the volume, the inode is closed below
+			IFile->dirState->ni = NULL;
+			ZeroMem(&r, sizeof(struct _reent));
+			ntfs_dirclose_r(&r, IFile->dirState);
+		}
 		ntfsCloseEntry(IFile->Volume->vd, IFile->inode);
 	} else
 		Status = EFI_INVALID_PARAMETER;
@@ -19,6 +19,7 @@ Revision History
 --*/
 
 #include "Ntfs.h"
+#include "ntfs/ntfsdir.h"
 
 EFI_STATUS
 EFIAPI
@@ -48,9 +49,21 @@ Returns:
 	u8 name_len;
 	ntfs_inode *ni, *dir_ni;
 	CHAR16  *unicode;
+	struct _reent r;
 
 	IFile = IFILE_FROM_FHAND(FHand);
-	
+
+	// The handle is closed in all cases: release the listing of a directory
+	// and unlink it from the open directories of the volume before its
+	// index goes away. The inode belongs to the handle, not to the listing
+	if (IFile->dirState)
+	{
+		IFile->dirState->ni = NULL;
+		ZeroMem(&r, sizeof(struct _reent));
+		ntfs_dirclose_r(&r, IFile->dirState);
+		FreePool(IFile->dirState);
+		IFile->dirState = NULL;
+	}
 
 	// Default error
 	Status = EFI_WARN_DELETE_FAILURE;
@@ -85,12 +98,6 @@ free:
 		ntfs_inode_close(ni);
 	}
 
-	if (IFile->dirState)
-	{
-		FreePool(IFile->dirState);
-		IFile->dirState = NULL;
-	}
-
 	if (IFile->fileState)
 	{
 		FreePool(IFile->fileState);
@@ -0,0 +1,152 @@
+/*++
+
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the Software
+License Agreement which accompanies this distribution.
+
+
+Module Name:
+
+  NtfsExtents.c
+
+Abstract:
+
+  Functions of the NTFS File Extents Protocol
+
+Revision History
+
+--*/
+
+#include "Ntfs.h"
+#include "ntfs/ntfsfile.h"
+#include "ntfs/extmap.h"
+
+//
+// Extents converted per call to the library, held on the stack
+//
+#define NTFS_EXTENT_BATCH  64
+
+EFI_STATUS
+EFIAPI
+NtfsGetFileExtents (
+  IN     NTFS_FILE_EXTENTS_PROTOCOL  *This,
+  IN     EFI_FILE_PROTOCOL           *File,
+  IN     UINT64                      Offset,
+  IN OUT UINTN                       *ExtentCount,
+  OUT    NTFS_FILE_EXTENT            *Extents
+  )
+/*++
+
+Routine Description:
+
+  Implements GetExtents() of the NTFS File Extents Protocol.
+
+Arguments:
+
+  This                  - Calling context.
+  File                  - The file whose extents are wanted.
+  Offset                - Byte offset of the first extent wanted.
+  ExtentCount           - Size of Extents in, extents returned out.
+  Extents               - Receives the extents of the file.
+
+Returns:
+
+  EFI_SUCCESS           - The extents were returned.
+  EFI_INVALID_PARAMETER - A parameter is invalid.
+  EFI_UNSUPPORTED       - File is a directory.
+  EFI_NOT_READY         - The volume is not mounted.
+  EFI_DEVICE_ERROR      - The runlist of the file could not be read.
+
+--*/
+{
+  NTFS_VOLUME   *Volume;
+  NTFS_IFILE    *IFile;
+  ntfs_extent   Ext[NTFS_EXTENT_BATCH];
+  EFI_STATUS    Status;
+  UINT32        BlockSize;
+  UINTN         Filled;
+  s64           LastPos;
+  int           Batch;
+  int           Index;
+  int           n;
+
+  if (This == NULL || File == NULL || ExtentCount == NULL ||
+      *ExtentCount == 0 || Extents == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Volume = VOLUME_FROM_EXTENTS_INTERFACE (This);
+  if (!Volume->Valid || Volume->vol == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  //
+  // Only handles of this driver carry an IFile around them
+  //
+  if (File->Read != NtfsRead) {
+    return EFI_INVALID_PARAMETER;
+  }
+  IFile = IFILE_FROM_FHAND (File);
+  if (IFile->Volume != Volume) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (IFile->Type != FSW_EFI_FILE_TYPE_FILE || IFile->fileState == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Convert through a fixed batch, so the size of Extents never decides
+  // an allocation. The library merges contiguous ranges within a call
+  // only, so the first extent of a batch is merged into the last one
+  // returned when it follows it on the device. Once Extents is full, one
+  // more extent is looked at for that, as a single large call would do.
+  //
+  Status    = EFI_SUCCESS;
+  Filled    = 0;
+  LastPos   = -1;
+  BlockSize = Volume->BlockIo->Media->BlockSize;
+
+  NtfsAcquireLock ();
+  Offset &= ~(UINT64) (Volume->vol->cluster_size - 1);
+  for (;;) {
+    Batch = NTFS_EXTENT_BATCH;
+    if (*ExtentCount - Filled < NTFS_EXTENT_BATCH) {
+      Batch = (int) MAX (*ExtentCount - Filled, 1);
+    }
+    n = ntfs_attr_get_extents (IFile->fileState->data_na, (s64) Offset, Ext, Batch);
+    if (n < 0) {
+      Status = EFI_DEVICE_ERROR;
+      break;
+    }
+
+    Index = 0;
+    if (n > 0 && Filled > 0 &&
+        Extents[Filled - 1].Flags == (Ext[0].flags & ~NTFS_EXTENT_LAST) &&
+        Extents[Filled - 1].FileOffset + Extents[Filled - 1].Length == (UINT64) Ext[0].offset &&
+        (Ext[0].pos < 0 ? LastPos < 0 : LastPos + (s64) Extents[Filled - 1].Length == Ext[0].pos)) {
+      Extents[Filled - 1].Length += Ext[0].length;
+      Extents[Filled - 1].Flags  |= Ext[0].flags & NTFS_EXTENT_LAST;
+      Index = 1;
+    }
+    for (; Index < n && Filled < *ExtentCount; Index++, Filled++) {
+      Extents[Filled].FileOffset = Ext[Index].offset;
+      Extents[Filled].Length     = Ext[Index].length;
+      Extents[Filled].Lba        = Ext[Index].pos < 0 ? 0 : DivU64x32 (Ext[Index].pos, BlockSize);
+      Extents[Filled].Flags      = Ext[Index].flags;
+      Extents[Filled].Reserved   = 0;
+      LastPos                    = Ext[Index].pos;
+    }
+    if (Index < n || n < Batch || (Ext[n - 1].flags & NTFS_EXTENT_LAST) != 0) {
+      break;
+    }
+    Offset = Ext[n - 1].offset + Ext[n - 1].length;
+  }
+  NtfsReleaseLock ();
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *ExtentCount = Filled;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/*++
+
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the Software
+License Agreement which accompanies this distribution.
+
+
+Module Name:
+
+  NtfsFileExtents.h
+
+Abstract:
+
+  NTFS File Extents Protocol. Installed by the NTFS driver next to its
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL, it tells where the data of a file opened
+  on the volume lies on the partition, so that a boot loader can read a
+  large file (a kernel, an initrd) with a few EFI_BLOCK_IO_PROTOCOL requests
+  of its own instead of many EFI_FILE_PROTOCOL.Read() calls. Ranges which
+  are not stored as they are (sparse, compressed, resident, encrypted or
+  past the initialized size) are flagged and must be read through the file.
+
+  The header does not depend on the driver and can be copied into the
+  application or boot loader that reads the extents.
+
+--*/
+
+#ifndef _NTFS_FILE_EXTENTS_H_
+#define _NTFS_FILE_EXTENTS_H_
+
+#define NTFS_FILE_EXTENTS_PROTOCOL_GUID \
+  { \
+    0x5c3b9f0e, 0x2a71, 0x4d8c, {0xa6, 0x13, 0x7e, 0x40, 0xd2, 0x95, 0x0b, 0xc8 } \
+  }
+
+#define NTFS_FILE_EXTENTS_PROTOCOL_REVISION  0x00010000
+
+typedef struct _NTFS_FILE_EXTENTS_PROTOCOL NTFS_FILE_EXTENTS_PROTOCOL;
+
+//
+// NTFS_FILE_EXTENT.Flags
+//
+#define NTFS_FILE_EXTENT_HOLE        0x00000001  // Sparse, reads as zeroes
+#define NTFS_FILE_EXTENT_UNINIT      0x00000002  // Past the initialized size, reads as zeroes
+#define NTFS_FILE_EXTENT_COMPRESSED  0x00000004  // In a compression unit stored compressed
+#define NTFS_FILE_EXTENT_RESIDENT    0x00000008  // Held in the MFT record
+#define NTFS_FILE_EXTENT_ENCRYPTED   0x00000010  // Stored encrypted
+#define NTFS_FILE_EXTENT_LAST        0x00000100  // Ends at the end of the file
+
+//
+// Extents whose data cannot be read from the partition as it is.
+//
+#define NTFS_FILE_EXTENT_NOT_DIRECT  (NTFS_FILE_EXTENT_HOLE | NTFS_FILE_EXTENT_UNINIT | \
+                                      NTFS_FILE_EXTENT_COMPRESSED | NTFS_FILE_EXTENT_RESIDENT | \
+                                      NTFS_FILE_EXTENT_ENCRYPTED)
+
+//
+// One range of a file. An extent without any NTFS_FILE_EXTENT_NOT_DIRECT
+// flag reads as the Length bytes of the partition from block Lba on; the
+// last block may hold bytes past the end of the file.
+//
+typedef struct {
+  UINT64  FileOffset;           // Byte offset of the range in the file
+  UINT64  Length;               // Bytes in the range
+  UINT64  Lba;                  // First block of the range on the partition, 0 if none
+  UINT32  Flags;                // NTFS_FILE_EXTENT_*
+  UINT32  Reserved;
+} NTFS_FILE_EXTENT;
+
+typedef
+EFI_STATUS
+(EFIAPI *NTFS_FILE_EXTENTS_GET) (
+  IN     NTFS_FILE_EXTENTS_PROTOCOL  *This,
+  IN     EFI_FILE_PROTOCOL           *File,
+  IN     UINT64                      Offset,
+  IN OUT UINTN                       *ExtentCount,
+  OUT    NTFS_FILE_EXTENT            *Extents
+  );
+/*++
+
+Routine Description:
+
+  Return the extents of a file from Offset on, in order and without gaps,
+  as many as fit in Extents. Offset is rounded down to a multiple of the
+  cluster size, so the first extent starts on a block boundary. The next
+  call usually starts where the last extent returned ends; the last extent
+  of the file carries NTFS_FILE_EXTENT_LAST.
+
+Arguments:
+
+  This                  - The protocol instance.
+  File                  - A file opened on the volume of This.
+  Offset                - Byte offset in the file of the first extent wanted.
+  ExtentCount           - On input the number of entries in Extents, on
+                          output the number of extents returned; 0 if
+                          Offset is at or past the end of the file.
+  Extents               - Receives the extents.
+
+Returns:
+
+  EFI_SUCCESS           - The extents were returned.
+  EFI_INVALID_PARAMETER - A parameter is NULL, ExtentCount is 0, or File
+                          was not opened on the volume of This.
+  EFI_UNSUPPORTED       - File is a directory.
+  EFI_NOT_READY         - The volume is not mounted.
+  EFI_DEVICE_ERROR      - The allocation of the file could not be read.
+
+--*/
+
+struct _NTFS_FILE_EXTENTS_PROTOCOL {
+  UINT64                  Revision;
+  NTFS_FILE_EXTENTS_GET   GetExtents;
+};
+
+extern EFI_GUID gNtfsFileExtentsProtocolGuid;
+
+#endif
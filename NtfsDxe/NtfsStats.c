@@ -0,0 +1,188 @@
+/*++
+
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the Software
+License Agreement which accompanies this distribution.
+
+
+Module Name:
+
+  NtfsStats.c
+
+Abstract:
+
+  Functions of the NTFS Volume Stats Protocol
+
+Revision History
+
+--*/
+
+#include "Ntfs.h"
+
+EFI_STATUS
+EFIAPI
+NtfsGetVolumeStats (
+  IN     NTFS_VOLUME_STATS_PROTOCOL  *This,
+  IN OUT NTFS_VOLUME_STATS           *Stats
+  )
+/*++
+
+Routine Description:
+
+  Implements GetStats() of the NTFS Volume Stats Protocol.
+
+Arguments:
+
+  This                  - Calling context.
+  Stats                 - Size set by the caller; receives the counters of
+                          the volume.
+
+Returns:
+
+  EFI_SUCCESS           - The counters were returned.
+  EFI_BUFFER_TOO_SMALL  - Stats->Size does not cover the Size and Reserved
+                          fields.
+  EFI_INVALID_PARAMETER - This or Stats is NULL.
+  EFI_NOT_READY         - The volume is not mounted.
+
+--*/
+{
+  NTFS_VOLUME       *Volume;
+  ntfs_volume_stats st;
+  NTFS_VOLUME_STATS Counters;
+
+  if (This == NULL || Stats == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The caller may have been built against an older, shorter structure
+  //
+  if (Stats->Size < OFFSET_OF (NTFS_VOLUME_STATS, DiskReads)) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Volume = VOLUME_FROM_STATS_INTERFACE (This);
+  if (!Volume->Valid || Volume->vol == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  NtfsAcquireLock ();
+  ntfs_volume_get_stats (Volume->vol, &st);
+  NtfsReleaseLock ();
+
+  ZeroMem (&Counters, sizeof (Counters));
+  Counters.Size               = (UINT32) MIN (Stats->Size, sizeof (Counters));
+  Counters.DiskReads          = st.dev_reads;
+  Counters.DiskReadBytes      = st.dev_read_bytes;
+  Counters.MftRecords         = st.mft_records;
+  Counters.IndexBlocks        = st.index_blocks;
+  Counters.CompressionBlocks  = st.compression_blocks;
+  Counters.CacheHits          = st.cache_hits;
+  Counters.CacheMisses        = st.cache_misses;
+  Counters.Allocations        = st.allocations;
+  Counters.PrefetchHits       = st.prefetch_hits;
+  Counters.PathIndexHits      = st.path_index_hits;
+
+  CopyMem (Stats, &Counters, Counters.Size);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+NtfsResetVolumeStats (
+  IN  NTFS_VOLUME_STATS_PROTOCOL  *This
+  )
+/*++
+
+Routine Description:
+
+  Implements Reset() of the NTFS Volume Stats Protocol.
+
+Arguments:
+
+  This                  - Calling context.
+
+Returns:
+
+  EFI_SUCCESS           - The counters were reset.
+  EFI_INVALID_PARAMETER - This is NULL.
+  EFI_NOT_READY         - The volume is not mounted.
+
+--*/
+{
+  NTFS_VOLUME *Volume;
+
+  if (This == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Volume = VOLUME_FROM_STATS_INTERFACE (This);
+  if (!Volume->Valid || Volume->vol == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  NtfsAcquireLock ();
+  ntfs_volume_reset_stats (Volume->vol);
+  NtfsReleaseLock ();
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+NtfsGetVolumeTrace (
+  IN     NTFS_VOLUME_STATS_PROTOCOL  *This,
+  IN OUT UINTN                       *BufferSize,
+  OUT    VOID                        *Buffer
+  )
+/*++
+
+Routine Description:
+
+  Implements GetTrace() of the NTFS Volume Stats Protocol.
+
+Arguments:
+
+  This                  - Calling context.
+  BufferSize            - Size of Buffer in, size of the trace out.
+  Buffer                - Receives the trace.
+
+Returns:
+
+  EFI_SUCCESS           - The trace was copied.
+  EFI_BUFFER_TOO_SMALL  - Buffer is too small for the trace.
+  EFI_INVALID_PARAMETER - This or BufferSize is NULL.
+  EFI_NOT_STARTED       - The volume is not traced.
+  EFI_NOT_READY         - The volume is not mounted.
+
+--*/
+{
+  NTFS_VOLUME *Volume;
+  EFI_STATUS  Status;
+  s64         Size;
+
+  if (This == NULL || BufferSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Volume = VOLUME_FROM_STATS_INTERFACE (This);
+  if (!Volume->Valid || Volume->vol == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  NtfsAcquireLock ();
+  Size = ntfs_device_trace_save (Volume->vol->dev, NULL, 0);
+  if (Size < 0) {
+    Status = EFI_NOT_STARTED;
+  } else if (Buffer == NULL || *BufferSize < (UINTN) Size) {
+    *BufferSize = (UINTN) Size;
+    Status = EFI_BUFFER_TOO_SMALL;
+  } else {
+    *BufferSize = (UINTN) ntfs_device_trace_save (Volume->vol->dev, Buffer, Size);
+    Status = EFI_SUCCESS;
+  }
+  NtfsReleaseLock ();
+
+  return Status;
+}
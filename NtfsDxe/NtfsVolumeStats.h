@@ -0,0 +1,159 @@
+/*++
+
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the Software
+License Agreement which accompanies this distribution.
+
+
+Module Name:
+
+  NtfsVolumeStats.h
+
+Abstract:
+
+  NTFS Volume Stats Protocol. Installed by the NTFS driver on every device
+  handle that carries its EFI_SIMPLE_FILE_SYSTEM_PROTOCOL, it reports what
+  the volume has cost since it was mounted: disk reads, metadata reads,
+  decompression, cache behaviour and allocations. When the driver is built
+  with an I/O trace (UEFI_IO_TRACE_SIZE), it also hands out the trace of the
+  last disk requests for offline replay.
+
+  The header does not depend on the driver and can be copied into the
+  application or boot loader that collects the counters.
+
+--*/
+
+#ifndef _NTFS_VOLUME_STATS_H_
+#define _NTFS_VOLUME_STATS_H_
+
+#define NTFS_VOLUME_STATS_PROTOCOL_GUID \
+  { \
+    0xeb5d1cf5, 0xede7, 0x44f4, {0x9b, 0x45, 0x82, 0x5b, 0xec, 0x63, 0xb1, 0x27 } \
+  }
+
+#define NTFS_VOLUME_STATS_PROTOCOL_REVISION  0x00010003
+
+typedef struct _NTFS_VOLUME_STATS_PROTOCOL NTFS_VOLUME_STATS_PROTOCOL;
+
+//
+// Counters of one volume. New counters are only ever appended, together with
+// a new protocol revision. The caller sets Size to sizeof (NTFS_VOLUME_STATS)
+// of the header it was built with; the driver fills no more than that and
+// sets Size to the number of bytes it filled.
+//
+typedef struct {
+  UINT32  Size;                 // IN: size of the buffer, OUT: bytes filled
+  UINT32  Reserved;
+  UINT64  DiskReads;            // EFI_DISK_IO_PROTOCOL.ReadDisk() calls
+  UINT64  DiskReadBytes;        // Bytes read by those calls
+  UINT64  MftRecords;           // MFT records read
+  UINT64  IndexBlocks;          // Directory index blocks read
+  UINT64  CompressionBlocks;    // Compression blocks decompressed
+  UINT64  CacheHits;            // Lookups satisfied by the metadata and sector caches
+  UINT64  CacheMisses;          // Lookups those caches could not satisfy
+  UINT64  Allocations;          // Driver allocations (all volumes)
+  //
+  // Revision 0x00010002
+  //
+  UINT64  PrefetchHits;         // Reads served from the boot profile prefetch
+  //
+  // Revision 0x00010003
+  //
+  UINT64  PathIndexHits;        // Paths opened through the path index
+} NTFS_VOLUME_STATS;
+
+typedef
+EFI_STATUS
+(EFIAPI *NTFS_VOLUME_STATS_GET) (
+  IN     NTFS_VOLUME_STATS_PROTOCOL  *This,
+  IN OUT NTFS_VOLUME_STATS           *Stats
+  );
+/*++
+
+Routine Description:
+
+  Return the counters of the volume since it was mounted or since the last
+  Reset(). Counters past Stats->Size are not returned, and counters the
+  driver does not know of are left untouched.
+
+Arguments:
+
+  This                  - The protocol instance.
+  Stats                 - Size set by the caller; receives the counters.
+
+Returns:
+
+  EFI_SUCCESS           - The counters were returned.
+  EFI_BUFFER_TOO_SMALL  - Stats->Size does not cover the Size and Reserved
+                          fields.
+  EFI_INVALID_PARAMETER - This or Stats is NULL.
+  EFI_NOT_READY         - The volume is not mounted.
+
+--*/
+
+typedef
+EFI_STATUS
+(EFIAPI *NTFS_VOLUME_STATS_RESET) (
+  IN  NTFS_VOLUME_STATS_PROTOCOL  *This
+  );
+/*++
+
+Routine Description:
+
+  Restart the counters of the volume from zero.
+
+Arguments:
+
+  This                  - The protocol instance.
+
+Returns:
+
+  EFI_SUCCESS           - The counters were reset.
+  EFI_INVALID_PARAMETER - This is NULL.
+  EFI_NOT_READY         - The volume is not mounted.
+
+--*/
+
+typedef
+EFI_STATUS
+(EFIAPI *NTFS_VOLUME_STATS_GET_TRACE) (
+  IN     NTFS_VOLUME_STATS_PROTOCOL  *This,
+  IN OUT UINTN                       *BufferSize,
+  OUT    VOID                        *Buffer
+  );
+/*++
+
+Routine Description:
+
+  Copy the I/O trace of the volume: an NTFS_IO_TRACE_HEADER followed by the
+  recorded disk requests, oldest first (see ntfs/device.h). Recording goes
+  on. Available from revision 0x00010001.
+
+Arguments:
+
+  This                  - The protocol instance.
+  BufferSize            - On input the size of Buffer, on output the size
+                          of the trace.
+  Buffer                - Receives the trace.
+
+Returns:
+
+  EFI_SUCCESS           - The trace was copied.
+  EFI_BUFFER_TOO_SMALL  - BufferSize was too small; it now holds the size
+                          needed.
+  EFI_INVALID_PARAMETER - This or BufferSize is NULL.
+  EFI_NOT_STARTED       - The driver does not trace this volume.
+  EFI_NOT_READY         - The volume is not mounted.
+
+--*/
+
+struct _NTFS_VOLUME_STATS_PROTOCOL {
+  UINT64                      Revision;
+  NTFS_VOLUME_STATS_GET       GetStats;
+  NTFS_VOLUME_STATS_RESET     Reset;
+  NTFS_VOLUME_STATS_GET_TRACE GetTrace;
+};
+
+extern EFI_GUID gNtfsVolumeStatsProtocolGuid;
+
+#endif
@@ -0,0 +1,234 @@
+/**
+ * membench.c - Host microbenchmark for the driver's memory primitives.
+ *
+ * Builds ../mem.c and ../memmove.c with their symbols renamed (see Makefile),
+ * checks them against the host C library on random sizes and alignments,
+ * then times them against the byte-at-a-time versions they replaced.
+ *
+ *   make membench && ./membench
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void *ntfs_memcpy(void *dst, const void *src, int size);
+void *ntfs_memset(void *dst, int pattern, int size);
+int ntfs_memcmp(const void *buf1, const void *buf2, int size);
+void *ntfs_memmove(void *dst, const void *src, int count);
+
+/* The previous libc.c / memmove.c implementations, kept as the baseline. */
+
+static void *old_memcpy(void *dst, void *src, int size)
+{
+	char *pDst = (char *) dst;
+	char *pSrc = (char *) src;
+
+	while(size-- > 0)
+		*pDst++ = *pSrc++;
+
+	return dst;
+}
+
+static void *old_memset(void *dst, int pattern, int size)
+{
+	char *pDst = (char *) dst;
+
+	while(size-- > 0)
+		*pDst++ = pattern;
+
+	return dst;
+}
+
+static int old_memcmp(void *dst, void *src, int size)
+{
+	char *pDst = (char *) dst;
+	char *pSrc = (char *) src;
+	int i;
+
+	for(i = 0; i < size; i++)
+	{
+		if (*pDst == *pSrc)
+		{
+			pDst++;
+			pSrc++;
+		}
+		else
+			return -1;
+	}
+
+	return 0;
+}
+
+static void *old_memmove(void *dst, const void *src, int count)
+{
+	void *ret = dst;
+
+	if (dst <= src || (char *)dst >= ((char *)src + count)) {
+		while (count--) {
+			*(char *)dst = *(char *)src;
+			dst = (char *)dst + 1;
+			src = (char *)src + 1;
+		}
+	} else {
+		dst = (char *)dst + count - 1;
+		src = (char *)src + count - 1;
+		while (count--) {
+			*(char *)dst = *(char *)src;
+			dst = (char *)dst - 1;
+			src = (char *)src - 1;
+		}
+	}
+
+	return ret;
+}
+
+#define ARENA_SIZE	(1 << 20)
+#define CHECK_ROUNDS	20000
+
+static unsigned char *arena_a, *arena_b, *arena_c;
+
+static int sign(int v)
+{
+	return (v > 0) - (v < 0);
+}
+
+static void fill_random(unsigned char *p, int n)
+{
+	while (n--)
+		*p++ = (unsigned char) rand();
+}
+
+static int check(void)
+{
+	int round, failures = 0;
+
+	for (round = 0; round < CHECK_ROUNDS; round++) {
+		int len = rand() % 2048;
+		int so = rand() % 64, doff = rand() % 64;
+		int shift = rand() % 64 - 32;
+		int c = rand() & 0xff;
+
+		fill_random(arena_a, 4096);
+		memcpy(arena_b, arena_a, 4096);
+		memcpy(arena_c, arena_a, 4096);
+
+		/* memcpy */
+		ntfs_memcpy(arena_b + doff, arena_a + so + 1024, len);
+		memcpy(arena_c + doff, arena_a + so + 1024, len);
+		if (memcmp(arena_b, arena_c, 4096)) {
+			printf("memcpy mismatch len %d src+%d dst+%d\n", len, so, doff);
+			failures++;
+		}
+
+		/* memset */
+		ntfs_memset(arena_b + doff, c, len);
+		memset(arena_c + doff, c, len);
+		if (memcmp(arena_b, arena_c, 4096)) {
+			printf("memset mismatch len %d dst+%d\n", len, doff);
+			failures++;
+		}
+
+		/* memmove, overlapping in both directions */
+		ntfs_memmove(arena_b + 1024 + shift, arena_b + 1024, len);
+		memmove(arena_c + 1024 + shift, arena_c + 1024, len);
+		if (memcmp(arena_b, arena_c, 4096)) {
+			printf("memmove mismatch len %d shift %d\n", len, shift);
+			failures++;
+		}
+
+		/* memcmp ordering */
+		memcpy(arena_b, arena_a, 4096);
+		if (len && (rand() & 1))
+			arena_b[so + rand() % len] ^= (unsigned char) (1 + rand() % 255);
+		if (sign(ntfs_memcmp(arena_a + so, arena_b + so, len)) !=
+				sign(memcmp(arena_a + so, arena_b + so, len))) {
+			printf("memcmp mismatch len %d off %d\n", len, so);
+			failures++;
+		}
+	}
+
+	return failures;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef void (*bench_fn)(int size, int misalign);
+
+static volatile int sink;
+
+static void b_old_memcpy(int size, int m)  { old_memcpy(arena_b + m, arena_a, size); }
+static void b_new_memcpy(int size, int m)  { ntfs_memcpy(arena_b + m, arena_a, size); }
+static void b_old_memset(int size, int m)  { old_memset(arena_b + m, 0, size); }
+static void b_new_memset(int size, int m)  { ntfs_memset(arena_b + m, 0, size); }
+static void b_old_memcmp(int size, int m)  { sink += old_memcmp(arena_c + m, arena_a + m, size); }
+static void b_new_memcmp(int size, int m)  { sink += ntfs_memcmp(arena_c + m, arena_a + m, size); }
+static void b_old_memmove(int size, int m) { old_memmove(arena_b + 8 + m, arena_b, size); }
+static void b_new_memmove(int size, int m) { ntfs_memmove(arena_b + 8 + m, arena_b, size); }
+
+static double run(bench_fn fn, int size, int misalign)
+{
+	long iters = (64L << 20) / size, i;
+	double t0;
+
+	if (iters < 16)
+		iters = 16;
+	fn(size, misalign);
+	t0 = now();
+	for (i = 0; i < iters; i++)
+		fn(size, misalign);
+	return (double) size * iters / (now() - t0) / (1 << 20);
+}
+
+int main(void)
+{
+	static const struct {
+		const char *name;
+		bench_fn old_fn, new_fn;
+	} ops[] = {
+		{ "memcpy",  b_old_memcpy,  b_new_memcpy },
+		{ "memset",  b_old_memset,  b_new_memset },
+		{ "memcmp",  b_old_memcmp,  b_new_memcmp },
+		{ "memmove", b_old_memmove, b_new_memmove },
+	};
+	static const int sizes[] = { 16, 512, 4096, 65536, 1 << 19 };
+	unsigned int o, s;
+	int failures;
+
+	arena_a = malloc(ARENA_SIZE);
+	arena_b = malloc(ARENA_SIZE + 64);
+	arena_c = malloc(ARENA_SIZE);
+	if (!arena_a || !arena_b || !arena_c)
+		return 1;
+
+	srand(1);
+	failures = check();
+	printf("correctness: %s (%d rounds)\n", failures ? "FAILED" : "ok", CHECK_ROUNDS);
+
+	fill_random(arena_a, ARENA_SIZE);
+	memcpy(arena_c, arena_a, ARENA_SIZE);
+
+	printf("%-8s %8s %5s %12s %12s %8s\n", "op", "size", "skew", "old MiB/s", "new MiB/s", "speedup");
+	for (o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+		for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			int skew;
+
+			for (skew = 0; skew <= 3; skew += 3) {
+				double before = run(ops[o].old_fn, sizes[s], skew);
+				double after = run(ops[o].new_fn, sizes[s], skew);
+
+				printf("%-8s %8d %5d %12.0f %12.0f %7.1fx\n", ops[o].name,
+				       sizes[s], skew, before, after, after / before);
+			}
+		}
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,952 @@
+#!/usr/bin/env python3
+"""Build small synthetic NTFS images for the host benchmarks.
+
+The images are produced from scratch, without mkntfs, so that the benchmark
+suite can run anywhere. They contain only what a read-only mount of the
+library needs: the system files, a cluster bitmap, an $MFT bitmap, directory
+B+trees in $INDEX_ROOT/$INDEX_ALLOCATION, and file data that is resident,
+contiguous, fragmented, sparse or LZNT1 compressed.
+
+    mkimage.py SHAPE OUTPUT [--files N] [--depth N] [--size BYTES] ...
+
+Run with --help for the list of shapes.
+"""
+
+import argparse
+import os
+import random
+import struct
+import sys
+
+SECTOR = 512
+MFT_RECORD = 1024
+INDEX_BLOCK = 4096
+NTFS_EPOCH = 116444736000000000
+
+AT_STANDARD_INFORMATION = 0x10
+AT_ATTRIBUTE_LIST = 0x20
+AT_FILE_NAME = 0x30
+AT_VOLUME_NAME = 0x60
+AT_VOLUME_INFORMATION = 0x70
+AT_DATA = 0x80
+AT_INDEX_ROOT = 0x90
+AT_INDEX_ALLOCATION = 0xA0
+AT_BITMAP = 0xB0
+
+ATTR_IS_COMPRESSED = 0x0001
+ATTR_IS_SPARSE = 0x8000
+
+FILE_ATTR_HIDDEN = 0x0002
+FILE_ATTR_SYSTEM = 0x0004
+FILE_ATTR_ARCHIVE = 0x0020
+FILE_ATTR_SPARSE_FILE = 0x0200
+FILE_ATTR_COMPRESSED = 0x0800
+FILE_ATTR_I30_INDEX_PRESENT = 0x10000000
+
+MFT_RECORD_IN_USE = 1
+MFT_RECORD_IS_DIRECTORY = 2
+
+INDEX_ENTRY_NODE = 1
+INDEX_ENTRY_END = 2
+
+FILE_NAME_POSIX = 0
+
+SYSTEM_FILES = ["$MFT", "$MFTMirr", "$LogFile", "$Volume", "$AttrDef", ".",
+                "$Bitmap", "$Boot", "$BadClus", "$Secure", "$UpCase",
+                "$Extend"]
+FIRST_USER_RECORD = 24
+
+ATTR_DEFS = [
+    ("$STANDARD_INFORMATION", 0x10, 0, 0x40, 48, 72),
+    ("$ATTRIBUTE_LIST", 0x20, 0, 0x80, 0, -1),
+    ("$FILE_NAME", 0x30, 1, 0x42, 68, 578),
+    ("$OBJECT_ID", 0x40, 0, 0x40, 0, 256),
+    ("$SECURITY_DESCRIPTOR", 0x50, 0, 0x80, 0, -1),
+    ("$VOLUME_NAME", 0x60, 0, 0x40, 2, 256),
+    ("$VOLUME_INFORMATION", 0x70, 0, 0x40, 12, 12),
+    ("$DATA", 0x80, 0, 0x00, 0, -1),
+    ("$INDEX_ROOT", 0x90, 0, 0x40, 0, -1),
+    ("$INDEX_ALLOCATION", 0xA0, 0, 0x80, 0, -1),
+    ("$BITMAP", 0xB0, 0, 0x80, 0, -1),
+    ("$REPARSE_POINT", 0xC0, 0, 0x80, 0, 16384),
+    ("$EA_INFORMATION", 0xD0, 0, 0x40, 8, 8),
+    ("$EA", 0xE0, 0, 0x00, 0, 65536),
+    ("$LOGGED_UTILITY_STREAM", 0x100, 0, 0x80, 0, 65536),
+]
+
+
+def align(n, a):
+    return (n + a - 1) & ~(a - 1)
+
+
+def utf16(s):
+    return s.encode("utf-16-le")
+
+
+def upcase_char(c):
+    if 0x61 <= c <= 0x7A or (0xE0 <= c <= 0xFE and c != 0xF7):
+        return c - 0x20
+    return c
+
+
+def collate_key(name):
+    units = struct.unpack("<%dH" % len(name), utf16(name))
+    return (tuple(upcase_char(c) for c in units), units)
+
+
+# ---------------------------------------------------------------------------
+# LZNT1
+
+
+def lznt1_chunk(data):
+    """Compress one chunk of at most 4096 bytes, returning the token stream."""
+    out = bytearray()
+    pos = 0
+    n = len(data)
+    table = {}
+    while pos < n:
+        flag_at = len(out)
+        out.append(0)
+        flags = 0
+        for bit in range(8):
+            if pos >= n:
+                break
+            lg = 0
+            i = pos - 1
+            while i >= 0x10:
+                i >>= 1
+                lg += 1
+            max_len = min((0xFFF >> lg) + 3, n - pos)
+            max_off = 1 << (4 + lg)
+            best_len = 0
+            best_off = 0
+            if pos >= 1 and max_len >= 3:
+                for cand in table.get(data[pos:pos + 3], ()):
+                    off = pos - cand
+                    if off > max_off:
+                        continue
+                    length = 3
+                    while length < max_len and data[cand + length] == data[pos + length]:
+                        length += 1
+                    if length > best_len:
+                        best_len, best_off = length, off
+                        if length == max_len:
+                            break
+            if best_len >= 3:
+                out += struct.pack("<H", ((best_off - 1) << (12 - lg)) | (best_len - 3))
+                flags |= 1 << bit
+                step = best_len
+            else:
+                out.append(data[pos])
+                step = 1
+            for p in range(pos, min(pos + step, n - 2)):
+                lst = table.setdefault(data[p:p + 3], [])
+                lst.insert(0, p)
+                del lst[8:]
+            pos += step
+        out[flag_at] = flags
+    return out
+
+
+def lznt1_compress(data):
+    """Compress a compression unit, returning None if it does not shrink."""
+    out = bytearray()
+    for ofs in range(0, len(data), 4096):
+        chunk = data[ofs:ofs + 4096]
+        tokens = lznt1_chunk(chunk)
+        if len(tokens) + 2 < len(chunk) + 2 and len(tokens) < 4096:
+            out += struct.pack("<H", 0xB000 | (len(tokens) + 2 - 3))
+            out += tokens
+        else:
+            chunk = chunk.ljust(4096, b"\0")
+            out += struct.pack("<H", 0x3000 | (4096 + 2 - 3))
+            out += chunk
+    return out
+
+
+# ---------------------------------------------------------------------------
+# Attribute and record encoding
+
+
+def mapping_pairs(runs):
+    """Encode [(lcn or None, length)] as NTFS mapping pairs."""
+    out = bytearray()
+    prev = 0
+    for lcn, length in runs:
+        lb = length.to_bytes(8, "little", signed=True)
+        nl = 8
+        while nl > 1 and lb[nl - 1] == 0 and lb[nl - 2] < 0x80:
+            nl -= 1
+        if lcn is None:
+            out.append(nl)
+            out += lb[:nl]
+            continue
+        delta = lcn - prev
+        db = delta.to_bytes(8, "little", signed=True)
+        nd = 8
+        while nd > 1 and ((db[nd - 1] == 0 and db[nd - 2] < 0x80) or
+                          (db[nd - 1] == 0xFF and db[nd - 2] >= 0x80)):
+            nd -= 1
+        out.append((nd << 4) | nl)
+        out += lb[:nl] + db[:nd]
+        prev = lcn
+    out.append(0)
+    return bytes(out)
+
+
+def merge_runs(runs):
+    merged = []
+    for lcn, length in runs:
+        if length == 0:
+            continue
+        if merged:
+            plcn, plen = merged[-1]
+            if (plcn is None and lcn is None) or \
+               (plcn is not None and lcn is not None and plcn + plen == lcn):
+                merged[-1] = (plcn, plen + length)
+                continue
+        merged.append((lcn, length))
+    return merged
+
+
+class Attr:
+    def __init__(self, type, name="", value=None, runs=None, data_size=0,
+                 flags=0, comp_unit=0, indexed=False, compressed_size=None,
+                 alloc_size=None, lowest_vcn=0):
+        self.type = type
+        self.name = name
+        self.value = value
+        self.runs = runs
+        self.data_size = data_size
+        self.flags = flags
+        self.comp_unit = comp_unit
+        self.indexed = indexed
+        self.compressed_size = compressed_size
+        self.alloc_size = alloc_size
+        self.lowest_vcn = lowest_vcn
+
+    def encode(self, instance, cluster_size):
+        name = utf16(self.name)
+        if self.runs is None:
+            name_ofs = 24
+            value_ofs = align(name_ofs + len(name), 8)
+            length = align(value_ofs + len(self.value), 8)
+            b = bytearray(length)
+            struct.pack_into("<IIBBHHHIHBB", b, 0, self.type, length, 0,
+                             len(self.name), name_ofs, self.flags, instance,
+                             len(self.value), value_ofs,
+                             1 if self.indexed else 0, 0)
+            b[name_ofs:name_ofs + len(name)] = name
+            b[value_ofs:value_ofs + len(self.value)] = self.value
+            return bytes(b)
+        extended = self.flags & (ATTR_IS_COMPRESSED | ATTR_IS_SPARSE)
+        name_ofs = 72 if extended else 64
+        mp = mapping_pairs(self.runs)
+        mp_ofs = align(name_ofs + len(name), 8)
+        length = align(mp_ofs + len(mp), 8)
+        vcns = sum(l for _, l in self.runs)
+        alloc = self.alloc_size if self.alloc_size is not None else vcns * cluster_size
+        size = self.data_size
+        if self.lowest_vcn:
+            # only the first extent of an attribute carries the sizes
+            alloc = size = 0
+        b = bytearray(length)
+        struct.pack_into("<IIBBHHHqqHB5xqqq", b, 0, self.type, length, 1,
+                         len(self.name), name_ofs, self.flags, instance,
+                         self.lowest_vcn, self.lowest_vcn + vcns - 1, mp_ofs,
+                         self.comp_unit, alloc, size, size)
+        if extended and not self.lowest_vcn:
+            cs = self.compressed_size
+            if cs is None:
+                cs = sum(l for lcn, l in self.runs if lcn is not None) * cluster_size
+            struct.pack_into("<q", b, 64, cs)
+        b[name_ofs:name_ofs + len(name)] = name
+        b[mp_ofs:mp_ofs + len(mp)] = mp
+        return bytes(b)
+
+
+def apply_fixup(buf, usa_ofs, size):
+    count = size // SECTOR
+    usn = 1
+    struct.pack_into("<H", buf, usa_ofs, usn)
+    for i in range(count):
+        end = (i + 1) * SECTOR - 2
+        buf[usa_ofs + 2 + 2 * i:usa_ofs + 4 + 2 * i] = buf[end:end + 2]
+        struct.pack_into("<H", buf, end, usn)
+
+
+def ntfs_time(t):
+    return NTFS_EPOCH + int(t * 10000000)
+
+
+# ---------------------------------------------------------------------------
+# Volume model
+
+
+class Node:
+    def __init__(self, name, parent, is_dir=False, content=b"",
+                 size=None, kind="plain", fragments=1, attrs=0):
+        self.name = name
+        self.parent = parent
+        self.is_dir = is_dir
+        self.children = []
+        self.content = content
+        self.size = len(content) if size is None else size
+        self.kind = kind            # plain, sparse, compressed
+        self.fragments = fragments
+        self.attrs = attrs
+        self.mft_no = None
+        self.seq_no = 1
+        self.extra = []             # additional Attr objects
+        self.data_attr = None
+        self.fn_value = None
+        self.ext_records = []       # mft numbers reserved for extents
+        if parent is not None:
+            parent.children.append(self)
+
+
+class Volume:
+    def __init__(self, size, cluster_size=4096, label="BENCH", seed=1,
+                 mft_fragments=1, timestamp=1500000000):
+        self.cluster_size = cluster_size
+        self.nr_sectors = size // SECTOR
+        self.nr_clusters = (self.nr_sectors - 1) * SECTOR // cluster_size
+        self.label = label
+        self.rand = random.Random(seed)
+        self.mft_fragments = mft_fragments
+        self.time = ntfs_time(timestamp)
+        self.bitmap = bytearray(align((self.nr_clusters + 7) // 8, 8))
+        self.next_lcn = 0
+        self.writes = []
+        self.root = Node(".", None, is_dir=True,
+                         attrs=FILE_ATTR_HIDDEN | FILE_ATTR_SYSTEM)
+        self.root.parent = self.root
+        # $Extend joins the root directory when the image is written
+        self.extend = Node("$Extend", None, is_dir=True,
+                           attrs=FILE_ATTR_HIDDEN | FILE_ATTR_SYSTEM)
+        self.extend.parent = self.root
+
+    # cluster allocation -------------------------------------------------
+
+    def mark(self, lcn, count):
+        for c in range(lcn, lcn + count):
+            self.bitmap[c >> 3] |= 1 << (c & 7)
+
+    def alloc(self, count, gap=0):
+        """Allocate count contiguous clusters, optionally leaving a gap first."""
+        self.next_lcn += gap
+        lcn = self.next_lcn
+        if lcn + count > self.nr_clusters:
+            raise SystemExit("image too small: need more than %d clusters"
+                             % self.nr_clusters)
+        self.mark(lcn, count)
+        self.next_lcn += count
+        return lcn
+
+    def alloc_runs(self, count, fragments=1):
+        runs = []
+        left = count
+        for i in range(fragments):
+            n = left // (fragments - i)
+            if n == 0:
+                continue
+            runs.append((self.alloc(n, gap=1 if i else 0), n))
+            left -= n
+        return runs
+
+    def write_runs(self, runs, data):
+        ofs = 0
+        for lcn, n in runs:
+            if lcn is not None:
+                chunk = data[ofs:ofs + n * self.cluster_size]
+                if chunk.strip(b"\0"):
+                    self.writes.append((lcn * self.cluster_size, bytes(chunk)))
+            ofs += n * self.cluster_size
+
+    # building ---------------------------------------------------------------
+
+    def add_dir(self, parent, name):
+        return Node(name, parent, is_dir=True)
+
+    def add_file(self, parent, name, content=b"", **kw):
+        return Node(name, parent, content=content, **kw)
+
+    def nonresident(self, data, fragments=1, size=None):
+        size = len(data) if size is None else size
+        clusters = (size + self.cluster_size - 1) // self.cluster_size
+        runs = self.alloc_runs(clusters, fragments) if clusters else []
+        self.write_runs(runs, data)
+        return runs
+
+    def estimate_runs(self, node):
+        if node.is_dir:
+            return 0
+        if node.kind == "plain":
+            return node.fragments if node.size > 600 else 0
+        if node.kind == "sparse":
+            return 2 * len(node.content) + 1
+        return 2 * ((node.size + 16 * self.cluster_size - 1) //
+                    (16 * self.cluster_size))
+
+    def data_attr(self, node):
+        cs = self.cluster_size
+        if node.kind == "plain":
+            if node.size <= 600:
+                return Attr(AT_DATA, value=node.content)
+            runs = self.nonresident(node.content, node.fragments)
+            return Attr(AT_DATA, runs=runs, data_size=node.size)
+        if node.kind == "sparse":
+            # node.content is a list of (offset, bytes) extents
+            clusters = (node.size + cs - 1) // cs
+            runs = []
+            vcn = 0
+            for ofs, blob in sorted(node.content):
+                first = ofs // cs
+                last = (ofs + len(blob) + cs - 1) // cs
+                if first > vcn:
+                    runs.append((None, first - vcn))
+                pad = blob.rjust(len(blob) + ofs - first * cs, b"\0")
+                lcn = self.alloc(last - first, gap=1)
+                self.write_runs([(lcn, last - first)], pad)
+                runs.append((lcn, last - first))
+                vcn = last
+            if clusters > vcn:
+                runs.append((None, clusters - vcn))
+            runs = merge_runs(runs)
+            node.attrs |= FILE_ATTR_SPARSE_FILE
+            return Attr(AT_DATA, runs=runs, data_size=node.size,
+                        flags=ATTR_IS_SPARSE)
+        if node.kind == "compressed":
+            unit = 16 * cs
+            runs = []
+            data = node.content
+            for ofs in range(0, align(node.size, unit), unit):
+                chunk = data[ofs:ofs + unit].ljust(unit, b"\0")
+                if not chunk.strip(b"\0"):
+                    runs.append((None, 16))
+                    continue
+                comp = lznt1_compress(chunk)
+                n = (len(comp) + cs - 1) // cs
+                if n >= 16:
+                    lcn = self.alloc(16, gap=self.rand.randrange(2))
+                    self.write_runs([(lcn, 16)], chunk)
+                    runs.append((lcn, 16))
+                else:
+                    lcn = self.alloc(n, gap=self.rand.randrange(2))
+                    self.write_runs([(lcn, n)], comp)
+                    runs.append((lcn, n))
+                    runs.append((None, 16 - n))
+            node.attrs |= FILE_ATTR_COMPRESSED
+            compressed = sum(l for lcn, l in runs if lcn is not None) * cs
+            return Attr(AT_DATA, runs=merge_runs(runs), data_size=node.size,
+                        flags=ATTR_IS_COMPRESSED, comp_unit=4,
+                        compressed_size=compressed)
+        raise ValueError(node.kind)
+
+    # serialization -----------------------------------------------------
+
+    def std_info(self, attrs):
+        t = self.time
+        return struct.pack("<qqqqIIIIIIQQ", t, t, t, t, attrs, 0, 0, 0, 0,
+                           0x100, 0, 0)
+
+    def file_name(self, node, alloc, size):
+        name = utf16(node.name)
+        attrs = node.attrs | (FILE_ATTR_I30_INDEX_PRESENT if node.is_dir else 0)
+        if not node.is_dir and not attrs:
+            attrs = FILE_ATTR_ARCHIVE
+        t = self.time
+        return struct.pack("<QqqqqqqIIBB", self.mref(node.parent), t, t, t, t,
+                           alloc, size, attrs, 0, len(node.name),
+                           FILE_NAME_POSIX) + name
+
+    def mref(self, node):
+        return node.mft_no | (node.seq_no << 48)
+
+    def record(self, node, attrs, flags=MFT_RECORD_IN_USE, base=None,
+               mft_no=None):
+        mft_no = node.mft_no if mft_no is None else mft_no
+        b = bytearray(MFT_RECORD)
+        attrs = sorted(attrs, key=lambda a: (a.type, a.name))
+        ofs = 56
+        for inst, a in enumerate(attrs):
+            enc = a.encode(inst, self.cluster_size)
+            if ofs + len(enc) + 8 > MFT_RECORD:
+                raise SystemExit("mft record %d overflows" % mft_no)
+            b[ofs:ofs + len(enc)] = enc
+            ofs += len(enc)
+        struct.pack_into("<II", b, ofs, 0xFFFFFFFF, 0)
+        ofs += 8
+        struct.pack_into("<4sHHqHHHHIIQHHI", b, 0, b"FILE", 48,
+                         MFT_RECORD // SECTOR + 1, 0, node.seq_no,
+                         0 if base else 1, 56, flags, ofs,
+                         MFT_RECORD, base or 0, len(attrs), 0, mft_no)
+        return b
+
+    def fits(self, attrs):
+        return 56 + 8 + sum(len(a.encode(0, self.cluster_size))
+                            for a in attrs) <= MFT_RECORD
+
+    def split_extents(self, a):
+        """Split a non-resident attribute into extents of one record each."""
+        cs = self.cluster_size
+        room = MFT_RECORD - 56 - 8 - 72 - 8 - 8
+        unit = 16 if a.flags & ATTR_IS_COMPRESSED else 1
+        extents, cur, vcn, first = [], [], 0, 0
+        for run in a.runs:
+            # cut only on compression unit boundaries
+            if cur and vcn % unit == 0 and \
+               len(mapping_pairs(cur + [run])) > room:
+                extents.append((first, cur))
+                cur, first = [], vcn
+            cur.append(run)
+            vcn += run[1]
+        extents.append((first, cur))
+        compressed = a.compressed_size
+        if compressed is None:
+            compressed = sum(l for lcn, l in a.runs if lcn is not None) * cs
+        return [Attr(a.type, a.name, runs=r, data_size=a.data_size,
+                     flags=a.flags, comp_unit=a.comp_unit,
+                     compressed_size=compressed,
+                     alloc_size=sum(l for _, l in a.runs) * cs if not lv else None,
+                     lowest_vcn=lv)
+                for lv, r in extents]
+
+    def attr_list_records(self, node, attrs, big):
+        """Records of a file whose attribute big does not fit its record.
+
+        The attribute moves to extension records, one extent each, listed
+        with the base record's own attributes in an $ATTRIBUTE_LIST.
+        """
+        base = sorted(attrs, key=lambda a: (a.type, a.name))
+        extents = self.split_extents(big)
+        if len(extents) > len(node.ext_records):
+            raise SystemExit("mft record %d needs %d extension records, %d "
+                             "reserved" % (node.mft_no, len(extents),
+                                           len(node.ext_records)))
+        entries = []
+        # the base record instances follow its sorted attribute order, with
+        # the $ATTRIBUTE_LIST itself after $STANDARD_INFORMATION
+        inst = 0
+        for a in base:
+            if inst == 1:
+                inst += 1
+            entries.append((a.type, a.name, 0, self.mref(node), inst))
+            inst += 1
+        for (a, no) in zip(extents, node.ext_records):
+            entries.append((a.type, a.name, a.lowest_vcn,
+                            no | (node.seq_no << 48), 0))
+        entries.sort(key=lambda e: (e[0], e[1], e[2]))
+        al = bytearray()
+        for t, name, lv, mref, inst in entries:
+            nm = utf16(name)
+            length = align(26 + len(nm), 8)
+            e = bytearray(length)
+            struct.pack_into("<IHBBqQH", e, 0, t, length, len(name), 26, lv,
+                             mref, inst)
+            e[26:26 + len(nm)] = nm
+            al += e
+        if len(al) <= 600:
+            lst = Attr(AT_ATTRIBUTE_LIST, value=bytes(al))
+        else:
+            lst = Attr(AT_ATTRIBUTE_LIST, runs=self.nonresident(bytes(al)),
+                       data_size=len(al))
+        recs = {node.mft_no: self.record(node, [base[0], lst] + base[1:])}
+        for a, no in zip(extents, node.ext_records):
+            recs[no] = self.record(node, [a], base=self.mref(node), mft_no=no)
+        return recs
+
+    def index_entry(self, child, vcn=None):
+        key = child.fn_value
+        length = align(16 + len(key), 8) + (8 if vcn is not None else 0)
+        b = bytearray(length)
+        struct.pack_into("<QHHHH", b, 0, self.mref(child), length, len(key),
+                         INDEX_ENTRY_NODE if vcn is not None else 0, 0)
+        b[16:16 + len(key)] = key
+        if vcn is not None:
+            struct.pack_into("<q", b, length - 8, vcn)
+        return bytes(b)
+
+    def end_entry(self, vcn=None):
+        length = 16 + (8 if vcn is not None else 0)
+        b = bytearray(length)
+        flags = INDEX_ENTRY_END | (INDEX_ENTRY_NODE if vcn is not None else 0)
+        struct.pack_into("<QHHHH", b, 0, 0, length, 0, flags, 0)
+        if vcn is not None:
+            struct.pack_into("<q", b, length - 8, vcn)
+        return bytes(b)
+
+    def index_block(self, vcn, entries, is_node):
+        b = bytearray(INDEX_BLOCK)
+        body = b"".join(entries)
+        if 0x40 + len(body) > INDEX_BLOCK:
+            raise SystemExit("index block overflow")
+        struct.pack_into("<4sHHqqIIIB", b, 0, b"INDX", 0x28,
+                         INDEX_BLOCK // SECTOR + 1, 0, vcn, 0x28,
+                         0x28 + len(body), INDEX_BLOCK - 0x18,
+                         1 if is_node else 0)
+        b[0x40:0x40 + len(body)] = body
+        apply_fixup(b, 0x28, INDEX_BLOCK)
+        return b
+
+    def plan_index(self, children, root_room):
+        """Split sorted children into index blocks until the top fits root_room."""
+        items = [(c, None) for c in children]
+        last = None
+        blocks = []
+        block_vcn = INDEX_BLOCK // self.cluster_size if INDEX_BLOCK >= self.cluster_size else INDEX_BLOCK // SECTOR
+
+        def size_of(level, last):
+            return sum(len(self.index_entry(c, v)) for c, v in level) + \
+                len(self.end_entry(last))
+
+        while 32 + size_of(items, last) > root_room:
+            # split this level into index blocks, promoting one entry
+            # between each pair of blocks to the level above
+            cap = INDEX_BLOCK - 0x40
+            upper = []
+            cur = []
+            used = 0
+            for c, v in items:
+                e = self.index_entry(c, v)
+                if cur and used + len(e) + 24 > cap:
+                    blocks.append(cur + [self.end_entry(v)])
+                    upper.append((c, (len(blocks) - 1) * block_vcn))
+                    cur, used = [], 0
+                    continue
+                cur.append(e)
+                used += len(e)
+            blocks.append(cur + [self.end_entry(last)])
+            items, last = upper, (len(blocks) - 1) * block_vcn
+        return items, last, blocks, 32 + size_of(items, last)
+
+    def build_index(self, node, avail):
+        """Return (root value, [Attr for allocation and bitmap])."""
+        children = sorted(node.children, key=lambda c: collate_key(c.name))
+        block_vcn = INDEX_BLOCK // self.cluster_size if INDEX_BLOCK >= self.cluster_size else INDEX_BLOCK // SECTOR
+        room = avail
+        while True:
+            items, last, blocks, used = self.plan_index(children, room)
+            if blocks:
+                # $INDEX_ALLOCATION with a few runs plus the resident $BITMAP
+                used += 72 + 8 + 32 + 32 + align((len(blocks) + 7) // 8, 8)
+            if used <= avail:
+                break
+            room -= 64
+        entries = b"".join(self.index_entry(c, v) for c, v in items) + \
+            self.end_entry(last)
+        large = last is not None
+        root = struct.pack("<IIIbxxx", AT_FILE_NAME, 1, INDEX_BLOCK,
+                           INDEX_BLOCK // self.cluster_size
+                           if INDEX_BLOCK >= self.cluster_size else -9)
+        root += struct.pack("<IIIBxxx", 16, 16 + len(entries),
+                            16 + len(entries), 1 if large else 0)
+        root += entries
+        extra = []
+        if blocks:
+            data = bytearray()
+            for n, ents in enumerate(blocks):
+                is_node = any(struct.unpack_from("<H", e, 12)[0] & INDEX_ENTRY_NODE
+                              for e in ents)
+                data += self.index_block(n * block_vcn, ents, is_node)
+            runs = self.nonresident(bytes(data), self.rand.choice([1, 1, 2]))
+            extra.append(Attr(AT_INDEX_ALLOCATION, "$I30", runs=runs,
+                              data_size=len(data)))
+            bm = bytearray(align((len(blocks) + 7) // 8, 8))
+            for n in range(len(blocks)):
+                bm[n >> 3] |= 1 << (n & 7)
+            extra.append(Attr(AT_BITMAP, "$I30", value=bytes(bm)))
+        return root, extra
+
+    def write(self, path):
+        cs = self.cluster_size
+        # number the records
+        user = []
+
+        def walk(n):
+            for c in n.children:
+                user.append(c)
+                if c.is_dir:
+                    walk(c)
+        walk(self.root)
+        walk(self.extend)
+        sysnodes = {".": self.root, "$Extend": self.extend}
+        for i, name in enumerate(SYSTEM_FILES):
+            if name not in sysnodes:
+                sysnodes[name] = Node(name, self.root,
+                                      attrs=FILE_ATTR_HIDDEN | FILE_ATTR_SYSTEM)
+            n = sysnodes[name]
+            n.mft_no = i
+            n.seq_no = i if i else 1
+        self.root.children.append(self.extend)
+        for i, n in enumerate(user):
+            n.mft_no = FIRST_USER_RECORD + i
+        # extension records for files with too many runs for one record,
+        # numbered after the base records and reserved from an estimate of
+        # eight bytes of mapping pairs per run
+        next_no = FIRST_USER_RECORD + len(user)
+        for n in user:
+            runs = self.estimate_runs(n)
+            if runs * 8 > 600:
+                count = (runs * 8 + 799) // 800 + 1
+                n.ext_records = list(range(next_no, next_no + count))
+                next_no += count
+        nr_records = align(next_no, 64)
+        mft_clusters = nr_records * MFT_RECORD // cs
+
+        # fixed metadata placement
+        boot_clusters = max(1, 8192 // cs)
+        self.alloc(boot_clusters)
+        mft_runs = self.alloc_runs(mft_clusters, self.mft_fragments)
+        mirr = self.alloc(max(1, 4 * MFT_RECORD // cs))
+        log_runs = self.nonresident(b"\xff" * 65536, size=65536)
+        upcase = bytearray()
+        for c in range(65536):
+            upcase += struct.pack("<H", upcase_char(c))
+        upcase_runs = self.nonresident(bytes(upcase))
+        attrdef = bytearray()
+        for name, t, disp, flags, mn, mx in ATTR_DEFS:
+            e = bytearray(160)
+            e[0:len(utf16(name))] = utf16(name)
+            struct.pack_into("<IIIIqq", e, 128, t, 0, disp, flags, mn, mx)
+            attrdef += e
+        attrdef += bytes(160)
+        attrdef_runs = self.nonresident(bytes(attrdef))
+        bitmap_clusters = (len(self.bitmap) + cs - 1) // cs
+        bitmap_lcn = self.alloc(bitmap_clusters)
+        mftbmp_size = align(nr_records // 8, 8)
+        mftbmp_lcn = self.alloc((mftbmp_size + cs - 1) // cs)
+
+        # file data, then directories from the deepest up
+        order = [n for n in user if not n.is_dir]
+        dirs = [n for n in user if n.is_dir]
+        for n in order:
+            n.data_attr = self.data_attr(n)
+
+        def fn_for(n):
+            if n.is_dir:
+                return self.file_name(n, 0, 0)
+            a = n.data_attr
+            if a is None:
+                return self.file_name(n, 0, 0)
+            if a.runs is None:
+                return self.file_name(n, align(len(a.value), 8), len(a.value))
+            return self.file_name(n, sum(l for _, l in a.runs) * cs, a.data_size)
+
+        # system file data attributes
+        sysdata = {
+            "$MFT": Attr(AT_DATA, runs=mft_runs, data_size=nr_records * MFT_RECORD),
+            "$MFTMirr": Attr(AT_DATA, runs=[(mirr, max(1, 4 * MFT_RECORD // cs))],
+                             data_size=4 * MFT_RECORD),
+            "$LogFile": Attr(AT_DATA, runs=log_runs, data_size=65536),
+            "$Volume": Attr(AT_DATA, value=b""),
+            "$AttrDef": Attr(AT_DATA, runs=attrdef_runs, data_size=len(attrdef)),
+            "$Bitmap": Attr(AT_DATA, runs=[(bitmap_lcn, bitmap_clusters)],
+                            data_size=len(self.bitmap)),
+            "$Boot": Attr(AT_DATA, runs=[(0, boot_clusters)],
+                          data_size=boot_clusters * cs),
+            "$BadClus": Attr(AT_DATA, value=b""),
+            "$Secure": Attr(AT_DATA, value=b""),
+            "$UpCase": Attr(AT_DATA, runs=upcase_runs, data_size=len(upcase)),
+        }
+        for name, a in sysdata.items():
+            sysnodes[name].data_attr = a
+        for n in list(sysnodes.values()) + user:
+            n.fn_value = fn_for(n)
+
+        records = {}
+
+        def dir_record(n):
+            base = [Attr(AT_STANDARD_INFORMATION, value=self.std_info(n.attrs))]
+            base.append(Attr(AT_FILE_NAME, value=n.fn_value, indexed=True))
+            base += n.extra
+            used = 56 + 8 + sum(len(a.encode(0, cs)) for a in base)
+            # room for the $INDEX_ROOT value, allocation and bitmap attributes
+            root, extra = self.build_index(n, MFT_RECORD - used)
+            attrs = base + [Attr(AT_INDEX_ROOT, "$I30", value=root)] + extra
+            return self.record(n, attrs, MFT_RECORD_IN_USE | MFT_RECORD_IS_DIRECTORY)
+
+        def depth(n):
+            d = 0
+            while n.parent is not n:
+                n = n.parent
+                d += 1
+            return d
+        for n in sorted(dirs, key=depth, reverse=True):
+            records[n.mft_no] = dir_record(n)
+        records[11] = dir_record(self.extend)
+        records[5] = dir_record(self.root)
+
+        in_use = []
+        for n in order:
+            attrs = [Attr(AT_STANDARD_INFORMATION, value=self.std_info(n.attrs or FILE_ATTR_ARCHIVE)),
+                     Attr(AT_FILE_NAME, value=n.fn_value, indexed=True),
+                     n.data_attr] + n.extra
+            if self.fits(attrs) or n.data_attr.runs is None:
+                records[n.mft_no] = self.record(n, attrs)
+                continue
+            attrs.remove(n.data_attr)
+            recs = self.attr_list_records(n, attrs, n.data_attr)
+            records.update(recs)
+            in_use += [no for no in recs if no != n.mft_no]
+
+        # $MFT bitmap and the volume bitmap are final now
+        mftbmp = bytearray(mftbmp_size)
+        for no in list(range(16)) + [n.mft_no for n in user] + in_use:
+            mftbmp[no >> 3] |= 1 << (no & 7)
+        self.writes.append((mftbmp_lcn * cs, bytes(mftbmp)))
+        sysdata["$MFT_BITMAP"] = Attr(AT_BITMAP, runs=[(mftbmp_lcn, (mftbmp_size + cs - 1) // cs)],
+                                      data_size=mftbmp_size)
+
+        vol_name = utf16(self.label)
+        for i, name in enumerate(SYSTEM_FILES):
+            if name in (".", "$Extend"):
+                continue
+            n = sysnodes[name]
+            attrs = [Attr(AT_STANDARD_INFORMATION,
+                          value=self.std_info(FILE_ATTR_HIDDEN | FILE_ATTR_SYSTEM)),
+                     Attr(AT_FILE_NAME, value=n.fn_value, indexed=True),
+                     sysdata[name]]
+            if name == "$MFT":
+                attrs.append(sysdata["$MFT_BITMAP"])
+            if name == "$Volume":
+                attrs.append(Attr(AT_VOLUME_NAME, value=vol_name))
+                attrs.append(Attr(AT_VOLUME_INFORMATION,
+                                  value=struct.pack("<QBBH", 0, 3, 1, 0)))
+            records[i] = self.record(n, attrs)
+        for i in range(12, 16):
+            dummy = Node("", None)
+            dummy.mft_no = i
+            records[i] = self.record(dummy, [
+                Attr(AT_STANDARD_INFORMATION,
+                     value=self.std_info(FILE_ATTR_HIDDEN | FILE_ATTR_SYSTEM)),
+                Attr(AT_DATA, value=b"")])
+        self.writes.append((bitmap_lcn * cs, bytes(self.bitmap)))
+
+        mft = bytearray(nr_records * MFT_RECORD)
+        for no, rec in records.items():
+            apply_fixup(rec, 48, MFT_RECORD)
+            mft[no * MFT_RECORD:(no + 1) * MFT_RECORD] = rec
+        self.write_runs(mft_runs, mft)
+        self.writes.append((mirr * cs, bytes(mft[:4 * MFT_RECORD])))
+        self.write_runs(log_runs, b"\xff" * 65536)
+
+        boot = bytearray(SECTOR)
+        struct.pack_into("<3s8sHBHBHHBHHHII", boot, 0, b"\xebR\x90", b"NTFS    ",
+                         SECTOR, cs // SECTOR, 0, 0, 0, 0, 0xF8, 0, 63, 255, 0, 0)
+        struct.pack_into("<BBBBqqqbxxxbxxxQI", boot, 0x24, 0x80, 0, 0x80, 0,
+                         self.nr_sectors - 1, mft_runs[0][0], mirr, -10, 1,
+                         self.rand.getrandbits(64), 0)
+        struct.pack_into("<H", boot, 510, 0xAA55)
+
+        with open(path, "wb") as f:
+            f.truncate(self.nr_sectors * SECTOR)
+            f.seek(0)
+            f.write(boot)
+            f.seek((self.nr_sectors - 1) * SECTOR)
+            f.write(boot)
+            for ofs, blob in self.writes:
+                f.seek(ofs)
+                f.write(blob)
+
+
+# ---------------------------------------------------------------------------
+# Shapes
+
+
+def pattern(rand, size, compressible=False):
+    if compressible:
+        words = [b"alpha ", b"beta ", b"gamma ", b"delta ", b"ntfs ",
+                 b"cluster ", b"record ", b"index\n"]
+        out = bytearray()
+        while len(out) < size:
+            out += rand.choice(words)
+        return bytes(out[:size])
+    return rand.getrandbits(size * 8).to_bytes(size, "little") if size else b""
+
+
+def shape_flat(vol, args):
+    d = vol.add_dir(vol.root, "flat")
+    for i in range(args.files):
+        size = vol.rand.choice([0, 100, 500, 3000, 20000])
+        vol.add_file(d, "file%06d.dat" % i, pattern(vol.rand, size))
+
+
+def shape_deep(vol, args):
+    per = max(1, args.files // max(1, args.depth))
+    d = vol.root
+    for level in range(args.depth):
+        d = vol.add_dir(d, "level%02d" % level)
+        for i in range(per):
+            vol.add_file(d, "f%02d_%04d.txt" % (level, i), pattern(vol.rand, 200, True))
+    vol.add_file(d, "leaf.txt", b"bottom of the tree\n")
+
+
+def shape_fragmented(vol, args):
+    vol.add_file(vol.root, "fragmented.bin", pattern(vol.rand, args.size),
+                 fragments=args.fragments)
+
+
+def shape_compressed(vol, args):
+    vol.add_file(vol.root, "compressed.txt", pattern(vol.rand, args.size, True),
+                 kind="compressed")
+
+
+def shape_sparse(vol, args):
+    extents = []
+    step = max(args.size // 16, 1 << 16)
+    for ofs in range(0, args.size - 4096, step * 2):
+        extents.append((ofs + step, pattern(vol.rand, 8192)))
+    extents = [(o, b) for o, b in extents if o + len(b) <= args.size]
+    vol.add_file(vol.root, "sparse.bin", extents, size=args.size, kind="sparse")
+
+
+def shape_mftfrag(vol, args):
+    vol.mft_fragments = args.fragments
+    d = vol.add_dir(vol.root, "many")
+    for i in range(args.files):
+        vol.add_file(d, "r%06d" % i, pattern(vol.rand, 64))
+
+
+def shape_mixed(vol, args):
+    shape_deep(vol, args)
+    docs = vol.add_dir(vol.root, "docs")
+    vol.add_file(docs, "readme.txt", b"synthetic NTFS image\n")
+    vol.add_file(docs, "big.bin", pattern(vol.rand, 300000), fragments=4)
+    vol.add_file(docs, "compressed.txt", pattern(vol.rand, 200000, True),
+                 kind="compressed")
+    vol.add_file(docs, "sparse.bin", [(1 << 20, b"x" * 5000)], size=4 << 20,
+                 kind="sparse")
+
+
+SHAPES = {
+    "flat": shape_flat,
+    "deep": shape_deep,
+    "fragmented": shape_fragmented,
+    "compressed": shape_compressed,
+    "sparse": shape_sparse,
+    "mftfrag": shape_mftfrag,
+    "mixed": shape_mixed,
+}
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__,
+                                formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("shape", choices=sorted(SHAPES))
+    p.add_argument("output")
+    p.add_argument("--image-size", type=int, default=64 << 20)
+    p.add_argument("--files", type=int, default=1000)
+    p.add_argument("--depth", type=int, default=8)
+    p.add_argument("--size", type=int, default=4 << 20)
+    p.add_argument("--fragments", type=int, default=64)
+    p.add_argument("--seed", type=int, default=1)
+    args = p.parse_args()
+
+    vol = Volume(args.image_size, seed=args.seed)
+    SHAPES[args.shape](vol, args)
+    vol.write(args.output)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,701 @@
+/**
+ * ntfsbench - Time the core read paths of the library on a volume image.
+ *
+ *	ntfsbench [-m] [-r reps] image op[:arg] ...
+ *
+ * Each operation is repeated @reps times on one mounted volume (mount itself
+ * remounts every time), fast ones in an inner loop, and its timings per
+ * iteration are written to stdout as JSON, one object per operation, for
+ * bench/run.py to collect and compare.
+ *
+ *	mount		ntfs_device_mount() and ntfs_umount()
+ *	lookup:PATH	ntfs_pathname_to_inode() of PATH
+ *	lookupdir:DIR	ntfs_pathname_to_inode() of every entry of DIR
+ *	readdir:DIR	ntfs_readdir() of DIR
+ *	list:DIR	the driver's directory listing: ntfs_diropen_r() and, per
+ *			entry, the inode and $DATA opens of fsw_efi_dir_read()
+ *			followed by ntfs_dirnext_r()
+ *	read:PATH	ntfs_attr_pread() of the whole unnamed $DATA
+ *	cread:PATH	ntfs_compressed_attr_pread() of the whole unnamed $DATA
+ *	readv:PATH	ntfs_attr_preadv() of the whole unnamed $DATA, in the
+ *			same pieces as read, all in one call
+ *	readall:DIR	ntfs_attr_pread() of the unnamed $DATA of every file
+ *			of DIR, one file after the other
+ *	readvall:DIR	ntfs_attr_preadv() of the same, all in one call
+ *
+ * Paths use '/' or '\' and are relative to the root. Each object also
+ * carries the volume counters (ntfs_volume_get_stats()) of the first, cold
+ * run of the operation; for mount, those of the volume it mounted.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "types.h"
+#include "layout.h"
+#include "volume.h"
+#include "inode.h"
+#include "attrib.h"
+#include "compress.h"
+#include "readv.h"
+#include "dir.h"
+#include "unistr.h"
+#include "logging.h"
+#include "ntfsinternal.h"
+#include "ntfsdir.h"
+#include "image_io.h"
+
+#define BENCH_READ_SIZE		(64 * 1024)
+#define BENCH_READV_GAP		(64 * 1024)	/* gap read over by readv */
+#define BENCH_MAX_REPS		1000
+#define BENCH_MAX_ITERS		100000
+#define BENCH_MIN_TIME		0.02	/* seconds per repetition */
+
+/**
+ * struct bench_result - outcome of one repetition
+ * @items:	entries, lookups or records handled
+ * @bytes:	bytes read
+ */
+struct bench_result {
+	s64 items;
+	s64 bytes;
+	BOOL own_stats;		/* @stats are those of a volume the
+				   operation mounted itself. */
+	ntfs_volume_stats stats;
+};
+
+typedef int (*bench_fn)(ntfs_volume *vol, const char *arg,
+		struct bench_result *res);
+
+static const char *image;
+static BOOL map;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Translate a benchmark path to the separator used by the library. */
+static char *bench_path(const char *path)
+{
+	char *p, *s;
+
+	while (*path == '/' || *path == '\\')
+		path++;
+	s = strdup(path);
+	if (!s)
+		return NULL;
+	for (p = s; *p; p++)
+		if (*p == '/')
+			*p = PATH_SEP;
+	return s;
+}
+
+static ntfs_inode *bench_open(ntfs_volume *vol, const char *path)
+{
+	ntfs_inode *ni;
+	char *s;
+
+	s = bench_path(path ? path : "");
+	if (!s)
+		return NULL;
+	ni = ntfs_pathname_to_inode(vol, NULL, s);
+	free(s);
+	return ni;
+}
+
+static int bench_mount(ntfs_volume *unused, const char *arg,
+		struct bench_result *res)
+{
+	ntfs_volume *vol;
+
+	vol = ntfs_image_mount(image, NTFS_MNT_RDONLY, map);
+	if (!vol)
+		return -1;
+	res->items = 1;
+	ntfs_volume_get_stats(vol, &res->stats);
+	res->own_stats = TRUE;
+	return ntfs_umount(vol, FALSE);
+}
+
+static int bench_lookup(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	ntfs_inode *ni;
+
+	ni = bench_open(vol, arg);
+	if (!ni)
+		return -1;
+	res->items = 1;
+	return ntfs_inode_close(ni);
+}
+
+/**
+ * struct bench_names - names of a directory, for lookupdir
+ */
+struct bench_names {
+	char **names;
+	s64 count;
+	s64 size;
+};
+
+static int bench_names_filldir(void *dirent, const ntfschar *name,
+		const int name_len, const int name_type, const s64 pos,
+		const MFT_REF mref, const unsigned dt_type)
+{
+	struct bench_names *bn = dirent;
+	char *s = NULL, **p;
+
+	if (name_type == FILE_NAME_DOS || MREF(mref) < FILE_first_user)
+		return 0;
+	if (ntfs_ucstombs(name, name_len, &s, 0) < 0)
+		return -1;
+	if (!strcmp(s, ".") || !strcmp(s, "..")) {
+		free(s);
+		return 0;
+	}
+	if (bn->count == bn->size) {
+		p = realloc(bn->names, (bn->size * 2 + 16) * sizeof(*p));
+		if (!p) {
+			free(s);
+			return -1;
+		}
+		bn->names = p;
+		bn->size = bn->size * 2 + 16;
+	}
+	bn->names[bn->count++] = s;
+	return 0;
+}
+
+static int bench_lookupdir(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	static struct bench_names bn;
+	static const char *bn_dir;
+	ntfs_inode *ni;
+	char *path;
+	s64 pos, i;
+	int ret = 0;
+
+	/* Collect the names once, outside of the timed part of later runs. */
+	if (bn_dir != arg) {
+		while (bn.count)
+			free(bn.names[--bn.count]);
+		ni = bench_open(vol, arg);
+		if (!ni)
+			return -1;
+		pos = 0;
+		ret = ntfs_readdir(ni, &pos, &bn, bench_names_filldir);
+		ntfs_inode_close(ni);
+		if (ret)
+			return -1;
+		bn_dir = arg;
+	}
+	for (i = 0; i < bn.count && !ret; i++) {
+		path = malloc(strlen(arg) + strlen(bn.names[i]) + 2);
+		if (!path)
+			return -1;
+		sprintf(path, "%s/%s", arg, bn.names[i]);
+		ni = bench_open(vol, path);
+		free(path);
+		if (!ni)
+			return -1;
+		ret = ntfs_inode_close(ni);
+	}
+	res->items = bn.count;
+	return ret;
+}
+
+static int bench_count_filldir(void *dirent, const ntfschar *name,
+		const int name_len, const int name_type, const s64 pos,
+		const MFT_REF mref, const unsigned dt_type)
+{
+	(*(s64 *)dirent)++;
+	return 0;
+}
+
+static int bench_readdir(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	ntfs_inode *ni;
+	s64 pos = 0;
+	int ret;
+
+	ni = bench_open(vol, arg);
+	if (!ni)
+		return -1;
+	ret = ntfs_readdir(ni, &pos, &res->items, bench_count_filldir);
+	ntfs_inode_close(ni);
+	return ret;
+}
+
+static int bench_list(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	struct _reent r;
+	ntfs_dir_state dir;
+	ntfs_vd vd;
+	ntfs_inode *ni;
+	ntfs_attr *na;
+	int ret = 0;
+
+	/* The volume descriptor ntfsMount() sets up for the driver. */
+	memset(&vd, 0, sizeof(vd));
+	vd.vol = vol;
+	vd.dev = vol->dev;
+	vd.atime = ATIME_DISABLED;
+
+	memset(&r, 0, sizeof(r));
+	memset(&dir, 0, sizeof(dir));
+	dir.vd = &vd;
+	dir.ni = bench_open(vol, arg);
+	if (!dir.ni)
+		return -1;
+	/* The directory inode now belongs to the directory state. */
+	if (!ntfs_diropen_r(&r, &dir, NULL)) {
+		errno = r._errno;
+		return -1;
+	}
+	while (dir.current) {
+		/* What fsw_efi_dir_read() looks at for each entry. */
+		ni = ntfs_inode_open(vol, dir.current->mref);
+		if (!ni) {
+			ret = -1;
+			break;
+		}
+		na = ntfs_attr_open(ni, AT_DATA, AT_UNNAMED, 0);
+		if (na) {
+			res->bytes += na->data_size;
+			ntfs_attr_close(na);
+		}
+		ntfs_inode_close(ni);
+		res->items++;
+		ntfs_dirnext_r(&r, &dir, dir.current->name, NULL);
+	}
+	ntfs_dirclose_r(&r, &dir);
+	return ret;
+}
+
+static int bench_read_common(ntfs_volume *vol, const char *arg,
+		struct bench_result *res, BOOL compressed)
+{
+	ntfs_inode *ni;
+	ntfs_attr *na;
+	s64 pos, br;
+	char *buf;
+	int ret = -1;
+
+	ni = bench_open(vol, arg);
+	if (!ni)
+		return -1;
+	na = ntfs_attr_open(ni, AT_DATA, AT_UNNAMED, 0);
+	if (!na)
+		goto close_inode;
+	if (compressed && !(na->data_flags & ATTR_IS_COMPRESSED)) {
+		errno = EINVAL;
+		goto close_attr;
+	}
+	buf = malloc(BENCH_READ_SIZE);
+	if (!buf)
+		goto close_attr;
+	for (pos = 0; pos < na->data_size; pos += br) {
+		if (compressed)
+			br = ntfs_compressed_attr_pread(na, pos,
+					BENCH_READ_SIZE, buf);
+		else
+			br = ntfs_attr_pread(na, pos, BENCH_READ_SIZE, buf);
+		if (br <= 0)
+			goto free_buf;
+	}
+	res->bytes = na->data_size;
+	res->items = 1;
+	ret = 0;
+free_buf:
+	free(buf);
+close_attr:
+	ntfs_attr_close(na);
+close_inode:
+	ntfs_inode_close(ni);
+	return ret;
+}
+
+static int bench_read(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	return bench_read_common(vol, arg, res, FALSE);
+}
+
+static int bench_cread(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	return bench_read_common(vol, arg, res, TRUE);
+}
+
+/*
+ * A buffer of at least @size bytes, kept from one run to the next so that
+ * the page faults of a large destination are not timed.
+ */
+static char *bench_buffer(s64 size)
+{
+	static char *buf;
+	static s64 buf_size;
+	char *p;
+
+	if (size > buf_size) {
+		p = realloc(buf, size);
+		if (!p)
+			return NULL;
+		memset(p, 0, size);
+		buf = p;
+		buf_size = size;
+	}
+	return buf ? buf : bench_buffer(1);
+}
+
+static int bench_readv(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	ntfs_readv_req *reqs;
+	ntfs_inode *ni;
+	ntfs_attr *na;
+	s64 pos;
+	char *buf;
+	int i, n, ret = -1;
+
+	ni = bench_open(vol, arg);
+	if (!ni)
+		return -1;
+	na = ntfs_attr_open(ni, AT_DATA, AT_UNNAMED, 0);
+	if (!na)
+		goto close_inode;
+	n = (na->data_size + BENCH_READ_SIZE - 1) / BENCH_READ_SIZE;
+	reqs = calloc(n ? n : 1, sizeof(*reqs));
+	buf = bench_buffer(na->data_size);
+	if (!reqs || !buf)
+		goto free_reqs;
+	for (i = 0, pos = 0; i < n; i++, pos += BENCH_READ_SIZE) {
+		reqs[i].na = na;
+		reqs[i].offset = pos;
+		reqs[i].count = BENCH_READ_SIZE;
+		reqs[i].buf = buf + pos;
+	}
+	if (ntfs_attr_preadv(vol, reqs, n, BENCH_READV_GAP))
+		goto free_reqs;
+	res->bytes = na->data_size;
+	res->items = 1;
+	ret = 0;
+free_reqs:
+	free(reqs);
+	ntfs_attr_close(na);
+close_inode:
+	ntfs_inode_close(ni);
+	return ret;
+}
+
+/**
+ * struct bench_files - files of a directory, for readall and readvall
+ */
+struct bench_files {
+	u64 *mref;
+	s64 count;
+	s64 size;
+};
+
+static int bench_files_filldir(void *dirent, const ntfschar *name,
+		const int name_len, const int name_type, const s64 pos,
+		const MFT_REF mref, const unsigned dt_type)
+{
+	struct bench_files *bf = dirent;
+	u64 *p;
+
+	if (name_type == FILE_NAME_DOS || MREF(mref) < FILE_first_user ||
+	    dt_type == NTFS_DT_DIR)
+		return 0;
+	if (bf->count == bf->size) {
+		p = realloc(bf->mref, (bf->size * 2 + 16) * sizeof(*p));
+		if (!p)
+			return -1;
+		bf->mref = p;
+		bf->size = bf->size * 2 + 16;
+	}
+	bf->mref[bf->count++] = MREF(mref);
+	return 0;
+}
+
+static int bench_readall_common(ntfs_volume *vol, const char *arg,
+		struct bench_result *res, BOOL vectored)
+{
+	struct bench_files bf;
+	ntfs_readv_req *reqs;
+	ntfs_inode *ni;
+	s64 pos = 0;
+	char *buf;
+	int i, n = 0, ret = -1;
+
+	memset(&bf, 0, sizeof(bf));
+	ni = bench_open(vol, arg);
+	if (!ni)
+		return -1;
+	ret = ntfs_readdir(ni, &pos, &bf, bench_files_filldir);
+	ntfs_inode_close(ni);
+	if (ret) {
+		free(bf.mref);
+		return -1;
+	}
+	ret = -1;
+	reqs = calloc(bf.count ? bf.count : 1, sizeof(*reqs));
+	if (!reqs)
+		goto free_files;
+	for (n = 0; n < bf.count; n++) {
+		ni = ntfs_inode_open(vol, bf.mref[n]);
+		if (!ni)
+			goto close_files;
+		reqs[n].na = ntfs_attr_open(ni, AT_DATA, AT_UNNAMED, 0);
+		if (!reqs[n].na) {
+			ntfs_inode_close(ni);
+			goto close_files;
+		}
+		reqs[n].count = reqs[n].na->data_size;
+		res->bytes += reqs[n].count;
+	}
+	buf = bench_buffer(res->bytes);
+	if (!buf)
+		goto close_files;
+	for (i = 0, pos = 0; i < n; pos += reqs[i++].count)
+		reqs[i].buf = buf + pos;
+	if (vectored) {
+		if (ntfs_attr_preadv(vol, reqs, n, BENCH_READV_GAP))
+			goto close_files;
+	} else {
+		for (i = 0; i < n; i++)
+			if (ntfs_attr_pread(reqs[i].na, 0, reqs[i].count,
+					reqs[i].buf) != reqs[i].count)
+				goto close_files;
+	}
+	res->items = n;
+	ret = 0;
+close_files:
+	while (n--) {
+		ni = reqs[n].na->ni;
+		ntfs_attr_close(reqs[n].na);
+		ntfs_inode_close(ni);
+	}
+	free(reqs);
+free_files:
+	free(bf.mref);
+	return ret;
+}
+
+static int bench_readall(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	return bench_readall_common(vol, arg, res, FALSE);
+}
+
+static int bench_readvall(ntfs_volume *vol, const char *arg,
+		struct bench_result *res)
+{
+	return bench_readall_common(vol, arg, res, TRUE);
+}
+
+static const struct {
+	const char *name;
+	bench_fn fn;
+	BOOL needs_arg;
+} bench_ops[] = {
+	{ "mount",	bench_mount,		FALSE },
+	{ "lookup",	bench_lookup,		TRUE },
+	{ "lookupdir",	bench_lookupdir,	TRUE },
+	{ "readdir",	bench_readdir,		TRUE },
+	{ "list",	bench_list,		TRUE },
+	{ "read",	bench_read,		TRUE },
+	{ "cread",	bench_cread,		TRUE },
+	{ "readv",	bench_readv,		TRUE },
+	{ "readall",	bench_readall,		TRUE },
+	{ "readvall",	bench_readvall,		TRUE },
+	{ NULL,		NULL,			FALSE }
+};
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Print @s as a JSON string. */
+static void json_string(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			printf("\\u%04x", *s);
+		else
+			putchar(*s);
+	}
+	putchar('"');
+}
+
+static int run_op(ntfs_volume *vol, const char *spec, int reps)
+{
+	static int printed;
+	struct bench_result res;
+	ntfs_volume_stats st;
+	double t[BENCH_MAX_REPS], start, elapsed, sum = 0;
+	const char *arg;
+	char *name;
+	int i, n, op, iters;
+
+	name = strdup(spec);
+	if (!name)
+		return -1;
+	arg = strchr(spec, ':');
+	if (arg) {
+		name[arg - spec] = '\0';
+		arg++;
+	}
+	for (op = 0; bench_ops[op].name; op++)
+		if (!strcmp(bench_ops[op].name, name))
+			break;
+	if (!bench_ops[op].name || (bench_ops[op].needs_arg && !arg)) {
+		fprintf(stderr, "Unknown operation %s\n", spec);
+		free(name);
+		return -1;
+	}
+
+	/*
+	 * A first, untimed run warms the caches and sizes the repetitions:
+	 * fast operations are looped until a repetition lasts long enough to
+	 * be measured reliably, and reported per iteration.
+	 */
+	memset(&res, 0, sizeof(res));
+	ntfs_volume_reset_stats(vol);
+	start = now();
+	if (bench_ops[op].fn(vol, arg, &res))
+		goto err;
+	elapsed = now() - start;
+	if (res.own_stats)
+		st = res.stats;
+	else
+		ntfs_volume_get_stats(vol, &st);
+	iters = 1;
+	if (elapsed < BENCH_MIN_TIME)
+		iters = elapsed > 0 ? (int)(BENCH_MIN_TIME / elapsed) + 1 :
+				BENCH_MAX_ITERS;
+	if (iters > BENCH_MAX_ITERS)
+		iters = BENCH_MAX_ITERS;
+
+	for (i = 0; i < reps; i++) {
+		start = now();
+		for (n = 0; n < iters; n++) {
+			memset(&res, 0, sizeof(res));
+			if (bench_ops[op].fn(vol, arg, &res))
+				goto err;
+		}
+		t[i] = (now() - start) / iters;
+		sum += t[i];
+	}
+	qsort(t, reps, sizeof(*t), cmp_double);
+
+	printf("%s{\"op\": ", printed++ ? ",\n" : "");
+	json_string(name);
+	printf(", \"arg\": ");
+	json_string(arg ? arg : "");
+	printf(", \"reps\": %d, \"iters\": %d, \"items\": %lld, "
+		"\"bytes\": %lld, \"min\": %.9f, \"median\": %.9f, "
+		"\"mean\": %.9f, \"stats\": {\"dev_reads\": %llu, "
+		"\"dev_read_bytes\": %llu, \"mft_records\": %llu, "
+		"\"index_blocks\": %llu, \"compression_blocks\": %llu, "
+		"\"cache_hits\": %llu, \"cache_misses\": %llu, "
+		"\"allocations\": %llu}}",
+		reps, iters, (long long)res.items, (long long)res.bytes,
+		t[0], t[reps / 2], sum / reps,
+		(unsigned long long)st.dev_reads,
+		(unsigned long long)st.dev_read_bytes,
+		(unsigned long long)st.mft_records,
+		(unsigned long long)st.index_blocks,
+		(unsigned long long)st.compression_blocks,
+		(unsigned long long)st.cache_hits,
+		(unsigned long long)st.cache_misses,
+		(unsigned long long)st.allocations);
+	fflush(stdout);
+	free(name);
+	return 0;
+err:
+	fprintf(stderr, "%s failed: %s\n", spec, strerror(errno));
+	free(name);
+	return -1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-m] [-r reps] image op[:arg] ...\n"
+		"\n"
+		"    -m          map the image instead of reading it\n"
+		"    -r reps     repetitions of each operation (default: 5)\n"
+		"\n"
+		"Operations: mount lookup:PATH lookupdir:DIR readdir:DIR "
+		"list:DIR\n"
+		"            read:PATH cread:PATH readv:PATH readall:DIR "
+		"readvall:DIR\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	ntfs_volume *vol;
+	int reps = 5, ret = 0, i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-m"))
+			map = TRUE;
+		else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+			reps = atoi(argv[++i]);
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (i + 2 > argc || reps < 1 || reps > BENCH_MAX_REPS) {
+		usage(argv[0]);
+		return 2;
+	}
+	image = argv[i++];
+
+	vol = ntfs_image_mount(image, NTFS_MNT_RDONLY, map);
+	if (!vol) {
+		fprintf(stderr, "Failed to mount %s: %s\n", image,
+				strerror(errno));
+		return 1;
+	}
+	printf("{\"image\": ");
+	json_string(image);
+	printf(", \"device\": \"%s\", \"results\": [\n", map ? "mmap" : "pread");
+	for (; i < argc; i++)
+		if (run_op(vol, argv[i], reps))
+			ret = 1;
+	printf("\n]}\n");
+	ntfs_umount(vol, FALSE);
+	return ret;
+}
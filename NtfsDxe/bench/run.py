@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Run the host benchmark suite and compare results between runs.
+
+    run.py run [--quick] [--mmap] [--reps N] [--out FILE]
+    run.py compare BASELINE CURRENT [--threshold PCT] [--stat STAT]
+
+"run" builds the host tools (NtfsDxe/host, make), generates the reference
+images with mkimage.py into host_build/bench-images (kept between runs,
+keyed by their parameters) and times each case with ntfsbench. The results
+are written as JSON, one entry per (image, operation, argument).
+
+"compare" matches two result files entry by entry and prints the change of
+the median (or --stat) time per iteration. It exits with status 1 if any
+entry got slower by more than the threshold, so it can gate a change in CI.
+"""
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HOST = os.path.join(HERE, os.pardir, "host")
+BUILD = os.path.join(HOST, "host_build")
+IMAGES = os.path.join(BUILD, "bench-images")
+
+# (name, mkimage arguments, quick mkimage arguments, operations)
+SUITE = [
+    ("flat",
+     ["flat", "--files", "50000", "--image-size", str(512 << 20)],
+     ["flat", "--files", "5000", "--image-size", str(64 << 20)],
+     ["mount", "readdir:flat", "list:flat", "lookup:flat/file000000.dat",
+      "lookupdir:flat", "readall:flat", "readvall:flat"]),
+    ("deep",
+     ["deep", "--depth", "32", "--files", "3200"],
+     ["deep", "--depth", "16", "--files", "320"],
+     ["lookup:" + "/".join("level%02d" % i for i in range(32)) + "/leaf.txt",
+      "readdir:level00", "list:level00"]),
+    ("fragmented",
+     ["fragmented", "--size", str(64 << 20), "--fragments", "4096",
+      "--image-size", str(256 << 20)],
+     ["fragmented", "--size", str(8 << 20), "--fragments", "512"],
+     ["read:fragmented.bin", "readv:fragmented.bin"]),
+    ("compressed",
+     ["compressed", "--size", str(16 << 20)],
+     ["compressed", "--size", str(2 << 20)],
+     ["read:compressed.txt", "cread:compressed.txt"]),
+    ("sparse",
+     ["sparse", "--size", str(256 << 20)],
+     ["sparse", "--size", str(32 << 20)],
+     ["read:sparse.bin"]),
+    ("mftfrag",
+     ["mftfrag", "--files", "20000", "--fragments", "64",
+      "--image-size", str(256 << 20)],
+     ["mftfrag", "--files", "2000", "--fragments", "16"],
+     ["mount", "readdir:many", "lookupdir:many"]),
+]
+
+
+def quick_ops(name, ops):
+    # The deep quick image is shallower; point the lookup at its leaf.
+    if name == "deep":
+        return ["lookup:" + "/".join("level%02d" % i for i in range(16)) +
+                "/leaf.txt"] + ops[1:]
+    return ops
+
+
+def image_for(name, margs):
+    path = os.path.join(IMAGES, "%s-%s.img" % (
+        name, "_".join(a.lstrip("-") for a in margs[1:]) or "default"))
+    if not os.path.exists(path):
+        os.makedirs(IMAGES, exist_ok=True)
+        print("generating %s" % os.path.basename(path), file=sys.stderr)
+        tmp = path + ".tmp"
+        subprocess.check_call([sys.executable,
+                               os.path.join(HERE, "mkimage.py"),
+                               margs[0], tmp] + margs[1:])
+        os.rename(tmp, path)
+    return path
+
+
+def cmd_run(args):
+    subprocess.check_call(["make", "-s", "-C", HOST])
+    bench = os.path.join(BUILD, "ntfsbench")
+    out = {
+        "host": platform.node(),
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "device": "mmap" if args.mmap else "pread",
+        "quick": args.quick,
+        "results": [],
+    }
+    failed = False
+    for name, margs, qargs, ops in SUITE:
+        if args.only and name not in args.only:
+            continue
+        if args.quick:
+            margs, ops = qargs, quick_ops(name, ops)
+        image = image_for(name, margs)
+        cmd = [bench, "-r", str(args.reps)]
+        if args.mmap:
+            cmd.append("-m")
+        proc = subprocess.run(cmd + [image] + ops, stdout=subprocess.PIPE,
+                              universal_newlines=True)
+        if proc.returncode:
+            failed = True
+        for r in json.loads(proc.stdout)["results"]:
+            r["image"] = name
+            out["results"].append(r)
+            print("%-11s %-9s %-40s %12.6f s" % (name, r["op"], r["arg"][:40],
+                                                  r["median"]),
+                  file=sys.stderr)
+    text = json.dumps(out, indent=1) + "\n"
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+    return 1 if failed else 0
+
+
+def cmd_compare(args):
+    with open(args.baseline) as f:
+        base = json.load(f)
+    with open(args.current) as f:
+        cur = json.load(f)
+
+    def key(r):
+        return (r["image"], r["op"], r["arg"])
+
+    stat = args.stat
+    old = dict((key(r), r) for r in base["results"])
+    worse = 0
+    print("%-11s %-9s %-32s %12s %12s %8s" % ("image", "op", "arg",
+                                              "baseline", "current",
+                                              "change"))
+    for r in cur["results"]:
+        b = old.get(key(r))
+        if not b:
+            print("%-11s %-9s %-32s %12s %12.6f %8s" % (
+                r["image"], r["op"], r["arg"][:32], "-", r[stat], "new"))
+            continue
+        change = (r[stat] - b[stat]) / b[stat] * 100 if b[stat] else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  SLOWER"
+            worse += 1
+        elif change < -args.threshold:
+            flag = "  faster"
+        print("%-11s %-9s %-32s %12.6f %12.6f %+7.1f%%%s" % (
+            r["image"], r["op"], r["arg"][:32], b[stat], r[stat],
+            change, flag))
+    if worse:
+        print("%d regression(s) above %.1f%%" % (worse, args.threshold))
+    return 1 if worse else 0
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__,
+                                formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = p.add_subparsers(dest="cmd")
+    r = sub.add_parser("run", help="run the suite")
+    r.add_argument("--quick", action="store_true",
+                   help="small images, for a smoke test")
+    r.add_argument("--mmap", action="store_true",
+                   help="use the mapped image device")
+    r.add_argument("--reps", type=int, default=5)
+    r.add_argument("--only", action="append",
+                   help="run only this image (repeatable)")
+    r.add_argument("--out", help="write the JSON results here")
+    c = sub.add_parser("compare", help="compare two result files")
+    c.add_argument("baseline")
+    c.add_argument("current")
+    c.add_argument("--threshold", type=float, default=15.0,
+                   help="percentage slowdown reported as a regression")
+    c.add_argument("--stat", choices=["median", "min", "mean"],
+                   default="median", help="per-iteration time compared")
+    args = p.parse_args()
+    if args.cmd == "run":
+        return cmd_run(args)
+    if args.cmd == "compare":
+        return cmd_compare(args)
+    p.print_help()
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main())
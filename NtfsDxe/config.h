@@ -2,6 +2,10 @@
 #ifndef _CONFIG_H_
     #define _CONFIG_H_
 
+#ifdef NTFS_HOST_BUILD
+#include "host/hostconfig.h"
+#else
+
 #pragma warning (disable : 4200)
 #pragma warning (disable : 4341)	// signed value is out of range for enum constant
 #pragma warning (disable : 4309)	// truncation of constant value
@@ -72,5 +76,6 @@
 
 //#include <types.h>
 #define ptrdiff_t(x) ((int)x)
+#endif /* NTFS_HOST_BUILD */
 #endif
 
@@ -0,0 +1,154 @@
+/**
+ * dircheck - Check the life cycle of the directory state of a handle.
+ *
+ *	dircheck image dir
+ *
+ * Replays what the driver does with the ntfs_dir_state of a directory
+ * handle: fsw_efi_dir_read() opens a listing with ntfs_diropen_r() and reads
+ * part of it, then NtfsClose() or NtfsDelete() hand the state back with
+ * ntfs_dirclose_r() and release its memory, and the volume is unmounted with
+ * ntfsDeinitVolume(). A state must leave the list of open directories of the
+ * volume before its memory goes, or the unmount walks freed memory. The
+ * released states are poisoned instead of freed, so that any later use of
+ * one crashes here rather than going unnoticed.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "types.h"
+#include "volume.h"
+#include "inode.h"
+#include "dir.h"
+#include "ntfsinternal.h"
+#include "ntfsdir.h"
+#include "image_io.h"
+
+static ntfs_vd vd;
+static const char *dir_path;
+static int failures;
+
+#define CHECK(cond, what)						\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "dircheck: %s\n", what);	\
+			failures++;					\
+		}							\
+	} while (0)
+
+/* A directory handle as NtfsOpen() sets it up: a zeroed state. */
+static ntfs_dir_state *handle_open(void)
+{
+	ntfs_dir_state *dir;
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir) {
+		perror("dircheck");
+		exit(1);
+	}
+	return dir;
+}
+
+/* The first fsw_efi_dir_read() of a handle, then @reads more entries. */
+static void handle_list(ntfs_dir_state *dir, ntfs_inode **inode, int reads)
+{
+	struct _reent r;
+
+	*inode = ntfs_pathname_to_inode(vd.vol, NULL, dir_path);
+	if (!*inode) {
+		fprintf(stderr, "dircheck: cannot open %s: %s\n", dir_path,
+				strerror(errno));
+		exit(1);
+	}
+	memset(&r, 0, sizeof(r));
+	dir->ni = *inode;
+	dir->vd = &vd;
+	CHECK(ntfs_diropen_r(&r, dir, NULL) != NULL, "ntfs_diropen_r failed");
+	while (reads-- > 0 && dir->current)
+		ntfs_dirnext_r(&r, dir, dir->current->name, NULL);
+}
+
+/* NtfsClose() and NtfsDelete(): the inode belongs to the handle. */
+static void handle_close(ntfs_dir_state *dir, ntfs_inode *inode)
+{
+	struct _reent r;
+
+	memset(&r, 0, sizeof(r));
+	dir->ni = NULL;
+	ntfs_dirclose_r(&r, dir);
+	if (inode)
+		ntfs_inode_close(inode);
+	memset(dir, 0x5a, sizeof(*dir));
+}
+
+int main(int argc, char **argv)
+{
+	ntfs_dir_state *a, *b, *c, *d;
+	ntfs_inode *ia, *ib, *id;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s image dir\n", argv[0]);
+		return 2;
+	}
+	dir_path = argv[2];
+	vd.vol = ntfs_image_mount(argv[1], NTFS_MNT_RDONLY, FALSE);
+	if (!vd.vol) {
+		fprintf(stderr, "dircheck: cannot mount %s: %s\n", argv[1],
+				strerror(errno));
+		return 1;
+	}
+	vd.dev = vd.vol->dev;
+	vd.atime = ATIME_DISABLED;
+	ntfsInitVolume(&vd);
+
+	/* Handles closed partway through and after their listing. */
+	a = handle_open();
+	b = handle_open();
+	c = handle_open();
+	d = handle_open();
+	handle_list(a, &ia, 1);
+	handle_list(b, &ib, 1 << 30);
+	handle_list(d, &id, 0);
+	CHECK(vd.openDirCount == 3, "three listings should be open");
+
+	/* A listing that failed to open: set up, but never inserted. */
+	c->vd = &vd;
+	handle_close(c, NULL);
+	CHECK(vd.openDirCount == 3, "closing an unlisted handle changed "
+			"the open directories");
+	handle_close(b, ib);
+	handle_close(a, ia);
+	CHECK(vd.openDirCount == 1 && vd.firstOpenDir == d,
+			"closed listings are still open");
+
+	/* A handle left open is cleaned up by the unmount, inode included. */
+	ntfsDeinitVolume(&vd);
+	CHECK(vd.openDirCount == 0 && !vd.firstOpenDir,
+			"unmount left open listings");
+	ntfs_umount(vd.vol, FALSE);
+
+	free(a);
+	free(b);
+	free(c);
+	free(d);
+	if (failures)
+		return 1;
+	printf("dircheck: ok\n");
+	return 0;
+}
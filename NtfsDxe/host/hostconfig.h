@@ -0,0 +1,63 @@
+/**
+ * hostconfig.h - Configuration for building the NTFS library on a host.
+ *
+ * Included by config.h instead of the firmware configuration when
+ * NTFS_HOST_BUILD is defined. The library is then compiled against the
+ * system C library rather than the freestanding one in NtfsDxe, so sizes are
+ * real size_t and there are no UEFI services.
+ **/
+
+#ifndef __HOSTCONFIG_H_
+#define __HOSTCONFIG_H_
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#define HAVE_SYS_STAT_H	1
+#define HAVE_STRING_H	1
+#define HAVE_STDLIB_H	1
+#define HAVE_TIME_H		1
+#define HAVE_FCNTL_H	1
+#define HAVE_STDIO_H	1
+#define HAVE_STDARG_H	1
+#define HAVE_LIMITS_H	1
+#define HAVE_STDINT_H	1
+#define HAVE_ERRNO_H	1
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <endian.h>
+#include <sys/types.h>
+
+/* No hd_geometry probing, images are plain files. */
+#undef linux
+
+/* Device operations come from host/image_io.c, not unix_io.c. */
+#define NO_NTFS_DEVICE_DEFAULT_IO_OPS	1
+
+/* MSVC spellings used by the firmware build. */
+#define __int64			long long
+#define __int32			int
+#define __int16			short
+#define __int8			char
+#define __inline		inline
+#define __FUNCTION__	__func__
+
+/* EDK2 spellings used by the driver glue (ntfsdir.c, ntfsfile.c). */
+typedef uintptr_t		UINTN;
+typedef uint8_t			UINT8;
+
+#define MIN(a, b)		((a) < (b) ? (a) : (b))
+#define MAX(a, b)		((a) > (b) ? (a) : (b))
+
+#define BOOL			char
+#ifndef TRUE
+#define TRUE			1
+#define FALSE			0
+#endif
+
+#endif
@@ -0,0 +1,372 @@
+/**
+ * image_io.c - Device operations on a volume image file, for host builds.
+ *
+ * The firmware reads through EFI_DISK_IO_PROTOCOL (ntfs/uefi_io.c); on a
+ * development host the same library runs on top of a plain image file read
+ * with pread(2), or mapped with mmap(2) so that the library can borrow
+ * ranges of it in place. The device is always read-only.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "types.h"
+#include "bootsect.h"
+#include "device.h"
+#include "logging.h"
+#include "misc.h"
+#include "image_io.h"
+
+/**
+ * struct _image_fd - private data of an image file device
+ * @fd:		descriptor of the open image file
+ * @pos:	current position for read() and seek()
+ * @len:	size of the image in bytes
+ * @sectorSize:	bytes per sector from the boot sector
+ * @map:	read-only mapping of the whole image, NULL for the pread device
+ */
+struct _image_fd {
+	int fd;
+	s64 pos;
+	s64 len;
+	u16 sectorSize;
+	u8 *map;
+};
+
+#define DEV_FD(dev) ((struct _image_fd *)dev->d_private)
+
+static int image_open(struct ntfs_device *dev, int flags, BOOL map)
+{
+	struct _image_fd *fd;
+	NTFS_BOOT_SECTOR boot;
+	struct stat st;
+
+	if (NDevOpen(dev)) {
+		errno = EBUSY;
+		return -1;
+	}
+	if ((flags & O_ACCMODE) != O_RDONLY) {
+		errno = EROFS;
+		return -1;
+	}
+
+	fd = ntfs_calloc(sizeof(struct _image_fd));
+	if (!fd)
+		return -1;
+	fd->fd = open(dev->d_name, O_RDONLY);
+	if (fd->fd < 0)
+		goto err_out;
+	if (fstat(fd->fd, &st))
+		goto err_close;
+	fd->len = st.st_size;
+
+	if (pread(fd->fd, &boot, sizeof(boot), 0) != sizeof(boot)) {
+		ntfs_log_perror("Failed to read boot sector of %s", dev->d_name);
+		errno = EIO;
+		goto err_close;
+	}
+	if (!ntfs_boot_sector_is_ntfs(&boot)) {
+		errno = EINVAL;
+		goto err_close;
+	}
+	fd->sectorSize = le16_to_cpu(boot.bpb.bytes_per_sector);
+	if (map) {
+		fd->map = mmap(NULL, (size_t)fd->len, PROT_READ, MAP_SHARED,
+				fd->fd, 0);
+		if (fd->map == MAP_FAILED) {
+			ntfs_log_perror("Failed to map %s", dev->d_name);
+			goto err_close;
+		}
+	}
+
+	dev->d_private = fd;
+	NDevSetReadOnly(dev);
+	NDevSetOpen(dev);
+	return 0;
+err_close:
+	{
+		int eo = errno;
+
+		close(fd->fd);
+		errno = eo;
+	}
+err_out:
+	free(fd);
+	return -1;
+}
+
+static int ntfs_device_image_io_open(struct ntfs_device *dev, int flags)
+{
+	return image_open(dev, flags, FALSE);
+}
+
+static int ntfs_device_image_mmap_open(struct ntfs_device *dev, int flags)
+{
+	return image_open(dev, flags, TRUE);
+}
+
+static int ntfs_device_image_io_close(struct ntfs_device *dev)
+{
+	struct _image_fd *fd = DEV_FD(dev);
+
+	if (!NDevOpen(dev) || !fd) {
+		errno = EBADF;
+		return -1;
+	}
+	NDevClearOpen(dev);
+	if (fd->map)
+		munmap(fd->map, (size_t)fd->len);
+	close(fd->fd);
+	free(fd);
+	dev->d_private = NULL;
+	return 0;
+}
+
+static s64 ntfs_device_image_io_seek(struct ntfs_device *dev, s64 offset,
+		int whence)
+{
+	struct _image_fd *fd = DEV_FD(dev);
+	s64 pos;
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = fd->pos + offset;
+		break;
+	case SEEK_END:
+		pos = fd->len + offset;
+		break;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+	if (pos < 0 || pos > fd->len) {
+		errno = EINVAL;
+		return -1;
+	}
+	fd->pos = pos;
+	return pos;
+}
+
+static s64 ntfs_device_image_io_pread(struct ntfs_device *dev, void *buf,
+		s64 count, s64 offset)
+{
+	struct _image_fd *fd = DEV_FD(dev);
+	s64 total = 0;
+	ssize_t br;
+
+	while (total < count) {
+		br = pread(fd->fd, (u8 *)buf + total, (size_t)(count - total),
+				(off_t)(offset + total));
+		if (br < 0) {
+			if (errno == EINTR)
+				continue;
+			return total ? total : -1;
+		}
+		dev->d_reads++;
+		if (!br)
+			break;
+		dev->d_read_bytes += br;
+		total += br;
+	}
+	return total;
+}
+
+static s64 ntfs_device_image_mmap_pread(struct ntfs_device *dev, void *buf,
+		s64 count, s64 offset)
+{
+	struct _image_fd *fd = DEV_FD(dev);
+
+	if (offset < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (offset >= fd->len)
+		return 0;
+	if (count > fd->len - offset)
+		count = fd->len - offset;
+	memcpy(buf, fd->map + offset, (size_t)count);
+	dev->d_reads++;
+	dev->d_read_bytes += count;
+	return count;
+}
+
+static s64 ntfs_device_image_io_read(struct ntfs_device *dev, void *buf,
+		s64 count)
+{
+	struct _image_fd *fd = DEV_FD(dev);
+	s64 br;
+
+	br = dev->d_ops->pread(dev, buf, count, fd->pos);
+	if (br > 0)
+		fd->pos += br;
+	return br;
+}
+
+static s64 ntfs_device_image_io_write(struct ntfs_device *dev,
+		const void *buf, s64 count)
+{
+	errno = EROFS;
+	return -1;
+}
+
+static s64 ntfs_device_image_io_pwrite(struct ntfs_device *dev,
+		const void *buf, s64 count, s64 offset)
+{
+	errno = EROFS;
+	return -1;
+}
+
+static int ntfs_device_image_io_sync(struct ntfs_device *dev)
+{
+	return 0;
+}
+
+static int ntfs_device_image_io_stat(struct ntfs_device *dev, struct stat *buf)
+{
+	struct _image_fd *fd = DEV_FD(dev);
+
+	return fstat(fd->fd, buf);
+}
+
+static int ntfs_device_image_io_ioctl(struct ntfs_device *dev, int request,
+		void *argp)
+{
+	errno = EOPNOTSUPP;
+	return -1;
+}
+
+static const void *ntfs_device_image_mmap_borrow(struct ntfs_device *dev,
+		s64 offset, s64 count)
+{
+	struct _image_fd *fd = DEV_FD(dev);
+
+	if (offset < 0 || count < 0 || offset + count > fd->len) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return fd->map + offset;
+}
+
+/**
+ * Device operations for reading a volume image file.
+ */
+struct ntfs_device_operations ntfs_device_image_io_ops = {
+	.open		= ntfs_device_image_io_open,
+	.close		= ntfs_device_image_io_close,
+	.seek		= ntfs_device_image_io_seek,
+	.read		= ntfs_device_image_io_read,
+	.write		= ntfs_device_image_io_write,
+	.pread		= ntfs_device_image_io_pread,
+	.pwrite		= ntfs_device_image_io_pwrite,
+	.sync		= ntfs_device_image_io_sync,
+	.stat		= ntfs_device_image_io_stat,
+	.ioctl		= ntfs_device_image_io_ioctl,
+};
+
+/**
+ * Device operations for a mapped volume image file, able to lend its
+ * contents through the borrow operation.
+ */
+struct ntfs_device_operations ntfs_device_image_mmap_ops = {
+	.open		= ntfs_device_image_mmap_open,
+	.close		= ntfs_device_image_io_close,
+	.seek		= ntfs_device_image_io_seek,
+	.read		= ntfs_device_image_io_read,
+	.write		= ntfs_device_image_io_write,
+	.pread		= ntfs_device_image_mmap_pread,
+	.pwrite		= ntfs_device_image_io_pwrite,
+	.sync		= ntfs_device_image_io_sync,
+	.stat		= ntfs_device_image_io_stat,
+	.ioctl		= ntfs_device_image_io_ioctl,
+	.borrow		= ntfs_device_image_mmap_borrow,
+};
+
+/* Timestamps of the I/O trace, in nanoseconds. */
+static u64 image_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * ntfs_image_mount_traced - mount an image file, tracing its requests
+ * @path:	path of the image file
+ * @flags:	NTFS_MNT_* flags, NTFS_MNT_RDONLY is always added
+ * @map:	map the image instead of reading it with pread(2)
+ * @trace:	number of requests kept in the I/O trace of the device (see
+ *		ntfs_device_trace_start()), 0 for no trace
+ *
+ * The trace starts before the mount, so it includes the boot sector and
+ * the system files read by it. Save it with ntfs_device_trace_save() on
+ * vol->dev.
+ *
+ * Return the mounted volume, to be released with ntfs_umount(), or NULL on
+ * error with errno set.
+ */
+ntfs_volume *ntfs_image_mount_traced(const char *path, ntfs_mount_flags flags,
+		BOOL map, u32 trace)
+{
+	struct ntfs_device *dev;
+	ntfs_volume *vol;
+
+	dev = ntfs_device_alloc(path, 0, map ? &ntfs_device_image_mmap_ops :
+			&ntfs_device_image_io_ops, NULL);
+	if (!dev)
+		return NULL;
+	if (trace && ntfs_device_trace_start(dev, trace, image_clock,
+			1000000000)) {
+		int eo = errno;
+
+		ntfs_device_free(dev);
+		errno = eo;
+		return NULL;
+	}
+	vol = ntfs_device_mount(dev, flags | NTFS_MNT_RDONLY);
+	if (!vol) {
+		int eo = errno;
+
+		ntfs_device_free(dev);
+		errno = eo;
+	}
+	return vol;
+}
+
+/**
+ * ntfs_image_mount - mount the volume held in an image file
+ * @path:	path of the image file
+ * @flags:	NTFS_MNT_* flags, NTFS_MNT_RDONLY is always added
+ * @map:	map the image instead of reading it with pread(2)
+ *
+ * Return the mounted volume, to be released with ntfs_umount(), or NULL on
+ * error with errno set.
+ */
+ntfs_volume *ntfs_image_mount(const char *path, ntfs_mount_flags flags,
+		BOOL map)
+{
+	return ntfs_image_mount_traced(path, flags, map, 0);
+}
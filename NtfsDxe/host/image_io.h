@@ -0,0 +1,30 @@
+/**
+ * image_io.h - Exports for the host image file device.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _NTFS_IMAGE_IO_H
+#define _NTFS_IMAGE_IO_H
+
+#include "types.h"
+#include "device.h"
+#include "volume.h"
+
+extern struct ntfs_device_operations ntfs_device_image_io_ops;
+extern struct ntfs_device_operations ntfs_device_image_mmap_ops;
+
+extern ntfs_volume *ntfs_image_mount(const char *path, ntfs_mount_flags flags,
+		BOOL map);
+extern ntfs_volume *ntfs_image_mount_traced(const char *path,
+		ntfs_mount_flags flags, BOOL map, u32 trace);
+
+#endif /* defined _NTFS_IMAGE_IO_H */
@@ -0,0 +1,531 @@
+/**
+ * mftindex - Build a flat file index of an NTFS volume image.
+ *
+ * One reader thread streams the $MFT in chunks with the scan engine
+ * (ntfs/mftscan.c) while a pool of worker threads applies the fixups, parses
+ * the records and converts the names to UTF-8. The firmware driver serializes
+ * everything behind its single file system lock; this tool is what the same
+ * code does on a host with real threads.
+ *
+ * The output is one line per file name:
+ *
+ *	mref <TAB> parent mref <TAB> size <TAB> crtime <TAB> mtime <TAB> name
+ *
+ * with references printed as hexadecimal and times as NTFS time (100ns units
+ * since 1601).
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "layout.h"
+#include "volume.h"
+#include "mftscan.h"
+#include "unistr.h"
+#include "logging.h"
+#include "image_io.h"
+
+/**
+ * struct index_entry - one row of the flat index
+ * @mref:	mft reference of the file
+ * @parent:	mft reference of the parent directory
+ * @size:	data size, 0 for directories
+ * @crtime:	creation time
+ * @mtime:	last data change time
+ * @name:	UTF-8 name, NULL if the slot is not used
+ * @next:	further hard links of the same file
+ *
+ * The table is indexed by mft record number. An extension record updates
+ * the slot of its base record, which another worker may be filling in at the
+ * same time, so slots are updated under one of the indexer slot locks.
+ */
+struct index_entry {
+	MFT_REF mref;
+	MFT_REF parent;
+	s64 size;
+	s64 crtime;
+	s64 mtime;
+	char *name;
+	struct index_entry *next;
+};
+
+/**
+ * struct chunk_queue - bounded queue of chunks between threads
+ */
+struct chunk_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	ntfs_mft_chunk **items;
+	int size;
+	int head;
+	int count;
+	BOOL done;
+};
+
+#define INDEX_SLOT_LOCKS	256
+
+/**
+ * struct indexer - state shared by the reader and the workers
+ * @scan:	scan of the volume, only the reader touches its cursor
+ * @table:	index entries, one per mft record
+ * @nr_slots:	number of entries in @table
+ * @free_q:	empty chunk buffers, filled by the reader
+ * @full_q:	chunks read from disk, consumed by the workers
+ * @err:	first error seen by any thread, under @full_q.lock
+ * @records:	number of records indexed, updated under @full_q.lock
+ * @bytes:	number of $MFT bytes read
+ * @slot_locks:	striped locks protecting @table
+ */
+struct indexer {
+	ntfs_mft_scan *scan;
+	struct index_entry *table;
+	s64 nr_slots;
+	struct chunk_queue free_q;
+	struct chunk_queue full_q;
+	int err;
+	s64 records;
+	s64 bytes;
+	pthread_mutex_t slot_locks[INDEX_SLOT_LOCKS];
+};
+
+static void queue_init(struct chunk_queue *q, int size)
+{
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+	q->items = calloc(size, sizeof(*q->items));
+	q->size = size;
+	q->head = 0;
+	q->count = 0;
+	q->done = FALSE;
+}
+
+static void queue_destroy(struct chunk_queue *q)
+{
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->cond);
+	free(q->items);
+}
+
+static void queue_put(struct chunk_queue *q, ntfs_mft_chunk *c)
+{
+	pthread_mutex_lock(&q->lock);
+	/* Never full: the queues together hold exactly the pool. */
+	q->items[(q->head + q->count) % q->size] = c;
+	q->count++;
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+/* Return the next chunk, or NULL once the queue is closed and drained. */
+static ntfs_mft_chunk *queue_get(struct chunk_queue *q)
+{
+	ntfs_mft_chunk *c = NULL;
+
+	pthread_mutex_lock(&q->lock);
+	while (!q->count && !q->done)
+		pthread_cond_wait(&q->cond, &q->lock);
+	if (q->count) {
+		c = q->items[q->head];
+		q->head = (q->head + 1) % q->size;
+		q->count--;
+	}
+	pthread_mutex_unlock(&q->lock);
+	return c;
+}
+
+static void queue_close(struct chunk_queue *q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->done = TRUE;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ * Pick the name to index: the Win32 name of a file in preference to its DOS
+ * alias, and every POSIX name (hard link).
+ */
+static BOOL index_name_wanted(const ntfs_mft_scan_record *rec, int i)
+{
+	const FILE_NAME_ATTR *fn = rec->names[i];
+	int j;
+
+	if (fn->file_name_type != FILE_NAME_DOS)
+		return TRUE;
+	for (j = 0; j < rec->nr_names; j++)
+		if (rec->names[j]->file_name_type != FILE_NAME_DOS &&
+		    rec->names[j]->parent_directory == fn->parent_directory)
+			return FALSE;
+	return TRUE;
+}
+
+static int index_record(struct indexer *ix, const ntfs_mft_scan_record *rec)
+{
+	struct index_entry *e, *link;
+	struct index_entry *links[NTFS_MFT_SCAN_MAX_NAMES];
+	const FILE_NAME_ATTR *fn;
+	pthread_mutex_t *lock;
+	s64 slot;
+	int i, n = 0;
+
+	/*
+	 * Names and the data size of a file with an attribute list may be held
+	 * in extension records; index them under the base record.
+	 */
+	slot = rec->base_mref ? (s64)MREF(rec->base_mref) : rec->mft_no;
+	if (slot >= ix->nr_slots)
+		return 0;
+
+	/* Convert the names before taking the lock. */
+	for (i = 0; i < rec->nr_names; i++) {
+		if (!index_name_wanted(rec, i))
+			continue;
+		fn = rec->names[i];
+		link = calloc(1, sizeof(*link));
+		if (!link)
+			goto err;
+		links[n++] = link;
+		if (ntfs_ucstombs(fn->file_name, fn->file_name_length,
+				&link->name, 0) < 0)
+			goto err;
+		link->parent = le64_to_cpu(fn->parent_directory);
+		/* Fallback for a file without $STANDARD_INFORMATION. */
+		link->size = sle64_to_cpu(fn->data_size);
+		link->crtime = sle64_to_cpu(fn->creation_time);
+		link->mtime = sle64_to_cpu(fn->last_data_change_time);
+	}
+
+	lock = &ix->slot_locks[slot % INDEX_SLOT_LOCKS];
+	pthread_mutex_lock(lock);
+	e = &ix->table[slot];
+	for (i = 0; i < n; i++) {
+		if (!e->name) {
+			/* The first name lives in the slot itself. */
+			e->parent = links[i]->parent;
+			e->name = links[i]->name;
+			if (!e->crtime) {
+				e->size = links[i]->size;
+				e->crtime = links[i]->crtime;
+				e->mtime = links[i]->mtime;
+			}
+			free(links[i]);
+		} else {
+			links[i]->next = e->next;
+			e->next = links[i];
+		}
+	}
+	if (!rec->base_mref)
+		e->mref = MK_MREF(rec->mft_no, rec->seq_no);
+	if (rec->si) {
+		e->crtime = sle64_to_cpu(rec->si->creation_time);
+		e->mtime = sle64_to_cpu(rec->si->last_data_change_time);
+	}
+	if (rec->data_size >= 0)
+		e->size = rec->data_size;
+	pthread_mutex_unlock(lock);
+	return 0;
+err:
+	while (n--) {
+		free(links[n]->name);
+		free(links[n]);
+	}
+	return -1;
+}
+
+static void *worker_thread(void *arg)
+{
+	struct indexer *ix = arg;
+	const u32 size = ix->scan->vol->mft_record_size;
+	ntfs_mft_scan_record rec;
+	ntfs_mft_chunk *c;
+	MFT_RECORD *m;
+	s64 i, n;
+
+	while ((c = queue_get(&ix->full_q))) {
+		n = 0;
+		if (ntfs_mft_scan_fixup_chunk(ix->scan, c) < 0)
+			goto err;
+		for (i = 0; i < c->count; i++) {
+			m = (MFT_RECORD *)(c->buf + i * size);
+			if (!ntfs_mft_scan_record_in_use(ix->scan, m,
+					c->first + i))
+				continue;
+			if (ntfs_mft_scan_parse(ix->scan->vol, m, c->first + i,
+					&rec))
+				continue;
+			if (index_record(ix, &rec))
+				goto err;
+			n++;
+		}
+		pthread_mutex_lock(&ix->full_q.lock);
+		ix->records += n;
+		pthread_mutex_unlock(&ix->full_q.lock);
+		queue_put(&ix->free_q, c);
+		continue;
+err:
+		pthread_mutex_lock(&ix->full_q.lock);
+		if (!ix->err)
+			ix->err = errno;
+		pthread_mutex_unlock(&ix->full_q.lock);
+		queue_put(&ix->free_q, c);
+	}
+	return NULL;
+}
+
+static int indexer_failed(struct indexer *ix)
+{
+	int err;
+
+	pthread_mutex_lock(&ix->full_q.lock);
+	err = ix->err;
+	pthread_mutex_unlock(&ix->full_q.lock);
+	return err;
+}
+
+/*
+ * The reader runs in the main thread: it is the only user of the scan cursor
+ * and of the device, and stops early when a worker failed.
+ */
+static int reader_loop(struct indexer *ix)
+{
+	ntfs_mft_chunk *c;
+	s64 ret;
+	int err = 0;
+
+	while ((c = queue_get(&ix->free_q))) {
+		if (indexer_failed(ix))
+			break;
+		ret = ntfs_mft_scan_read_chunk(ix->scan, c);
+		if (ret <= 0) {
+			if (ret < 0)
+				err = errno;
+			queue_put(&ix->free_q, c);
+			break;
+		}
+		ix->bytes += ret << ix->scan->vol->mft_record_size_bits;
+		queue_put(&ix->full_q, c);
+	}
+	queue_close(&ix->full_q);
+	return err;
+}
+
+static void print_table(FILE *out, const struct index_entry *table, s64 n)
+{
+	const struct index_entry *e;
+	s64 i;
+
+	for (i = 0; i < n; i++)
+		for (e = &table[i]; e && e->name; e = e->next)
+			fprintf(out, "%llx\t%llx\t%lld\t%lld\t%lld\t%s\n",
+				(unsigned long long)table[i].mref,
+				(unsigned long long)e->parent,
+				(long long)(e == &table[i] ? e->size :
+						table[i].size),
+				(long long)(e == &table[i] ? e->crtime :
+						table[i].crtime),
+				(long long)(e == &table[i] ? e->mtime :
+						table[i].mtime),
+				e->name);
+}
+
+static void free_table(struct index_entry *table, s64 n)
+{
+	struct index_entry *e, *next;
+	s64 i;
+
+	for (i = 0; i < n; i++) {
+		free(table[i].name);
+		for (e = table[i].next; e; e = next) {
+			next = e->next;
+			free(e->name);
+			free(e);
+		}
+	}
+	free(table);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options] image\n"
+		"\n"
+		"    -t, --threads N     worker threads (default: online CPUs)\n"
+		"    -c, --chunk KB      $MFT read size in KiB (default: %d)\n"
+		"    -o, --output FILE   write the index to FILE (default: stdout)\n"
+		"    -q, --quiet         do not write the index, only the statistics\n"
+		"    -m, --mmap          map the image instead of reading it\n"
+		"    -h, --help          show this help\n",
+		prog, NTFS_MFT_SCAN_DEFAULT_CHUNK / 1024);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option lopt[] = {
+		{ "threads",	required_argument,	NULL, 't' },
+		{ "chunk",	required_argument,	NULL, 'c' },
+		{ "output",	required_argument,	NULL, 'o' },
+		{ "quiet",	no_argument,		NULL, 'q' },
+		{ "mmap",	no_argument,		NULL, 'm' },
+		{ "help",	no_argument,		NULL, 'h' },
+		{ NULL,		0,			NULL, 0 }
+	};
+	struct indexer ix;
+	ntfs_volume *vol;
+	pthread_t *workers;
+	ntfs_mft_chunk *pool;
+	const char *output = NULL;
+	s64 chunk_size = NTFS_MFT_SCAN_DEFAULT_CHUNK;
+	int threads = 0, pool_size, quiet = 0, map = 0, err, i, c;
+	double start, elapsed;
+	FILE *out;
+
+	while ((c = getopt_long(argc, argv, "t:c:o:qmh", lopt, NULL)) != -1) {
+		switch (c) {
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 'c':
+			chunk_size = strtoll(optarg, NULL, 0) * 1024;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'm':
+			map = 1;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (optind != argc - 1 || chunk_size <= 0) {
+		usage(argv[0]);
+		return 2;
+	}
+	if (threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0)
+		threads = 1;
+
+	vol = ntfs_image_mount(argv[optind], NTFS_MNT_RDONLY, map);
+	if (!vol) {
+		fprintf(stderr, "Failed to mount %s: %s\n", argv[optind],
+				strerror(errno));
+		return 1;
+	}
+
+	start = now();
+	memset(&ix, 0, sizeof(ix));
+	ix.scan = ntfs_mft_scan_open(vol, chunk_size);
+	if (!ix.scan) {
+		fprintf(stderr, "Failed to scan $MFT: %s\n", strerror(errno));
+		ntfs_umount(vol, FALSE);
+		return 1;
+	}
+	ix.nr_slots = ix.scan->nr_records;
+	ix.table = calloc(ix.nr_slots ? ix.nr_slots : 1, sizeof(*ix.table));
+
+	/* Two buffers per worker keep the reader a chunk ahead of each. */
+	pool_size = threads * 2;
+	pool = calloc(pool_size, sizeof(*pool));
+	workers = calloc(threads, sizeof(*workers));
+	if (!ix.table || !pool || !workers) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < INDEX_SLOT_LOCKS; i++)
+		pthread_mutex_init(&ix.slot_locks[i], NULL);
+	queue_init(&ix.free_q, pool_size);
+	queue_init(&ix.full_q, pool_size);
+	for (i = 0; i < pool_size; i++) {
+		pool[i].buf = malloc(ntfs_mft_scan_chunk_bytes(ix.scan));
+		if (!pool[i].buf) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		queue_put(&ix.free_q, &pool[i]);
+	}
+
+	for (i = 0; i < threads; i++)
+		if (pthread_create(&workers[i], NULL, worker_thread, &ix)) {
+			fprintf(stderr, "Failed to start worker thread\n");
+			return 1;
+		}
+	err = reader_loop(&ix);
+	for (i = 0; i < threads; i++)
+		pthread_join(workers[i], NULL);
+	if (!err)
+		err = ix.err;
+	elapsed = now() - start;
+
+	if (err)
+		fprintf(stderr, "Failed to index $MFT: %s\n", strerror(err));
+	else {
+		if (!quiet) {
+			out = output ? fopen(output, "w") : stdout;
+			if (!out) {
+				fprintf(stderr, "Failed to open %s: %s\n",
+						output, strerror(errno));
+				err = errno;
+			} else {
+				print_table(out, ix.table, ix.nr_slots);
+				if (out != stdout)
+					fclose(out);
+			}
+		}
+		fprintf(stderr, "%lld records, %.1f MiB of $MFT in %.3f s with "
+				"%d threads: %.0f records/s, %.1f MiB/s\n",
+				(long long)ix.records,
+				ix.bytes / 1048576.0, elapsed, threads,
+				elapsed > 0 ? ix.records / elapsed : 0.0,
+				elapsed > 0 ? ix.bytes / 1048576.0 / elapsed :
+						0.0);
+	}
+
+	for (i = 0; i < pool_size; i++)
+		free(pool[i].buf);
+	free(pool);
+	free(workers);
+	queue_destroy(&ix.free_q);
+	queue_destroy(&ix.full_q);
+	for (i = 0; i < INDEX_SLOT_LOCKS; i++)
+		pthread_mutex_destroy(&ix.slot_locks[i]);
+	free_table(ix.table, ix.nr_slots);
+	ntfs_mft_scan_close(ix.scan);
+	ntfs_umount(vol, FALSE);
+	return err ? 1 : 0;
+}
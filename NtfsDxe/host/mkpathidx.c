@@ -0,0 +1,738 @@
+/**
+ * mkpathidx - Build the path index of an NTFS volume image.
+ *
+ *	mkpathidx [-r restart] [-u old-index] image index
+ *
+ * The $MFT is read once with the scan engine (ntfs/mftscan.c), and every
+ * name of every file that can be reached from the root becomes an entry
+ * keyed by its path. The index is written in the format of ntfs/pathidx.h,
+ * with a key stored in full every restart keys (default 16). Copied to
+ * \EFI\ntfs.paths on the volume, it is loaded by the UEFI driver at mount
+ * (UEFI_PATH_INDEX in ntfs/param.h); ntfscli -x loads it on the host.
+ *
+ * DOS names are left out, so are names with a '\' and the names a directory
+ * holds more than once but for case, with everything below them. Those
+ * paths are still found by walking the directories.
+ *
+ * With -u, the names are taken from an index built earlier instead, and only
+ * the files which the change journal ($Extend\$UsnJrnl, ntfs/usnjrnl.c)
+ * shows were created, deleted, renamed or linked since are read from the
+ * $MFT. The whole $MFT is still read if the journal does not go back to the
+ * old index. Names left out of the old index stay out, with what is below
+ * them, until the next full build.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "types.h"
+#include "layout.h"
+#include "volume.h"
+#include "mftscan.h"
+#include "pathidx.h"
+#include "usnjrnl.h"
+#include "inode.h"
+#include "attrib.h"
+#include "dir.h"
+#include "logging.h"
+#include "image_io.h"
+
+#define MAX_KEY		0xffff	/* longest key, in characters */
+
+/**
+ * struct pix_name - a name of a file, linked into the list of its directory
+ */
+struct pix_name {
+	s64 slot;		/* Record of the file. */
+	MFT_REF parent;		/* Directory holding the name. */
+	ntfschar *name;
+	u8 len;
+	struct pix_name *next;	/* Next name of the directory. */
+};
+
+/**
+ * struct pix_record - what the index needs of a base mft record
+ */
+struct pix_record {
+	MFT_REF mref;		/* 0 if the record is not in use. */
+	BOOL dir;
+	BOOL visited;		/* The directory was listed. */
+	struct pix_name *children;
+};
+
+/**
+ * struct pix_entry - an entry of the index being built
+ */
+struct pix_entry {
+	ntfschar *key;
+	u32 len;
+	MFT_REF mref;
+	struct pix_entry *parent;	/* NULL in the root. */
+	u32 ordinal;			/* Entry number once sorted. */
+};
+
+/**
+ * struct builder - state of the index build
+ */
+struct builder {
+	ntfs_volume *vol;
+	struct pix_record *records;
+	s64 nr_records;
+	struct pix_name *names;
+	s64 nr_names;
+	s64 names_size;
+	struct pix_entry **entries;
+	u32 nr_entries;
+	u32 entries_size;
+	u32 left_out;		/* Names not indexed. */
+	ntfschar key[MAX_KEY + 1];
+};
+
+/* Same choice of names as mftindex: a DOS name only without a long one. */
+static BOOL name_wanted(const ntfs_mft_scan_record *rec, int i)
+{
+	const FILE_NAME_ATTR *fn = rec->names[i];
+	int j;
+
+	if (fn->file_name_type != FILE_NAME_DOS)
+		return TRUE;
+	for (j = 0; j < rec->nr_names; j++)
+		if (rec->names[j]->file_name_type != FILE_NAME_DOS &&
+		    rec->names[j]->parent_directory == fn->parent_directory)
+			return FALSE;
+	return TRUE;
+}
+
+static int add_name(struct builder *b, s64 slot, MFT_REF parent,
+		const ntfschar *name, u8 len)
+{
+	struct pix_name *n;
+
+	if (b->nr_names == b->names_size) {
+		b->names_size = b->names_size ? b->names_size * 2 : 4096;
+		n = realloc(b->names, b->names_size * sizeof(*n));
+		if (!n)
+			return -1;
+		b->names = n;
+	}
+	n = &b->names[b->nr_names];
+	n->slot = slot;
+	n->parent = parent;
+	n->len = len;
+	n->name = malloc(len * sizeof(ntfschar) + 1);
+	if (!n->name)
+		return -1;
+	memcpy(n->name, name, len * sizeof(ntfschar));
+	n->next = NULL;
+	b->nr_names++;
+	return 0;
+}
+
+static int add_record(struct builder *b, const ntfs_mft_scan_record *rec)
+{
+	const FILE_NAME_ATTR *fn;
+	s64 slot;
+	int i;
+
+	slot = rec->base_mref ? (s64)MREF(rec->base_mref) : rec->mft_no;
+	if (slot >= b->nr_records)
+		return 0;
+	if (!rec->base_mref) {
+		b->records[slot].mref = MK_MREF(rec->mft_no, rec->seq_no);
+		b->records[slot].dir =
+			(rec->flags & le16_to_cpu(MFT_RECORD_IS_DIRECTORY)) != 0;
+	}
+	for (i = 0; i < rec->nr_names; i++) {
+		if (!name_wanted(rec, i))
+			continue;
+		fn = rec->names[i];
+		if (add_name(b, slot, le64_to_cpu(fn->parent_directory),
+				fn->file_name, fn->file_name_length))
+			return -1;
+	}
+	return 0;
+}
+
+/* Read the names of every file from the $MFT. */
+static int scan_names(struct builder *b)
+{
+	ntfs_mft_scan_record rec;
+	ntfs_mft_scan *scan;
+	int ret;
+
+	scan = ntfs_mft_scan_open(b->vol, NTFS_MFT_SCAN_DEFAULT_CHUNK);
+	if (!scan)
+		return -1;
+	b->nr_records = scan->nr_records;
+	b->records = calloc(b->nr_records ? b->nr_records : 1,
+			sizeof(*b->records));
+	ret = b->records ? 0 : -1;
+	while (!ret && (ret = ntfs_mft_scan_next(scan, &rec)) > 0)
+		ret = add_record(b, &rec);
+	ntfs_mft_scan_close(scan);
+	return ret;
+}
+
+/*
+ * Read base record @slot as the scan would, with its names if @names. A
+ * record which is not in use is left out.
+ */
+static int read_record(struct builder *b, s64 slot, BOOL names)
+{
+	ntfs_mft_scan_record rec;
+	ntfs_attr_search_ctx *ctx;
+	ntfs_inode *ni;
+	int ret = 0;
+
+	ni = ntfs_inode_open(b->vol, slot);
+	if (!ni)
+		return errno == ENOENT ? 0 : -1;
+	memset(&rec, 0, sizeof(rec));
+	rec.mft_no = slot;
+	rec.seq_no = le16_to_cpu(ni->mrec->sequence_number);
+	rec.flags = le16_to_cpu(ni->mrec->flags);
+	ctx = names ? ntfs_attr_get_search_ctx(ni, NULL) : NULL;
+	if (names && !ctx)
+		ret = -1;
+	while (ctx && rec.nr_names < NTFS_MFT_SCAN_MAX_NAMES &&
+	       !ntfs_attr_lookup(AT_FILE_NAME, AT_UNNAMED, 0, CASE_SENSITIVE,
+			0, NULL, 0, ctx))
+		rec.names[rec.nr_names++] = (FILE_NAME_ATTR *)((u8 *)ctx->attr +
+				le16_to_cpu(ctx->attr->value_offset));
+	if (!ret)
+		ret = add_record(b, &rec);
+	if (ctx)
+		ntfs_attr_put_search_ctx(ctx);
+	ntfs_inode_close(ni);
+	return ret;
+}
+
+/*
+ * Take the names from @old, an index built earlier, and read again the
+ * files the journal shows were created, deleted, renamed or linked since.
+ * Return 0 on success, 1 if @old cannot be brought up to date from the
+ * journal, -1 on error.
+ */
+static int update_names(struct builder *b, const u8 *old, size_t size,
+		ntfs_usn_journal *j, s64 *changes)
+{
+	const NTFS_PATH_INDEX_HEADER *h = (const NTFS_PATH_INDEX_HEADER *)old;
+	const NTFS_PATH_INDEX_ENTRY *entries;
+	const le16 *k;
+	ntfs_usn_record rec;
+	MFT_REF mref, parent, root;
+	u32 count, koff, ksize, off, p, i, len, klen, start;
+	s64 slot, nr_names;
+	u8 *changed;
+	int ret;
+
+	if (ntfs_path_index_attach(b->vol, old, size, FALSE))
+		return 1;
+	ntfs_path_index_detach(b->vol);
+	if (!j || !h->journal_id ||
+	    le64_to_cpu(h->journal_id) != j->journal_id) {
+		fprintf(stderr, "The journal is not the one of the index\n");
+		return 1;
+	}
+	if (ntfs_usn_seek(j, sle64_to_cpu(h->usn))) {
+		fprintf(stderr, "The journal does not go back to the index\n");
+		return 1;
+	}
+
+	b->nr_records = b->vol->mft_na->initialized_size >>
+			b->vol->mft_record_size_bits;
+	b->records = calloc(b->nr_records ? b->nr_records : 1,
+			sizeof(*b->records));
+	changed = calloc(b->nr_records ? b->nr_records : 1, 1);
+	if (!b->records || !changed) {
+		free(changed);
+		return -1;
+	}
+	*changes = 0;
+	while ((ret = ntfs_usn_next(j, &rec)) > 0) {
+		slot = MREF(rec.mref);
+		if ((rec.reason & USN_REASON_NAME_CHANGE) &&
+		    slot < b->nr_records && !changed[slot]) {
+			changed[slot] = 1;
+			(*changes)++;
+		}
+	}
+	if (ret)
+		goto out;
+
+	/* The names of the other files are the last names of their keys. */
+	ret = 1;
+	count = le32_to_cpu(h->count);
+	entries = (const NTFS_PATH_INDEX_ENTRY *)(old +
+			le32_to_cpu(h->entries_offset));
+	koff = le32_to_cpu(h->keys_offset);
+	ksize = le32_to_cpu(h->keys_size);
+	root = le64_to_cpu(h->root);
+	klen = 0;
+	for (i = 0; i < count; i++) {
+		off = le32_to_cpu(entries[i].key);
+		if (off > ksize - 4)
+			goto out;
+		k = (const le16 *)(old + koff + off);
+		if (le16_to_cpu(k[0]) > klen ||
+		    le16_to_cpu(k[1]) > (ksize - off - 4) / sizeof(ntfschar))
+			goto out;
+		klen = le16_to_cpu(k[0]) + le16_to_cpu(k[1]);
+		if (klen > MAX_KEY)
+			goto out;
+		memcpy(b->key + le16_to_cpu(k[0]), k + 2,
+				le16_to_cpu(k[1]) * sizeof(ntfschar));
+		p = le32_to_cpu(entries[i].parent);
+		if (p == NTFS_PATH_INDEX_ROOT)
+			parent = root;
+		else if (p < count)
+			parent = le64_to_cpu(entries[p].mref);
+		else
+			goto out;
+		mref = le64_to_cpu(entries[i].mref);
+		slot = MREF(mref);
+		if (slot >= b->nr_records || changed[slot])
+			continue;
+		for (start = klen; start &&
+		     b->key[start - 1] != const_cpu_to_le16(PATH_SEP); start--)
+			;
+		len = klen - start;
+		if (!len || len > 0xff)
+			goto out;
+		b->records[slot].mref = mref;
+		if (MREF(parent) < (u64)b->nr_records &&
+		    !changed[MREF(parent)])
+			b->records[MREF(parent)].dir = TRUE;
+		if (add_name(b, slot, parent, b->key + start, len)) {
+			ret = -1;
+			goto out;
+		}
+	}
+	if (!changed[FILE_root]) {
+		b->records[FILE_root].mref = root;
+		b->records[FILE_root].dir = TRUE;
+	}
+
+	nr_names = b->nr_names;
+	for (slot = 0; slot < b->nr_records; slot++)
+		if (changed[slot] && read_record(b, slot, TRUE)) {
+			ret = -1;
+			goto out;
+		}
+	/* New names may be in directories which were empty. */
+	for (; nr_names < b->nr_names; nr_names++) {
+		slot = MREF(b->names[nr_names].parent);
+		if (slot < b->nr_records && !changed[slot] &&
+		    !b->records[slot].dir && read_record(b, slot, FALSE)) {
+			ret = -1;
+			goto out;
+		}
+	}
+	ret = 0;
+out:
+	if (ret > 0)
+		fprintf(stderr, "Invalid path index\n");
+	free(changed);
+	return ret;
+}
+
+/* Link every name into its directory, if that still is its directory. */
+static void link_names(struct builder *b)
+{
+	struct pix_record *dir;
+	struct pix_name *n;
+	s64 i, p;
+
+	for (i = 0; i < b->nr_names; i++) {
+		n = &b->names[i];
+		p = MREF(n->parent);
+		/* The root is its own parent. */
+		if (n->slot == FILE_root)
+			continue;
+		dir = p < b->nr_records ? &b->records[p] : NULL;
+		if (!dir || !dir->dir || dir->mref != n->parent ||
+		    !b->records[n->slot].mref) {
+			b->left_out++;
+			continue;
+		}
+		n->next = dir->children;
+		dir->children = n;
+	}
+}
+
+static BOOL has_separator(const ntfschar *name, u8 len)
+{
+	u8 i;
+
+	for (i = 0; i < len; i++)
+		if (name[i] == const_cpu_to_le16(PATH_SEP))
+			return TRUE;
+	return FALSE;
+}
+
+static const ntfs_volume *sort_vol;
+
+static int name_cmp(const void *p1, const void *p2)
+{
+	const struct pix_name *n1 = *(struct pix_name * const *)p1;
+	const struct pix_name *n2 = *(struct pix_name * const *)p2;
+
+	return ntfs_path_index_collate(sort_vol, n1->name, n1->len,
+			n2->name, n2->len);
+}
+
+static int entry_cmp(const void *p1, const void *p2)
+{
+	const struct pix_entry *e1 = *(struct pix_entry * const *)p1;
+	const struct pix_entry *e2 = *(struct pix_entry * const *)p2;
+
+	return ntfs_path_index_collate(sort_vol, e1->key, e1->len,
+			e2->key, e2->len);
+}
+
+static struct pix_entry *add_entry(struct builder *b, u32 len, MFT_REF mref,
+		struct pix_entry *parent)
+{
+	struct pix_entry *e, **entries;
+
+	if (b->nr_entries == b->entries_size) {
+		b->entries_size = b->entries_size ? b->entries_size * 2 : 4096;
+		entries = realloc(b->entries,
+				b->entries_size * sizeof(*entries));
+		if (!entries)
+			return NULL;
+		b->entries = entries;
+	}
+	e = malloc(sizeof(*e));
+	if (!e)
+		return NULL;
+	e->key = malloc(len * sizeof(ntfschar));
+	if (!e->key) {
+		free(e);
+		return NULL;
+	}
+	memcpy(e->key, b->key, len * sizeof(ntfschar));
+	e->len = len;
+	e->mref = mref;
+	e->parent = parent;
+	b->entries[b->nr_entries++] = e;
+	return e;
+}
+
+/*
+ * Add the names of directory @slot, whose path is the first @len characters
+ * of b->key, and of the directories below it.
+ */
+static int add_directory(struct builder *b, s64 slot, u32 len,
+		struct pix_entry *parent)
+{
+	struct pix_record *child;
+	struct pix_name **names, *n;
+	struct pix_entry *e;
+	u32 i, j, count, klen;
+	int ret = -1;
+
+	count = 0;
+	for (n = b->records[slot].children; n; n = n->next)
+		count++;
+	if (!count)
+		return 0;
+	names = malloc(count * sizeof(*names));
+	if (!names)
+		return -1;
+	count = 0;
+	for (n = b->records[slot].children; n; n = n->next)
+		names[count++] = n;
+	sort_vol = b->vol;
+	qsort(names, count, sizeof(*names), name_cmp);
+
+	for (i = 0; i < count; i = j) {
+		/* Names equal but for case are all left out. */
+		for (j = i + 1; j < count && !name_cmp(&names[i], &names[j]);
+				j++)
+			;
+		n = names[i];
+		if (j > i + 1) {
+			b->left_out += j - i;
+			continue;
+		}
+		klen = len + (len ? 1 : 0) + n->len;
+		if (!n->len || klen > MAX_KEY ||
+		    has_separator(n->name, n->len)) {
+			b->left_out++;
+			continue;
+		}
+		if (len)
+			b->key[len] = cpu_to_le16(PATH_SEP);
+		memcpy(b->key + klen - n->len, n->name,
+				n->len * sizeof(ntfschar));
+		child = &b->records[n->slot];
+		e = add_entry(b, klen, child->mref, parent);
+		if (!e)
+			goto out;
+		if (child->dir && !child->visited) {
+			child->visited = TRUE;
+			if (add_directory(b, n->slot, klen, e))
+				goto out;
+		}
+	}
+	ret = 0;
+out:
+	free(names);
+	return ret;
+}
+
+/* Characters key @i shares with the key before it. */
+static u32 shared_len(const struct builder *b, u32 i, u32 restart)
+{
+	const struct pix_entry *e, *prev;
+	u32 shared = 0;
+
+	if (!(i % restart))
+		return 0;
+	e = b->entries[i];
+	prev = b->entries[i - 1];
+	while (shared < e->len && shared < prev->len &&
+	       e->key[shared] == prev->key[shared])
+		shared++;
+	return shared;
+}
+
+static int write_index(struct builder *b, FILE *out, u32 restart,
+		const ntfs_usn_journal *j, u64 *bytes)
+{
+	NTFS_PATH_INDEX_HEADER h;
+	NTFS_PATH_INDEX_ENTRY ie;
+	struct pix_entry *e;
+	le16 lens[2];
+	u32 i, shared, max_key = 0, off = 0;
+
+	for (i = 0; i < b->nr_entries; i++) {
+		b->entries[i]->ordinal = i;
+		if (b->entries[i]->len > max_key)
+			max_key = b->entries[i]->len;
+		off += sizeof(lens) + (b->entries[i]->len -
+				shared_len(b, i, restart)) * sizeof(ntfschar);
+	}
+	memset(&h, 0, sizeof(h));
+	h.magic = cpu_to_le32(NTFS_PATH_INDEX_MAGIC);
+	h.version = cpu_to_le16(NTFS_PATH_INDEX_VERSION);
+	h.restart = cpu_to_le16(restart);
+	h.root = cpu_to_le64(b->records[FILE_root].mref);
+	h.count = cpu_to_le32(b->nr_entries);
+	h.max_key = cpu_to_le32(max_key);
+	h.entries_offset = cpu_to_le32(sizeof(h));
+	h.keys_offset = cpu_to_le32(sizeof(h) +
+			b->nr_entries * sizeof(NTFS_PATH_INDEX_ENTRY));
+	h.keys_size = cpu_to_le32(off);
+	if (j) {
+		h.journal_id = cpu_to_le64(j->journal_id);
+		h.usn = cpu_to_sle64(j->end_usn);
+	}
+	if (fwrite(&h, sizeof(h), 1, out) != 1)
+		return -1;
+
+	off = 0;
+	for (i = 0; i < b->nr_entries; i++) {
+		e = b->entries[i];
+		ie.mref = cpu_to_le64(e->mref);
+		ie.parent = cpu_to_le32(e->parent ? e->parent->ordinal :
+				NTFS_PATH_INDEX_ROOT);
+		ie.key = cpu_to_le32(off);
+		if (fwrite(&ie, sizeof(ie), 1, out) != 1)
+			return -1;
+		off += sizeof(lens) + (e->len - shared_len(b, i, restart)) *
+				sizeof(ntfschar);
+	}
+
+	for (i = 0; i < b->nr_entries; i++) {
+		e = b->entries[i];
+		shared = shared_len(b, i, restart);
+		lens[0] = cpu_to_le16(shared);
+		lens[1] = cpu_to_le16(e->len - shared);
+		if (fwrite(lens, sizeof(lens), 1, out) != 1 ||
+		    fwrite(e->key + shared, sizeof(ntfschar), e->len - shared,
+				out) != e->len - shared)
+			return -1;
+	}
+	*bytes = le32_to_cpu(h.keys_offset) + (u64)off;
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Read all of @path into memory. */
+static u8 *load_index(const char *path, size_t *size)
+{
+	FILE *in;
+	u8 *data = NULL;
+	long len;
+
+	in = fopen(path, "rb");
+	if (!in)
+		return NULL;
+	if (!fseek(in, 0, SEEK_END) && (len = ftell(in)) > 0 &&
+	    !fseek(in, 0, SEEK_SET)) {
+		data = malloc(len);
+		if (data && fread(data, 1, len, in) != (size_t)len) {
+			free(data);
+			data = NULL;
+			errno = EIO;
+		}
+		*size = len;
+	} else if (!errno)
+		errno = EINVAL;
+	fclose(in);
+	return data;
+}
+
+static void free_names(struct builder *b)
+{
+	s64 n;
+
+	for (n = 0; n < b->nr_names; n++)
+		free(b->names[n].name);
+	free(b->names);
+	free(b->records);
+	b->names = NULL;
+	b->records = NULL;
+	b->nr_names = b->names_size = b->nr_records = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-r restart] [-u old-index] image index\n",
+			prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct builder b;
+	ntfs_usn_journal *j;
+	const char *prog = argv[0], *old_path = NULL;
+	u32 restart = NTFS_PATH_INDEX_RESTART, i;
+	u64 bytes = 0;
+	s64 changes = -1;
+	size_t old_size = 0;
+	double start;
+	u8 *old = NULL;
+	FILE *out;
+	int ret;
+
+	while (argc > 2 && argv[1][0] == '-') {
+		if (!strcmp(argv[1], "-r"))
+			restart = strtoul(argv[2], NULL, 0);
+		else if (!strcmp(argv[1], "-u"))
+			old_path = argv[2];
+		else
+			break;
+		argv += 2;
+		argc -= 2;
+	}
+	if (argc != 3 || !restart || restart > 0xffff) {
+		usage(prog);
+		return 2;
+	}
+	if (old_path) {
+		old = load_index(old_path, &old_size);
+		if (!old) {
+			fprintf(stderr, "%s: %s\n", old_path, strerror(errno));
+			return 1;
+		}
+	}
+
+	ntfs_log_set_handler(ntfs_log_handler_stderr);
+	memset(&b, 0, sizeof(b));
+	b.vol = ntfs_image_mount(argv[1], NTFS_MNT_RDONLY, FALSE);
+	if (!b.vol) {
+		fprintf(stderr, "Failed to mount %s: %s\n", argv[1],
+				strerror(errno));
+		free(old);
+		return 1;
+	}
+	start = now();
+	/* Where the journal is before the $MFT is read. */
+	j = ntfs_usn_open(b.vol, 0);
+	ret = 1;
+	if (old) {
+		ret = update_names(&b, old, old_size, j, &changes);
+		if (ret > 0) {
+			fprintf(stderr, "Reading the whole $MFT\n");
+			free_names(&b);
+		}
+	}
+	if (ret > 0)
+		ret = scan_names(&b);
+	if (ret || b.nr_records <= FILE_root || !b.records[FILE_root].mref) {
+		fprintf(stderr, "Failed to read $MFT: %s\n",
+				strerror(ret ? errno : EIO));
+		goto out;
+	}
+
+	link_names(&b);
+	b.records[FILE_root].visited = TRUE;
+	ret = -1;
+	if (add_directory(&b, FILE_root, 0, NULL)) {
+		fprintf(stderr, "Out of memory\n");
+		goto out;
+	}
+	if (!b.nr_entries) {
+		fprintf(stderr, "No file to index\n");
+		goto out;
+	}
+	sort_vol = b.vol;
+	qsort(b.entries, b.nr_entries, sizeof(*b.entries), entry_cmp);
+
+	out = fopen(argv[2], "wb");
+	if (out) {
+		ret = write_index(&b, out, restart, j, &bytes);
+		if (fclose(out))
+			ret = -1;
+	}
+	if (ret)
+		fprintf(stderr, "%s: %s\n", argv[2], strerror(errno));
+	else {
+		if (changes >= 0)
+			fprintf(stderr, "%lld files changed since the old "
+					"index\n", (long long)changes);
+		fprintf(stderr, "%u entries, %u names left out, %llu bytes "
+				"in %.3f s\n", (unsigned)b.nr_entries,
+				(unsigned)b.left_out,
+				(unsigned long long)bytes, now() - start);
+	}
+
+out:
+	for (i = 0; i < b.nr_entries; i++) {
+		free(b.entries[i]->key);
+		free(b.entries[i]);
+	}
+	free(b.entries);
+	free_names(&b);
+	ntfs_usn_close(j);
+	ntfs_umount(b.vol, FALSE);
+	free(old);
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,567 @@
+/**
+ * ntfscli - Inspect an NTFS volume image with the library.
+ *
+ *	ntfscli [options] image mount		print volume information
+ *	ntfscli [options] image ls [dir]	list a directory
+ *	ntfscli [options] image stat path	print the attributes of a file
+ *	ntfscli [options] image cat path	write the unnamed data of a file
+ *						to stdout, leaving its holes
+ *						unwritten when stdout is a file
+ *	ntfscli [options] image map path	print the extent map of the
+ *						unnamed data of a file
+ *
+ *	-m		map the image
+ *	-s		print the volume counters to stderr
+ *	-t trace	save the I/O trace of the command, mount included, to
+ *			the file trace (see ntfsreplay)
+ *	-p profile	prefetch the reads of the I/O trace profile right
+ *			after the mount, as the driver does with its boot
+ *			profile (see ntfs_device_prefetch())
+ *	-x index	open paths through the path index built by mkpathidx,
+ *			as the driver does with \EFI\ntfs.paths
+ *
+ * Paths may use '/' or '\' as separator and are relative to the root. With
+ * -m the image is mapped, and cat writes file data straight from the mapping
+ * wherever it can be borrowed.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "types.h"
+#include "layout.h"
+#include "volume.h"
+#include "inode.h"
+#include "attrib.h"
+#include "dir.h"
+#include "pathidx.h"
+#include "extmap.h"
+#include "unistr.h"
+#include "logging.h"
+#include "image_io.h"
+
+#define CAT_BUFFER_SIZE	(256 * 1024)
+#define TRACE_SIZE	(1024 * 1024)	/* requests kept with -t */
+#define PREFETCH_SIZE	(64 << 20)	/* bytes prefetched at most with -p */
+#define PREFETCH_GAP	(64 << 10)
+#define MAP_EXTENTS	64		/* extents asked for at once by map */
+
+/* Translate a command line path to the separator used by the library. */
+static char *cli_path(const char *path)
+{
+	char *p, *s;
+
+	while (*path == '/' || *path == '\\')
+		path++;
+	s = strdup(path);
+	if (!s)
+		return NULL;
+	for (p = s; *p; p++)
+		if (*p == '/')
+			*p = PATH_SEP;
+	return s;
+}
+
+static ntfs_inode *cli_open(ntfs_volume *vol, const char *path)
+{
+	ntfs_inode *ni;
+	char *s;
+
+	s = cli_path(path ? path : "");
+	if (!s)
+		return NULL;
+	ni = ntfs_pathname_to_inode(vol, NULL, s);
+	if (!ni)
+		fprintf(stderr, "%s: %s\n", path ? path : "/",
+				strerror(errno));
+	free(s);
+	return ni;
+}
+
+static int cli_mount(ntfs_volume *vol)
+{
+	printf("name:          %s\n", vol->vol_name ? vol->vol_name : "");
+	printf("version:       %d.%d\n", vol->major_ver, vol->minor_ver);
+	printf("cluster size:  %u\n", (unsigned)vol->cluster_size);
+	printf("clusters:      %lld\n", (long long)vol->nr_clusters);
+	printf("record size:   %u\n", (unsigned)vol->mft_record_size);
+	printf("index block:   %u\n", (unsigned)vol->indx_record_size);
+	printf("mft records:   %lld\n", (long long)(vol->mft_na->initialized_size
+			>> vol->mft_record_size_bits));
+	return 0;
+}
+
+static int cli_filldir(void *dirent, const ntfschar *name,
+		const int name_len, const int name_type, const s64 pos,
+		const MFT_REF mref, const unsigned dt_type)
+{
+	char *s = NULL;
+
+	/* The DOS alias of a long name is listed under its Win32 name. */
+	if (name_type == FILE_NAME_DOS)
+		return 0;
+	if (ntfs_ucstombs(name, name_len, &s, 0) < 0)
+		return -1;
+	printf("%10lld %c %s\n", (long long)MREF(mref),
+			dt_type == NTFS_DT_DIR ? 'd' : '-', s);
+	free(s);
+	return 0;
+}
+
+static int cli_ls(ntfs_volume *vol, const char *path)
+{
+	ntfs_inode *ni;
+	s64 pos = 0;
+	int ret;
+
+	ni = cli_open(vol, path);
+	if (!ni)
+		return -1;
+	ret = ntfs_readdir(ni, &pos, NULL, cli_filldir);
+	if (ret)
+		fprintf(stderr, "%s: %s\n", path ? path : "/",
+				strerror(errno));
+	ntfs_inode_close(ni);
+	return ret;
+}
+
+static int cli_stat(ntfs_volume *vol, const char *path)
+{
+	ntfs_attr_search_ctx *ctx;
+	ATTR_RECORD *a;
+	ntfs_inode *ni;
+	char *name;
+
+	ni = cli_open(vol, path);
+	if (!ni)
+		return -1;
+	printf("mft record:    %llu\n", (unsigned long long)ni->mft_no);
+	printf("links:         %u\n",
+			(unsigned)le16_to_cpu(ni->mrec->link_count));
+	printf("flags:         0x%x\n", (unsigned)le32_to_cpu(ni->flags));
+	printf("data size:     %lld\n", (long long)ni->data_size);
+	printf("allocated:     %lld\n", (long long)ni->allocated_size);
+	printf("creation:      %lld\n", (long long)sle64_to_cpu(ni->creation_time));
+	printf("modification:  %lld\n",
+			(long long)sle64_to_cpu(ni->last_data_change_time));
+
+	ctx = ntfs_attr_get_search_ctx(ni, NULL);
+	if (!ctx) {
+		ntfs_inode_close(ni);
+		return -1;
+	}
+	while (!ntfs_attrs_walk(ctx)) {
+		a = ctx->attr;
+		if (a->type == AT_END)
+			break;
+		name = NULL;
+		if (a->name_length)
+			ntfs_ucstombs((ntfschar *)((u8 *)a +
+					le16_to_cpu(a->name_offset)),
+					a->name_length, &name, 0);
+		if (a->non_resident)
+			printf("attribute 0x%-4x %-12s non-resident size %lld "
+				"allocated %lld\n",
+				(unsigned)le32_to_cpu(a->type),
+				name ? name : "",
+				(long long)sle64_to_cpu(a->data_size),
+				(long long)sle64_to_cpu(a->allocated_size));
+		else
+			printf("attribute 0x%-4x %-12s resident size %u\n",
+				(unsigned)le32_to_cpu(a->type),
+				name ? name : "",
+				(unsigned)le32_to_cpu(a->value_length));
+		free(name);
+	}
+	ntfs_attr_put_search_ctx(ctx);
+	ntfs_inode_close(ni);
+	return 0;
+}
+
+/* Write the data of @na from @pos to @end to stdout. */
+static int cli_cat_data(ntfs_attr *na, const char *path, s64 pos, s64 end,
+		char *buf)
+{
+	const void *src;
+	s64 br;
+
+	for (; pos < end; pos += br) {
+		br = end - pos < CAT_BUFFER_SIZE ? end - pos : CAT_BUFFER_SIZE;
+		if (pos < na->initialized_size)
+			src = ntfs_attr_borrow(na, pos, &br);
+		else
+			src = NULL;
+		if (src) {
+			if (fwrite(src, 1, br, stdout) != (size_t)br)
+				return -1;
+			continue;
+		}
+		br = ntfs_attr_pread(na, pos, end - pos < CAT_BUFFER_SIZE ?
+				end - pos : CAT_BUFFER_SIZE, buf);
+		if (br <= 0) {
+			fprintf(stderr, "%s: read failed at %lld: %s\n", path,
+					(long long)pos, strerror(errno));
+			return -1;
+		}
+		if (fwrite(buf, 1, br, stdout) != (size_t)br)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Write a hole of @len bytes to stdout: seek over it if stdout is a file,
+ * which leaves the hole unallocated, or write zeroes.
+ */
+static int cli_cat_hole(s64 len, BOOL sparse, char *buf)
+{
+	size_t n;
+
+	if (sparse)
+		return fseeko(stdout, len, SEEK_CUR);
+	memset(buf, 0, len < CAT_BUFFER_SIZE ? len : CAT_BUFFER_SIZE);
+	for (; len > 0; len -= n) {
+		n = len < CAT_BUFFER_SIZE ? len : CAT_BUFFER_SIZE;
+		if (fwrite(buf, 1, n, stdout) != n)
+			return -1;
+	}
+	return 0;
+}
+
+static int cli_cat(ntfs_volume *vol, const char *path)
+{
+	ntfs_inode *ni;
+	ntfs_attr *na;
+	struct stat st;
+	s64 pos, data, hole;
+	BOOL sparse;
+	char *buf;
+	int ret = -1;
+
+	ni = cli_open(vol, path);
+	if (!ni)
+		return -1;
+	na = ntfs_attr_open(ni, AT_DATA, AT_UNNAMED, 0);
+	if (!na) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		goto close_inode;
+	}
+	buf = malloc(CAT_BUFFER_SIZE);
+	if (!buf)
+		goto close_attr;
+	/* Holes stay holes in a file, unless it is appended to. */
+	sparse = !fstat(fileno(stdout), &st) && S_ISREG(st.st_mode) &&
+			!(fcntl(fileno(stdout), F_GETFL) & O_APPEND);
+	for (pos = 0; pos < na->data_size; pos = hole) {
+		data = ntfs_attr_seek_data(na, pos);
+		if (data < 0) {
+			if (errno != ENXIO)
+				goto seek_failed;
+			data = na->data_size;
+		}
+		if (data > pos && cli_cat_hole(data - pos, sparse, buf))
+			goto free_buf;
+		if (data == na->data_size)
+			break;
+		hole = ntfs_attr_seek_hole(na, data);
+		if (hole < 0)
+			goto seek_failed;
+		if (cli_cat_data(na, path, data, hole, buf))
+			goto free_buf;
+	}
+	/* A hole at the end is only made by setting the size. */
+	if (sparse && (fflush(stdout) ||
+	    ftruncate(fileno(stdout), ftello(stdout))))
+		goto free_buf;
+	ret = 0;
+	goto free_buf;
+seek_failed:
+	fprintf(stderr, "%s: seek failed at %lld: %s\n", path,
+			(long long)pos, strerror(errno));
+free_buf:
+	free(buf);
+close_attr:
+	ntfs_attr_close(na);
+close_inode:
+	ntfs_inode_close(ni);
+	return ret;
+}
+
+static int cli_map(ntfs_volume *vol, const char *path)
+{
+	ntfs_extent ext[MAP_EXTENTS];
+	ntfs_inode *ni;
+	ntfs_attr *na;
+	s64 offset = 0;
+	int i, n, ret = -1;
+
+	ni = cli_open(vol, path);
+	if (!ni)
+		return -1;
+	na = ntfs_attr_open(ni, AT_DATA, AT_UNNAMED, 0);
+	if (!na) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		goto close_inode;
+	}
+	while ((n = ntfs_attr_get_extents(na, offset, ext, MAP_EXTENTS)) > 0) {
+		for (i = 0; i < n; i++)
+			printf("%12lld %12lld %12lld%s%s%s%s%s%s\n",
+				(long long)ext[i].offset,
+				(long long)ext[i].length,
+				(long long)ext[i].pos,
+				ext[i].flags & NTFS_EXTENT_HOLE ? " hole" : "",
+				ext[i].flags & NTFS_EXTENT_UNINIT ?
+					" uninit" : "",
+				ext[i].flags & NTFS_EXTENT_COMPRESSED ?
+					" compressed" : "",
+				ext[i].flags & NTFS_EXTENT_RESIDENT ?
+					" resident" : "",
+				ext[i].flags & NTFS_EXTENT_ENCRYPTED ?
+					" encrypted" : "",
+				ext[i].flags & NTFS_EXTENT_LAST ? " last" : "");
+		offset = ext[n - 1].offset + ext[n - 1].length;
+	}
+	if (n < 0)
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+	else
+		ret = 0;
+	ntfs_attr_close(na);
+close_inode:
+	ntfs_inode_close(ni);
+	return ret;
+}
+
+static void cli_stats(ntfs_volume *vol)
+{
+	ntfs_volume_stats st;
+
+	ntfs_volume_get_stats(vol, &st);
+	fprintf(stderr, "device reads:        %llu\n"
+		"device read bytes:   %llu\n"
+		"mft records:         %llu\n"
+		"index blocks:        %llu\n"
+		"compression blocks:  %llu\n"
+		"cache hits:          %llu\n"
+		"cache misses:        %llu\n"
+		"allocations:         %llu\n"
+		"prefetch hits:       %llu\n"
+		"path index hits:     %llu\n",
+		(unsigned long long)st.dev_reads,
+		(unsigned long long)st.dev_read_bytes,
+		(unsigned long long)st.mft_records,
+		(unsigned long long)st.index_blocks,
+		(unsigned long long)st.compression_blocks,
+		(unsigned long long)st.cache_hits,
+		(unsigned long long)st.cache_misses,
+		(unsigned long long)st.allocations,
+		(unsigned long long)st.prefetch_hits,
+		(unsigned long long)st.path_index_hits);
+}
+
+static int cli_trace(ntfs_volume *vol, const char *path)
+{
+	FILE *f;
+	void *buf;
+	s64 size;
+	int ret = -1;
+
+	size = ntfs_device_trace_save(vol->dev, NULL, 0);
+	if (size < 0)
+		return -1;
+	buf = malloc(size);
+	if (!buf)
+		return -1;
+	if (ntfs_device_trace_save(vol->dev, buf, size) == size) {
+		f = fopen(path, "wb");
+		if (f) {
+			if (fwrite(buf, 1, size, f) == (size_t)size)
+				ret = 0;
+			if (fclose(f))
+				ret = -1;
+		}
+	}
+	if (ret)
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+	free(buf);
+	return ret;
+}
+
+static int cli_prefetch(ntfs_volume *vol, const char *path, BOOL stats)
+{
+	FILE *f;
+	void *buf = NULL;
+	long size;
+	s64 bytes = -1;
+
+	f = fopen(path, "rb");
+	if (f) {
+		if (!fseek(f, 0, SEEK_END) && (size = ftell(f)) > 0 &&
+		    !fseek(f, 0, SEEK_SET) && (buf = malloc(size)) &&
+		    fread(buf, 1, size, f) == (size_t)size)
+			bytes = ntfs_device_prefetch(vol->dev, buf, size,
+					PREFETCH_SIZE, PREFETCH_GAP);
+		else if (!errno)
+			errno = EINVAL;
+		fclose(f);
+	}
+	free(buf);
+	if (bytes < 0) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (stats)
+		fprintf(stderr, "prefetched bytes:    %lld\n",
+				(long long)bytes);
+	return 0;
+}
+
+/* Map the path index file and attach it to the volume. */
+static void *cli_path_index(ntfs_volume *vol, const char *path, size_t *size)
+{
+	struct stat st;
+	void *map = NULL;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		if (!fstat(fd, &st) && st.st_size > 0) {
+			map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd,
+					0);
+			if (map == MAP_FAILED)
+				map = NULL;
+			else if (ntfs_path_index_attach(vol, map, st.st_size,
+					FALSE)) {
+				munmap(map, st.st_size);
+				map = NULL;
+			}
+		} else if (!errno)
+			errno = EINVAL;
+		close(fd);
+	}
+	if (!map)
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+	*size = map ? st.st_size : 0;
+	return map;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-m] [-s] [-t trace] [-p profile] "
+		"[-x index] image mount\n"
+		"       %s [-m] [-s] [-t trace] [-p profile] [-x index] "
+		"image ls [dir]\n"
+		"       %s [-m] [-s] [-t trace] [-p profile] [-x index] "
+		"image stat path\n"
+		"       %s [-m] [-s] [-t trace] [-p profile] [-x index] "
+		"image cat path\n"
+		"       %s [-m] [-s] [-t trace] [-p profile] [-x index] "
+		"image map path\n",
+		prog, prog, prog, prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+	ntfs_volume *vol;
+	const char *prog = argv[0], *cmd;
+	const char *trace = NULL, *profile = NULL, *index = NULL;
+	BOOL map = FALSE, stats = FALSE;
+	void *index_map = NULL;
+	size_t index_size = 0;
+	int ret;
+
+	while (argc > 1 && argv[1][0] == '-') {
+		if (!strcmp(argv[1], "-m"))
+			map = TRUE;
+		else if (!strcmp(argv[1], "-s"))
+			stats = TRUE;
+		else if (!strcmp(argv[1], "-t") && argc > 2) {
+			trace = argv[2];
+			argv++;
+			argc--;
+		} else if (!strcmp(argv[1], "-p") && argc > 2) {
+			profile = argv[2];
+			argv++;
+			argc--;
+		} else if (!strcmp(argv[1], "-x") && argc > 2) {
+			index = argv[2];
+			argv++;
+			argc--;
+		} else {
+			usage(prog);
+			return 2;
+		}
+		argv++;
+		argc--;
+	}
+	if (argc < 3 || argc > 4) {
+		usage(prog);
+		return 2;
+	}
+	cmd = argv[2];
+	if (strcmp(cmd, "mount") && strcmp(cmd, "ls") &&
+	    ((strcmp(cmd, "stat") && strcmp(cmd, "cat") &&
+	      strcmp(cmd, "map")) || argc != 4)) {
+		usage(prog);
+		return 2;
+	}
+
+	ntfs_log_set_handler(ntfs_log_handler_stderr);
+	vol = ntfs_image_mount_traced(argv[1], NTFS_MNT_RDONLY, map,
+			trace ? TRACE_SIZE : 0);
+	if (!vol) {
+		fprintf(stderr, "Failed to mount %s: %s\n", argv[1],
+				strerror(errno));
+		return 1;
+	}
+	if (profile && cli_prefetch(vol, profile, stats)) {
+		ntfs_umount(vol, FALSE);
+		return 1;
+	}
+	if (index) {
+		index_map = cli_path_index(vol, index, &index_size);
+		if (!index_map) {
+			ntfs_umount(vol, FALSE);
+			return 1;
+		}
+	}
+
+	if (!strcmp(cmd, "mount"))
+		ret = cli_mount(vol);
+	else if (!strcmp(cmd, "ls"))
+		ret = cli_ls(vol, argc > 3 ? argv[3] : NULL);
+	else if (!strcmp(cmd, "stat"))
+		ret = cli_stat(vol, argv[3]);
+	else if (!strcmp(cmd, "map"))
+		ret = cli_map(vol, argv[3]);
+	else
+		ret = cli_cat(vol, argv[3]);
+	if (stats)
+		cli_stats(vol);
+	if (trace && cli_trace(vol, trace))
+		ret = -1;
+
+	ntfs_umount(vol, FALSE);
+	if (index_map)
+		munmap(index_map, index_size);
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,440 @@
+/**
+ * ntfsreplay - Replay an I/O trace against a volume image.
+ *
+ *	ntfsreplay [-c cache_kb,...] [-p page_kb] [-a pages,...] [-v]
+ *		trace image
+ *
+ * The trace is a dump of the device requests of a mount (an
+ * NTFS_IO_TRACE_HEADER and its records, see ntfs/device.h), saved by the
+ * driver through its volume stats protocol or by ntfscli -t. Its read
+ * requests are replayed through a simulated LRU page cache in front of the
+ * image, once per combination of cache size (-c, in KiB, 0 for no cache)
+ * and read-ahead (-a, pages read past a miss), so that cache and prefetch
+ * settings can be compared offline against a real boot.
+ *
+ * A miss reads the run of missing pages, plus the read-ahead, from the
+ * image with one pread(2). For each setting the number of those reads, the
+ * bytes they moved, the page hits and misses and the replay time are
+ * printed; -v adds the requests and misses per tag. The counts do not
+ * depend on the host, the times do (the image is likely in the host page
+ * cache after the first setting).
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "types.h"
+#include "endians.h"
+#include "device.h"
+
+#define MAX_SETTINGS	16
+#define READ_BUFFER	(1 << 20)
+
+static const char *tag_names[NTFS_IO_TAGS] = {
+	"other", "boot", "mft", "index", "data", "bitmap", "logfile", "meta",
+	"prefetch",
+};
+
+/**
+ * struct page - a cached page, in the LRU list and in a hash chain
+ */
+struct page {
+	s64 no;
+	struct page *prev, *next;	/* LRU list, most recent first */
+	struct page *hnext;		/* hash chain */
+};
+
+struct cache {
+	struct page *pages;
+	struct page **hash;
+	struct page *head, *tail;
+	u32 size, used, hmask;
+};
+
+struct result {
+	u64 reads, bytes, hits, misses;
+	u64 tag_requests[NTFS_IO_TAGS], tag_misses[NTFS_IO_TAGS];
+	double time;
+};
+
+static u32 page_size = 4096;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cache_init(struct cache *c, u32 size)
+{
+	u32 n;
+
+	memset(c, 0, sizeof(*c));
+	if (!size)
+		return 0;
+	for (n = 1; n < 2 * size; n <<= 1)
+		;
+	c->pages = calloc(size, sizeof(*c->pages));
+	c->hash = calloc(n, sizeof(*c->hash));
+	if (!c->pages || !c->hash)
+		return -1;
+	c->size = size;
+	c->hmask = n - 1;
+	return 0;
+}
+
+static void cache_free(struct cache *c)
+{
+	free(c->pages);
+	free(c->hash);
+}
+
+static struct page **cache_slot(struct cache *c, s64 no)
+{
+	struct page **pp;
+
+	pp = &c->hash[(u32)(no * 0x9e3779b1) & c->hmask];
+	while (*pp && (*pp)->no != no)
+		pp = &(*pp)->hnext;
+	return pp;
+}
+
+static void lru_unlink(struct cache *c, struct page *p)
+{
+	if (p->prev)
+		p->prev->next = p->next;
+	else
+		c->head = p->next;
+	if (p->next)
+		p->next->prev = p->prev;
+	else
+		c->tail = p->prev;
+}
+
+static void lru_push(struct cache *c, struct page *p)
+{
+	p->prev = NULL;
+	p->next = c->head;
+	if (c->head)
+		c->head->prev = p;
+	else
+		c->tail = p;
+	c->head = p;
+}
+
+/* Look page @no up, making it the most recent on a hit. */
+static BOOL cache_lookup(struct cache *c, s64 no)
+{
+	struct page *p;
+
+	if (!c->size)
+		return FALSE;
+	p = *cache_slot(c, no);
+	if (!p)
+		return FALSE;
+	lru_unlink(c, p);
+	lru_push(c, p);
+	return TRUE;
+}
+
+static void cache_insert(struct cache *c, s64 no)
+{
+	struct page **pp, *p;
+
+	if (!c->size || *cache_slot(c, no))
+		return;
+	if (c->used < c->size)
+		p = &c->pages[c->used++];
+	else {
+		/* Evict the least recently used page. */
+		p = c->tail;
+		lru_unlink(c, p);
+		pp = cache_slot(c, p->no);
+		*pp = p->hnext;
+	}
+	p->no = no;
+	pp = cache_slot(c, no);
+	p->hnext = NULL;
+	*pp = p;
+	lru_push(c, p);
+}
+
+/* One device request of @count bytes, done in READ_BUFFER sized pieces. */
+static int image_read(int fd, u8 *buf, s64 pos, s64 count,
+		struct result *res)
+{
+	ssize_t br;
+
+	res->reads++;
+	res->bytes += count;
+	while (count > 0) {
+		br = pread(fd, buf, (size_t)(count > READ_BUFFER ?
+				READ_BUFFER : count), (off_t)pos);
+		if (br < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (!br)
+			break;
+		pos += br;
+		count -= br;
+	}
+	return 0;
+}
+
+static int replay(int fd, s64 image_size, const NTFS_IO_TRACE_RECORD *rec,
+		u32 count, u32 cache_pages, u32 readahead, struct result *res)
+{
+	struct cache c;
+	s64 pos, len, first, last, no, run, end, max_page;
+	BOOL missed;
+	u8 *buf;
+	u32 i;
+	int tag, ret = -1;
+
+	memset(res, 0, sizeof(*res));
+	if (cache_init(&c, cache_pages))
+		goto out;
+	buf = malloc(READ_BUFFER);
+	if (!buf)
+		goto out;
+	max_page = (image_size + page_size - 1) / page_size;
+	res->time = now();
+	for (i = 0; i < count; i++) {
+		if (rec[i].flags & NTFS_IO_WRITE)
+			continue;
+		pos = sle64_to_cpu(rec[i].pos);
+		len = le32_to_cpu(rec[i].count);
+		tag = rec[i].tag < NTFS_IO_TAGS ? rec[i].tag : NTFS_IO_OTHER;
+		if (len <= 0 || pos >= image_size)
+			continue;
+		if (len > image_size - pos)
+			len = image_size - pos;
+		res->tag_requests[tag]++;
+		if (!cache_pages) {
+			/* No cache: the request goes to the device as is. */
+			res->tag_misses[tag]++;
+			res->misses += (pos + len - 1) / page_size -
+					pos / page_size + 1;
+			if (image_read(fd, buf, pos, len, res))
+				goto free_buf;
+			continue;
+		}
+		first = pos / page_size;
+		last = (pos + len - 1) / page_size;
+		missed = FALSE;
+		for (no = first; no <= last; no++) {
+			if (cache_lookup(&c, no)) {
+				res->hits++;
+				continue;
+			}
+			missed = TRUE;
+			/* Read the run of missing pages and the read-ahead. */
+			for (end = no + 1; end <= last &&
+					end - no < cache_pages; end++)
+				if (*cache_slot(&c, end))
+					break;
+			res->misses += end - no;
+			run = end - no;
+			if (end > last)
+				for (; run < cache_pages && end < max_page &&
+						end <= last + readahead; end++) {
+					if (*cache_slot(&c, end))
+						break;
+					run++;
+				}
+			if (image_read(fd, buf, no * page_size,
+					run * page_size, res))
+				goto free_buf;
+			for (; no < end; no++)
+				cache_insert(&c, no);
+			no--;
+		}
+		if (missed)
+			res->tag_misses[tag]++;
+	}
+	res->time = now() - res->time;
+	ret = 0;
+free_buf:
+	free(buf);
+out:
+	cache_free(&c);
+	return ret;
+}
+
+static int parse_list(const char *s, u32 *v, int max)
+{
+	char *end;
+	int n = 0;
+
+	do {
+		if (n == max)
+			return -1;
+		v[n++] = (u32)strtoul(s, &end, 0);
+		if (end == s || (*end && *end != ','))
+			return -1;
+		s = end + 1;
+	} while (*end);
+	return n;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-c cache_kb,...] [-p page_kb] "
+		"[-a pages,...] [-v] trace image\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	u32 caches[MAX_SETTINGS] = { 0, 256, 1024, 4096 };
+	u32 aheads[MAX_SETTINGS] = { 0, 8 };
+	int ncaches = 4, naheads = 2, verbose = 0;
+	NTFS_IO_TRACE_HEADER *h;
+	NTFS_IO_TRACE_RECORD *rec;
+	struct result res;
+	struct stat st;
+	u64 tag_requests[NTFS_IO_TAGS] = { 0 }, bytes = 0, span = 0;
+	u32 count, i;
+	char *data;
+	FILE *f;
+	long size;
+	int opt, fd, ci, ai, t;
+
+	while ((opt = getopt(argc, argv, "c:p:a:v")) != -1) {
+		switch (opt) {
+		case 'c':
+			ncaches = parse_list(optarg, caches, MAX_SETTINGS);
+			break;
+		case 'a':
+			naheads = parse_list(optarg, aheads, MAX_SETTINGS);
+			break;
+		case 'p':
+			page_size = (u32)strtoul(optarg, NULL, 0) * 1024;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (argc - optind != 2 || ncaches < 0 || naheads < 0 || !page_size) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	f = fopen(argv[optind], "rb");
+	if (!f || fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET)) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	data = malloc(size ? size : 1);
+	if (!data || fread(data, 1, size, f) != (size_t)size) {
+		fprintf(stderr, "%s: read failed\n", argv[optind]);
+		return 1;
+	}
+	fclose(f);
+	h = (NTFS_IO_TRACE_HEADER *)data;
+	if (size < (long)sizeof(*h) ||
+	    le32_to_cpu(h->magic) != NTFS_IO_TRACE_MAGIC ||
+	    le16_to_cpu(h->version) != NTFS_IO_TRACE_VERSION ||
+	    le16_to_cpu(h->record_size) != sizeof(*rec)) {
+		fprintf(stderr, "%s: not an I/O trace\n", argv[optind]);
+		return 1;
+	}
+	count = le32_to_cpu(h->count);
+	if ((size - sizeof(*h)) / sizeof(*rec) < count) {
+		fprintf(stderr, "%s: truncated trace\n", argv[optind]);
+		return 1;
+	}
+	rec = (NTFS_IO_TRACE_RECORD *)(h + 1);
+
+	fd = open(argv[optind + 1], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		fprintf(stderr, "%s: %s\n", argv[optind + 1], strerror(errno));
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		t = rec[i].tag < NTFS_IO_TAGS ? rec[i].tag : NTFS_IO_OTHER;
+		tag_requests[t]++;
+		bytes += le32_to_cpu(rec[i].count);
+	}
+	if (count)
+		span = le64_to_cpu(rec[count - 1].time) -
+				le64_to_cpu(rec[0].time);
+	printf("trace: %u requests (%llu seen), %llu bytes", count,
+			(unsigned long long)le64_to_cpu(h->total),
+			(unsigned long long)bytes);
+	if (le64_to_cpu(h->ticks_per_sec))
+		printf(", %.6f s", (double)span /
+				le64_to_cpu(h->ticks_per_sec));
+	printf("\n");
+	for (t = 0; t < NTFS_IO_TAGS; t++)
+		if (tag_requests[t])
+			printf("  %-8s %llu\n", tag_names[t],
+					(unsigned long long)tag_requests[t]);
+
+	printf("%10s %10s %10s %12s %10s %10s %10s\n", "cache_kb", "readahead",
+			"reads", "bytes", "hits", "misses", "time_s");
+	for (ci = 0; ci < ncaches; ci++) {
+		for (ai = 0; ai < naheads; ai++) {
+			/* Read-ahead needs a cache to read into. */
+			if (!caches[ci] && ai)
+				continue;
+			if (replay(fd, st.st_size, rec, count,
+					(u32)((u64)caches[ci] * 1024 /
+					page_size), caches[ci] ? aheads[ai] : 0,
+					&res)) {
+				fprintf(stderr, "replay failed: %s\n",
+						strerror(errno));
+				return 1;
+			}
+			printf("%10u %10u %10llu %12llu %10llu %10llu %10.6f\n",
+					caches[ci], caches[ci] ? aheads[ai] : 0,
+					(unsigned long long)res.reads,
+					(unsigned long long)res.bytes,
+					(unsigned long long)res.hits,
+					(unsigned long long)res.misses,
+					res.time);
+			if (verbose)
+				for (t = 0; t < NTFS_IO_TAGS; t++)
+					if (res.tag_requests[t])
+						printf("  %-8s %llu requests, "
+							"%llu missed\n",
+							tag_names[t],
+							(unsigned long long)
+							res.tag_requests[t],
+							(unsigned long long)
+							res.tag_misses[t]);
+		}
+	}
+	close(fd);
+	free(data);
+	return 0;
+}
@@ -47,105 +47,156 @@ int r = 1;
   return r;
 }
 
-// mem.cpp
-int memcmp(void *dst, void *src, int size)
+void *memchr(void *src, int c)
 {
-	char *pDst = (char *) dst;
 	char *pSrc = (char *) src;
-	int i;
 
-	for(i =0; i < size; i++)
-	{
-		if (*pDst == *pSrc)
-		{
-			pDst++;
-			pSrc++;
-		}
-		else
-			return -1;
-	}
-	
-	return 0;
+	while(*pSrc != c)
+		pSrc++;
+
+	return (void *) pSrc;
 }
 
-void* memcpy(void *dst, void *src, int size)
-{
-	char *pDst = (char *) dst;
-	char *pSrc = (char *) src;
 
-	while(size-- > 0)
-	{
-		*pDst++ = *pSrc++;
-	}
+//
+// Every block handed out by malloc() is preceded by a LIBC_BLOCK header that
+// records how many bytes the caller asked for and how many are reserved, so
+// realloc() can grow in place and copy only the bytes actually in use.
+//
+#define LIBC_BLOCK_SIGNATURE	SIGNATURE_32 ('l', 'b', 'l', 'k')
+#define LIBC_BLOCK_FREED	SIGNATURE_32 ('l', 'b', 'f', 'r')
+#define LIBC_BLOCK_ALIGNMENT	sizeof(UINTN)
 
-	return dst;
-}
+typedef struct {
+	UINT32	Signature;
+	UINT32	Reserved;
+	UINTN	Size;		// bytes requested by the caller
+	UINTN	Capacity;	// bytes usable after the header
+} LIBC_BLOCK;
+
+#define LIBC_BLOCK_FROM_PTR(p)	((LIBC_BLOCK *) (p) - 1)
 
-void *memset(void *dst, int pattern, int size)
+static LIBC_BLOCK *LibcBlockFromPtr(void *ptr)
 {
-	char *pDst = (char *) dst;
+	LIBC_BLOCK *block = LIBC_BLOCK_FROM_PTR(ptr);
 
-	while(size-- > 0)
+	if (block->Signature != LIBC_BLOCK_SIGNATURE)
 	{
-		*pDst++ = pattern;
+		Print(L"invalid pointer %x\n", ptr);
+		return NULL;
 	}
 
-	return dst;
+	return block;
 }
 
-void *memchr(void *src, int c)
+/**
+ *	Allocate a block able to hold Capacity bytes, of which Size are in use.
+ *	Only the bytes from ZeroFrom up to Capacity are cleared; the caller is
+ *	expected to fill the head of the block itself.
+ **/
+static void *LibcAllocateBlock(UINTN Size, UINTN Capacity, UINTN ZeroFrom)
 {
-	char *pSrc = (char *) src;
+	LIBC_BLOCK *block;
 
-	while(*pSrc != c)
-		pSrc++;
+	Capacity = ALIGN_VALUE(Capacity, LIBC_BLOCK_ALIGNMENT);
 
-	return (void *) pSrc;
-}
+	block = AllocatePool(sizeof(LIBC_BLOCK) + Capacity);
+	if (block == NULL)
+		return NULL;
+
+	block->Signature = LIBC_BLOCK_SIGNATURE;
+	block->Reserved = 0;
+	block->Size = Size;
+	block->Capacity = Capacity;
 
+	if (ZeroFrom < Capacity)
+		ZeroMem((UINT8 *) (block + 1) + ZeroFrom, Capacity - ZeroFrom);
+
+	return block + 1;
+}
 
 void free(void *ptr)
 {
-	int *x;
+	LIBC_BLOCK *block;
 
 	if (ptr == NULL)
 		return;	// nothing to free!!!
 
-	// force! fix!
-	x = (int *) ptr;
-
-	x -= sizeof(UINTN);
-
-	if (*x == 0x30726670)
-	{
-		Print(L"invalid pointer %x\n", ptr);
+	block = LibcBlockFromPtr(ptr);
+	if (block == NULL)
 		return;
-	}
-	FreePool(ptr);
+
+	block->Signature = LIBC_BLOCK_FREED;
+	FreePool(block);
 	return;
 }
 
 /////////////
 void *malloc(size_t size)
 {
-	return AllocateZeroPool(size);
+	if (size < 0)
+		return NULL;
+
+	return LibcAllocateBlock(size, size, 0);
 }
 
 void * calloc(size_t nmemb, size_t lsize)
 {
-	return AllocateZeroPool(nmemb * lsize);
+	if (nmemb < 0 || lsize < 0 || (lsize != 0 && nmemb > MAX_INT32 / lsize))
+		return NULL;
+
+	return malloc(nmemb * lsize);
 }
 
+/**
+ *	void *realloc(void *ptr, size_t size)
+ *	Resize a block, preserving its contents.
+ *	Blocks are grown in place while they fit in the reserved capacity;
+ *	otherwise the capacity is doubled, so a sequence of small growths
+ *	(runlists, attribute lists) costs amortized linear time overall.
+ *	Newly exposed bytes are zeroed, like the rest of malloc() memory.
+ **/
 void *realloc(void *ptr, size_t size)
 {
-	void *nb = malloc(size);
+	LIBC_BLOCK *block;
+	UINTN capacity;
+	void *nb;
+
+	if (ptr == NULL)
+		return malloc(size);
+
+	if (size < 0)
+		return NULL;
 
-	if (ptr != NULL && nb != NULL)
-	{	// transfer
-		memcpy(nb, ptr, size);
-		free(ptr);
+	block = LibcBlockFromPtr(ptr);
+	if (block == NULL)
+		return NULL;
+
+	if ((UINTN) size <= block->Capacity)
+	{	// fits: grow or shrink in place
+		if ((UINTN) size > block->Size)
+			ZeroMem((UINT8 *) ptr + block->Size, size - block->Size);
+
+		block->Size = size;
+		return ptr;
+	}
+
+	capacity = block->Capacity * 2;
+	if (capacity < (UINTN) size)
+		capacity = size;
+
+	nb = LibcAllocateBlock(size, capacity, block->Size);
+	if (nb == NULL)
+	{	// retry without the headroom before giving up
+		nb = LibcAllocateBlock(size, size, block->Size);
+		if (nb == NULL)
+			return NULL;
 	}
 
+	// transfer only what the old block actually holds
+	CopyMem(nb, ptr, block->Size);
+	free(ptr);
+
 	return nb;
 }
 
@@ -0,0 +1,195 @@
+/**
+ * mem.c - memcpy, memset and memcmp for the freestanding C runtime.
+ *
+ * These sit under every sector copy, bounce buffer and MST fixup, so after
+ * aligning the destination they move a 64-bit word per step, or four SSE2
+ * vectors per step for large blocks where SSE2 is available. Only the head
+ * and tail are handled a byte at a time.
+ **/
+
+#include "memops.h"
+
+void *memcpy(void *dst, const void *src, int size)
+{
+	unsigned char *d = (unsigned char *) dst;
+	const unsigned char *s = (const unsigned char *) src;
+	unsigned int n, head;
+
+	if (size <= 0)
+		return dst;
+
+	n = (unsigned int) size;
+
+	if (n >= MEM_WORD_SIZE * 2)
+	{
+		// bring the destination to a word boundary
+		head = (MEM_WORD_SIZE - MEM_MISALIGN(d, MEM_WORD_MASK)) & MEM_WORD_MASK;
+		n -= head;
+		while (head--)
+			*d++ = *s++;
+
+#ifndef MEM_UNALIGNED_OK
+		if (MEM_MISALIGN(s, MEM_WORD_MASK) == 0)
+#endif
+		{
+#ifdef MEM_USE_SSE2
+			if (n >= MEM_VECTOR_SIZE * 4)
+			{
+				if (MEM_MISALIGN(d, MEM_VECTOR_MASK) != 0)
+				{	// one word takes us to a vector boundary
+					*(mem_aword *) d = *(const mem_uword *) s;
+					d += MEM_WORD_SIZE;
+					s += MEM_WORD_SIZE;
+					n -= MEM_WORD_SIZE;
+				}
+
+				for (; n >= MEM_VECTOR_SIZE * 4; n -= MEM_VECTOR_SIZE * 4)
+				{
+					__m128i v0 = _mm_loadu_si128((const __m128i *) s);
+					__m128i v1 = _mm_loadu_si128((const __m128i *) (s + 16));
+					__m128i v2 = _mm_loadu_si128((const __m128i *) (s + 32));
+					__m128i v3 = _mm_loadu_si128((const __m128i *) (s + 48));
+
+					_mm_store_si128((__m128i *) d, v0);
+					_mm_store_si128((__m128i *) (d + 16), v1);
+					_mm_store_si128((__m128i *) (d + 32), v2);
+					_mm_store_si128((__m128i *) (d + 48), v3);
+
+					d += MEM_VECTOR_SIZE * 4;
+					s += MEM_VECTOR_SIZE * 4;
+				}
+			}
+#endif
+			for (; n >= MEM_WORD_SIZE; n -= MEM_WORD_SIZE)
+			{
+				*(mem_aword *) d = *(const mem_uword *) s;
+				d += MEM_WORD_SIZE;
+				s += MEM_WORD_SIZE;
+			}
+		}
+	}
+
+	while (n--)
+		*d++ = *s++;
+
+	return dst;
+}
+
+void *memset(void *dst, int pattern, int size)
+{
+	unsigned char *d = (unsigned char *) dst;
+	unsigned char c = (unsigned char) pattern;
+	unsigned int n, head;
+	mem_word w;
+
+	if (size <= 0)
+		return dst;
+
+	n = (unsigned int) size;
+
+	if (n >= MEM_WORD_SIZE * 2)
+	{
+		head = (MEM_WORD_SIZE - MEM_MISALIGN(d, MEM_WORD_MASK)) & MEM_WORD_MASK;
+		n -= head;
+		while (head--)
+			*d++ = c;
+
+		w = 0x0101010101010101ULL * c;
+
+#ifdef MEM_USE_SSE2
+		if (n >= MEM_VECTOR_SIZE * 4)
+		{
+			__m128i v = _mm_set1_epi8((char) c);
+
+			if (MEM_MISALIGN(d, MEM_VECTOR_MASK) != 0)
+			{
+				*(mem_aword *) d = w;
+				d += MEM_WORD_SIZE;
+				n -= MEM_WORD_SIZE;
+			}
+
+			for (; n >= MEM_VECTOR_SIZE * 4; n -= MEM_VECTOR_SIZE * 4)
+			{
+				_mm_store_si128((__m128i *) d, v);
+				_mm_store_si128((__m128i *) (d + 16), v);
+				_mm_store_si128((__m128i *) (d + 32), v);
+				_mm_store_si128((__m128i *) (d + 48), v);
+				d += MEM_VECTOR_SIZE * 4;
+			}
+		}
+#endif
+		for (; n >= MEM_WORD_SIZE; n -= MEM_WORD_SIZE)
+		{
+			*(mem_aword *) d = w;
+			d += MEM_WORD_SIZE;
+		}
+	}
+
+	while (n--)
+		*d++ = c;
+
+	return dst;
+}
+
+/**
+ *	int memcmp(const void *buf1, const void *buf2, int size)
+ *	Compare two buffers as unsigned bytes.
+ *	Returns <0, 0 or >0 as the first differing byte of buf1 is lower than,
+ *	equal to or greater than the one of buf2.
+ **/
+int memcmp(const void *buf1, const void *buf2, int size)
+{
+	const unsigned char *p1 = (const unsigned char *) buf1;
+	const unsigned char *p2 = (const unsigned char *) buf2;
+	unsigned int n;
+
+	if (size <= 0)
+		return 0;
+
+	n = (unsigned int) size;
+
+#ifdef MEM_USE_SSE2
+	for (; n >= MEM_VECTOR_SIZE; n -= MEM_VECTOR_SIZE)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *) p1);
+		__m128i b = _mm_loadu_si128((const __m128i *) p2);
+		unsigned int diff = ~(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xffff;
+
+		if (diff != 0)
+		{	// locate the first differing byte
+			unsigned int i = 0;
+
+			while (!(diff & 1))
+			{
+				diff >>= 1;
+				i++;
+			}
+			return (int) p1[i] - (int) p2[i];
+		}
+
+		p1 += MEM_VECTOR_SIZE;
+		p2 += MEM_VECTOR_SIZE;
+	}
+#endif
+
+#ifndef MEM_UNALIGNED_OK
+	if (MEM_MISALIGN(p1, MEM_WORD_MASK) == 0 && MEM_MISALIGN(p2, MEM_WORD_MASK) == 0)
+#endif
+	{
+		// skip equal words; the byte loop below orders the first mismatch
+		while (n >= MEM_WORD_SIZE && *(const mem_uword *) p1 == *(const mem_uword *) p2)
+		{
+			p1 += MEM_WORD_SIZE;
+			p2 += MEM_WORD_SIZE;
+			n -= MEM_WORD_SIZE;
+		}
+	}
+
+	for (; n > 0; n--, p1++, p2++)
+	{
+		if (*p1 != *p2)
+			return (int) *p1 - (int) *p2;
+	}
+
+	return 0;
+}
@@ -8,7 +8,7 @@
 *       Overlapping buffers are treated specially, to avoid propogation.
 *
 *******************************************************************************/
-#include <sys/types.h>
+#include "memops.h"
 
 /***
 *memmove - Copy source buffer to destination buffer
@@ -18,10 +18,15 @@
 *       This routine recognize overlapping buffers to avoid propogation.
 *       For cases where propogation is not a problem, memcpy() can be used.
 *
+*       When the destination starts below the source a forward copy never
+*       overwrites source bytes before they are read, so that case is handed
+*       to the word-wide memcpy(). Otherwise the copy runs from the top down,
+*       a word at a time once the end of the destination is aligned.
+*
 *Entry:
 *       void *dst = pointer to destination buffer
 *       const void *src = pointer to source buffer
-*       size_t count = number of bytes to copy
+*       int count = number of bytes to copy
 *
 *Exit:
 *       Returns a pointer to the destination buffer
@@ -29,35 +34,51 @@
 *Exceptions:
 *******************************************************************************/
 
-void * memmove (void * dst, const void * src, size_t count)
+void * memmove (void * dst, const void * src, int count)
 {
-        void * ret = dst;
+        unsigned char *d;
+        const unsigned char *s;
+        unsigned int n, tail;
+
+        if (count <= 0)
+                return(dst);
 
         if (dst <= src || (char *)dst >= ((char *)src + count)) {
                 /*
-                 * Non-Overlapping Buffers
+                 * Non-Overlapping Buffers, or destination below source
                  * copy from lower addresses to higher addresses
                  */
-                while (count--) {
-                        *(char *)dst = *(char *)src;
-                        dst = (char *)dst + 1;
-                        src = (char *)src + 1;
-                }
+                return memcpy(dst, src, count);
         }
-        else {
-                /*
-                 * Overlapping Buffers
-                 * copy from higher addresses to lower addresses
-                 */
-                dst = (char *)dst + count - 1;
-                src = (char *)src + count - 1;
 
-                while (count--) {
-                        *(char *)dst = *(char *)src;
-                        dst = (char *)dst - 1;
-                        src = (char *)src - 1;
+        /*
+         * Overlapping Buffers
+         * copy from higher addresses to lower addresses
+         */
+        n = (unsigned int) count;
+        d = (unsigned char *)dst + n;
+        s = (const unsigned char *)src + n;
+
+        if (n >= MEM_WORD_SIZE * 2) {
+                tail = MEM_MISALIGN(d, MEM_WORD_MASK);
+                n -= tail;
+                while (tail--)
+                        *--d = *--s;
+
+#ifndef MEM_UNALIGNED_OK
+                if (MEM_MISALIGN(s, MEM_WORD_MASK) == 0)
+#endif
+                {
+                        for (; n >= MEM_WORD_SIZE; n -= MEM_WORD_SIZE) {
+                                d -= MEM_WORD_SIZE;
+                                s -= MEM_WORD_SIZE;
+                                *(mem_aword *)d = *(const mem_uword *)s;
+                        }
                 }
         }
 
-        return(ret);
+        while (n--)
+                *--d = *--s;
+
+        return(dst);
 }
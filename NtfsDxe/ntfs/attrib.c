@@ -84,6 +84,12 @@ ntfschar TXF_DATA[] = { const_cpu_to_le16('$'),
 			const_cpu_to_le16('A'),
 			const_cpu_to_le16('\0') };
 
+/*
+ * Bumped whenever attribute records are moved inside an mft record, which
+ * makes every attribute table stale. Starts at 1, 0 meaning "no table".
+ */
+u32 ntfs_attr_layout_gen = 1;
+
 static int NAttrFlag(ntfs_attr *na, FILE_ATTR_FLAGS flag)
 {
 	if (na->type == AT_DATA && na->name == AT_UNNAMED)
@@ -400,7 +406,7 @@ void ntfs_attr_init(ntfs_attr *na, const BOOL non_resident,
 ntfs_attr *ntfs_attr_open(ntfs_inode *ni, const ATTR_TYPES type,
 		ntfschar *name, u32 name_len)
 {
-	ntfs_attr_search_ctx *ctx;
+	ntfs_attr_search_ctx actx, *ctx = &actx;
 	ntfs_attr *na = NULL;
 	ntfschar *newname = NULL;
 	ATTR_RECORD *a;
@@ -423,9 +429,7 @@ ntfs_attr *ntfs_attr_open(ntfs_inode *ni, const ATTR_TYPES type,
 		newname = name;
 	}
 
-	ctx = ntfs_attr_get_search_ctx(ni, NULL);
-	if (!ctx)
-		goto err_out;
+	ntfs_attr_stack_search_ctx(ctx, ni, NULL);
 
 	if (ntfs_attr_lookup(type, name, name_len, 0, 0, NULL, 0, ctx))
 		goto put_err_out;
@@ -499,8 +503,8 @@ ntfs_attr *ntfs_attr_open(ntfs_inode *ni, const ATTR_TYPES type,
 			goto put_err_out;
 		}
 		ntfs_attr_init(na, TRUE, a->flags,
-				a->flags & ATTR_IS_ENCRYPTED,
-				a->flags & ATTR_IS_SPARSE,
+				!!(a->flags & ATTR_IS_ENCRYPTED),
+				!!(a->flags & ATTR_IS_SPARSE),
 				sle64_to_cpu(a->allocated_size),
 				sle64_to_cpu(a->data_size),
 				sle64_to_cpu(a->initialized_size),
@@ -509,17 +513,15 @@ ntfs_attr *ntfs_attr_open(ntfs_inode *ni, const ATTR_TYPES type,
 	} else {
 		s64 l = le32_to_cpu(a->value_length);
 		ntfs_attr_init(na, FALSE, a->flags,
-				a->flags & ATTR_IS_ENCRYPTED,
-				a->flags & ATTR_IS_SPARSE, (l + 7) & ~7, l, l,
+				!!(a->flags & ATTR_IS_ENCRYPTED),
+				!!(a->flags & ATTR_IS_SPARSE), (l + 7) & ~7, l, l,
 				cs ? (l + 7) & ~7 : 0, 0);
 	}
-	ntfs_attr_put_search_ctx(ctx);
 out:
 	ntfs_log_leave("\n");	
 	return na;
 
 put_err_out:
-	ntfs_attr_put_search_ctx(ctx);
 err_out:
 	free(newname);
 	free(na);
@@ -610,7 +612,7 @@ static int ntfs_attr_map_partial_runlist(ntfs_attr *na, VCN vcn)
 	runlist_element *rl;
 	ATTR_RECORD *a;
 	BOOL startseen;
-	ntfs_attr_search_ctx *ctx;
+	ntfs_attr_search_ctx actx, *ctx = &actx;
 
 	lcn = ntfs_rl_vcn_to_lcn(na->rl, vcn);
 	if (lcn >= 0 || lcn == LCN_HOLE || lcn == LCN_ENOENT)
@@ -618,9 +620,7 @@ static int ntfs_attr_map_partial_runlist(ntfs_attr *na, VCN vcn)
 
 	existing_vcn = (na->rl ? na->rl->vcn : -1);
 
-	ctx = ntfs_attr_get_search_ctx(na->ni, NULL);
-	if (!ctx)
-		return -1;
+	ntfs_attr_stack_search_ctx(ctx, na->ni, NULL);
 
 	/* Get the last vcn in the attribute. */
 	last_vcn = na->allocated_size >> na->ni->vol->cluster_size_bits;
@@ -658,7 +658,6 @@ static int ntfs_attr_map_partial_runlist(ntfs_attr *na, VCN vcn)
 		} else
 			rl = (runlist_element*)NULL;
 	} while (rl && (needed < last_vcn));
-	ntfs_attr_put_search_ctx(ctx);
 		/* mark fully mapped if we did so */
 	if (rl && startseen)
 		NAttrSetFullyMapped(na);
@@ -908,6 +907,35 @@ map_rl:
 	return NULL;
 }
 
+/**
+ * ntfs_attr_io_tag - what the device requests for an attribute are for
+ * @na:		opened ntfs attribute
+ *
+ * Return the ntfs_io_tag under which reads and writes of @na show in an I/O
+ * trace (see ntfs_device_set_io_tag()).
+ */
+static ntfs_io_tag ntfs_attr_io_tag(const ntfs_attr *na)
+{
+	switch (na->ni->mft_no) {
+	case FILE_MFT:
+		return na->type == AT_BITMAP ? NTFS_IO_BITMAP : NTFS_IO_MFT;
+	case FILE_MFTMirr:
+		return NTFS_IO_MFT;
+	case FILE_LogFile:
+		return NTFS_IO_LOGFILE;
+	case FILE_Bitmap:
+		return NTFS_IO_BITMAP;
+	}
+	if (na->type == AT_ATTRIBUTE_LIST)
+		return NTFS_IO_MFT;
+	if (na->type == AT_INDEX_ALLOCATION || na->type == AT_INDEX_ROOT ||
+	    (na->type == AT_BITMAP && na->name_len))
+		return NTFS_IO_INDEX;
+	if (na->ni->mft_no < FILE_first_user)
+		return NTFS_IO_META;
+	return NTFS_IO_DATA;
+}
+
 /**
  * ntfs_attr_pread_i - see description at ntfs_attr_pread()
  */ 
@@ -967,28 +995,47 @@ static s64 ntfs_attr_pread_i(ntfs_attr *na, const s64 pos, s64 count, void *b)
 	}
 	/* If it is a resident attribute, get the value from the mft record. */
 	if (!NAttrNonResident(na)) {
-		ntfs_attr_search_ctx *ctx;
+		ntfs_attr_search_ctx actx, *ctx;
+		ATTR_RECORD *a;
 		char *val;
 
-		ctx = ntfs_attr_get_search_ctx(na->ni, NULL);
-		if (!ctx)
-			return -1;
+		/*
+		 * Serve repeated reads from the record found last time, as
+		 * long as no attribute has moved since.
+		 */
+		a = na->value_attr;
+		if (a && na->value_gen == ntfs_attr_layout_gen &&
+				a->type == na->type && !a->non_resident) {
+			val = (char*)a + le16_to_cpu(a->value_offset);
+			if (val >= (char*)a && val +
+					le32_to_cpu(a->value_length) <=
+					(char*)a + le32_to_cpu(a->length) &&
+					pos + count <=
+					le32_to_cpu(a->value_length)) {
+				memcpy(b, val + pos, count);
+				return count;
+			}
+		}
+		na->value_attr = NULL;
+		ctx = &actx;
+		ntfs_attr_stack_search_ctx(ctx, na->ni, NULL);
 		if (ntfs_attr_lookup(na->type, na->name, na->name_len, 0,
-				0, NULL, 0, ctx)) {
-res_err_out:
-			ntfs_attr_put_search_ctx(ctx);
+				0, NULL, 0, ctx))
 			return -1;
-		}
 		val = (char*)ctx->attr + le16_to_cpu(ctx->attr->value_offset);
 		if (val < (char*)ctx->attr || val +
 				le32_to_cpu(ctx->attr->value_length) >
 				(char*)ctx->mrec + vol->mft_record_size) {
 			errno = EIO;
 			ntfs_log_perror("%s: Sanity check failed", __FUNCTION__);
-			goto res_err_out;
+			return -1;
 		}
 		memcpy(b, val + pos, count);
-		ntfs_attr_put_search_ctx(ctx);
+		if (val + le32_to_cpu(ctx->attr->value_length) <=
+				(char*)ctx->attr + le32_to_cpu(ctx->attr->length)) {
+			na->value_attr = ctx->attr;
+			na->value_gen = ntfs_attr_layout_gen;
+		}
 		return count;
 	}
 	total = total2 = 0;
@@ -1142,6 +1189,7 @@ rl_err_out:
  */
 s64 ntfs_attr_pread(ntfs_attr *na, const s64 pos, s64 count, void *b)
 {
+	ntfs_io_tag tag;
 	s64 ret;
 	
 	if (!na || !na->ni || !na->ni->vol || !b || pos < 0 || count < 0) {
@@ -1156,12 +1204,72 @@ s64 ntfs_attr_pread(ntfs_attr *na, const s64 pos, s64 count, void *b)
 		       "%l\n", (unsigned long long)na->ni->mft_no,
 		       na->type, (long long)pos, (long long)count);
 
+	tag = ntfs_device_set_io_tag(na->ni->vol->dev, ntfs_attr_io_tag(na));
 	ret = ntfs_attr_pread_i(na, pos, count, b);
+	ntfs_device_set_io_tag(na->ni->vol->dev, tag);
 	
 	ntfs_log_leave("\n");
 	return ret;
 }
 
+/**
+ * ntfs_attr_borrow - access attribute data in place on a mapped device
+ * @na:		ntfs attribute to read from
+ * @pos:	byte position in the attribute of the first byte wanted
+ * @count:	on entry the number of bytes wanted, on return the number of
+ *		bytes available at the returned address
+ *
+ * When the device of @na can lend its contents (see ntfs_device_borrow()),
+ * return a pointer to the data of @na at @pos without copying it. Only plain
+ * non-resident data qualifies: no compression, encryption or multi sector
+ * fixups are applied, holes and data past the initialized size are not
+ * backed by the device. @count is trimmed to the end of the run holding @pos
+ * and to the initialized size, so a caller walks a file with successive
+ * calls and falls back to ntfs_attr_pread() whenever NULL is returned.
+ *
+ * Return NULL with errno set to EOPNOTSUPP if the data cannot be borrowed,
+ * or to EINVAL on invalid arguments, including @pos at or past the
+ * initialized size.
+ */
+const void *ntfs_attr_borrow(ntfs_attr *na, const s64 pos, s64 *count)
+{
+	ntfs_volume *vol;
+	runlist_element *rl;
+	ntfs_io_tag tag;
+	const void *p;
+	s64 ofs, max;
+
+	if (!na || !na->ni || !na->ni->vol || !count || *count <= 0 ||
+	    pos < 0 || pos >= na->initialized_size) {
+		errno = EINVAL;
+		return NULL;
+	}
+	vol = na->ni->vol;
+	if (!vol->dev->d_ops->borrow || !NAttrNonResident(na) ||
+	    na->data_flags & (ATTR_COMPRESSION_MASK | ATTR_IS_ENCRYPTED)) {
+		errno = EOPNOTSUPP;
+		return NULL;
+	}
+	rl = ntfs_attr_find_vcn(na, pos >> vol->cluster_size_bits);
+	if (!rl)
+		return NULL;
+	if (rl->lcn < 0) {
+		errno = EOPNOTSUPP;
+		return NULL;
+	}
+	ofs = pos - (rl->vcn << vol->cluster_size_bits);
+	max = (rl->length << vol->cluster_size_bits) - ofs;
+	if (max > na->initialized_size - pos)
+		max = na->initialized_size - pos;
+	if (*count > max)
+		*count = max;
+	tag = ntfs_device_set_io_tag(vol->dev, ntfs_attr_io_tag(na));
+	p = ntfs_device_borrow(vol->dev,
+			(rl->lcn << vol->cluster_size_bits) + ofs, *count);
+	ntfs_device_set_io_tag(vol->dev, tag);
+	return p;
+}
+
 static int ntfs_attr_fill_zero(ntfs_attr *na, s64 pos, s64 count)
 {
 	char *buf;
@@ -2542,7 +2650,6 @@ s64 ntfs_attr_mst_pread(ntfs_attr *na, const s64 pos, const s64 bk_cnt,
 		const u32 bk_size, void *dst)
 {
 	s64 br;
-	u8 *end;
 	BOOL warn;
 
 	ntfs_log_trace("Entering for inode 0x%lx, attr type 0x%x, pos 0x%lx.\n",
@@ -2559,9 +2666,7 @@ s64 ntfs_attr_mst_pread(ntfs_attr *na, const s64 pos, const s64 bk_cnt,
 	br /= bk_size;
 		/* log errors unless silenced */
 	warn = !na->ni || !na->ni->vol || !NVolNoFixupWarn(na->ni->vol);
-	for (end = (u8*)dst + br * bk_size; (u8*)dst < end; dst = (u8*)dst +
-			bk_size)
-		ntfs_mst_post_read_fixup_warn((NTFS_RECORD*)dst, bk_size, warn);
+	ntfs_mst_post_read_fixup_batch(dst, br, bk_size, warn);
 	/* Finally, return the number of blocks read. */
 	return br;
 }
@@ -2641,6 +2746,171 @@ s64 ntfs_attr_mst_pwrite(ntfs_attr *na, const s64 pos, s64 bk_cnt,
 	return written / bk_size;
 }
 
+/*
+ *		Hash an attribute name for the attribute table
+ *
+ *	Never returns 0, which stands for unnamed attributes.
+ */
+
+static u16 ntfs_attr_name_hash(const ntfschar *name, u32 name_len)
+{
+	u32 h = 2166136261U;
+
+	while (name_len--)
+		h = (h ^ le16_to_cpu(*name++)) * 16777619U;
+	h ^= h >> 16;
+	return (u16)h ? (u16)h : 1;
+}
+
+/**
+ * ntfs_attr_table_build - index the attributes of an inode's mft record
+ * @ni:		inode whose base or extent mft record is indexed
+ *
+ * Parse the attribute headers of @ni->mrec once into @ni->attr_table, so that
+ * ntfs_attr_find() can probe the table rather than walk the record, and
+ * ntfs_external_attr_find() can go straight to the attribute an attribute
+ * list entry names by its mft reference and instance. The
+ * table stays valid until attribute records are moved in any mft record
+ * (ntfs_make_room_for_attr(), ntfs_attr_record_resize()); it is then rebuilt
+ * on the next lookup.
+ *
+ * Return 0 on success, or -1 if the record has more than
+ * NTFS_ATTR_TABLE_SIZE attributes or looks corrupt, in which case lookups
+ * walk the record as before.
+ */
+int ntfs_attr_table_build(ntfs_inode *ni)
+{
+	MFT_RECORD *m = ni->mrec;
+	ATTR_RECORD *a;
+	leMFT_REF mref;
+	u32 ofs, len, used;
+	u16 count = 0;
+
+	ni->attr_table_gen = 0;
+	used = le32_to_cpu(m->bytes_in_use);
+	if (used > le32_to_cpu(m->bytes_allocated) || used > 0xffff)
+		return -1;
+	mref = cpu_to_le64(MK_MREF(ni->mft_no,
+			le16_to_cpu(m->sequence_number)));
+	for (ofs = le16_to_cpu(m->attrs_offset); ofs + 4 <= used; ofs += len) {
+		a = (ATTR_RECORD *)((u8 *)m + ofs);
+		if (a->type == AT_END) {
+			ni->attr_table_end = (u16)ofs;
+			ni->attr_table_count = count;
+			ni->attr_table_gen = ntfs_attr_layout_gen;
+			return 0;
+		}
+		len = le32_to_cpu(a->length);
+		if (count == NTFS_ATTR_TABLE_SIZE || !len || len > used - ofs ||
+				le16_to_cpu(a->name_offset) +
+				a->name_length * sizeof(ntfschar) > len)
+			return -1;
+		ni->attr_table[count].type = a->type;
+		ni->attr_table[count].offset = (u16)ofs;
+		ni->attr_table[count].name_hash = a->name_length ?
+				ntfs_attr_name_hash((ntfschar *)((u8 *)a +
+				le16_to_cpu(a->name_offset)), a->name_length) :
+				0;
+		ni->attr_table[count].mref = mref;
+		ni->attr_table[count].instance = a->instance;
+		count++;
+	}
+	return -1;
+}
+
+/*
+ *		Find the attribute an attribute list entry stands for through
+ *	the attribute table of the inode holding it
+ *
+ *	Returns the attribute record, or NULL if the table cannot tell and
+ *	the mft record has to be walked.
+ */
+
+static ATTR_RECORD *ntfs_attr_table_find_entry(ntfs_inode *ni,
+		const ATTR_LIST_ENTRY *al_entry)
+{
+	const ntfs_attr_entry *e, *end;
+
+	if ((!ni->attr_table_gen ||
+			ni->attr_table_gen != ntfs_attr_layout_gen) &&
+			ntfs_attr_table_build(ni))
+		return NULL;
+	e = ni->attr_table;
+	end = e + ni->attr_table_count;
+	for (; e < end; e++)
+		if (e->instance == al_entry->instance &&
+				e->mref == al_entry->mft_reference)
+			return (ATTR_RECORD *)((u8 *)ni->mrec + e->offset);
+	return NULL;
+}
+
+/*
+ *		Find an attribute through the attribute table of an inode
+ *
+ *	Only for a search starting at the first attribute of the record of
+ *	@ctx->ntfs_ino. Answers like ntfs_attr_find() would (0 if found, -1
+ *	with ENOENT if not, @ctx->attr set the same way), or returns 1 with
+ *	@ctx->attr set to where the linear search must go on from: the first
+ *	attribute of @type, when names have to be collated or values compared.
+ */
+
+static int ntfs_attr_table_find(const ATTR_TYPES type, const ntfschar *name,
+		const u32 name_len, const IGNORE_CASE_BOOL ic, const u8 *val,
+		ntfs_attr_search_ctx *ctx)
+{
+	ntfs_inode *ni = ctx->ntfs_ino;
+	const ntfs_attr_entry *e, *end;
+	ATTR_RECORD *a;
+	u16 hash;
+
+	if ((!ni->attr_table_gen ||
+			ni->attr_table_gen != ntfs_attr_layout_gen) &&
+			ntfs_attr_table_build(ni))
+		return 1;
+	e = ni->attr_table;
+	end = e + ni->attr_table_count;
+	while (e < end && le32_to_cpu(e->type) < le32_to_cpu(type))
+		e++;
+	ctx->is_first = FALSE;
+	if (e == end || e->type != type) {
+		ctx->attr = (ATTR_RECORD *)((u8 *)ctx->mrec +
+				(e == end ? ni->attr_table_end : e->offset));
+		errno = ENOENT;
+		return -1;
+	}
+	ctx->attr = (ATTR_RECORD *)((u8 *)ctx->mrec + e->offset);
+	if (val)
+		goto walk;
+	if (name == AT_UNNAMED) {
+		if (e->name_hash) {
+			errno = ENOENT;
+			return -1;
+		}
+		return 0;
+	}
+	if (!name)
+		return 0;
+	/* Equal names hash the same only when compared case sensitively. */
+	if (ic != CASE_SENSITIVE)
+		goto walk;
+	hash = ntfs_attr_name_hash(name, name_len);
+	for (; e < end && e->type == type; e++) {
+		if (e->name_hash != hash)
+			continue;
+		a = (ATTR_RECORD *)((u8 *)ctx->mrec + e->offset);
+		if (a->name_length == name_len &&
+				!memcmp((u8 *)a + le16_to_cpu(a->name_offset),
+				name, name_len * sizeof(ntfschar))) {
+			ctx->attr = a;
+			return 0;
+		}
+	}
+	/* Not there; the walk finds where it would be inserted. */
+walk:
+	ctx->is_first = TRUE;
+	return 1;
+}
+
 /**
  * ntfs_attr_find - find (next) attribute in mft record
  * @type:	attribute type to find
@@ -2719,6 +2989,7 @@ static int ntfs_attr_find(const ATTR_TYPES type, const ntfschar *name,
 	ntfs_volume *vol;
 	ntfschar *upcase;
 	u32 upcase_len;
+	int rc;
 
 	ntfs_log_trace("attribute type 0x%x.\n", type);
 
@@ -2736,6 +3007,16 @@ static int ntfs_attr_find(const ATTR_TYPES type, const ntfschar *name,
 		upcase = NULL;
 		upcase_len = 0;
 	}
+	/* A fresh search of an inode's own record can use its table. */
+	if (ctx->is_first && ctx->ntfs_ino &&
+			ctx->mrec == ctx->ntfs_ino->mrec &&
+			type != AT_UNUSED && type != AT_END &&
+			(u8 *)ctx->attr == (u8 *)ctx->mrec +
+			le16_to_cpu(ctx->mrec->attrs_offset)) {
+		rc = ntfs_attr_table_find(type, name, name_len, ic, val, ctx);
+		if (rc <= 0)
+			return rc;
+	}
 	/*
 	 * Iterate over attributes in mft record starting at @ctx->attr, or the
 	 * attribute following that, if @ctx->is_first is TRUE.
@@ -2935,6 +3216,7 @@ static int ntfs_external_attr_find(ATTR_TYPES type, const ntfschar *name,
 {
 	ntfs_inode *base_ni, *ni;
 	ntfs_volume *vol;
+	struct ntfs_attrlist_index *idx;
 	ATTR_LIST_ENTRY *al_entry, *next_al_entry;
 	u8 *al_start, *al_end;
 	ATTR_RECORD *a;
@@ -2962,6 +3244,7 @@ static int ntfs_external_attr_find(ATTR_TYPES type, const ntfschar *name,
 		ctx->al_entry = (ATTR_LIST_ENTRY*)al_start;
 		is_first_search = TRUE;
 	}
+	idx = type != AT_UNUSED ? ntfs_attrlist_index_get(base_ni) : NULL;
 	/*
 	 * Iterate over entries in attribute list starting at @ctx->al_entry,
 	 * or the entry following that, if @ctx->is_first is TRUE.
@@ -2978,6 +3261,9 @@ static int ntfs_external_attr_find(ATTR_TYPES type, const ntfschar *name,
 				le32_to_cpu(al_entry->type) >
 				le32_to_cpu(AT_ATTRIBUTE_LIST))
 			goto find_attr_list_attr;
+		/* Skip the entries of lower types in one probe. */
+		if (idx && is_first_search)
+			al_entry = ntfs_attrlist_index_type(idx, type);
 	} else {
 		al_entry = (ATTR_LIST_ENTRY*)((char*)ctx->al_entry +
 				le16_to_cpu(ctx->al_entry->length));
@@ -3094,8 +3380,15 @@ find_attr_list_attr:
 		 * unnamed. Now check @lowest_vcn. Continue search if the
 		 * next attribute list entry still fits @lowest_vcn. Otherwise
 		 * we have reached the right one or the search has failed.
+		 * The index finds that entry directly.
 		 */
-		if (lowest_vcn && (u8*)next_al_entry >= al_start	    &&
+		if (lowest_vcn && idx) {
+			al_entry = ntfs_attrlist_index_vcn(idx, al_entry,
+					lowest_vcn);
+			ctx->al_entry = al_entry;
+			next_al_entry = (ATTR_LIST_ENTRY*)((u8*)al_entry +
+					le16_to_cpu(al_entry->length));
+		} else if (lowest_vcn && (u8*)next_al_entry >= al_start	    &&
 				(u8*)next_al_entry + 6 < al_end	    &&
 				(u8*)next_al_entry + le16_to_cpu(
 					next_al_entry->length) <= al_end    &&
@@ -3137,6 +3430,13 @@ is_enumeration:
 		}
 		a = ctx->attr = (ATTR_RECORD*)((char*)ctx->mrec +
 				le16_to_cpu(ctx->mrec->attrs_offset));
+		/* The attribute table of the record may know where it is. */
+		if (ctx->mrec == ni->mrec) {
+			ATTR_RECORD *ta = ntfs_attr_table_find_entry(ni,
+					al_entry);
+			if (ta)
+				a = ctx->attr = ta;
+		}
 		/*
 		 * ctx->ntfs_ino, ctx->mrec, and ctx->attr now point to the
 		 * mft record containing the attribute represented by the
@@ -3434,6 +3734,25 @@ void ntfs_attr_reinit_search_ctx(ntfs_attr_search_ctx *ctx)
 	return;
 }
 
+/**
+ * ntfs_attr_stack_search_ctx - initialize a search context owned by the caller
+ * @ctx:	attribute search context to initialize, usually on the stack
+ * @ni:		ntfs inode with which to initialize the search context
+ * @mrec:	mft record with which to initialize the search context
+ *
+ * Initialize @ctx like ntfs_attr_get_search_ctx() would, for a short-lived
+ * lookup that does not need the context past the calling function. Such a
+ * context needs no release and must not be passed to
+ * ntfs_attr_put_search_ctx().
+ */
+void ntfs_attr_stack_search_ctx(ntfs_attr_search_ctx *ctx, ntfs_inode *ni,
+		MFT_RECORD *mrec)
+{
+	ntfs_attr_init_search_ctx(ctx, ni, mrec);
+	ctx->pool_vol = NULL;
+	ctx->pool_next = NULL;
+}
+
 /**
  * ntfs_attr_get_search_ctx - allocate/initialize a new attribute search context
  * @ni:		ntfs inode with which to initialize the search context
@@ -3444,6 +3763,9 @@ void ntfs_attr_reinit_search_ctx(ntfs_attr_search_ctx *ctx)
  *
  * @mrec can be NULL, in which case the mft record is taken from @ni.
  *
+ * The context is taken from the pool of released contexts of the volume of
+ * @ni when there is one, and only allocated when the pool is empty.
+ *
  * Note: For low level utilities which know what they are doing we allow @ni to
  * be NULL and @mrec to be set.  Do NOT do this unless you understand the
  * implications!!!  For example it is no longer safe to call ntfs_attr_lookup().
@@ -3451,15 +3773,27 @@ void ntfs_attr_reinit_search_ctx(ntfs_attr_search_ctx *ctx)
 ntfs_attr_search_ctx *ntfs_attr_get_search_ctx(ntfs_inode *ni, MFT_RECORD *mrec)
 {
 	ntfs_attr_search_ctx *ctx;
+	ntfs_volume *vol;
 
 	if (!ni && !mrec) {
 		errno = EINVAL;
 		ntfs_log_perror("NULL arguments");
 		return NULL;
 	}
-	ctx = (ntfs_attr_search_ctx *) ntfs_malloc(sizeof(ntfs_attr_search_ctx));
-	if (ctx)
-		ntfs_attr_init_search_ctx(ctx, ni, mrec);
+	vol = ni ? ni->vol : NULL;
+	if (vol && vol->search_ctx_pool) {
+		ctx = vol->search_ctx_pool;
+		vol->search_ctx_pool = ctx->pool_next;
+		vol->search_ctx_pooled--;
+	} else {
+		ctx = (ntfs_attr_search_ctx *)
+				ntfs_malloc(sizeof(ntfs_attr_search_ctx));
+		if (!ctx)
+			return NULL;
+	}
+	ntfs_attr_init_search_ctx(ctx, ni, mrec);
+	ctx->pool_vol = vol;
+	ctx->pool_next = NULL;
 	return ctx;
 }
 
@@ -3467,14 +3801,43 @@ ntfs_attr_search_ctx *ntfs_attr_get_search_ctx(ntfs_inode *ni, MFT_RECORD *mrec)
  * ntfs_attr_put_search_ctx - release an attribute search context
  * @ctx:	attribute search context to free
  *
- * Release the attribute search context @ctx.
+ * Release the attribute search context @ctx. It goes back to the pool of its
+ * volume while the pool has room, and is freed otherwise.
  */
 void ntfs_attr_put_search_ctx(ntfs_attr_search_ctx *ctx)
 {
+	ntfs_volume *vol;
+
 	// NOTE: save errno if it could change and function stays void!
+	if (!ctx)
+		return;
+	vol = ctx->pool_vol;
+	if (vol && vol->search_ctx_pooled < NTFS_SEARCH_CTX_POOL) {
+		ctx->pool_next = vol->search_ctx_pool;
+		vol->search_ctx_pool = ctx;
+		vol->search_ctx_pooled++;
+		return;
+	}
 	free(ctx);
 }
 
+/**
+ * ntfs_attr_free_search_ctx_pool - free the pooled search contexts of a volume
+ * @vol:	ntfs volume whose pool to empty
+ *
+ * Called when @vol is released, after its inodes have been closed.
+ */
+void ntfs_attr_free_search_ctx_pool(ntfs_volume *vol)
+{
+	ntfs_attr_search_ctx *ctx;
+
+	while ((ctx = vol->search_ctx_pool)) {
+		vol->search_ctx_pool = ctx->pool_next;
+		free(ctx);
+	}
+	vol->search_ctx_pooled = 0;
+}
+
 /**
  * ntfs_attr_find_in_attrdef - find an attribute in the $AttrDef system file
  * @vol:	ntfs volume to which the attribute belongs
@@ -3718,6 +4081,7 @@ int ntfs_make_room_for_attr(MFT_RECORD *m, u8 *pos, u32 size)
 	}
 	/* Move everything after pos to pos + size. */
 	memmove(pos + size, pos, biu - (pos - (u8*)m));
+	ntfs_attr_layout_gen++;
 	/* Update mft record. */
 	m->bytes_in_use = cpu_to_le32(biu + size);
 	return 0;
@@ -4060,6 +4424,7 @@ int ntfs_attr_record_rm(ntfs_attr_search_ctx *ctx)
 	if (type == AT_ATTRIBUTE_LIST) {
 		if (NInoAttrList(base_ni) && base_ni->attr_list)
 			free(base_ni->attr_list);
+		ntfs_attrlist_index_free(base_ni);
 		base_ni->attr_list = NULL;
 		NInoClearAttrList(base_ni);
 		NInoAttrListClearDirty(base_ni);
@@ -4488,6 +4853,7 @@ int ntfs_attr_record_resize(MFT_RECORD *m, ATTR_RECORD *a, u32 new_size)
 		/* Move attributes following @a to their new location. */
 		memmove((u8 *)a + new_size, (u8 *)a + attr_size,
 			old_size - ((u8 *)a - (u8 *)m) - attr_size);
+		ntfs_attr_layout_gen++;
 		
 		/* Adjust @m to reflect the change in used space. */
 		m->bytes_in_use = cpu_to_le32(new_muse);
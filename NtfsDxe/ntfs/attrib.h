@@ -91,12 +91,28 @@ struct _ntfs_attr_search_ctx {
 	ntfs_inode *base_ntfs_ino;
 	MFT_RECORD *base_mrec;
 	ATTR_RECORD *base_attr;
+	ntfs_volume *pool_vol;	/* Volume the context goes back to on put,
+				   NULL if it is freed. */
+	ntfs_attr_search_ctx *pool_next; /* Next free context of the pool. */
 };
 
+/*
+ * Number of released search contexts each volume keeps for reuse, so that
+ * attribute lookups do not go through the allocator once the pool is warm.
+ */
+#define NTFS_SEARCH_CTX_POOL	16
+
+extern u32 ntfs_attr_layout_gen;
+
+extern int ntfs_attr_table_build(ntfs_inode *ni);
+
 extern void ntfs_attr_reinit_search_ctx(ntfs_attr_search_ctx *ctx);
+extern void ntfs_attr_stack_search_ctx(ntfs_attr_search_ctx *ctx,
+		ntfs_inode *ni, MFT_RECORD *mrec);
 extern ntfs_attr_search_ctx *ntfs_attr_get_search_ctx(ntfs_inode *ni,
 		MFT_RECORD *mrec);
 extern void ntfs_attr_put_search_ctx(ntfs_attr_search_ctx *ctx);
+extern void ntfs_attr_free_search_ctx_pool(ntfs_volume *vol);
 
 extern int ntfs_attr_lookup(const ATTR_TYPES type, const ntfschar *name,
 		const u32 name_len, const IGNORE_CASE_BOOL ic,
@@ -133,7 +149,7 @@ extern ATTR_DEF *ntfs_attr_find_in_attrdef(const ntfs_volume *vol,
  *		// Ooops. An error occurred! You should handle this case.
  *	// Now finished with all attributes in the inode.
  */
-static int ntfs_attrs_walk(ntfs_attr_search_ctx *ctx)
+static __inline int ntfs_attrs_walk(ntfs_attr_search_ctx *ctx)
 {
 	return ntfs_attr_lookup(AT_UNUSED, NULL, 0, CASE_SENSITIVE, 0,
 			NULL, 0, ctx);
@@ -197,6 +213,10 @@ struct _ntfs_attr {
 	u8 compression_block_size_bits; /* 0x40 */
 	u8 compression_block_clusters;  /* 0x41 */
 	s8 unused_runs; /* pre-reserved entries available */
+	ATTR_RECORD *value_attr;	/* Record of a resident value, only
+					   valid while @value_gen matches
+					   ntfs_attr_layout_gen. */
+	u32 value_gen;
 };
 
 /**
@@ -294,6 +314,8 @@ extern s64 ntfs_attr_pread(ntfs_attr *na, const s64 pos, s64 count,
 		void *b);
 extern s64 ntfs_attr_pwrite(ntfs_attr *na, const s64 pos, s64 count,
 		const void *b);
+extern const void *ntfs_attr_borrow(ntfs_attr *na, const s64 pos,
+		s64 *count);
 extern int ntfs_attr_pclose(ntfs_attr *na);
 
 extern void *ntfs_attr_readall(ntfs_inode *ni, const ATTR_TYPES type,
@@ -45,6 +45,165 @@
 #include "logging.h"
 #include "misc.h"
 
+u32 ntfs_attrlist_gen;
+
+/**
+ * ntfs_attrlist_index_free - drop the attribute list index of an inode
+ * @ni:		base inode
+ */
+void ntfs_attrlist_index_free(ntfs_inode *ni)
+{
+	free(ni->attr_list_index);
+	ni->attr_list_index = NULL;
+}
+
+/**
+ * ntfs_attrlist_index_get - get the sorted index of an attribute list
+ * @ni:		base inode with an attribute list
+ *
+ * Index the entries of @ni->attr_list once, so that lookups locate a type,
+ * and the extent of an attribute holding a vcn, by binary search instead of
+ * scanning the list (see ntfs_external_attr_find()). The index is rebuilt
+ * when the list has changed since.
+ *
+ * The attribute list is sorted by type, name and lowest vcn. A list that is
+ * not, or that is malformed, is not indexed and lookups scan it as before,
+ * reporting the corruption where they used to.
+ *
+ * Return the index, or NULL if the list cannot be indexed.
+ */
+struct ntfs_attrlist_index *ntfs_attrlist_index_get(ntfs_inode *ni)
+{
+	struct ntfs_attrlist_index *idx = ni->attr_list_index;
+	ATTR_LIST_ENTRY *ale, *prev;
+	u8 *al, *al_end;
+	u32 count, run, i, len;
+
+	if (idx && idx->al == ni->attr_list && idx->size == ni->attr_list_size
+			&& idx->gen == ntfs_attrlist_gen)
+		return idx;
+	ntfs_attrlist_index_free(ni);
+	al = ni->attr_list;
+	if (!NInoAttrList(ni) || !al)
+		return NULL;
+	al_end = al + ni->attr_list_size;
+	/* Entries are at least 26 bytes, this bounds their number. */
+	count = ni->attr_list_size / offsetof(ATTR_LIST_ENTRY, name) + 1;
+	idx = ntfs_malloc(sizeof(*idx) + (count - 1) * sizeof(idx->slot[0]));
+	if (!idx)
+		return NULL;
+	prev = NULL;
+	run = 0;
+	for (i = 0, ale = (ATTR_LIST_ENTRY *)al; (u8 *)ale < al_end; i++) {
+		if ((u8 *)ale + offsetof(ATTR_LIST_ENTRY, name) > al_end)
+			goto unsorted;
+		len = le16_to_cpu(ale->length);
+		if (len < offsetof(ATTR_LIST_ENTRY, name) ||
+				(u8 *)ale + len > al_end ||
+				ale->name_offset + ale->name_length *
+				sizeof(ntfschar) > len)
+			goto unsorted;
+		if (prev && le32_to_cpu(ale->type) < le32_to_cpu(prev->type))
+			goto unsorted;
+		if (!prev || ale->type != prev->type ||
+				ale->name_length != prev->name_length ||
+				memcmp((u8 *)ale + ale->name_offset,
+				(u8 *)prev + prev->name_offset,
+				ale->name_length * sizeof(ntfschar))) {
+			/* A new attribute starts. */
+			for (; run < i; run++)
+				idx->slot[run].run_end = i;
+		} else if (sle64_to_cpu(ale->lowest_vcn) <
+				sle64_to_cpu(prev->lowest_vcn))
+			goto unsorted;
+		idx->slot[i].offset = (u8 *)ale - al;
+		idx->slot[i].lowest_vcn = sle64_to_cpu(ale->lowest_vcn);
+		prev = ale;
+		ale = (ATTR_LIST_ENTRY *)((u8 *)ale + len);
+	}
+	for (; run < i; run++)
+		idx->slot[run].run_end = i;
+	idx->al = al;
+	idx->size = ni->attr_list_size;
+	idx->gen = ntfs_attrlist_gen;
+	idx->count = i;
+	ni->attr_list_index = idx;
+	return idx;
+unsorted:
+	free(idx);
+	return NULL;
+}
+
+/**
+ * ntfs_attrlist_index_type - locate a type in an attribute list
+ * @idx:	index of the attribute list
+ * @type:	attribute type
+ *
+ * Return the first entry of @type or of a higher type, or the end of the
+ * attribute list if there is none: where a linear scan for @type stops.
+ */
+ATTR_LIST_ENTRY *ntfs_attrlist_index_type(
+		const struct ntfs_attrlist_index *idx, const ATTR_TYPES type)
+{
+	const ATTR_LIST_ENTRY *ale;
+	u32 lo, hi, mid;
+
+	lo = 0;
+	hi = idx->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		ale = (const ATTR_LIST_ENTRY *)(idx->al +
+				idx->slot[mid].offset);
+		if (le32_to_cpu(ale->type) < le32_to_cpu(type))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == idx->count)
+		return (ATTR_LIST_ENTRY *)(idx->al + idx->size);
+	return (ATTR_LIST_ENTRY *)(idx->al + idx->slot[lo].offset);
+}
+
+/**
+ * ntfs_attrlist_index_vcn - locate the extent holding a vcn
+ * @idx:	index of the attribute list
+ * @ale:	first entry of an attribute in the attribute list
+ * @vcn:	vcn looked for
+ *
+ * Return the last entry of the attribute of @ale whose lowest vcn is not
+ * above @vcn, or @ale itself if there is none.
+ */
+ATTR_LIST_ENTRY *ntfs_attrlist_index_vcn(
+		const struct ntfs_attrlist_index *idx,
+		const ATTR_LIST_ENTRY *ale, const VCN vcn)
+{
+	u32 ofs, lo, hi, mid;
+
+	ofs = (const u8 *)ale - idx->al;
+	lo = 0;
+	hi = idx->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx->slot[mid].offset < ofs)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == idx->count || idx->slot[lo].offset != ofs)
+		return (ATTR_LIST_ENTRY *)ale;
+	/* Last slot of the run with a lowest vcn not above @vcn. */
+	hi = idx->slot[lo].run_end;
+	lo++;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx->slot[mid].lowest_vcn <= vcn)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (ATTR_LIST_ENTRY *)(idx->al + idx->slot[lo - 1].offset);
+}
+
 /**
  * ntfs_attrlist_need - check whether inode need attribute list
  * @ni:		opened ntfs inode for which perform check
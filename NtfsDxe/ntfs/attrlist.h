@@ -26,8 +26,40 @@
 
 #include "attrib.h"
 
+/**
+ * struct ntfs_attrlist_slot - an entry of an attribute list index
+ */
+typedef struct {
+	u32 offset;		/* Offset of the entry in the attribute list. */
+	u32 run_end;		/* Slot after the last entry of the same type
+				   and name. */
+	VCN lowest_vcn;		/* Lowest vcn of the extent it describes. */
+} ntfs_attrlist_slot;
+
+/**
+ * struct ntfs_attrlist_index - the entries of an attribute list, in order
+ *
+ * Valid while @al and @size are those of the inode and @gen is
+ * ntfs_attrlist_gen.
+ */
+struct ntfs_attrlist_index {
+	const u8 *al;		/* Attribute list indexed. */
+	u32 size;		/* Its size in bytes. */
+	u32 gen;		/* ntfs_attrlist_gen when built. */
+	u32 count;		/* Number of entries. */
+	ntfs_attrlist_slot slot[1];
+};
+
 extern int ntfs_attrlist_need(ntfs_inode *ni);
 
+extern struct ntfs_attrlist_index *ntfs_attrlist_index_get(ntfs_inode *ni);
+extern void ntfs_attrlist_index_free(ntfs_inode *ni);
+extern ATTR_LIST_ENTRY *ntfs_attrlist_index_type(
+		const struct ntfs_attrlist_index *idx, const ATTR_TYPES type);
+extern ATTR_LIST_ENTRY *ntfs_attrlist_index_vcn(
+		const struct ntfs_attrlist_index *idx,
+		const ATTR_LIST_ENTRY *ale, const VCN vcn);
+
 extern int ntfs_attrlist_entry_add(ntfs_inode *ni, ATTR_RECORD *attr);
 extern int ntfs_attrlist_entry_rm(ntfs_attr_search_ctx *ctx);
 
@@ -40,7 +72,7 @@ extern int ntfs_attrlist_entry_rm(ntfs_attr_search_ctx *ctx);
  *
  * This function cannot fail.
  */
-static void ntfs_attrlist_mark_dirty(ntfs_inode *ni)
+static __inline void ntfs_attrlist_mark_dirty(ntfs_inode *ni)
 {
 	if (ni->nr_extents == -1)
 		NInoAttrListSetDirty(ni->base_ni);
@@ -51,7 +51,7 @@ extern int  ntfs_bitmap_clear_run(ntfs_attr *na, s64 start_bit, s64 count);
  *
  * On success return 0 and on error return -1 with errno set to the error code.
  */
-static int ntfs_bitmap_set_bit(ntfs_attr *na, s64 bit)
+static __inline int ntfs_bitmap_set_bit(ntfs_attr *na, s64 bit)
 {
 	return ntfs_bitmap_set_run(na, bit, 1);
 }
@@ -65,7 +65,7 @@ static int ntfs_bitmap_set_bit(ntfs_attr *na, s64 bit)
  *
  * On success return 0 and on error return -1 with errno set to the error code.
  */
-static int ntfs_bitmap_clear_bit(ntfs_attr *na, s64 bit)
+static __inline int ntfs_bitmap_clear_bit(ntfs_attr *na, s64 bit)
 {
 	return ntfs_bitmap_clear_run(na, bit, 1);
 }
@@ -76,7 +76,7 @@ static int ntfs_bitmap_clear_bit(ntfs_attr *na, s64 bit)
  * @word: value to rotate
  * @shift: bits to roll
  */
-static u32 ntfs_rol32(u32 word, unsigned int shift)
+static __inline u32 ntfs_rol32(u32 word, unsigned int shift)
 {
         return (word << shift) | (word >> (32 - shift));
 }
@@ -87,7 +87,7 @@ static u32 ntfs_rol32(u32 word, unsigned int shift)
  * @word: value to rotate
  * @shift: bits to roll
  */
-static u32 ntfs_ror32(u32 word, unsigned int shift)
+static __inline u32 ntfs_ror32(u32 word, unsigned int shift)
 {
         return (word >> shift) | (word << (32 - shift));
 }
@@ -499,7 +499,9 @@ static struct CACHE_HEADER *ntfs_create_cache(const char *name,
 			cache->dohash = (cache_hash)NULL;
 			cache->max_hash = 0;
 		}
-		cache->fixed_size = full_item_size - sizeof(struct CACHED_GENERIC);
+		/* the payload array has one element, it is part of the data */
+		cache->fixed_size = full_item_size
+				- offsetof(struct CACHED_GENERIC, payload);
 		cache->reads = 0;
 		cache->writes = 0;
 		cache->hits = 0;
@@ -584,6 +586,25 @@ void ntfs_create_lru_caches(ntfs_volume *vol)
 #endif
 }
 
+/*
+ *		Create the cache of directory name filters
+ *
+ *	Unlike the caches above, it is created by every mount : a filter
+ *	is checked against the index generation when fetched, so that
+ *	the callers changing directories have nothing to invalidate.
+ */
+
+void ntfs_create_dirfilter_cache(ntfs_volume *vol)
+{
+#if CACHE_DIRFILTER_SIZE
+	if (!vol->dirfilter_cache)
+		vol->dirfilter_cache = ntfs_create_cache("dirfilter",
+			(cache_free)NULL, ntfs_dir_filter_hash,
+			sizeof(struct CACHED_DIRFILTER),
+			CACHE_DIRFILTER_SIZE, 2*CACHE_DIRFILTER_SIZE);
+#endif
+}
+
 /*
  *		Free all LRU caches
  */
@@ -603,4 +624,7 @@ void ntfs_free_lru_caches(ntfs_volume *vol)
 #if CACHE_LEGACY_SIZE
 	ntfs_free_cache(vol->legacy_cache);
 #endif
+#if CACHE_DIRFILTER_SIZE
+	ntfs_free_cache(vol->dirfilter_cache);
+#endif
 }
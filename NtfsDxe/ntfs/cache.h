@@ -64,6 +64,17 @@ struct CACHED_LOOKUP {
 	u64 inum;
 } ;
 
+struct CACHED_DIRFILTER {
+	struct CACHED_DIRFILTER *next;
+	struct CACHED_DIRFILTER *previous;
+	const u8 *bits;
+	size_t size;
+	union ALIGNMENT payload[1];
+		/* above fields must match "struct CACHED_GENERIC" */
+	u64 inum;
+	u32 index_gen;
+} ;
+
 enum {
 	CACHE_FREE = 1,
 	CACHE_NOHASH = 2
@@ -112,6 +123,7 @@ int ntfs_remove_cache(struct CACHE_HEADER *cache,
 			struct CACHED_GENERIC *item, int flags);
 
 void ntfs_create_lru_caches(ntfs_volume *vol);
+void ntfs_create_dirfilter_cache(ntfs_volume *vol);
 void ntfs_free_lru_caches(ntfs_volume *vol);
 
 #endif /* _NTFS_CACHE_H_ */
@@ -70,6 +70,8 @@ NTFS_CACHE* _NTFS_cache_constructor (unsigned int numberOfPages, unsigned int se
 	cache->numberOfPages = numberOfPages;
 	cache->sectorsPerPage = sectorsPerPage;
 	cache->sectorSize = sectorSize;
+	cache->hits = 0;
+	cache->misses = 0;
 
 
 	cacheEntries = (NTFS_CACHE_ENTRY*) ntfs_alloc ( sizeof(NTFS_CACHE_ENTRY) * numberOfPages);
@@ -128,6 +130,7 @@ static NTFS_CACHE_ENTRY* _NTFS_cache_getPage(NTFS_CACHE *cache,sec_t sector)
 	for(i=0;i<numberOfPages;i++) {
 		if(sector>=cacheEntries[i].sector && sector<(cacheEntries[i].sector + cacheEntries[i].count)) {
 			cacheEntries[i].last_access = accessTime();
+			cache->hits++;
 			return &(cacheEntries[i]);
 		}
 
@@ -147,6 +150,7 @@ static NTFS_CACHE_ENTRY* _NTFS_cache_getPage(NTFS_CACHE *cache,sec_t sector)
 	if(next_page > cache->endOfPartition)	next_page = cache->endOfPartition;
 
 	if(!cache->disc->readSectors(sector,next_page-sector,cacheEntries[oldUsed].cache)) return NULL;
+	cache->misses++;
 
 	cacheEntries[oldUsed].sector = sector;
 	cacheEntries[oldUsed].count = next_page-sector;
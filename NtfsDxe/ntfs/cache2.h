@@ -64,6 +64,8 @@ typedef struct {
 	unsigned int          sectorsPerPage;
 	sec_t                 sectorSize;
 	NTFS_CACHE_ENTRY*     cacheEntries;
+	u64                   hits;      // Page lookups found in the cache
+	u64                   misses;    // Page lookups read in from the disc
 } NTFS_CACHE;
 
 /*
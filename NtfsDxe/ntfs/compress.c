@@ -79,6 +79,9 @@ typedef enum {
 	NTFS_SB_SIZE_MASK	=	0x0fff,
 	NTFS_SB_SIZE		=	0x1000,
 	NTFS_SB_IS_COMPRESSED	=	0x8000,
+
+	/* Most compression blocks read with one request. */
+	NTFS_CB_READAHEAD	=	16,
 } ntfs_compression_constants;
 
 struct COMPRESS_CONTEXT {
@@ -344,9 +347,11 @@ do_next_sb:
 	 * Have we reached the end of the compression block or the end of the
 	 * decompressed data?  The latter can happen for example if the current
 	 * position in the compression block is one byte before its end so the
-	 * first two checks do not detect it.
+	 * first two checks do not detect it.  Less than a sub-block header
+	 * left is the end too: @cb_size stops at the end of the clusters
+	 * read, and there is no zero terminator past it to be read.
 	 */
-	if (cb == cb_end || !le16_to_cpup((le16*)cb) || dest == dest_end) {
+	if (cb + 2 > cb_end || !le16_to_cpup((le16*)cb) || dest == dest_end) {
 		ntfs_log_debug("Completed. Returning success (0).\n");
 		return 0;
 	}
@@ -539,6 +544,176 @@ restart:
 	return FALSE;
 }
 
+/*
+ *		Read a device range holding compressed data
+ *
+ *	A request cut short is resumed once, then the read fails with errno
+ *	set to EIO.
+ *
+ *	Returns the amount of data read
+ */
+
+static s64 read_device(ntfs_volume *vol, s64 pos, s64 count, char *buf)
+{
+	s64 got, br;
+
+	got = ntfs_pread(vol->dev, pos, count, buf);
+	if ((got > 0) && (got < count)) {
+		br = ntfs_pread(vol->dev, pos + got, count - got, buf + got);
+		if (br > 0)
+			got += br;
+	}
+	if (got != count) {
+		if (got >= 0)
+			errno = EIO;
+		ntfs_log_perror("Failed to read compressed clusters at 0x%llx",
+				(long long)(pos + (got > 0 ? got : 0)));
+	}
+	return (got > 0 ? got : 0);
+}
+
+/*
+ *		Read data from a set of clusters
+ *
+ *	Runs which follow each other on the device are read with a single
+ *	request. The read stops with errno set to EIO on a run which is not
+ *	allocated or a device request which cannot be completed.
+ *
+ *	Returns the amount of data read
+ */
+
+static u32 read_clusters(ntfs_volume *vol, const runlist_element *rl,
+			s64 offs, u32 to_read, char *inbuf)
+{
+	u32 got;
+	s64 count, xpos, br;
+	const runlist_element *xrl;
+
+	got = 0;
+	xrl = rl;
+	while (got < to_read) {
+		if (!xrl->length || xrl->lcn < 0) {
+			ntfs_log_error("Compressed clusters not allocated at "
+					"vcn 0x%llx\n", (long long)xrl->vcn);
+			errno = EIO;
+			break;
+		}
+		xpos = (xrl->lcn << vol->cluster_size_bits) + offs;
+		count = (xrl->length << vol->cluster_size_bits) - offs;
+		offs = 0;
+		while (count < to_read - got && xrl[1].length &&
+		    xrl[1].lcn == xrl->lcn + xrl->length) {
+			xrl++;
+			count += xrl->length << vol->cluster_size_bits;
+		}
+		xrl++;
+		if (count > to_read - got)
+			count = to_read - got;
+		br = read_device(vol, xpos, count, inbuf + got);
+		got += br;
+		if (br != count)
+			break;
+	}
+	return (got);
+}
+
+/*
+ *		Count the allocated clusters of a compression block
+ *
+ *	@rl is the run holding @vcn, the first vcn of the block. The
+ *	compressed data of a block is in its clusters up to the first hole.
+ *	@end_lcn gets the lcn following the last of them if they are all
+ *	contiguous on the device, or -1.
+ */
+
+static s64 cb_allocated_clusters(const runlist_element *rl, VCN vcn,
+			u32 cb_clusters, LCN *end_lcn)
+{
+	VCN v, end, run_end;
+	LCN next;
+	BOOL contiguous;
+
+	v = vcn;
+	end = vcn + cb_clusters;
+	next = -1;
+	contiguous = TRUE;
+	while ((v < end) && rl->length && (rl->lcn >= 0)) {
+		if ((v != vcn) && (rl->lcn + (v - rl->vcn) != next))
+			contiguous = FALSE;
+		run_end = rl->vcn + rl->length;
+		if (run_end > end)
+			run_end = end;
+		next = rl->lcn + (run_end - rl->vcn);
+		v = run_end;
+		rl++;
+	}
+	*end_lcn = (contiguous ? next : -1);
+	return (v - vcn);
+}
+
+/*
+ *		Read the compressed data of consecutive compression blocks
+ *
+ *	The block at @vcn, held in run @rl, is compressed. The blocks after
+ *	it, up to @max_cbs in all, are read along with it as long as they are
+ *	compressed too and their data follows its data on the device, so that
+ *	reading through a compressed file makes one request for several
+ *	blocks instead of one per run. The runlist must be fully mapped.
+ *
+ *	@ofs gets the offset in @buf of the data of each block read, followed
+ *	by the end of the data of the last one. @buf must hold @max_cbs
+ *	compression blocks.
+ *
+ *	Returns the number of blocks read, or 0 with errno set
+ */
+
+static u32 read_compressed_cbs(ntfs_attr *na, const runlist_element *rl,
+			VCN vcn, u32 max_cbs, char *buf, u32 *ofs)
+{
+	ntfs_volume *vol;
+	const runlist_element *xrl;
+	u32 cb_clusters, n;
+	s64 clusters, total;
+	LCN start_lcn, end_lcn;
+	VCN xvcn;
+
+	vol = na->ni->vol;
+	cb_clusters = na->compression_block_clusters;
+	total = cb_allocated_clusters(rl, vcn, cb_clusters, &end_lcn);
+	ofs[0] = 0;
+	ofs[1] = total << vol->cluster_size_bits;
+	if (end_lcn < 0) {
+		/* Scattered on the device, read it on its own. */
+		if (read_clusters(vol, rl, (vcn - rl->vcn)
+				<< vol->cluster_size_bits, ofs[1], buf)
+				!= ofs[1])
+			return (0);
+		return (1);
+	}
+	start_lcn = rl->lcn + (vcn - rl->vcn);
+	xrl = rl;
+	for (n = 1; n < max_cbs; n++) {
+		xvcn = vcn + (s64)n * cb_clusters;
+		while (xrl->length && (xvcn >= xrl->vcn + xrl->length))
+			xrl++;
+		if (!xrl->length || (xrl->lcn < 0)
+		    || (xrl->lcn + (xvcn - xrl->vcn) != start_lcn + total))
+			break;
+		clusters = cb_allocated_clusters(xrl, xvcn, cb_clusters,
+				&end_lcn);
+		/* Stop at a block stored uncompressed or scattered. */
+		if ((clusters >= cb_clusters) || (end_lcn < 0))
+			break;
+		total += clusters;
+		ofs[n + 1] = total << vol->cluster_size_bits;
+	}
+	/* All of it in one range of the device, holes between blocks aside. */
+	if (read_device(vol, start_lcn << vol->cluster_size_bits, ofs[n], buf)
+			!= ofs[n])
+		return (0);
+	return (n);
+}
+
 /**
  * ntfs_compressed_attr_pread - read from a compressed attribute
  * @na:		ntfs attribute to read from
@@ -573,6 +748,9 @@ s64 ntfs_compressed_attr_pread(ntfs_attr *na, s64 pos, s64 count, void *b)
 	ATTR_FLAGS data_flags;
 	FILE_ATTR_FLAGS compression;
 	unsigned int nr_cbs, cb_clusters;
+	VCN raw_vcn;
+	u32 raw_cbs;
+	u32 raw_ofs[NTFS_CB_READAHEAD + 1];
 
 	ntfs_log_trace("Entering for inode 0x%lx, attr 0x%x, pos 0x%lx, count 0x%lx.\n",
 			(unsigned long long)na->ni->mft_no, na->type,
@@ -622,24 +800,17 @@ s64 ntfs_compressed_attr_pread(ntfs_attr *na, s64 pos, s64 count, void *b)
 	cb_size_mask = cb_size - 1UL;
 	cb_clusters = na->compression_block_clusters;
 	
-	/* Need a temporary buffer for each loaded compression block. */
-	cb = (u8*)ntfs_malloc(cb_size);
-	if (!cb)
-		return -1;
-	
-	/* Need a temporary buffer for each uncompressed block. */
-	dest = (u8*)ntfs_malloc(cb_size);
-	if (!dest) {
-		free(cb);
+	/*
+	 * The runlist is walked run by run to find the compressed blocks
+	 * following each other on the device.
+	 */
+	if (ntfs_attr_map_whole_runlist(na))
 		return -1;
-	}
 	/*
 	 * The first vcn in the first compression block (cb) which we need to
 	 * decompress.
 	 */
 	start_vcn = (pos & ~cb_size_mask) >> vol->cluster_size_bits;
-	/* Offset in the uncompressed cb at which to start reading data. */
-	ofs = pos & cb_size_mask;
 	/*
 	 * The first vcn in the cb after the last cb which we need to
 	 * decompress.
@@ -649,10 +820,27 @@ s64 ntfs_compressed_attr_pread(ntfs_attr *na, s64 pos, s64 count, void *b)
 	/* Number of compression blocks (cbs) in the wanted vcn range. */
 	nr_cbs = (end_vcn - start_vcn) << vol->cluster_size_bits >>
 			na->compression_block_size_bits;
-	cb_end = cb + cb_size;
+
+	/*
+	 * Need a temporary buffer for the compressed data of the cbs loaded
+	 * at once.
+	 */
+	cb = (u8*)ntfs_malloc((size_t)cb_size * min(nr_cbs, NTFS_CB_READAHEAD));
+	if (!cb)
+		return -1;
+	
+	/* Need a temporary buffer for each uncompressed block. */
+	dest = (u8*)ntfs_malloc(cb_size);
+	if (!dest) {
+		free(cb);
+		return -1;
+	}
+	/* Offset in the uncompressed cb at which to start reading data. */
+	ofs = pos & cb_size_mask;
+	raw_vcn = 0;
+	raw_cbs = 0;
 do_next_cb:
 	nr_cbs--;
-	cb_pos = cb;
 	vcn = start_vcn;
 	start_vcn += cb_clusters;
 
@@ -733,65 +921,36 @@ do_next_cb:
 		na->data_flags = data_flags;
 		ofs = 0;
 	} else {
-		s64 tdata_size, tinitialized_size;
-
 		/*
 		 * Compressed cb, decompress it into the temporary buffer, then
 		 * copy the data to the destination range overlapping the cb.
 		 */
 		ntfs_log_debug("Found compressed compression block.\n");
 		/*
-		 * Read the compressed data into the temporary buffer.
-		 * NOTE: We cheat a little bit here by marking the attribute as
-		 * not compressed in the ntfs_attr structure so that we can
-		 * read the raw, compressed data by simply using
-		 * ntfs_attr_pread().  (-8
-		 * NOTE: We have to modify data_size and initialized_size
-		 * temporarily as well...
+		 * Read the compressed data of the cb, and that of the next
+		 * cbs wanted when it follows on the device, unless it was
+		 * read with an earlier cb.
 		 */
-		to_read = cb_size;
-		NAttrClearCompressed(na);
-		na->data_flags &= ~ATTR_COMPRESSION_MASK;
-		tdata_size = na->data_size;
-		tinitialized_size = na->initialized_size;
-		na->data_size = na->initialized_size = na->allocated_size;
-		do {
-			br = ntfs_attr_pread(na,
-					(vcn << vol->cluster_size_bits) +
-					(cb_pos - cb), to_read, cb_pos);
-			if (br <= 0) {
-				if (!br) {
-					ntfs_log_error("Failed to read a"
-						" compressed cluster, "
-						" inode %l offs 0x%lx\n",
-						(long long)na->ni->mft_no,
-						(long long)(vcn << vol->cluster_size_bits));
-					errno = EIO;
-				}
+		if ((vcn < raw_vcn)
+		    || (vcn >= raw_vcn + (s64)raw_cbs * cb_clusters)) {
+			raw_cbs = read_compressed_cbs(na, rl, vcn,
+					min(nr_cbs + 1, NTFS_CB_READAHEAD),
+					(char*)cb, raw_ofs);
+			if (!raw_cbs) {
 				err = errno;
-				na->data_size = tdata_size;
-				na->initialized_size = tinitialized_size;
-				na->ni->flags |= compression;
-				na->data_flags = data_flags;
 				free(cb);
 				free(dest);
 				if (total)
 					return total;
 				errno = err;
-				return br;
+				return -1;
 			}
-			cb_pos += br;
-			to_read -= br;
-		} while (to_read > 0);
-		na->data_size = tdata_size;
-		na->initialized_size = tinitialized_size;
-		na->ni->flags |= compression;
-		na->data_flags = data_flags;
-		/* Just a precaution. */
-		if (cb_pos + 2 <= cb_end)
-			*(u16*)cb_pos = 0;
+			raw_vcn = vcn;
+		}
+		cb_pos = cb + raw_ofs[(vcn - raw_vcn) / cb_clusters];
+		cb_end = cb + raw_ofs[(vcn - raw_vcn) / cb_clusters + 1];
 		ntfs_log_debug("Successfully read the compression block.\n");
-		if (ntfs_decompress(dest, cb_size, cb, cb_size) < 0) {
+		if (ntfs_decompress(dest, cb_size, cb_pos, cb_end - cb_pos) < 0) {
 			err = errno;
 			free(cb);
 			free(dest);
@@ -800,6 +959,7 @@ do_next_cb:
 			errno = err;
 			return -1;
 		}
+		NVolStatAdd(vol, compression_blocks, 1);
 		to_read = min(count, cb_size - ofs);
 		memcpy(b, dest + ofs, to_read);
 		total += to_read;
@@ -817,48 +977,6 @@ do_next_cb:
 	return total + total2;
 }
 
-/*
- *		Read data from a set of clusters
- *
- *	Returns the amount of data read
- */
-
-static u32 read_clusters(ntfs_volume *vol, const runlist_element *rl,
-			s64 offs, u32 to_read, char *inbuf)
-{
-	u32 count;
-	int xgot;
-	u32 got;
-	s64 xpos;
-	BOOL first;
-	char *xinbuf;
-	const runlist_element *xrl;
-
-	got = 0;
-	xrl = rl;
-	xinbuf = inbuf;
-	first = TRUE;
-	do {
-		count = xrl->length << vol->cluster_size_bits;
-		xpos = xrl->lcn << vol->cluster_size_bits;
-		if (first) {
-			count -= offs;
-			xpos += offs;
-		}
-		if ((to_read - got) < count)
-			count = to_read - got;
-		xgot = ntfs_pread(vol->dev, xpos, count, xinbuf);
-		if (xgot == (int)count) {
-			got += count;
-			xpos += count;
-			xinbuf += count;
-			xrl++;
-		}
-		first = FALSE;
-	} while ((xgot == (int)count) && (got < to_read));
-	return (got);
-}
-
 /*
  *		Write data to a set of clusters
  *
@@ -1,9 +1,11 @@
 //#include "../config.h"
 
+#ifndef NTFS_HOST_BUILD
 #define size_t int
 #define PATH_MAX 255
 
 extern int errno;
+#endif
 
 
 /* config.h.in.  Generated from configure.ac by autoheader.  */
@@ -74,6 +74,7 @@
 #include "device.h"
 #include "logging.h"
 #include "misc.h"
+#include "compat.h"
 
 #if defined(linux) && defined(_IO) && !defined(BLKGETSIZE)
 #define BLKGETSIZE	_IO(0x12,96)  /* Get device size in 512-byte blocks. */
@@ -128,10 +129,34 @@ struct ntfs_device *ntfs_device_alloc(const char *name, const long state,
 		dev->d_ops = dops;
 		dev->d_state = state;
 		dev->d_private = priv_data;
+		dev->d_reads = 0;
+		dev->d_read_bytes = 0;
+		dev->d_cache_hits = 0;
+		dev->d_cache_misses = 0;
+		dev->d_io_tag = NTFS_IO_OTHER;
+		dev->d_trace = NULL;
+		dev->d_prefetch = NULL;
 	}
 	return dev;
 }
 
+/*
+ *		Free the prefetched data of a device
+ */
+
+static void ntfs_device_prefetch_free(struct ntfs_device *dev)
+{
+	struct ntfs_prefetch *pf = dev->d_prefetch;
+	u32 i;
+
+	if (!pf)
+		return;
+	for (i = 0; i < pf->count; i++)
+		free(pf->ext[i].data);
+	free(pf);
+	dev->d_prefetch = NULL;
+}
+
 /**
  * ntfs_device_free - free an ntfs device structure
  * @dev:	ntfs device structure to free
@@ -153,6 +178,8 @@ int ntfs_device_free(struct ntfs_device *dev)
 		errno = EBUSY;
 		return -1;
 	}
+	ntfs_device_trace_stop(dev);
+	ntfs_device_prefetch_free(dev);
 	free(dev->d_name);
 	free(dev);
 	return 0;
@@ -177,6 +204,388 @@ int ntfs_device_sync(struct ntfs_device *dev)
 	return ret;
 }
 
+/**
+ * ntfs_device_set_io_tag - tag the next requests to a device
+ * @dev:	device the requests go to
+ * @tag:	what they are for
+ *
+ * Return the previous tag, for the caller to restore once its requests are
+ * done, so that nested reads (a data read mapping its runlist from an
+ * attribute list, say) are tagged by the innermost caller.
+ */
+ntfs_io_tag ntfs_device_set_io_tag(struct ntfs_device *dev, ntfs_io_tag tag)
+{
+	ntfs_io_tag prev = dev->d_io_tag;
+
+	dev->d_io_tag = tag;
+	return prev;
+}
+
+/**
+ * ntfs_device_trace_start - start recording the requests to a device
+ * @dev:	device to trace
+ * @size:	number of requests kept, rounded up to a power of two
+ * @clock:	timestamp source, NULL to leave the timestamps at zero
+ * @ticks_per_sec: frequency of @clock, 0 if unknown
+ *
+ * Record every request to @dev in a ring buffer holding the last @size of
+ * them, dropping any previous trace. See ntfs_device_trace_save().
+ *
+ * Return 0 on success or -1 with errno set to EINVAL or ENOMEM.
+ */
+int ntfs_device_trace_start(struct ntfs_device *dev, u32 size,
+		u64 (*clock)(void), u64 ticks_per_sec)
+{
+	struct ntfs_io_trace *trace;
+	u32 n;
+
+	if (!size || size > 0x1000000) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (n = 1; n < size; n <<= 1)
+		;
+	trace = ntfs_calloc(sizeof(*trace) + (n - 1) * sizeof(trace->rec[0]));
+	if (!trace)
+		return -1;
+	trace->clock = clock;
+	trace->ticks_per_sec = ticks_per_sec;
+	trace->size = n;
+	ntfs_device_trace_stop(dev);
+	dev->d_trace = trace;
+	return 0;
+}
+
+/**
+ * ntfs_device_trace_stop - stop recording the requests to a device
+ * @dev:	device traced
+ *
+ * The trace recorded so far is dropped.
+ */
+void ntfs_device_trace_stop(struct ntfs_device *dev)
+{
+	free(dev->d_trace);
+	dev->d_trace = NULL;
+}
+
+/**
+ * ntfs_device_trace - record a request in the trace of a device
+ * @dev:	device the request goes to
+ * @pos:	byte offset of the request
+ * @count:	bytes requested
+ * @flags:	NTFS_IO_* flags
+ *
+ * Does nothing unless @dev is traced. Device operations call this for the
+ * requests they make on their own, ntfs_pread() and friends do it for the
+ * others.
+ */
+void ntfs_device_trace(struct ntfs_device *dev, const s64 pos,
+		const s64 count, const u8 flags)
+{
+	struct ntfs_io_trace *trace = dev->d_trace;
+	struct ntfs_io_record *rec;
+
+	if (!trace)
+		return;
+	rec = &trace->rec[trace->total++ & (trace->size - 1)];
+	rec->time = trace->clock ? trace->clock() : 0;
+	rec->pos = pos;
+	rec->count = count > 0xffffffffLL ? 0xffffffffU : (u32)count;
+	rec->tag = (u8)dev->d_io_tag;
+	rec->flags = flags;
+	rec->reserved = 0;
+}
+
+/**
+ * ntfs_device_trace_save - dump the trace of a device
+ * @dev:	device traced
+ * @buf:	destination, or NULL to get the size needed
+ * @size:	size of @buf in bytes
+ *
+ * Write an NTFS_IO_TRACE_HEADER followed by the recorded requests, oldest
+ * first, to @buf. Recording goes on.
+ *
+ * Return the number of bytes written, or needed when @buf is NULL, or -1
+ * with errno set to ENODATA if @dev is not traced, or ERANGE if @size is too
+ * small.
+ */
+s64 ntfs_device_trace_save(struct ntfs_device *dev, void *buf, s64 size)
+{
+	struct ntfs_io_trace *trace = dev->d_trace;
+	NTFS_IO_TRACE_HEADER *h;
+	NTFS_IO_TRACE_RECORD *r;
+	struct ntfs_io_record *rec;
+	u64 i, first;
+	u32 count;
+	s64 needed;
+
+	if (!trace) {
+		errno = ENODATA;
+		return -1;
+	}
+	count = trace->total < trace->size ? (u32)trace->total : trace->size;
+	needed = sizeof(*h) + (s64)count * sizeof(*r);
+	if (!buf)
+		return needed;
+	if (size < needed) {
+		errno = ERANGE;
+		return -1;
+	}
+	h = (NTFS_IO_TRACE_HEADER *)buf;
+	h->magic = cpu_to_le32(NTFS_IO_TRACE_MAGIC);
+	h->version = cpu_to_le16(NTFS_IO_TRACE_VERSION);
+	h->record_size = cpu_to_le16(sizeof(*r));
+	h->ticks_per_sec = cpu_to_le64(trace->ticks_per_sec);
+	h->total = cpu_to_le64(trace->total);
+	h->count = cpu_to_le32(count);
+	h->reserved = 0;
+	r = (NTFS_IO_TRACE_RECORD *)(h + 1);
+	first = trace->total - count;
+	for (i = first; i < trace->total; i++, r++) {
+		rec = &trace->rec[i & (trace->size - 1)];
+		r->time = cpu_to_le64(rec->time);
+		r->pos = cpu_to_sle64(rec->pos);
+		r->count = cpu_to_le32(rec->count);
+		r->tag = rec->tag;
+		r->flags = rec->flags;
+		r->reserved = 0;
+	}
+	return needed;
+}
+
+/*
+ *		Sort prefetch extents by position (heapsort, no libc qsort
+ *	in the firmware)
+ */
+
+static void ntfs_prefetch_sift(struct ntfs_prefetch_extent *ext, u32 i,
+		u32 n)
+{
+	struct ntfs_prefetch_extent tmp;
+	u32 child;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n && ext[child + 1].pos > ext[child].pos)
+			child++;
+		if (ext[i].pos >= ext[child].pos)
+			break;
+		tmp = ext[i];
+		ext[i] = ext[child];
+		ext[child] = tmp;
+		i = child;
+	}
+}
+
+static void ntfs_prefetch_sort(struct ntfs_prefetch_extent *ext, u32 n)
+{
+	struct ntfs_prefetch_extent tmp;
+	u32 i;
+
+	for (i = n / 2; i-- > 0; )
+		ntfs_prefetch_sift(ext, i, n);
+	while (n-- > 1) {
+		tmp = ext[0];
+		ext[0] = ext[n];
+		ext[n] = tmp;
+		ntfs_prefetch_sift(ext, 0, n);
+	}
+}
+
+/*
+ *		Find the prefetched extent holding a whole device range
+ *
+ *	Returns NULL if the range is not entirely in one extent.
+ */
+
+static struct ntfs_prefetch_extent *ntfs_prefetch_find(
+		struct ntfs_prefetch *pf, s64 pos, s64 count)
+{
+	struct ntfs_prefetch_extent *ext;
+	u32 lo, hi, mid;
+
+	lo = 0;
+	hi = pf->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (pf->ext[mid].pos <= pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo)
+		return NULL;
+	ext = &pf->ext[lo - 1];
+	if (pos + count > ext->pos + ext->count)
+		return NULL;
+	return ext;
+}
+
+/**
+ * ntfs_device_prefetch - read a boot profile ahead of its use
+ * @dev:	device to prefetch from
+ * @profile:	I/O trace of an earlier boot, as saved by
+ *		ntfs_device_trace_save()
+ * @size:	size of @profile in bytes
+ * @max_bytes:	most bytes of recorded reads to prefetch
+ * @gap:	largest hole between two reads filled to merge them
+ *
+ * Take the reads of @profile, in the order they were made until @max_bytes
+ * of them, round them out to NTFS_PREFETCH_ALIGN, sort them by position and
+ * merge those closer than @gap bytes. Each merged extent is then read with a
+ * single request, in increasing positions, and kept in memory: later reads
+ * and borrows of @dev falling entirely in an extent are served from it, and
+ * writes update it. The data stays until @dev is freed.
+ *
+ * The profile only steers what is read, a stale one costs memory and time
+ * but never returns stale data. Extents that fail to read are dropped.
+ *
+ * Return the number of bytes prefetched, or -1 with errno set to EINVAL if
+ * @profile is not an I/O trace, EBUSY if @dev was already prefetched, or
+ * ENOMEM.
+ */
+s64 ntfs_device_prefetch(struct ntfs_device *dev, const void *profile,
+		s64 size, s64 max_bytes, u32 gap)
+{
+	const NTFS_IO_TRACE_HEADER *h = (const NTFS_IO_TRACE_HEADER *)profile;
+	const NTFS_IO_TRACE_RECORD *r;
+	struct ntfs_prefetch_extent *ext, *last;
+	struct ntfs_prefetch *pf;
+	ntfs_io_tag tag;
+	u32 count, rsize, i, n;
+	s64 pos, end, budget, br;
+
+	if (dev->d_prefetch) {
+		errno = EBUSY;
+		return -1;
+	}
+	if (!profile || size < (s64)sizeof(*h) ||
+			le32_to_cpu(h->magic) != NTFS_IO_TRACE_MAGIC ||
+			le16_to_cpu(h->version) != NTFS_IO_TRACE_VERSION ||
+			le16_to_cpu(h->record_size) < sizeof(*r)) {
+		errno = EINVAL;
+		return -1;
+	}
+	count = le32_to_cpu(h->count);
+	rsize = le16_to_cpu(h->record_size);
+	if ((s64)count * rsize > size - (s64)sizeof(*h)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!count)
+		return 0;
+	pf = ntfs_calloc(sizeof(*pf) + (count - 1) * sizeof(pf->ext[0]));
+	if (!pf)
+		return -1;
+	/* Keep the reads made first when the budget runs out. */
+	budget = max_bytes;
+	n = 0;
+	for (i = 0; i < count; i++) {
+		r = (const NTFS_IO_TRACE_RECORD *)((const u8 *)(h + 1) +
+				(s64)i * rsize);
+		pos = sle64_to_cpu(r->pos);
+		if ((r->flags & NTFS_IO_WRITE) || pos < 0 || !r->count)
+			continue;
+		end = pos + le32_to_cpu(r->count);
+		pos &= ~(s64)(NTFS_PREFETCH_ALIGN - 1);
+		end = (end + NTFS_PREFETCH_ALIGN - 1) &
+				~(s64)(NTFS_PREFETCH_ALIGN - 1);
+		if (end - pos > budget)
+			break;
+		budget -= end - pos;
+		pf->ext[n].pos = pos;
+		pf->ext[n].count = end - pos;
+		n++;
+	}
+	ntfs_prefetch_sort(pf->ext, n);
+	last = NULL;
+	for (ext = pf->ext; ext < pf->ext + n; ext++) {
+		if (last && ext->pos <= last->pos + last->count + gap) {
+			end = ext->pos + ext->count;
+			if (end > last->pos + last->count)
+				last->count = end - last->pos;
+			continue;
+		}
+		last = last ? last + 1 : pf->ext;
+		*last = *ext;
+	}
+	n = last ? (u32)(last - pf->ext) + 1 : 0;
+	/* One sweep in increasing positions. */
+	tag = ntfs_device_set_io_tag(dev, NTFS_IO_PREFETCH);
+	pf->count = 0;
+	for (i = 0; i < n; i++) {
+		ext = &pf->ext[pf->count];
+		*ext = pf->ext[i];
+		ext->data = ntfs_malloc(ext->count);
+		if (!ext->data)
+			break;
+		br = ntfs_pread(dev, ext->pos, ext->count, ext->data);
+		if (br <= 0) {
+			free(ext->data);
+			continue;
+		}
+		ext->count = br;
+		pf->bytes += br;
+		pf->count++;
+	}
+	ntfs_device_set_io_tag(dev, tag);
+	if (!pf->count) {
+		free(pf);
+		if (i < n)
+			return -1;
+		return 0;
+	}
+	dev->d_prefetch = pf;
+	return pf->bytes;
+}
+
+/**
+ * ntfs_device_borrow - access a device range in place
+ * @dev:	device to read from
+ * @pos:	position in device of the first byte
+ * @count:	number of bytes wanted
+ *
+ * Return a pointer to @count bytes of @dev starting at @pos without copying
+ * them, for devices providing the borrow operation and for ranges held by
+ * ntfs_device_prefetch(). Ranges lent by the device count as reads of it.
+ * The data must not be modified and stays valid until the device is closed;
+ * prefetched data follows the writes made through ntfs_pwrite().
+ *
+ * Return NULL with errno set to EOPNOTSUPP if the device cannot lend its
+ * contents, or to EINVAL if the range is invalid. Callers then fall back to
+ * ntfs_pread().
+ */
+const void *ntfs_device_borrow(struct ntfs_device *dev, const s64 pos,
+		const s64 count)
+{
+	struct ntfs_prefetch_extent *ext;
+	const void *p;
+
+	if (count <= 0 || pos < 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (dev->d_prefetch) {
+		ext = ntfs_prefetch_find(dev->d_prefetch, pos, count);
+		if (ext) {
+			ntfs_device_trace(dev, pos, count,
+					NTFS_IO_BORROW | NTFS_IO_CACHED);
+			dev->d_prefetch->hits++;
+			return ext->data + (pos - ext->pos);
+		}
+	}
+	if (!dev->d_ops->borrow) {
+		errno = EOPNOTSUPP;
+		return NULL;
+	}
+	ntfs_device_trace(dev, pos, count, NTFS_IO_BORROW);
+	p = dev->d_ops->borrow(dev, pos, count);
+	if (p) {
+		dev->d_reads++;
+		dev->d_read_bytes += count;
+	}
+	return p;
+}
+
 /**
  * ntfs_pread - positioned read from disk
  * @dev:	device to read from
@@ -200,6 +609,7 @@ s64 ntfs_pread(struct ntfs_device *dev, const s64 pos, s64 count, void *b)
 {
 	s64 br, total;
 	struct ntfs_device_operations *dops;
+	struct ntfs_prefetch_extent *ext;
 
 	ntfs_log_trace("pos %l, count %l\n",(long long)pos,(long long)count);
 	
@@ -209,8 +619,18 @@ s64 ntfs_pread(struct ntfs_device *dev, const s64 pos, s64 count, void *b)
 	}
 	if (!count)
 		return 0;
+	if (dev->d_prefetch) {
+		ext = ntfs_prefetch_find(dev->d_prefetch, pos, count);
+		if (ext) {
+			ntfs_device_trace(dev, pos, count, NTFS_IO_CACHED);
+			dev->d_prefetch->hits++;
+			memcpy(b, ext->data + (pos - ext->pos), count);
+			return count;
+		}
+	}
 	
 	dops = dev->d_ops;
+	ntfs_device_trace(dev, pos, count, 0);
 
 	for (total = 0; count; count -= br, total += br) {
 		br = dops->pread(dev, (char*)b + total, count, pos + total);
@@ -227,6 +647,27 @@ s64 ntfs_pread(struct ntfs_device *dev, const s64 pos, s64 count, void *b)
 	return total;
 }
 
+/*
+ *		Copy written data over the prefetched data it overlaps
+ */
+
+static void ntfs_prefetch_update(struct ntfs_prefetch *pf, s64 pos,
+		s64 count, const void *b)
+{
+	struct ntfs_prefetch_extent *ext;
+	s64 start, end;
+
+	for (ext = pf->ext; ext < pf->ext + pf->count; ext++) {
+		start = pos > ext->pos ? pos : ext->pos;
+		end = pos + count < ext->pos + ext->count ?
+				pos + count : ext->pos + ext->count;
+		if (start < end)
+			memcpy(ext->data + (start - ext->pos),
+					(const u8 *)b + (start - pos),
+					end - start);
+	}
+}
+
 /**
  * ntfs_pwrite - positioned write to disk
  * @dev:	device to write to
@@ -266,6 +707,7 @@ s64 ntfs_pwrite(struct ntfs_device *dev, const s64 pos, s64 count,
 	}
 	
 	dops = dev->d_ops;
+	ntfs_device_trace(dev, pos, count, NTFS_IO_WRITE);
 
 	NDevSetDirty(dev);
 	for (total = 0; count; count -= written, total += written) {
@@ -286,6 +728,8 @@ s64 ntfs_pwrite(struct ntfs_device *dev, const s64 pos, s64 count,
 	if (NDevSync(dev) && total && dops->sync(dev)) {
 		total--; /* on sync error, return partially written */
 	}
+	if (dev->d_prefetch && total > 0)
+		ntfs_prefetch_update(dev->d_prefetch, pos, total, b);
 	ret = total;
 out:	
 	return ret;
@@ -323,7 +767,7 @@ out:
 s64 ntfs_mst_pread(struct ntfs_device *dev, const s64 pos, s64 count,
 		const u32 bksize, void *b)
 {
-	s64 br, i;
+	s64 br;
 
 	if (bksize & (bksize - 1) || bksize % NTFS_BLOCK_SIZE) {
 		errno = EINVAL;
@@ -334,15 +778,13 @@ s64 ntfs_mst_pread(struct ntfs_device *dev, const s64 pos, s64 count,
 	if (br < 0)
 		return br;
 	/*
-	 * Apply fixups to successfully read data, disregarding any errors
-	 * returned from the MST fixup function. This is because we want to
-	 * fixup everything possible and we rely on the fact that the "BAAD"
-	 * magic will be detected later on.
+	 * Apply fixups to successfully read data in one pass, disregarding
+	 * any errors returned from the MST fixup function. This is because we
+	 * want to fixup everything possible and we rely on the fact that the
+	 * "BAAD" magic will be detected later on.
 	 */
 	count = br / bksize;
-	for (i = 0; i < count; ++i)
-		ntfs_mst_post_read_fixup((NTFS_RECORD*)
-				((u8*)b + i * bksize), bksize);
+	ntfs_mst_post_read_fixup_batch(b, count, bksize, TRUE);
 	/* Finally, return the number of complete blocks read. */
 	return count;
 }
@@ -68,6 +68,112 @@ typedef enum {
 #define NDevSetSync(nd)		  set_ndev_flag(nd, Sync)
 #define NDevClearSync(nd)	clear_ndev_flag(nd, Sync)
 
+/**
+ * enum ntfs_io_tag -
+ *
+ * What a device request is for. The library tags the device (see
+ * ntfs_device_set_io_tag()) around the reads it issues so that an I/O trace
+ * tells metadata from file data.
+ */
+typedef enum {
+	NTFS_IO_OTHER,		/* Untagged. */
+	NTFS_IO_BOOT,		/* Boot sector. */
+	NTFS_IO_MFT,		/* $MFT, $MFTMirr and attribute lists. */
+	NTFS_IO_INDEX,		/* Directory and view index blocks. */
+	NTFS_IO_DATA,		/* Data of user files. */
+	NTFS_IO_BITMAP,		/* $Bitmap and $MFT/$BITMAP. */
+	NTFS_IO_LOGFILE,	/* $LogFile. */
+	NTFS_IO_META,		/* Other system files ($UpCase, $Secure...). */
+	NTFS_IO_PREFETCH,	/* Boot profile prefetch. */
+	NTFS_IO_TAGS
+} ntfs_io_tag;
+
+/* ntfs_io_record flags. */
+#define NTFS_IO_WRITE	0x01	/* The request wrote to the device. */
+#define NTFS_IO_BORROW	0x02	/* The data was borrowed, not copied. */
+#define NTFS_IO_CACHED	0x04	/* Served from prefetched data. */
+
+/**
+ * struct ntfs_io_record - one device request of an I/O trace
+ */
+struct ntfs_io_record {
+	u64 time;		/* Clock of the trace at the request. */
+	s64 pos;		/* Byte offset on the device. */
+	u32 count;		/* Bytes requested. */
+	u8 tag;			/* ntfs_io_tag of the request. */
+	u8 flags;		/* NTFS_IO_* flags. */
+	u16 reserved;
+};
+
+/**
+ * struct ntfs_io_trace - ring buffer of the last requests of a device
+ *
+ * @size is a power of two. @total counts every request seen, so the ring
+ * holds the last min(@total, @size) of them, the newest at
+ * (@total - 1) & (@size - 1).
+ */
+struct ntfs_io_trace {
+	u64 (*clock)(void);	/* Timestamp source. */
+	u64 ticks_per_sec;	/* Frequency of @clock, 0 if unknown. */
+	u32 size;		/* Number of records. */
+	u64 total;		/* Requests recorded so far. */
+	struct ntfs_io_record rec[1];
+};
+
+/*
+ * An I/O trace as saved by ntfs_device_trace_save(): this header followed by
+ * @count records, oldest first, all little endian.
+ */
+#define NTFS_IO_TRACE_MAGIC	0x4f49544e	/* "NTIO" */
+#define NTFS_IO_TRACE_VERSION	1
+
+#pragma pack(push, 1)
+typedef struct {
+	le32 magic;		/* NTFS_IO_TRACE_MAGIC */
+	le16 version;		/* NTFS_IO_TRACE_VERSION */
+	le16 record_size;	/* sizeof(NTFS_IO_TRACE_RECORD) */
+	le64 ticks_per_sec;	/* Frequency of the timestamps, 0 if
+				   unknown. */
+	le64 total;		/* Requests seen; the first total - count
+				   were overwritten. */
+	le32 count;		/* Records that follow. */
+	le32 reserved;
+} NTFS_IO_TRACE_HEADER;
+
+typedef struct {
+	le64 time;
+	sle64 pos;		/* Byte offset on the device. */
+	le32 count;		/* Bytes requested. */
+	u8 tag;			/* ntfs_io_tag */
+	u8 flags;		/* NTFS_IO_* flags */
+	le16 reserved;
+} NTFS_IO_TRACE_RECORD;
+#pragma pack(pop)
+
+/* Granularity of the reads of ntfs_device_prefetch(). */
+#define NTFS_PREFETCH_ALIGN	4096
+
+/**
+ * struct ntfs_prefetch_extent - a device range read ahead of its use
+ */
+struct ntfs_prefetch_extent {
+	s64 pos;		/* Byte offset on the device. */
+	s64 count;		/* Bytes held. */
+	u8 *data;
+};
+
+/**
+ * struct ntfs_prefetch - data of a device read from a boot profile
+ *
+ * The extents are sorted by position and do not overlap.
+ */
+struct ntfs_prefetch {
+	u32 count;		/* Number of extents. */
+	s64 bytes;		/* Bytes held by all of them. */
+	u64 hits;		/* Requests served from them. */
+	struct ntfs_prefetch_extent ext[1];
+};
+
 /**
  * struct ntfs_device -
  *
@@ -80,8 +186,23 @@ struct ntfs_device {
 	char *d_name;				/* Name of device. */
 	void *d_private;			/* Private data used by the
 						   device operations. */
+	u64 d_reads;				/* Read requests issued to the
+						   underlying medium. */
+	u64 d_read_bytes;			/* Bytes read from it. */
+	u64 d_cache_hits;			/* Lookups served by the sector
+						   cache of the device. */
+	u64 d_cache_misses;			/* Lookups it had to read in. */
+	ntfs_io_tag d_io_tag;			/* Tag of the requests being
+						   issued. */
+	struct ntfs_io_trace *d_trace;		/* I/O trace, NULL when not
+						   tracing. */
+	struct ntfs_prefetch *d_prefetch;	/* Prefetched data, NULL if
+						   none. */
 };
 
+#ifdef NTFS_HOST_BUILD
+#include <sys/stat.h>
+#else
 #define ino_t int
 #define nlink_t int
 #define blksize_t int
@@ -105,11 +226,17 @@ struct stat {
 	time_t    st_mtime;   /* time of last modification */
 	time_t    st_ctime;   /* time of last status change */
 };
+#endif /* NTFS_HOST_BUILD */
 /**
  * struct ntfs_device_operations -
  *
  * The ntfs device operations defining all operations that can be performed on
  * the low level device described by an ntfs device structure.
+ *
+ * @borrow is optional. A device whose contents are addressable in memory, like
+ * a mapped image file, returns a pointer to @count bytes at @offset that stays
+ * valid and unchanged until the device is closed; the caller must not write
+ * through it. Devices without such a view leave it NULL.
  */
 struct ntfs_device_operations {
 	int (*open)(struct ntfs_device *dev, int flags);
@@ -123,6 +250,7 @@ struct ntfs_device_operations {
 	int (*sync)(struct ntfs_device *dev);
 	int (*stat)(struct ntfs_device *dev, struct stat *buf);
 	int (*ioctl)(struct ntfs_device *dev, int request, void *argp);
+	const void *(*borrow)(struct ntfs_device *dev, s64 offset, s64 count);
 };
 
 extern struct ntfs_device *ntfs_device_alloc(const char *name, const long state,
@@ -130,6 +258,22 @@ extern struct ntfs_device *ntfs_device_alloc(const char *name, const long state,
 extern int ntfs_device_free(struct ntfs_device *dev);
 extern int ntfs_device_sync(struct ntfs_device *dev);
 
+extern const void *ntfs_device_borrow(struct ntfs_device *dev, const s64 pos,
+		const s64 count);
+
+extern ntfs_io_tag ntfs_device_set_io_tag(struct ntfs_device *dev,
+		ntfs_io_tag tag);
+extern int ntfs_device_trace_start(struct ntfs_device *dev, u32 size,
+		u64 (*clock)(void), u64 ticks_per_sec);
+extern void ntfs_device_trace_stop(struct ntfs_device *dev);
+extern void ntfs_device_trace(struct ntfs_device *dev, const s64 pos,
+		const s64 count, const u8 flags);
+extern s64 ntfs_device_trace_save(struct ntfs_device *dev, void *buf,
+		s64 size);
+
+extern s64 ntfs_device_prefetch(struct ntfs_device *dev, const void *profile,
+		s64 size, s64 max_bytes, u32 gap);
+
 extern s64 ntfs_pread(struct ntfs_device *dev, const s64 pos, s64 count,
 		void *b);
 extern s64 ntfs_pwrite(struct ntfs_device *dev, const s64 pos, s64 count,
@@ -57,6 +57,7 @@
 #include "lcnalloc.h"
 #include "logging.h"
 #include "cache.h"
+#include "pathidx.h"
 #include "misc.h"
 #include "security.h"
 #include "reparse.h"
@@ -217,6 +218,257 @@ int ntfs_dir_lookup_hash(const struct CACHED_GENERIC *cached)
 
 #endif
 
+/*
+ *		Hash a name as the index collates it, upcased
+ */
+
+static u64 ntfs_dir_name_hash(const ntfschar *name, int len,
+		const ntfschar *upcase, u32 upcase_len)
+{
+	u64 h;
+	u16 c;
+	int i;
+
+	h = 0xcbf29ce484222325ULL;
+	for (i=0; i<len; i++) {
+		c = le16_to_cpu(name[i]);
+		if (c < upcase_len)
+			c = le16_to_cpu(upcase[c]);
+		h = (h ^ c) * 0x100000001b3ULL;
+	}
+		/* spread the bits, the probes use both halves */
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (h);
+}
+
+#if CACHE_DIRFILTER_SIZE
+
+/*
+ *		Directory comparing for entering/fetching name filters
+ */
+
+static int dir_filter_compare(const struct CACHED_GENERIC *cached,
+			const struct CACHED_GENERIC *wanted)
+{
+	const struct CACHED_DIRFILTER *c = (const struct CACHED_DIRFILTER*) cached;
+	const struct CACHED_DIRFILTER *w = (const struct CACHED_DIRFILTER*) wanted;
+	return (!c->bits || (c->inum != w->inum));
+}
+
+/*
+ *		Name filter hashing, by directory inode
+ */
+
+int ntfs_dir_filter_hash(const struct CACHED_GENERIC *cached)
+{
+	const struct CACHED_DIRFILTER *c = (const struct CACHED_DIRFILTER*) cached;
+
+	return (c->inum % (2*CACHE_DIRFILTER_SIZE));
+}
+
+/*
+ *		Get the name filter of a directory
+ *
+ *	A filter built before the last change of an index is dropped.
+ *	Returns NULL if there is no usable filter.
+ */
+
+static const struct CACHED_DIRFILTER *ntfs_dir_filter_fetch(
+			ntfs_inode *dir_ni)
+{
+	struct CACHED_DIRFILTER item;
+	struct CACHED_DIRFILTER *cached;
+	ntfs_volume *vol = dir_ni->vol;
+
+	if (!vol->dirfilter_cache)
+		return ((const struct CACHED_DIRFILTER*)NULL);
+	item.inum = dir_ni->mft_no;
+	item.bits = (const u8*)NULL;
+	item.size = 0;
+	cached = (struct CACHED_DIRFILTER*)ntfs_fetch_cache(
+			vol->dirfilter_cache, GENERIC(&item),
+			dir_filter_compare);
+	if (cached && (cached->index_gen != ntfs_index_gen)) {
+		ntfs_remove_cache(vol->dirfilter_cache,
+			(struct CACHED_GENERIC*)cached, 0);
+		cached = (struct CACHED_DIRFILTER*)NULL;
+	}
+	return (cached);
+}
+
+/*
+ *		Check whether a name is certainly not in a directory
+ *
+ *	Only a directory with a filter can be answered, otherwise the
+ *	index has to be searched.
+ */
+
+static BOOL ntfs_dir_filter_excludes(ntfs_inode *dir_ni,
+			const ntfschar *uname, int uname_len)
+{
+	const struct CACHED_DIRFILTER *filter;
+	ntfs_volume *vol = dir_ni->vol;
+	u32 bit, step, mask;
+	u64 h;
+	int i;
+
+	filter = ntfs_dir_filter_fetch(dir_ni);
+	if (!filter)
+		return (FALSE);
+	h = ntfs_dir_name_hash(uname, uname_len, vol->upcase,
+			vol->upcase_len);
+	mask = (filter->size << 3) - 1;
+	bit = (u32)h;
+	step = (u32)(h >> 32) | 1;
+	for (i=0; i<NTFS_DIRFILTER_PROBES; i++) {
+		if (!(filter->bits[(bit & mask) >> 3] & (1 << (bit & 7))))
+			return (TRUE);
+		bit += step;
+	}
+	return (FALSE);
+}
+
+/*
+ *		Enter the filter of the names of a directory into cache
+ */
+
+static void ntfs_dir_filter_enter(ntfs_inode *dir_ni,
+			const ntfs_dir_names *names)
+{
+	struct CACHED_DIRFILTER item;
+	ntfs_volume *vol = dir_ni->vol;
+
+	item.inum = dir_ni->mft_no;
+	item.index_gen = names->index_gen;
+	item.bits = names->bits;
+	item.size = names->size;
+		/* replace a stale filter, entering does not update */
+	ntfs_invalidate_cache(vol->dirfilter_cache, GENERIC(&item),
+			dir_filter_compare, 0);
+	ntfs_enter_cache(vol->dirfilter_cache, GENERIC(&item),
+			dir_filter_compare);
+}
+
+#endif
+
+/*
+ *		Start collecting the names met by a listing
+ *
+ *	Nothing is collected if the directory already has a filter. The
+ *	filter is sized for as many names as the index can hold, counting
+ *	the shortest possible entries, so that no name has to be kept.
+ */
+
+static void ntfs_dir_names_start(ntfs_dir_names *names, ntfs_inode *dir_ni,
+			s64 index_size)
+{
+#if CACHE_DIRFILTER_SIZE
+	s64 nbits;
+	u32 size;
+#endif
+
+	names->index_gen = ntfs_index_gen;
+	names->active = FALSE;
+#if CACHE_DIRFILTER_SIZE
+	if (!dir_ni->vol->dirfilter_cache || ntfs_dir_filter_fetch(dir_ni))
+		return;
+	nbits = (index_size / ((sizeof(INDEX_ENTRY_HEADER)
+			+ sizeof(FILE_NAME_ATTR) + sizeof(ntfschar) + 7) & ~7)
+			+ 1) * NTFS_DIRFILTER_BITS;
+		/* a power of two, as the probes are masked */
+	size = 8;
+	while (((s64)size << 3) < nbits)
+		size <<= 1;
+	free(names->bits);
+	names->bits = (u8*)ntfs_calloc(size);
+	if (!names->bits)
+		return;		/* not an error, just no filter */
+	names->size = size;
+	names->active = TRUE;
+#endif
+}
+
+static void ntfs_dir_names_free(ntfs_dir_names *names)
+{
+	free(names->bits);
+	names->bits = (u8*)NULL;
+	names->size = 0;
+	names->active = FALSE;
+}
+
+/*
+ *		Enter the name of an index entry into the filter
+ */
+
+static void ntfs_dir_names_add(ntfs_dir_names *names, ntfs_volume *vol,
+			const FILE_NAME_ATTR *fn)
+{
+	u32 bit, step, mask;
+	u64 h;
+	int i;
+
+	h = ntfs_dir_name_hash(fn->file_name, fn->file_name_length,
+			vol->upcase, vol->upcase_len);
+	mask = (names->size << 3) - 1;
+	bit = (u32)h;
+	step = (u32)(h >> 32) | 1;
+	for (i=0; i<NTFS_DIRFILTER_PROBES; i++) {
+		names->bits[(bit & mask) >> 3] |= 1 << (bit & 7);
+		bit += step;
+	}
+}
+
+/*
+ *		Enter the filter filled by a listing into cache
+ *
+ *	The names are only complete if no index changed since the start.
+ */
+
+static void ntfs_dir_names_end(ntfs_dir_names *names, ntfs_inode *dir_ni)
+{
+#if CACHE_DIRFILTER_SIZE
+	if (names->active && (names->index_gen == ntfs_index_gen))
+		ntfs_dir_filter_enter(dir_ni, names);
+#endif
+	ntfs_dir_names_free(names);
+}
+
+static int ntfs_readdir_i(ntfs_inode *dir_ni, s64 *pos, void *dirent,
+		ntfs_filldir_t filldir, ntfs_dir_cursor *cur,
+		ntfs_dir_names *names);
+
+#if CACHE_DIRFILTER_SIZE
+
+/*
+ *		Build the filter of a small directory in which a lookup missed
+ *
+ *	The index is listed without looking at the entries, which only
+ *	costs reading the index blocks, at most NTFS_DIRFILTER_SCAN bytes.
+ *	Next missing names are then answered without any read.
+ */
+
+static void ntfs_dir_filter_build(ntfs_inode *dir_ni, s64 ia_size)
+{
+	ntfs_dir_names names;
+	s64 pos;
+	int eo;
+
+	if (!dir_ni->vol->dirfilter_cache || (ia_size > NTFS_DIRFILTER_SCAN)
+	    || ntfs_dir_filter_fetch(dir_ni))
+		return;
+	eo = errno;
+	memset(&names, 0, sizeof(names));
+	pos = 0;
+	ntfs_readdir_i(dir_ni, &pos, (void*)NULL, (ntfs_filldir_t)NULL,
+			(ntfs_dir_cursor*)NULL, &names);
+	ntfs_dir_names_free(&names);
+	errno = eo;
+}
+
+#endif
+
 /**
  * ntfs_inode_lookup_by_name - find an inode in a directory given its name
  * @dir_ni:	ntfs inode of the directory in which to search for the name
@@ -241,15 +493,19 @@ int ntfs_dir_lookup_hash(const struct CACHED_GENERIC *cached)
  *
  * If the volume is mounted with the case sensitive flag set, then we only
  * allow exact matches.
+ *
+ * Note, when the directory has a name filter (CACHE_DIRFILTER_SIZE), a name
+ * it does not hold is reported missing without reading the index. A miss in
+ * a small directory with no filter builds one.
  */
 u64 ntfs_inode_lookup_by_name(ntfs_inode *dir_ni,
 		const ntfschar *uname, const int uname_len)
 {
 	VCN vcn;
 	u64 mref = 0;
-	s64 br;
+	s64 br, ia_size;
 	ntfs_volume *vol = dir_ni->vol;
-	ntfs_attr_search_ctx *ctx;
+	ntfs_attr_search_ctx actx, *ctx = &actx;
 	INDEX_ROOT *ir;
 	INDEX_ENTRY *ie;
 	INDEX_ALLOCATION *ia;
@@ -267,9 +523,15 @@ u64 ntfs_inode_lookup_by_name(ntfs_inode *dir_ni,
 		return -1;
 	}
 
-	ctx = ntfs_attr_get_search_ctx(dir_ni, NULL);
-	if (!ctx)
+#if CACHE_DIRFILTER_SIZE
+	/* A name missing from the filter of the directory is not there. */
+	if (ntfs_dir_filter_excludes(dir_ni, uname, uname_len)) {
+		errno = ENOENT;
 		return -1;
+	}
+#endif
+
+	ntfs_attr_stack_search_ctx(ctx, dir_ni, NULL);
 
 	/* Find the index root attribute in the mft record. */
 	if (ntfs_attr_lookup(AT_INDEX_ROOT, NTFS_INDEX_I30, 4, CASE_SENSITIVE, 0, NULL,
@@ -343,7 +605,6 @@ u64 ntfs_inode_lookup_by_name(ntfs_inode *dir_ni,
 		 * still treat it correctly.
 		 */
 		mref = le64_to_cpu(ie->indexed_file);
-		ntfs_attr_put_search_ctx(ctx);
 		return mref;
 	}
 	/*
@@ -353,10 +614,12 @@ u64 ntfs_inode_lookup_by_name(ntfs_inode *dir_ni,
 	 * cached in mref in which case return mref.
 	 */
 	if (!(ie->ie_flags & INDEX_ENTRY_NODE)) {
-		ntfs_attr_put_search_ctx(ctx);
 		if (mref)
 			return mref;
 		ntfs_log_debug("Entry not found - between root entries.\n");
+#if CACHE_DIRFILTER_SIZE
+		ntfs_dir_filter_build(dir_ni, 0);
+#endif
 		errno = ENOENT;
 		return -1;
 	} /* Child node present, descend into it. */
@@ -398,6 +661,7 @@ descend_into_child_node:
 			       	(unsigned long long)vcn);
 		goto close_err_out;
 	}
+	NVolStatAdd(vol, index_blocks, 1);
 
 	if (sle64_to_cpu(ia->index_block_vcn) != vcn) {
 		ntfs_log_error("Actual VCN (0x%lx) of index buffer is different "
@@ -480,7 +744,6 @@ descend_into_child_node:
 		mref = le64_to_cpu(ie->indexed_file);
 		free(ia);
 		ntfs_attr_close(ia_na);
-		ntfs_attr_put_search_ctx(ctx);
 		return mref;
 	}
 	/*
@@ -504,9 +767,9 @@ descend_into_child_node:
 		errno = EIO;
 		goto close_err_out;
 	}
+	ia_size = ia_na->data_size;
 	free(ia);
 	ntfs_attr_close(ia_na);
-	ntfs_attr_put_search_ctx(ctx);
 	/*
 	 * No child node present, return error code ENOENT, unless we have got
 	 * the mft reference of a matching name cached in mref in which case
@@ -515,13 +778,15 @@ descend_into_child_node:
 	if (mref)
 		return mref;
 	ntfs_log_debug("Entry not found.\n");
+#if CACHE_DIRFILTER_SIZE
+	ntfs_dir_filter_build(dir_ni, ia_size);
+#endif
 	errno = ENOENT;
 	return -1;
 put_err_out:
 	eo = EIO;
 	ntfs_log_debug("Corrupt directory. Aborting lookup.\n");
 eo_put_err_out:
-	ntfs_attr_put_search_ctx(ctx);
 	errno = eo;
 	return -1;
 close_err_out:
@@ -596,11 +861,12 @@ u64 ntfs_inode_lookup_by_mbsname(ntfs_inode *dir_ni, const char *name)
 #endif
 			{
 				/* Generate unicode name. */
-			uname_len = ntfs_mbstoucs(cached_name, &uname);
-			if (uname_len >= 0)
+			uname_len = ntfs_mbstoucs(const_name, &uname);
+			if (uname_len >= 0) {
 				inum = ntfs_inode_lookup_by_name(dir_ni,
 						uname, uname_len);
-			else
+				free(uname);
+			} else
 				inum = (s64)-1;
 		}
 		if (cached_name)
@@ -658,6 +924,9 @@ void ntfs_inode_update_mbsname(ntfs_inode *dir_ni, const char *name, u64 inum)
  * splits the path and then descends the directory tree.  If @parent is NULL,
  * then the root directory '.' will be used as the base for the search.
  *
+ * A path from the root is first looked for in the path index of the volume,
+ * if one is attached (see ntfs_path_index_lookup()).
+ *
  * Return:  inode  Success, the pathname was valid
  *	    NULL   Error, the pathname was invalid, or some other error occurred
  */
@@ -703,6 +972,14 @@ ntfs_inode *ntfs_pathname_to_inode(ntfs_volume *vol, ntfs_inode *parent,
 	if (parent) {
 		ni = parent;
 	} else {
+			/*
+			 * a path from the root may be in the path index
+			 */
+		ni = ntfs_path_index_lookup(vol, p);
+		if (ni) {
+			result = ni;
+			goto out;
+		}
 #if CACHE_INODE_SIZE
 			/*
 			 * fetch inode for full path from cache
@@ -1105,43 +1382,179 @@ err_out:
 	return ERR_MREF(-1);
 }
 
-/**
- * ntfs_readdir - read the contents of an ntfs directory
- * @dir_ni:	ntfs inode of current directory
- * @pos:	current position in directory
- * @dirent:	context for filldir callback supplied by the caller
- * @filldir:	filldir callback supplied by the caller
+/*
+ *		Find the next set bit of an index bitmap, from bit @bit on
  *
- * Parse the index root and the index blocks that are marked in use in the
- * index bitmap and hand each found directory entry to the @filldir callback
- * supplied by the caller.
+ *	The buffer must be padded with zeroes to a multiple of 8 bytes,
+ *	so that runs of free blocks can be skipped a word at a time.
+ *	Returns @bits if no bit is set beyond @bit.
+ */
+
+static s64 ntfs_bmp_next_set(const u8 *bmp, s64 bits, s64 bit)
+{
+	while (bit < bits) {
+		if (!(bit & 63) && !*(const u64*)(bmp + (bit >> 3))) {
+			bit += 64;
+			continue;
+		}
+		if (!(bit & 7) && !bmp[bit >> 3]) {
+			bit += 8;
+			continue;
+		}
+		if (bmp[bit >> 3] & (1 << (bit & 7)))
+			return bit;
+		bit++;
+	}
+	return bits;
+}
+
+static void ntfs_dir_cursor_drop(ntfs_dir_cursor *cur);
+
+/*
+ *		List the entries of the index blocks held in a chunk
  *
- * Return 0 on success or -1 on error with errno set to the error code.
+ *	@chunk holds @count index blocks, already fixed up, from block
+ *	@first of the index allocation on. The listing starts at @ia_pos,
+ *	which is within the chunk, skipping the entries before it in its
+ *	block.
  *
- * Note: Index blocks are parsed in ascending vcn order, from which follows
- * that the directory entries are not returned sorted.
+ *	Returns 0 when the chunk is done, the nonzero return of filldir()
+ *	when it asked to stop, or -1 with errno set if a block is corrupt.
  */
-int ntfs_readdir(ntfs_inode *dir_ni, s64 *pos,
-		void *dirent, ntfs_filldir_t filldir)
+
+static int ntfs_readdir_chunk(ntfs_inode *dir_ni, s64 *pos, void *dirent,
+		ntfs_filldir_t filldir, ntfs_dir_names *names, u8 *chunk,
+		s64 first, s64 count, s64 ia_pos, u32 index_block_size,
+		u8 index_vcn_size_bits)
+{
+	INDEX_ALLOCATION *ia;
+	INDEX_ENTRY *ie;
+	index_union iu;
+	u8 *index_end;
+	s64 blk, ia_start;
+	int rc;
+
+	for (blk = ia_pos / index_block_size - first; blk < count; blk++) {
+		ia = (INDEX_ALLOCATION*)(chunk + blk * index_block_size);
+		ia_start = (first + blk) * index_block_size;
+		if (sle64_to_cpu(ia->index_block_vcn) !=
+				ia_start >> index_vcn_size_bits) {
+			ntfs_log_error("Actual VCN (0x%lx) of index buffer is "
+				"different from expected VCN (0x%lx) in "
+				"inode 0x%lx.\n",
+				(long long)sle64_to_cpu(ia->index_block_vcn),
+				(long long)ia_start >> index_vcn_size_bits,
+				(unsigned long long)dir_ni->mft_no);
+			goto corrupt;
+		}
+		if (le32_to_cpu(ia->index.allocated_size) + 0x18 !=
+				index_block_size) {
+			ntfs_log_error("Index buffer (VCN 0x%lx) of directory "
+				"inode %l has a size (%u) differing from the "
+				"directory specified size (%u).\n",
+				(long long)ia_start >> index_vcn_size_bits,
+				(unsigned long long)dir_ni->mft_no,
+				(unsigned)le32_to_cpu(ia->index.allocated_size)
+				+ 0x18, (unsigned)index_block_size);
+			goto corrupt;
+		}
+		index_end = (u8*)&ia->index +
+				le32_to_cpu(ia->index.index_length);
+		if (index_end > (u8*)ia + index_block_size) {
+			ntfs_log_error("Size of index buffer (VCN 0x%lx) of "
+				"directory inode %l exceeds maximum size.\n",
+				(long long)ia_start >> index_vcn_size_bits,
+				(unsigned long long)dir_ni->mft_no);
+			goto corrupt;
+		}
+		/* The first index entry. */
+		ie = (INDEX_ENTRY*)((u8*)&ia->index +
+				le32_to_cpu(ia->index.entries_offset));
+		/*
+		 * Loop until we exceed valid memory (corruption case) or until
+		 * we reach the last entry or until ntfs_filldir tells us it
+		 * has had enough or signals an error.
+		 */
+		for (;; ie = (INDEX_ENTRY*)((u8*)ie +
+				le16_to_cpu(ie->length))) {
+			ntfs_log_debug("In index allocation, offset 0x%lx.\n",
+				(long long)ia_start + ((u8*)ie - (u8*)ia));
+			/* Bounds checks. */
+			if ((u8*)ie < (u8*)ia ||
+			    (u8*)ie + sizeof(INDEX_ENTRY_HEADER) > index_end ||
+			    (u8*)ie + le16_to_cpu(ie->key_length) > index_end) {
+				ntfs_log_error("Index entry out of bounds in "
+					"directory inode %l.\n",
+					(unsigned long long)dir_ni->mft_no);
+				goto corrupt;
+			}
+			/* The last entry cannot contain a name. */
+			if (ie->ie_flags & INDEX_ENTRY_END)
+				break;
+			if (!le16_to_cpu(ie->length))
+				goto corrupt;
+			/* Skip index entry if continuing previous readdir. */
+			if (ia_pos - ia_start > (u8*)ie - (u8*)ia)
+				continue;
+			/*
+			 * Submit the directory entry to ntfs_filldir(), which
+			 * will invoke the filldir() callback as appropriate.
+			 */
+			iu.ia = ia;
+			if (filldir) {
+				rc = ntfs_filldir(dir_ni, pos,
+						index_vcn_size_bits,
+						INDEX_TYPE_ALLOCATION,
+						(index_union *) &iu, ie,
+						dirent, filldir);
+				if (rc)
+					return (rc);
+			}
+			if (names && names->active)
+				ntfs_dir_names_add(names, dir_ni->vol,
+						&ie->key.file_name);
+		}
+	}
+	return (0);
+corrupt:
+	errno = EIO;
+	return (-1);
+}
+
+/*
+ *		List a directory, see ntfs_readdir()
+ *
+ *	With a cursor, the attributes, the bitmap and the index blocks read
+ *	are taken from it and left in it, and a positive return from
+ *	filldir() ends the call with 1 instead of an error.
+ *	A listing from the start collects the names into @names, and
+ *	enters the filter of the directory when it reaches the end. With no
+ *	filldir() the entries are only collected.
+ */
+
+static int ntfs_readdir_i(ntfs_inode *dir_ni, s64 *pos, void *dirent,
+		ntfs_filldir_t filldir, ntfs_dir_cursor *cur,
+		ntfs_dir_names *names)
 {
-	s64 i_size, br, ia_pos, bmp_pos, ia_start;
+	s64 i_size, br, ia_pos, bmp_pos;
+	s64 bmp_bits, chunk_blocks, ia_blocks, run_end, first;
 	ntfs_volume *vol;
 	ntfs_attr *ia_na, *bmp_na = NULL;
 	ntfs_attr_search_ctx *ctx = NULL;
-	u8 *index_end, *bmp = NULL;
+	runlist_element *rl;
+	u8 *index_end, *bmp = NULL, *chunk = NULL;
 	INDEX_ROOT *ir;
 	INDEX_ENTRY *ie;
-	INDEX_ALLOCATION *ia = NULL;
 	// - cod (FIX FOR UNION ATTRIBUTE!)
 	index_union iu;
 
-	int rc, ir_pos, bmp_buf_size, bmp_buf_pos, eo;
+	int rc, ir_pos, eo;
 	u32 index_block_size;
 	u8 index_block_size_bits, index_vcn_size_bits;
 
 	ntfs_log_trace("Entering.\n");
 
-	if (!dir_ni || !pos || !filldir) {
+	if (!dir_ni || !pos) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -1156,18 +1569,31 @@ int ntfs_readdir(ntfs_inode *dir_ni, s64 *pos,
 	ntfs_log_trace("Entering for inode %l, *pos 0x%lx.\n",
 			(unsigned long long)dir_ni->mft_no, (long long)*pos);
 
+	/* Drop what the cursor holds if the index changed since. */
+	if (cur && cur->valid && (cur->index_gen != ntfs_index_gen ||
+			cur->layout_gen != ntfs_attr_layout_gen))
+		ntfs_dir_cursor_drop(cur);
+
 	/* Open the index allocation attribute. */
-	ia_na = ntfs_attr_open(dir_ni, AT_INDEX_ALLOCATION, NTFS_INDEX_I30, 4);
-	if (!ia_na) {
-		if (errno != ENOENT) {
+	if (cur && cur->valid)
+		ia_na = cur->ia_na;
+	else {
+		ia_na = ntfs_attr_open(dir_ni, AT_INDEX_ALLOCATION,
+				NTFS_INDEX_I30, 4);
+		if (!ia_na && errno != ENOENT) {
 			ntfs_log_perror("Failed to open index allocation attribute. "
 				"Directory inode %l is corrupt or bug",
 				(unsigned long long)dir_ni->mft_no);
 			return -1;
 		}
-		i_size = 0;
-	} else
-		i_size = ia_na->data_size;
+		if (cur) {
+			cur->ia_na = ia_na;
+			cur->index_gen = ntfs_index_gen;
+			cur->layout_gen = ntfs_attr_layout_gen;
+			cur->valid = TRUE;
+		}
+	}
+	i_size = ia_na ? ia_na->data_size : 0;
 
 	rc = 0;
 
@@ -1177,27 +1603,34 @@ int ntfs_readdir(ntfs_inode *dir_ni, s64 *pos,
 
 	/* Emulate . and .. for all directories. */
 	if (!*pos) {
-		rc = filldir(dirent, dotdot, 1, FILE_NAME_POSIX, *pos,
-				MK_MREF(dir_ni->mft_no,
-				le16_to_cpu(dir_ni->mrec->sequence_number)),
-				NTFS_DT_DIR);
-		if (rc)
-			goto err_out;
+		if (names)
+			ntfs_dir_names_start(names, dir_ni,
+					i_size + vol->mft_record_size);
+		if (filldir) {
+			rc = filldir(dirent, dotdot, 1, FILE_NAME_POSIX, *pos,
+					MK_MREF(dir_ni->mft_no,
+					le16_to_cpu(dir_ni->mrec->sequence_number)),
+					NTFS_DT_DIR);
+			if (rc)
+				goto stop_out;
+		}
 		++*pos;
 	}
 	if (*pos == 1) {
 		MFT_REF parent_mref;
 
-		parent_mref = ntfs_mft_get_parent_ref(dir_ni);
-		if (parent_mref == ERR_MREF(-1)) {
-			ntfs_log_perror("Parent directory not found");
-			goto dir_err_out;
-		}
+		if (filldir) {
+			parent_mref = ntfs_mft_get_parent_ref(dir_ni);
+			if (parent_mref == ERR_MREF(-1)) {
+				ntfs_log_perror("Parent directory not found");
+				goto dir_err_out;
+			}
 
-		rc = filldir(dirent, dotdot, 2, FILE_NAME_POSIX, *pos,
-				parent_mref, NTFS_DT_DIR);
-		if (rc)
-			goto err_out;
+			rc = filldir(dirent, dotdot, 2, FILE_NAME_POSIX, *pos,
+					parent_mref, NTFS_DT_DIR);
+			if (rc)
+				goto stop_out;
+		}
 		++*pos;
 	}
 
@@ -1276,13 +1709,17 @@ int ntfs_readdir(ntfs_inode *dir_ni, s64 *pos,
 		
 		// fix (index_union *) ir modified in iu.ir = ir; (index_union *) &iu
 		iu.ir = ir;
-		rc = ntfs_filldir(dir_ni, pos, index_vcn_size_bits,
-				INDEX_TYPE_ROOT, (index_union *) &iu, ie, dirent, filldir);
+		if (filldir)
+			rc = ntfs_filldir(dir_ni, pos, index_vcn_size_bits,
+					INDEX_TYPE_ROOT, (index_union *) &iu, ie,
+					dirent, filldir);
 		if (rc) {
 			ntfs_attr_put_search_ctx(ctx);
 			ctx = NULL;
-			goto err_out;
+			goto stop_out;
 		}
+		if (names && names->active)
+			ntfs_dir_names_add(names, vol, &ie->key.file_name);
 	}
 	ntfs_attr_put_search_ctx(ctx);
 	ctx = NULL;
@@ -1299,15 +1736,16 @@ skip_index_root:
 	if (!ia_na)
 		goto done;
 
-	/* Allocate a buffer for the current index block. */
-	ia = (INDEX_ALLOCATION *) ntfs_malloc(index_block_size);
-	if (!ia)
-		goto err_out;
-
-	bmp_na = ntfs_attr_open(dir_ni, AT_BITMAP, NTFS_INDEX_I30, 4);
-	if (!bmp_na) {
-		ntfs_log_perror("Failed to open index bitmap attribute");
-		goto dir_err_out;
+	if (cur && cur->bmp_na)
+		bmp_na = cur->bmp_na;
+	else {
+		bmp_na = ntfs_attr_open(dir_ni, AT_BITMAP, NTFS_INDEX_I30, 4);
+		if (!bmp_na) {
+			ntfs_log_perror("Failed to open index bitmap attribute");
+			goto dir_err_out;
+		}
+		if (cur)
+			cur->bmp_na = bmp_na;
 	}
 
 	/* Get the offset into the index allocation attribute. */
@@ -1320,144 +1758,130 @@ skip_index_root:
 		goto dir_err_out;
 	}
 
-	bmp_buf_size = min(bmp_na->data_size - (bmp_pos >> 3), 4096);
-	bmp = (u8 *) ntfs_malloc(bmp_buf_size);
-	if (!bmp)
-		goto err_out;
-
-	br = ntfs_attr_pread(bmp_na, bmp_pos >> 3, bmp_buf_size, bmp);
-	if (br != bmp_buf_size) {
-		if (br != -1)
-			errno = EIO;
-		ntfs_log_perror("Failed to read from index bitmap attribute");
-		goto err_out;
-	}
-
-	bmp_buf_pos = 0;
-	/* If the index block is not in use find the next one that is. */
-	while (!(bmp[bmp_buf_pos >> 3] & (1 << (bmp_buf_pos & 7)))) {
-find_next_index_buffer:
-		bmp_pos++;
-		bmp_buf_pos++;
-		/* If we have reached the end of the bitmap, we are done. */
-		if (bmp_pos >> 3 >= bmp_na->data_size)
-			goto EOD;
-		ia_pos = bmp_pos << index_block_size_bits;
-		if (bmp_buf_pos >> 3 < bmp_buf_size)
-			continue;
-		/* Read next chunk from the index bitmap. */
-		bmp_buf_pos = 0;
-		if ((bmp_pos >> 3) + bmp_buf_size > bmp_na->data_size)
-			bmp_buf_size = bmp_na->data_size - (bmp_pos >> 3);
-		br = ntfs_attr_pread(bmp_na, bmp_pos >> 3, bmp_buf_size, bmp);
-		if (br != bmp_buf_size) {
+	/*
+	 * Read the whole bitmap once, padded to a word so that it can be
+	 * scanned a word at a time.
+	 */
+	bmp_bits = bmp_na->data_size << 3;
+	if (cur && cur->bmp)
+		bmp = cur->bmp;
+	else {
+		bmp = (u8 *) ntfs_calloc((bmp_na->data_size + 7) & ~7);
+		if (!bmp)
+			goto err_out;
+		if (cur)
+			cur->bmp = bmp;
+		br = ntfs_attr_pread(bmp_na, 0, bmp_na->data_size, bmp);
+		if (br != bmp_na->data_size) {
 			if (br != -1)
 				errno = EIO;
-			ntfs_log_perror("Failed to read from index bitmap attribute");
+			ntfs_log_perror("Failed to read from index bitmap "
+					"attribute");
 			goto err_out;
 		}
 	}
 
-	ntfs_log_debug("Handling index block 0x%lx.\n", (long long)bmp_pos);
-	
-	/* Read the index block starting at bmp_pos. */
-	br = ntfs_attr_mst_pread(ia_na, bmp_pos << index_block_size_bits, 1,
-			index_block_size, ia);
-	if (br != 1) {
-		if (br != -1)
-			errno = EIO;
-		ntfs_log_perror("Failed to read index block");
-		goto err_out;
-	}
-
-	ia_start = ia_pos & ~(s64)(index_block_size - 1);
-	if (sle64_to_cpu(ia->index_block_vcn) != ia_start >>
-			index_vcn_size_bits) {
-		ntfs_log_error("Actual VCN (0x%lx) of index buffer is different "
-				"from expected VCN (0x%lx) in inode 0x%lx.\n",
-				(long long)sle64_to_cpu(ia->index_block_vcn),
-				(long long)ia_start >> index_vcn_size_bits,
-				(unsigned long long)dir_ni->mft_no);
-		goto dir_err_out;
-	}
-	if (le32_to_cpu(ia->index.allocated_size) + 0x18 != index_block_size) {
-		ntfs_log_error("Index buffer (VCN 0x%lx) of directory inode %l "
-				"has a size (%u) differing from the directory "
-				"specified size (%u).\n", (long long)ia_start >>
-				index_vcn_size_bits,
-				(unsigned long long)dir_ni->mft_no,
-				(unsigned) le32_to_cpu(ia->index.allocated_size)
-				+ 0x18, (unsigned)index_block_size);
-		goto dir_err_out;
-	}
-	index_end = (u8*)&ia->index + le32_to_cpu(ia->index.index_length);
-	if (index_end > (u8*)ia + index_block_size) {
-		ntfs_log_error("Size of index buffer (VCN 0x%lx) of directory inode "
-				"%l exceeds maximum size.\n",
-				(long long)ia_start >> index_vcn_size_bits,
-				(unsigned long long)dir_ni->mft_no);
-		goto dir_err_out;
-	}
-	/* The first index entry. */
-	ie = (INDEX_ENTRY*)((u8*)&ia->index +
-			le32_to_cpu(ia->index.entries_offset));
 	/*
-	 * Loop until we exceed valid memory (corruption case) or until we
-	 * reach the last entry or until ntfs_filldir tells us it has had
-	 * enough or signals an error (both covered by the rc test).
+	 * The in-use index blocks are read in runs of consecutive blocks, up
+	 * to NTFS_READDIR_CHUNK bytes at a time, into one buffer.
 	 */
-	for (;; ie = (INDEX_ENTRY*)((u8*)ie + le16_to_cpu(ie->length))) {
-		ntfs_log_debug("In index allocation, offset 0x%lx.\n",
-				(long long)ia_start + ((u8*)ie - (u8*)ia));
-		/* Bounds checks. */
-		if ((u8*)ie < (u8*)ia || (u8*)ie +
-				sizeof(INDEX_ENTRY_HEADER) > index_end ||
-				(u8*)ie + le16_to_cpu(ie->key_length) >
-				index_end) {
-			ntfs_log_error("Index entry out of bounds in directory inode "
-				"%l.\n", (unsigned long long)dir_ni->mft_no);
-			goto dir_err_out;
-		}
-		/* The last entry cannot contain a name. */
-		if (ie->ie_flags & INDEX_ENTRY_END)
-			break;
-		
-		if (!le16_to_cpu(ie->length))
-		{
-			goto dir_err_out;
+	chunk_blocks = NTFS_READDIR_CHUNK >> index_block_size_bits;
+	if (chunk_blocks < 1)
+		chunk_blocks = 1;
+	if (chunk_blocks > i_size >> index_block_size_bits)
+		chunk_blocks = max(i_size >> index_block_size_bits, 1);
+	if (cur && cur->chunk)
+		chunk = cur->chunk;
+	else {
+		chunk = (u8 *) ntfs_malloc(chunk_blocks << index_block_size_bits);
+		if (!chunk)
+			goto err_out;
+		if (cur)
+			cur->chunk = chunk;
+	}
+
+	for (;;) {
+		bmp_pos = ntfs_bmp_next_set(bmp, bmp_bits, bmp_pos);
+		/* If we have reached the end of the bitmap, we are done. */
+		if (bmp_pos >= bmp_bits)
+			goto EOD;
+		if (ia_pos < bmp_pos << index_block_size_bits)
+			ia_pos = bmp_pos << index_block_size_bits;
+		/* A cursor may still hold the block from its last call. */
+		if (cur && bmp_pos >= cur->chunk_first &&
+				bmp_pos < cur->chunk_first + cur->chunk_count) {
+			first = cur->chunk_first;
+			ia_blocks = cur->chunk_count;
+			goto parse_chunk;
 		}
-		
-		/* Skip index entry if continuing previous readdir. */
-		if (ia_pos - ia_start > (u8*)ie - (u8*)ia)
-			continue;
 		/*
-		 * Submit the directory entry to ntfs_filldir(), which will
-		 * invoke the filldir() callback as appropriate.
+		 * Extend the read over the following in-use blocks, but not
+		 * past the end of the run holding the first one, so that
+		 * every read is a single sequential device request.
 		 */
-		
-		// fix (index_union *) ir modified in iu.ia = ia; (index_union *) &iu
-		iu.ia = ia;
-
-		rc = ntfs_filldir(dir_ni, pos, index_vcn_size_bits,
-				INDEX_TYPE_ALLOCATION, (index_union *) &iu, ie, dirent, filldir);
-		if (rc)
-		{
+		ia_blocks = 1;
+		rl = ntfs_attr_find_vcn(ia_na, (bmp_pos << index_block_size_bits)
+				>> vol->cluster_size_bits);
+		if (rl) {
+			run_end = (rl->vcn + rl->length) << vol->cluster_size_bits;
+			run_end = (run_end + index_block_size - 1) >>
+					index_block_size_bits;
+		} else
+			run_end = bmp_pos + 1;
+		while (ia_blocks < chunk_blocks && bmp_pos + ia_blocks < run_end &&
+				bmp_pos + ia_blocks < bmp_bits &&
+				(bmp[(bmp_pos + ia_blocks) >> 3] &
+				(1 << ((bmp_pos + ia_blocks) & 7))))
+			ia_blocks++;
+
+		ntfs_log_debug("Handling index blocks 0x%lx-0x%lx.\n",
+				(long long)bmp_pos,
+				(long long)bmp_pos + ia_blocks - 1);
+
+		br = ntfs_attr_mst_pread(ia_na, bmp_pos << index_block_size_bits,
+				ia_blocks, index_block_size, chunk);
+		if (br <= 0) {
+			if (br != -1)
+				errno = EIO;
+			ntfs_log_perror("Failed to read index block");
 			goto err_out;
 		}
+		NVolStatAdd(vol, index_blocks, br);
+		ia_blocks = br;
+		first = bmp_pos;
+		if (cur) {
+			cur->chunk_first = first;
+			cur->chunk_count = ia_blocks;
+		}
+parse_chunk:
+		rc = ntfs_readdir_chunk(dir_ni, pos, dirent, filldir, names,
+				chunk, first, ia_blocks, ia_pos,
+				index_block_size, index_vcn_size_bits);
+		if (rc)
+			goto stop_out;
+		bmp_pos = first + ia_blocks;
 	}
-	goto find_next_index_buffer;
 EOD:
 	/* We are finished, set *pos to EOD. */
 	*pos = i_size + vol->mft_record_size;
+	if (names)
+		ntfs_dir_names_end(names, dir_ni);
 done:
-	free(ia);
-	free(bmp);
-	if (bmp_na)
-		ntfs_attr_close(bmp_na);
-	if (ia_na)
-		ntfs_attr_close(ia_na);
+	if (!cur) {
+		free(chunk);
+		free(bmp);
+		if (bmp_na)
+			ntfs_attr_close(bmp_na);
+		if (ia_na)
+			ntfs_attr_close(ia_na);
+	}
 	ntfs_log_debug("EOD, *pos 0x%lx, returning 0.\n", (long long)*pos);
 	return 0;
+stop_out:
+	/* A cursor keeps its state for the next call. */
+	if (cur && rc > 0)
+		return 1;
+	goto err_out;
 dir_err_out:
 	errno = EIO;
 err_out:
@@ -1465,16 +1889,158 @@ err_out:
 	ntfs_log_trace("failed.\n");
 	if (ctx)
 		ntfs_attr_put_search_ctx(ctx);
-	free(ia);
-	free(bmp);
-	if (bmp_na)
-		ntfs_attr_close(bmp_na);
-	if (ia_na)
-		ntfs_attr_close(ia_na);
+	if (names)
+		ntfs_dir_names_free(names);
+	if (cur)
+		ntfs_dir_cursor_drop(cur);
+	else {
+		free(chunk);
+		free(bmp);
+		if (bmp_na)
+			ntfs_attr_close(bmp_na);
+		if (ia_na)
+			ntfs_attr_close(ia_na);
+	}
 	errno = eo;
 	return -1;
 }
 
+/**
+ * ntfs_readdir - read the contents of an ntfs directory
+ * @dir_ni:	ntfs inode of current directory
+ * @pos:	current position in directory
+ * @dirent:	context for filldir callback supplied by the caller
+ * @filldir:	filldir callback supplied by the caller
+ *
+ * Parse the index root and the index blocks that are marked in use in the
+ * index bitmap and hand each found directory entry to the @filldir callback
+ * supplied by the caller.
+ *
+ * The bitmap is read once per call, and consecutive in-use index blocks are
+ * read together, up to NTFS_READDIR_CHUNK bytes and within one run of the
+ * index allocation, so that a large directory is listed with few, large
+ * sequential reads. A listing from the start to the end also builds the name
+ * filter of the directory (see ntfs_inode_lookup_by_name()).
+ *
+ * Return 0 on success or -1 on error with errno set to the error code.
+ *
+ * Note: Index blocks are parsed in ascending vcn order, from which follows
+ * that the directory entries are not returned sorted.
+ */
+int ntfs_readdir(ntfs_inode *dir_ni, s64 *pos,
+		void *dirent, ntfs_filldir_t filldir)
+{
+	ntfs_dir_names names;
+	int ret;
+
+	if (!filldir) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(&names, 0, sizeof(names));
+	ret = ntfs_readdir_i(dir_ni, pos, dirent, filldir, NULL, &names);
+	ntfs_dir_names_free(&names);
+	return ret;
+}
+
+/*
+ *		Release what a directory cursor holds, keeping its position
+ */
+
+static void ntfs_dir_cursor_drop(ntfs_dir_cursor *cur)
+{
+	free(cur->chunk);
+	free(cur->bmp);
+	if (cur->bmp_na)
+		ntfs_attr_close(cur->bmp_na);
+	if (cur->ia_na)
+		ntfs_attr_close(cur->ia_na);
+	cur->chunk = NULL;
+	cur->bmp = NULL;
+	cur->bmp_na = NULL;
+	cur->ia_na = NULL;
+	cur->chunk_first = cur->chunk_count = 0;
+	cur->valid = FALSE;
+}
+
+/**
+ * ntfs_dir_cursor_open - start listing a directory through a cursor
+ * @dir_ni:	ntfs inode of the directory, which must stay open
+ *
+ * Return a cursor at the start of the directory @dir_ni, or NULL on error
+ * with errno set.
+ */
+ntfs_dir_cursor *ntfs_dir_cursor_open(ntfs_inode *dir_ni)
+{
+	ntfs_dir_cursor *cur;
+
+	if (!dir_ni) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (!(dir_ni->mrec->flags & MFT_RECORD_IS_DIRECTORY)) {
+		errno = ENOTDIR;
+		return NULL;
+	}
+	cur = (ntfs_dir_cursor *) ntfs_calloc(sizeof(ntfs_dir_cursor));
+	if (cur)
+		cur->dir_ni = dir_ni;
+	return cur;
+}
+
+/**
+ * ntfs_dir_cursor_read - hand the next directory entries to a callback
+ * @cur:	directory cursor
+ * @dirent:	context for filldir callback supplied by the caller
+ * @filldir:	filldir callback supplied by the caller
+ *
+ * Like ntfs_readdir() from the position of @cur, except that a positive
+ * return from @filldir means the caller has taken enough for now: that
+ * entry is not consumed and is the first one handed out by the next call.
+ * Between calls the cursor keeps the index allocation and bitmap attributes
+ * open, the bitmap, and the last index blocks read and fixed up, so that a
+ * large directory can be streamed a few entries at a time. All of it is
+ * dropped and read again if an index or an mft record of the volume has
+ * been changed in the meantime.
+ *
+ * Return 1 if @filldir stopped the listing, 0 at the end of the directory,
+ * or -1 on error with errno set.
+ */
+int ntfs_dir_cursor_read(ntfs_dir_cursor *cur, void *dirent,
+		ntfs_filldir_t filldir)
+{
+	if (!cur || !filldir) {
+		errno = EINVAL;
+		return -1;
+	}
+	return ntfs_readdir_i(cur->dir_ni, &cur->pos, dirent, filldir, cur,
+			&cur->names);
+}
+
+/**
+ * ntfs_dir_cursor_rewind - move a directory cursor back to the start
+ * @cur:	directory cursor
+ */
+void ntfs_dir_cursor_rewind(ntfs_dir_cursor *cur)
+{
+	cur->pos = 0;
+}
+
+/**
+ * ntfs_dir_cursor_close - release a directory cursor
+ * @cur:	directory cursor, may be NULL
+ *
+ * The directory inode is left open.
+ */
+void ntfs_dir_cursor_close(ntfs_dir_cursor *cur)
+{
+	if (cur) {
+		ntfs_dir_cursor_drop(cur);
+		ntfs_dir_names_free(&cur->names);
+		free(cur);
+	}
+}
+
 
 /**
  * __ntfs_create - create object on ntfs volume
@@ -108,6 +108,43 @@ typedef int (*ntfs_filldir_t)(void *dirent, const ntfschar *name,
 extern int ntfs_readdir(ntfs_inode *dir_ni, s64 *pos,
 		void *dirent, ntfs_filldir_t filldir);
 
+/*
+ * Name filter being filled by a listing which started at the beginning of
+ * the directory, entered into cache when the listing reaches the end.
+ */
+typedef struct {
+	u8 *bits;		/* Filter, sized from the index at the start. */
+	u32 size;		/* Bytes in @bits, a power of two. */
+	u32 index_gen;		/* ntfs_index_gen when the listing started. */
+	BOOL active;		/* The names are being collected. */
+} ntfs_dir_names;
+
+/*
+ * A position in a directory, with what ntfs_readdir() would otherwise
+ * reopen and read again on every call (see ntfs_dir_cursor_read()).
+ */
+typedef struct {
+	ntfs_inode *dir_ni;	/* Directory listed, owned by the caller. */
+	s64 pos;		/* Next position, as *pos of ntfs_readdir(). */
+	BOOL valid;		/* The fields below have been set up. */
+	u32 index_gen;		/* ntfs_index_gen when set up. */
+	u32 layout_gen;		/* ntfs_attr_layout_gen when set up. */
+	ntfs_attr *ia_na;	/* $INDEX_ALLOCATION, NULL if the index has
+				   only a root. */
+	ntfs_attr *bmp_na;	/* $BITMAP of the index. */
+	u8 *bmp;		/* Whole bitmap, padded to a word. */
+	u8 *chunk;		/* Index blocks last read, fixed up. */
+	s64 chunk_first;	/* First block held in @chunk. */
+	s64 chunk_count;	/* Number of blocks held in @chunk. */
+	ntfs_dir_names names;	/* Names met since the start. */
+} ntfs_dir_cursor;
+
+extern ntfs_dir_cursor *ntfs_dir_cursor_open(ntfs_inode *dir_ni);
+extern int ntfs_dir_cursor_read(ntfs_dir_cursor *cur, void *dirent,
+		ntfs_filldir_t filldir);
+extern void ntfs_dir_cursor_rewind(ntfs_dir_cursor *cur);
+extern void ntfs_dir_cursor_close(ntfs_dir_cursor *cur);
+
 ntfs_inode *ntfs_dir_parent_inode(ntfs_inode *ni);
 
 int ntfs_get_ntfs_dos_name(ntfs_inode *ni, ntfs_inode *dir_ni,
@@ -125,5 +162,13 @@ extern int ntfs_dir_lookup_hash(const struct CACHED_GENERIC *cached);
 
 #endif
 
+#if CACHE_DIRFILTER_SIZE
+
+struct CACHED_GENERIC;
+
+extern int ntfs_dir_filter_hash(const struct CACHED_GENERIC *cached);
+
+#endif
+
 #endif /* defined _NTFS_DIR_H */
 
@@ -0,0 +1,286 @@
+/**
+ * extmap.c - Extent map of attributes.
+ *
+ * ntfs_attr_pread() finds its way through the runlist on every call, and a
+ * caller reading a large file in small pieces pays that, and a device
+ * request per piece, again and again. The extent map hands the caller the
+ * runlist instead, as ranges of the data and where they lie on the device,
+ * so that a loader can issue its own large reads for the ranges stored as
+ * they are and leave the others (holes, compressed units, uninitialized
+ * tails) to ntfs_attr_pread(). The same map answers where the next data or
+ * the next hole is, so that a copier can skip the zeroes which
+ * ntfs_attr_pread() would otherwise fill in for it.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#include "types.h"
+#include "layout.h"
+#include "attrib.h"
+#include "runlist.h"
+#include "volume.h"
+#include "extmap.h"
+#include "logging.h"
+
+/* Extents looked at by one step of ext_seek(). */
+#define EXT_SEEK_BATCH	32
+
+/* Kinds of compression units, as ntfs_compressed_attr_pread() tells them. */
+enum {
+	EXT_UNIT_SPARSE,
+	EXT_UNIT_COMPRESSED,
+	EXT_UNIT_PLAIN,
+};
+
+/*
+ * Kind of the compression unit starting at @unit_vcn, @rl being the run
+ * holding a vcn of the unit. A unit whose first run is sparse is sparse,
+ * one allocated throughout is stored as it is, any other is compressed.
+ */
+static int ext_unit_kind(const ntfs_attr *na, const runlist_element *rl,
+		VCN unit_vcn)
+{
+	s64 left = na->compression_block_clusters;
+	VCN vcn = unit_vcn;
+
+	while (rl > na->rl && rl->vcn > unit_vcn)
+		rl--;
+	if (rl->lcn == LCN_HOLE)
+		return EXT_UNIT_SPARSE;
+	while (left > 0) {
+		if (!rl->length || rl->lcn < 0)
+			return EXT_UNIT_COMPRESSED;
+		left -= rl->vcn + rl->length - vcn;
+		vcn = rl->vcn + rl->length;
+		rl++;
+	}
+	return EXT_UNIT_PLAIN;
+}
+
+/*
+ * Append a range to @ext, or extend the last one when the range follows
+ * it on the device with the same flags. Return FALSE if @ext is full.
+ */
+static BOOL ext_add(ntfs_extent *ext, int *n, int count, s64 offset,
+		s64 length, s64 pos, u32 flags)
+{
+	ntfs_extent *last = *n ? &ext[*n - 1] : NULL;
+
+	if (last && last->flags == flags &&
+	    last->offset + last->length == offset &&
+	    (pos < 0 ? last->pos < 0 : last->pos + last->length == pos)) {
+		last->length += length;
+		return TRUE;
+	}
+	if (*n == count)
+		return FALSE;
+	last = &ext[(*n)++];
+	last->offset = offset;
+	last->length = length;
+	last->pos = pos;
+	last->flags = flags;
+	return TRUE;
+}
+
+/**
+ * ntfs_attr_get_extents - describe where the data of an attribute lies
+ * @na:		opened attribute
+ * @offset:	byte offset in the attribute of the first range wanted
+ * @extents:	destination of the ranges
+ * @count:	number of entries in @extents
+ *
+ * Fill @extents with the ranges of the data of @na from @offset on, in
+ * order and without gaps, as many as fit. The first range starts at
+ * @offset, the next call usually starts where the last range returned
+ * ends. Ranges stored as they are end at the end of the data, so the last
+ * cluster of one may hold bytes past it; ranges are never longer than the
+ * data. The whole runlist is mapped on the first call.
+ *
+ * Compression units stored as they are count as plain data, sparse ones
+ * as holes and the others as NTFS_EXTENT_COMPRESSED, whole, although a
+ * range may start within such a unit when @offset does.
+ *
+ * Return the number of ranges stored, 0 if @offset is at or past the end of
+ * the data, or -1 on error with errno set, to EIO if the runlist does not
+ * cover the data.
+ */
+int ntfs_attr_get_extents(ntfs_attr *na, s64 offset, ntfs_extent *extents,
+		int count)
+{
+	runlist_element *rl;
+	s64 end, init, next, pos, unit_end;
+	u32 base, flags;
+	VCN vcn, unit_vcn;
+	u8 bits;
+	int n = 0;
+
+	if (!na || offset < 0 || !extents || count <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	end = na->data_size;
+	if (offset >= end)
+		return 0;
+	base = (na->data_flags & ATTR_IS_ENCRYPTED) ?
+			NTFS_EXTENT_ENCRYPTED : 0;
+	if (!NAttrNonResident(na)) {
+		ext_add(extents, &n, count, offset, end - offset, -1,
+				base | NTFS_EXTENT_RESIDENT | NTFS_EXTENT_LAST);
+		return n;
+	}
+	if (ntfs_attr_map_whole_runlist(na))
+		return -1;
+
+	bits = na->ni->vol->cluster_size_bits;
+	init = na->initialized_size < end ? na->initialized_size : end;
+	rl = NULL;
+	while (offset < end) {
+		if (offset >= init) {
+			next = end;
+			pos = -1;
+			flags = base | NTFS_EXTENT_UNINIT;
+			goto add;
+		}
+		vcn = offset >> bits;
+		/* Find the run holding @offset, then follow the runs. */
+		if (!rl)
+			rl = ntfs_attr_find_vcn(na, vcn);
+		else
+			while (rl->length && vcn >= rl->vcn + rl->length)
+				rl++;
+		if (!rl || !rl->length || vcn < rl->vcn ||
+		    (rl->lcn < 0 && rl->lcn != LCN_HOLE)) {
+			ntfs_log_error("Runlist of inode %lld does not cover "
+					"its data.\n",
+					(long long)na->ni->mft_no);
+			errno = EIO;
+			return -1;
+		}
+		next = (rl->vcn + rl->length) << bits;
+		if (rl->lcn == LCN_HOLE) {
+			pos = -1;
+			flags = base | NTFS_EXTENT_HOLE;
+		} else {
+			pos = (rl->lcn << bits) + offset - (rl->vcn << bits);
+			flags = base;
+		}
+		if ((na->data_flags & ATTR_COMPRESSION_MASK) &&
+		    na->compression_block_clusters) {
+			unit_vcn = vcn & ~(VCN)(na->compression_block_clusters
+					- 1);
+			unit_end = (unit_vcn + na->compression_block_clusters)
+					<< bits;
+			switch (ext_unit_kind(na, rl, unit_vcn)) {
+			case EXT_UNIT_COMPRESSED:
+				next = unit_end;
+				pos = -1;
+				flags = base | NTFS_EXTENT_COMPRESSED;
+				break;
+			case EXT_UNIT_SPARSE:
+				pos = -1;
+				flags = base | NTFS_EXTENT_HOLE;
+				/* fall through */
+			default:
+				if (next > unit_end)
+					next = unit_end;
+				break;
+			}
+		}
+		if (next > init)
+			next = init;
+add:
+		if (!ext_add(extents, &n, count, offset, next - offset, pos,
+				flags))
+			return n;
+		offset = next;
+	}
+	extents[n - 1].flags |= NTFS_EXTENT_LAST;
+	return n;
+}
+
+/*
+ * Offset of the first byte at or after @offset which is in a hole (@hole)
+ * or holds data (!@hole), ranges past the initialized size counting as
+ * holes.
+ */
+static s64 ext_seek(ntfs_attr *na, s64 offset, BOOL hole)
+{
+	ntfs_extent ext[EXT_SEEK_BATCH];
+	BOOL found = FALSE;
+	int i, n;
+
+	if (!na || offset < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	while ((n = ntfs_attr_get_extents(na, offset, ext,
+			EXT_SEEK_BATCH)) > 0) {
+		found = TRUE;
+		for (i = 0; i < n; i++)
+			if (!(ext[i].flags & (NTFS_EXTENT_HOLE |
+					NTFS_EXTENT_UNINIT)) == !hole)
+				return ext[i].offset;
+		offset = ext[n - 1].offset + ext[n - 1].length;
+	}
+	if (n < 0)
+		return -1;
+	/* The end of the data is where the last hole starts. */
+	if (hole && found)
+		return na->data_size;
+	errno = ENXIO;
+	return -1;
+}
+
+/**
+ * ntfs_attr_seek_data - find the next data of an attribute
+ * @na:		opened attribute
+ * @offset:	byte offset in the attribute to search from
+ *
+ * The lseek() SEEK_DATA of the attribute: sparse ranges and those past the
+ * initialized size are holes, everything else, compressed units included,
+ * is data.
+ *
+ * Return the offset of the first byte of data at or after @offset, or -1
+ * with errno set, to ENXIO if there is no data from @offset to the end.
+ */
+s64 ntfs_attr_seek_data(ntfs_attr *na, s64 offset)
+{
+	return ext_seek(na, offset, FALSE);
+}
+
+/**
+ * ntfs_attr_seek_hole - find the next hole of an attribute
+ * @na:		opened attribute
+ * @offset:	byte offset in the attribute to search from
+ *
+ * The lseek() SEEK_HOLE of the attribute, see ntfs_attr_seek_data(). The
+ * end of the data counts as a hole.
+ *
+ * Return the offset of the first byte of a hole at or after @offset, or -1
+ * with errno set, to ENXIO if @offset is at or past the end of the data.
+ */
+s64 ntfs_attr_seek_hole(ntfs_attr *na, s64 offset)
+{
+	return ext_seek(na, offset, TRUE);
+}
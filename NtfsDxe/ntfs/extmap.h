@@ -0,0 +1,65 @@
+/*
+ * extmap.h - Exports for the extent map of attributes.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NTFS_EXTMAP_H
+#define _NTFS_EXTMAP_H
+
+#include "types.h"
+#include "attrib.h"
+
+/* ntfs_extent flags. */
+#define NTFS_EXTENT_HOLE	0x0001	/* Sparse, reads as zeroes. */
+#define NTFS_EXTENT_UNINIT	0x0002	/* Past the initialized size, reads
+					   as zeroes. */
+#define NTFS_EXTENT_COMPRESSED	0x0004	/* In a compression unit stored
+					   compressed. */
+#define NTFS_EXTENT_RESIDENT	0x0008	/* Held in the mft record. */
+#define NTFS_EXTENT_ENCRYPTED	0x0010	/* Stored encrypted. */
+#define NTFS_EXTENT_LAST	0x0100	/* Ends at the end of the data. */
+
+/* Extents whose data cannot be read from the device as it is. */
+#define NTFS_EXTENT_NOT_DIRECT	(NTFS_EXTENT_HOLE | NTFS_EXTENT_UNINIT | \
+				 NTFS_EXTENT_COMPRESSED | \
+				 NTFS_EXTENT_RESIDENT | NTFS_EXTENT_ENCRYPTED)
+
+/**
+ * struct ntfs_extent - a range of an attribute and where its data lies
+ * @offset:	byte offset of the range in the attribute
+ * @length:	bytes in the range
+ * @pos:	byte offset of the data on the device, or -1 if the range
+ *		has no data of its own there (hole, uninitialized, resident
+ *		or compressed)
+ * @flags:	NTFS_EXTENT_*
+ *
+ * A range without any NTFS_EXTENT_NOT_DIRECT flag reads as the @length
+ * bytes of the device at @pos.
+ */
+typedef struct {
+	s64 offset;
+	s64 length;
+	s64 pos;
+	u32 flags;
+} ntfs_extent;
+
+extern int ntfs_attr_get_extents(ntfs_attr *na, s64 offset,
+		ntfs_extent *extents, int count);
+extern s64 ntfs_attr_seek_data(ntfs_attr *na, s64 offset);
+extern s64 ntfs_attr_seek_hole(ntfs_attr *na, s64 offset);
+
+#endif /* defined _NTFS_EXTMAP_H */
@@ -48,6 +48,14 @@
 #include "reparse.h"
 #include "misc.h"
 
+/*
+ * Bumped whenever an index entry is added or removed and whenever an index
+ * block or an index bitmap is written, so that readers holding decoded
+ * index blocks (ntfs_dir_cursor) or the names of a directory (its name
+ * filter) know to drop them.
+ */
+u32 ntfs_index_gen = 1;
+
 /**
  * ntfs_index_entry_mark_dirty - mark an index entry dirty
  * @ictx:	ntfs index context describing the index entry
@@ -86,6 +94,7 @@ static int ntfs_ib_write(ntfs_index_context *icx, INDEX_BLOCK *ib)
 	
 	ntfs_log_trace("vcn: %l\n", (long long)vcn);
 	
+	ntfs_index_gen++;
 	ret = ntfs_attr_mst_pwrite(icx->ia_na, ntfs_ib_vcn_to_pos(icx, vcn),
 				   1, icx->block_size, ib);
 	if (ret != 1) {
@@ -604,6 +613,7 @@ static int ntfs_ib_read(ntfs_index_context *icx, VCN vcn, INDEX_BLOCK *dst)
 				       "%l\n", (long long)pos);
 		return -1;
 	}
+	NVolStatAdd(icx->ia_na->ni->vol, index_blocks, 1);
 	
 	if (ntfs_ia_check(icx, dst, vcn))
 		return -1;
@@ -926,6 +936,7 @@ static int ntfs_ibm_modify(ntfs_index_context *icx, VCN vcn, int set)
 	else
 		byte &= ~bit;
 		
+	ntfs_index_gen++;
 	if (ntfs_attr_pwrite(na, bpos, 1, &byte) != 1) {
 		ntfs_log_perror("Failed to write $Bitmap");
 		goto err_na;
@@ -1500,6 +1511,7 @@ int ntfs_ie_add(ntfs_index_context *icx, INDEX_ENTRY *ie)
 		ntfs_index_ctx_reinit(icx);
 	}
 	
+	ntfs_index_gen++;
 	ntfs_ie_insert(ih, ie, icx->entry);
 	ntfs_index_entry_mark_dirty(icx);
 	
@@ -1815,6 +1827,7 @@ int ntfs_index_rm(ntfs_index_context *icx)
 	else
 		ih = &icx->ib->index;
 	
+	ntfs_index_gen++;
 	if (icx->entry->ie_flags & INDEX_ENTRY_NODE) {
 		
 		ret = ntfs_index_rm_node(icx);
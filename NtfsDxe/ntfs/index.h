@@ -133,6 +133,8 @@ typedef struct {
 	u8 vcn_size_bits;
 } ntfs_index_context;
 
+extern u32 ntfs_index_gen;
+
 extern ntfs_index_context *ntfs_index_ctx_get(ntfs_inode *ni,
 						ntfschar *name, u32 name_len);
 extern void ntfs_index_ctx_put(ntfs_index_context *ictx);
@@ -128,6 +128,7 @@ static void __ntfs_inode_release(ntfs_inode *ni)
 			       (long long)ni->mft_no);
 	if (NInoAttrList(ni) && ni->attr_list)
 		free(ni->attr_list);
+	ntfs_attrlist_index_free(ni);
 	free(ni->mrec);
 	free(ni);
 	return;
@@ -162,6 +163,7 @@ static ntfs_inode *ntfs_inode_real_open(ntfs_volume *vol, const MFT_REF mref)
 	ntfs_inode *ni = NULL;
 	ntfs_attr_search_ctx *ctx;
 	STANDARD_INFORMATION *std_info;
+	ntfs_io_tag tag;
 	le32 lthle;
 	int olderrno;
 
@@ -180,6 +182,8 @@ static ntfs_inode *ntfs_inode_real_open(ntfs_volume *vol, const MFT_REF mref)
 		goto err_out;
 	}
 	ni->mft_no = MREF(mref);
+	/* Index the attributes once for the lookups below and later ones. */
+	ntfs_attr_table_build(ni);
 	ctx = ntfs_attr_get_search_ctx(ni, NULL);
 	if (!ctx)
 		goto err_out;
@@ -237,7 +241,9 @@ static ntfs_inode *ntfs_inode_real_open(ntfs_volume *vol, const MFT_REF mref)
 	ni->attr_list = (u8*) ntfs_malloc(ni->attr_list_size);
 	if (!ni->attr_list)
 		goto put_err_out;
+	tag = ntfs_device_set_io_tag(vol->dev, NTFS_IO_MFT);
 	l = ntfs_get_attribute_value(vol, ctx->attr, ni->attr_list);
+	ntfs_device_set_io_tag(vol->dev, tag);
 	if (!l)
 		goto put_err_out;
 	if (l != ni->attr_list_size) {
@@ -1154,7 +1160,8 @@ int ntfs_inode_add_attrlist(ntfs_inode *ni)
 			ntfs_log_perror("Failed to realloc %d bytes", al_len);
 			goto put_err_out;
 		}
-		ale = (ATTR_LIST_ENTRY *)(aln + ((u8 *)ale - al));
+		/* The new entry goes at the end, @al may have moved. */
+		ale = (ATTR_LIST_ENTRY *)(aln + al_len - ale_size);
 		al = aln;
 		
 		memset(ale, 0, ale_size);
@@ -84,7 +84,8 @@ typedef enum {
 			       test_and_clear_nino_flag(ni, flag)
 
 #define NInoAttrListDirty(ni)			    test_nino_al_flag(ni, NI_AttrListDirty)
-#define NInoAttrListSetDirty(ni)		     set_nino_al_flag(ni, NI_AttrListDirty)
+#define NInoAttrListSetDirty(ni)	\
+		(ntfs_attrlist_gen++, set_nino_al_flag(ni, NI_AttrListDirty))
 #define NInoAttrListClearDirty(ni)		   clear_nino_al_flag(ni, NI_AttrListDirty)
 #define NInoAttrListTestAndSetDirty(ni)	    test_and_set_nino_al_flag(ni, NI_AttrListDirty)
 #define NInoAttrListTestAndClearDirty(ni) test_and_clear_nino_al_flag(ni, NI_AttrListDirty)
@@ -97,6 +98,32 @@ typedef enum {
 
 #define NInoFileNameTestAndClearDirty(ni)	test_and_clear_nino_flag(ni, NI_FileNameDirty)
 
+/*
+ * Bumped whenever an in-memory attribute list changes (which always marks it
+ * dirty), making every attribute list index stale (see attrlist.c).
+ */
+extern u32 ntfs_attrlist_gen;
+
+struct ntfs_attrlist_index;
+
+/* Most attributes of an mft record the attribute table can hold. */
+#define NTFS_ATTR_TABLE_SIZE	16
+
+/**
+ * struct ntfs_attr_entry - an attribute of an mft record, as indexed by the
+ * attribute table of its inode (see ntfs_attr_table_build())
+ */
+typedef struct {
+	ATTR_TYPES type;	/* Type of the attribute. */
+	u16 offset;		/* Offset of the attribute record in the mft
+				   record. */
+	u16 name_hash;		/* Hash of the name, 0 if unnamed. */
+	leMFT_REF mref;		/* Base or extent mft record holding the
+				   attribute, as attribute lists name it. */
+	le16 instance;		/* Instance of the attribute in that
+				   record. */
+} ntfs_attr_entry;
+
 /**
  * struct _ntfs_inode - The NTFS in-memory inode structure.
  *
@@ -118,6 +145,18 @@ struct _ntfs_inode {
 	 */
 	u32 attr_list_size;	/* Length of attribute list value in bytes. */
 	u8 *attr_list;		/* Attribute list value itself. */
+	struct ntfs_attrlist_index *attr_list_index; /* Sorted index of
+				   @attr_list, NULL until first needed. */
+	/*
+	 * Attribute table: the attributes of @mrec in record order, so that
+	 * lookups probe a compact array instead of walking the record. Only
+	 * valid while @attr_table_gen matches ntfs_attr_layout_gen.
+	 */
+	u32 attr_table_gen;	/* Layout generation of the table, 0 if
+				   none. */
+	u16 attr_table_end;	/* Offset of the AT_END marker. */
+	u16 attr_table_count;	/* Entries in @attr_table. */
+	ntfs_attr_entry attr_table[NTFS_ATTR_TABLE_SIZE];
 	/* Below fields are always valid. */
 	s32 nr_extents;		/* For a base mft record, the number of
 				   attached extent inodes (0 if none), for
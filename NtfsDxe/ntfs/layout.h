@@ -807,12 +807,12 @@ typedef struct {
 					s64	compressed_size;
 				};
 
-/*void *non_resident_end; /* [0]; */ /* Use offsetof(ATTR_RECORD,
+/* void *non_resident_end[0]; */ /* Use offsetof(ATTR_RECORD,
 						      non_resident_end) to get
 						      size of a non resident
 						      attribute. */
 /* sizeof(uncompressed attr) = 64*/
-/* 64*/			/*s64 compressed_size;	/* Byte size of the attribute
+/* 64*/			/* s64 compressed_size:	   Byte size of the attribute
 				value after compression. Only present when
 				compressed. Always is a multiple of the
 				cluster size. Represents the actual amount of
@@ -935,7 +935,7 @@ typedef struct {
 		struct {
 		/* 36 */ u8 reserved12[12];	/* Reserved/alignment to 8-byte
 						   boundary. */
-		/* 48  void *v1_end[0];	/* Marker for offsetof(). */
+		/* 48  void *v1_end[0];	   Marker for offsetof(). */
 		} /**/;
 /* sizeof() = 48 bytes */
 		/* NTFS 3.0 */
@@ -2242,6 +2242,101 @@ typedef struct {
 				   reparse point attribute. */
 }  REPARSE_INDEX_KEY;
 #pragma pack(pop)
+
+/**
+ * struct USN_JOURNAL_MAX - FILE_Extend/$UsnJrnl:$Max
+ *
+ * The change journal is kept in the named data attribute $J of
+ * FILE_Extend/$UsnJrnl, the named data attribute $Max describes it. A record
+ * of $J is found at the offset given by its usn. Windows frees the start of
+ * $J as the journal grows past its maximum size, leaving a sparse hole up to
+ * lowest_valid_usn.
+ */
+#pragma pack(push, 1)
+typedef struct {
+	sle64 maximum_size;	/* Size $J is kept at. */
+	sle64 allocation_delta;	/* Bytes freed or added at once. */
+	le64 journal_id;	/* Changes when the journal is recreated, so
+				   that usns of another journal are not
+				   mistaken for ones of this journal. */
+	sle64 lowest_valid_usn;	/* First usn still held in $J. */
+} USN_JOURNAL_MAX;
+#pragma pack(pop)
+
+/*
+ * USN_REASON_* - Changes recorded by a usn record (32-bit), in the reason
+ * field. Every record of a file accumulates the reasons of the changes made
+ * since the file was opened, until USN_REASON_CLOSE.
+ */
+#define	USN_REASON_DATA_OVERWRITE	const_cpu_to_le32(0x00000001)
+#define	USN_REASON_DATA_EXTEND		const_cpu_to_le32(0x00000002)
+#define	USN_REASON_DATA_TRUNCATION	const_cpu_to_le32(0x00000004)
+#define	USN_REASON_NAMED_DATA_OVERWRITE	const_cpu_to_le32(0x00000010)
+#define	USN_REASON_NAMED_DATA_EXTEND	const_cpu_to_le32(0x00000020)
+#define	USN_REASON_NAMED_DATA_TRUNCATION	const_cpu_to_le32(0x00000040)
+#define	USN_REASON_FILE_CREATE		const_cpu_to_le32(0x00000100)
+#define	USN_REASON_FILE_DELETE		const_cpu_to_le32(0x00000200)
+#define	USN_REASON_EA_CHANGE		const_cpu_to_le32(0x00000400)
+#define	USN_REASON_SECURITY_CHANGE	const_cpu_to_le32(0x00000800)
+#define	USN_REASON_RENAME_OLD_NAME	const_cpu_to_le32(0x00001000)
+#define	USN_REASON_RENAME_NEW_NAME	const_cpu_to_le32(0x00002000)
+#define	USN_REASON_INDEXABLE_CHANGE	const_cpu_to_le32(0x00004000)
+#define	USN_REASON_BASIC_INFO_CHANGE	const_cpu_to_le32(0x00008000)
+#define	USN_REASON_HARD_LINK_CHANGE	const_cpu_to_le32(0x00010000)
+#define	USN_REASON_COMPRESSION_CHANGE	const_cpu_to_le32(0x00020000)
+#define	USN_REASON_ENCRYPTION_CHANGE	const_cpu_to_le32(0x00040000)
+#define	USN_REASON_OBJECT_ID_CHANGE	const_cpu_to_le32(0x00080000)
+#define	USN_REASON_REPARSE_POINT_CHANGE	const_cpu_to_le32(0x00100000)
+#define	USN_REASON_STREAM_CHANGE	const_cpu_to_le32(0x00200000)
+#define	USN_REASON_CLOSE		const_cpu_to_le32(0x80000000)
+/* The changes which may add, remove or move a name of the file. */
+#define	USN_REASON_NAME_CHANGE		const_cpu_to_le32(0x00013300)
+
+/**
+ * struct USN_RECORD_V2 - A record of $UsnJrnl:$J, major version 2.
+ *
+ * Records are aligned to 8 bytes and never cross a 4096 byte page of $J;
+ * the end of a page that cannot hold the next record is filled with zeroes.
+ * Version 3 records (Windows 8 and later, mostly on ReFS) carry 128-bit file
+ * references instead, of which NTFS only uses the low 64 bits. Version 4
+ * records describe ranges of data written and hold no name.
+ */
+#pragma pack(push, 1)
+typedef struct {
+/*  0*/	le32 length;			/* Bytes of the record, name and
+					   padding included. */
+/*  4*/	le16 major_version;		/* 2 */
+/*  6*/	le16 minor_version;		/* 0 */
+/*  8*/	leMFT_REF file_reference;
+/* 16*/	leMFT_REF parent_reference;	/* Directory of the name. */
+/* 24*/	sle64 usn;			/* Offset of the record in $J. */
+/* 32*/	sle64 timestamp;		/* NTFS time of the change. */
+/* 40*/	le32 reason;			/* USN_REASON_* */
+/* 44*/	le32 source_info;
+/* 48*/	le32 security_id;
+/* 52*/	FILE_ATTR_FLAGS file_attributes;
+/* 56*/	le16 file_name_length;		/* In bytes. */
+/* 58*/	le16 file_name_offset;		/* From the start of the record. */
+/* 60*/	ntfschar file_name[0];
+} USN_RECORD_V2;
+
+typedef struct {
+/*  0*/	le32 length;
+/*  4*/	le16 major_version;		/* 3 */
+/*  6*/	le16 minor_version;		/* 0 */
+/*  8*/	u8 file_reference[16];
+/* 24*/	u8 parent_reference[16];
+/* 40*/	sle64 usn;
+/* 48*/	sle64 timestamp;
+/* 56*/	le32 reason;
+/* 60*/	le32 source_info;
+/* 64*/	le32 security_id;
+/* 68*/	FILE_ATTR_FLAGS file_attributes;
+/* 72*/	le16 file_name_length;
+/* 74*/	le16 file_name_offset;
+/* 76*/	ntfschar file_name[0];
+} USN_RECORD_V3;
+#pragma pack(pop)
 /**
  * enum QUOTA_FLAGS - Quota flags (32-bit).
  */
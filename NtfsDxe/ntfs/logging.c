@@ -321,7 +321,7 @@ int ntfs_log_redirect(const char *function, const char *file,
 	int ret;
 	va_list args;
 
-	/*if (!(ntfs_log.levels & level))		/* Don't log this message */
+	//if (!(ntfs_log.levels & level))		// Don't log this message
 	//	return 0;
 
 	//AsciiPrint("%a %a %d %d %a\n\r", function, file, line, level, format);
@@ -330,6 +330,14 @@ int ntfs_log_redirect(const char *function, const char *file,
 	//errno = olderr;
 	//ret = ntfs_log.handler(function, file, line, level, data, format, args);
 	//va_end(args);
+#ifdef NTFS_HOST_BUILD
+	if (!(ntfs_log.levels & level))
+		return 0;
+	va_start(args, format);
+	errno = olderr;
+	ret = ntfs_log.handler(function, file, line, level, data, format, args);
+	va_end(args);
+#endif
 
 	errno = olderr;
 	return ret;
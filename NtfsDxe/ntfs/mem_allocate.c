@@ -1,12 +1,21 @@
 //#include "mem_allocate.h"
+#ifdef NTFS_HOST_BUILD
+#include <stdlib.h>
+#else
 #include <mem.h>
+#endif
+#include "types.h"
+#include "misc.h"
+
 void* ntfs_alloc (size_t size) {
 	void *r = malloc(size);
 
+	ntfs_allocations++;
     return r;
 }
 
 void* ntfs_align (size_t size) {
+	ntfs_allocations++;
     return malloc(size);
 }
 
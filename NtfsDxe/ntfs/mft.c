@@ -113,6 +113,7 @@ int ntfs_mft_records_read(const ntfs_volume *vol, const MFT_REF mref,
 				(long long)br);
 		return -1;
 	}
+	NVolStatAdd(vol, mft_records, count);
 	return 0;
 }
 
@@ -47,7 +47,7 @@ extern int ntfs_mft_records_read(const ntfs_volume *vol, const MFT_REF mref,
  *
  * NOTE: @b has to be at least of size vol->mft_record_size.
  */
-static int ntfs_mft_record_read(const ntfs_volume *vol,
+static __inline int ntfs_mft_record_read(const ntfs_volume *vol,
 		const MFT_REF mref, MFT_RECORD *b)
 {
 	int ret; 
@@ -82,7 +82,7 @@ extern int ntfs_mft_records_write(const ntfs_volume *vol, const MFT_REF mref,
  *
  * NOTE: @b has to be at least of size vol->mft_record_size.
  */
-static int ntfs_mft_record_write(const ntfs_volume *vol,
+static __inline int ntfs_mft_record_write(const ntfs_volume *vol,
 		const MFT_REF mref, MFT_RECORD *b)
 {
 	int ret; 
@@ -109,7 +109,7 @@ static int ntfs_mft_record_write(const ntfs_volume *vol,
  * non-existent (don't know if Windows' NTFS driver/chkdsk wouldn't view this
  * as corruption in itself though).
  */
-static u32 ntfs_mft_record_get_data_size(const MFT_RECORD *m)
+static __inline u32 ntfs_mft_record_get_data_size(const MFT_RECORD *m)
 {
 	if (!m || !ntfs_is_mft_record(m->magic))
 		return 0;
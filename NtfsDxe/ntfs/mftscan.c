@@ -0,0 +1,429 @@
+/**
+ * mftscan.c - Sequential whole-MFT scan engine.
+ *
+ * mft_next_record() opens an inode for every mft record, which costs one
+ * random read per record. The functions below instead read $MFT in large
+ * chunks that follow its runlist, skip whatever the $MFT $BITMAP marks as
+ * unused, fix up a whole chunk in one pass and parse the few attributes
+ * indexers care about straight out of the buffer.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "types.h"
+#include "layout.h"
+#include "attrib.h"
+#include "device.h"
+#include "volume.h"
+#include "runlist.h"
+#include "mst.h"
+#include "mftscan.h"
+#include "logging.h"
+#include "misc.h"
+
+/* Size of the NTFS 1.2 $STANDARD_INFORMATION, all that is guaranteed. */
+#define MFT_SCAN_SI_V1_SIZE	48
+
+/**
+ * mft_scan_bit - test the $MFT $BITMAP bit of an mft record
+ */
+static __inline BOOL mft_scan_bit(const ntfs_mft_scan *scan, s64 mft_no)
+{
+	return (scan->bitmap[mft_no >> 3] >> (mft_no & 7)) & 1;
+}
+
+/**
+ * mft_scan_next_in_use - find the first in use mft record at or after @mft_no
+ * @scan:	scan to search the bitmap of
+ * @mft_no:	record number to start at
+ *
+ * Empty stretches of the bitmap are skipped a 64-bit word at a time.
+ *
+ * Return the record number found, or @scan->nr_records if there is none.
+ */
+static s64 mft_scan_next_in_use(const ntfs_mft_scan *scan, s64 mft_no)
+{
+	const s64 end = scan->nr_records;
+
+	while (mft_no < end && (mft_no & 63)) {
+		if (mft_scan_bit(scan, mft_no))
+			return mft_no;
+		mft_no++;
+	}
+	/* The bitmap buffer is word aligned and padded to a whole word. */
+	while (mft_no < end && !*(const u64 *)(scan->bitmap + (mft_no >> 3)))
+		mft_no += 64;
+	while (mft_no < end) {
+		if (mft_scan_bit(scan, mft_no))
+			return mft_no;
+		mft_no++;
+	}
+	return end;
+}
+
+/**
+ * ntfs_mft_scan_open - start a sequential scan of the mft of a volume
+ * @vol:	mounted volume to scan
+ * @chunk_size:	bytes of $MFT to read per device request, 0 for the default
+ *
+ * Map the whole $MFT runlist and load the $MFT $BITMAP so that the scan does
+ * no metadata lookups of its own while it runs. Only records inside the
+ * initialized part of $MFT are visited.
+ *
+ * Return the scan state on success or NULL on error with errno set.
+ */
+ntfs_mft_scan *ntfs_mft_scan_open(ntfs_volume *vol, s64 chunk_size)
+{
+	ntfs_mft_scan *scan;
+	s64 bmp_size, br;
+
+	if (!vol || !vol->mft_na || !vol->mftbmp_na) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (chunk_size <= 0)
+		chunk_size = NTFS_MFT_SCAN_DEFAULT_CHUNK;
+
+	if (ntfs_attr_map_whole_runlist(vol->mft_na)) {
+		ntfs_log_perror("Failed to map the $MFT runlist");
+		return NULL;
+	}
+
+	scan = ntfs_calloc(sizeof(ntfs_mft_scan));
+	if (!scan)
+		return NULL;
+	scan->vol = vol;
+	scan->nr_records = vol->mft_na->initialized_size >>
+			vol->mft_record_size_bits;
+
+	bmp_size = (scan->nr_records + 7) >> 3;
+	if (bmp_size > vol->mftbmp_na->data_size) {
+		bmp_size = vol->mftbmp_na->data_size;
+		scan->nr_records = bmp_size << 3;
+	}
+	/* Round up to a whole word for mft_scan_next_in_use(). */
+	scan->bitmap = ntfs_calloc((size_t)((bmp_size + 7) & ~7));
+	if (!scan->bitmap)
+		goto err_out;
+	br = ntfs_attr_pread(vol->mftbmp_na, 0, bmp_size, scan->bitmap);
+	if (br != bmp_size) {
+		if (br >= 0)
+			errno = EIO;
+		ntfs_log_perror("Failed to read $MFT bitmap");
+		goto err_out;
+	}
+
+	scan->chunk_records = chunk_size >> vol->mft_record_size_bits;
+	if (scan->chunk_records < 1)
+		scan->chunk_records = 1;
+	if (scan->chunk_records > scan->nr_records)
+		scan->chunk_records = scan->nr_records ? scan->nr_records : 1;
+	scan->chunk.buf = ntfs_malloc((size_t)ntfs_mft_scan_chunk_bytes(scan));
+	if (!scan->chunk.buf)
+		goto err_out;
+	return scan;
+err_out:
+	ntfs_mft_scan_close(scan);
+	return NULL;
+}
+
+/**
+ * ntfs_mft_scan_close - release a scan started by ntfs_mft_scan_open()
+ * @scan:	scan to release, may be NULL
+ */
+void ntfs_mft_scan_close(ntfs_mft_scan *scan)
+{
+	if (!scan)
+		return;
+	free(scan->chunk.buf);
+	free(scan->bitmap);
+	free(scan);
+}
+
+/**
+ * ntfs_mft_scan_chunk_bytes - size of the buffer needed for one chunk
+ * @scan:	scan the chunk will be read for
+ */
+s64 ntfs_mft_scan_chunk_bytes(const ntfs_mft_scan *scan)
+{
+	return scan->chunk_records << scan->vol->mft_record_size_bits;
+}
+
+/**
+ * ntfs_mft_scan_read_chunk - read the next run of mft records
+ * @scan:	scan to advance
+ * @chunk:	destination, @chunk->buf must hold ntfs_mft_scan_chunk_bytes()
+ *
+ * The chunk starts at the next in use record and extends to the end of the
+ * $MFT extent holding it, the chunk size limit or the last in use record in
+ * that range, whichever comes first, so that it is read with a single device
+ * request. The records are returned exactly as on disk; the caller applies
+ * ntfs_mft_scan_fixup_chunk() when it is ready to, which lets a reader thread
+ * hand the fixup work to others.
+ *
+ * Return the number of records read, 0 at the end of the mft, or -1 on error
+ * with errno set.
+ */
+s64 ntfs_mft_scan_read_chunk(ntfs_mft_scan *scan, ntfs_mft_chunk *chunk)
+{
+	ntfs_volume *vol = scan->vol;
+	runlist_element *rl;
+	s64 first, count, last, pos, ofs, br;
+	ntfs_io_tag tag;
+
+	first = mft_scan_next_in_use(scan, scan->next);
+	if (first >= scan->nr_records) {
+		scan->next = scan->nr_records;
+		return 0;
+	}
+
+	pos = first << vol->mft_record_size_bits;
+	rl = ntfs_attr_find_vcn(vol->mft_na, pos >> vol->cluster_size_bits);
+	if (!rl) {
+		ntfs_log_perror("Failed to locate mft record %lld",
+				(long long)first);
+		return -1;
+	}
+	ofs = pos - (rl->vcn << vol->cluster_size_bits);
+	count = (((rl->vcn + rl->length) << vol->cluster_size_bits) - pos) >>
+			vol->mft_record_size_bits;
+	if (rl->lcn < 0 || count < 1) {
+		/*
+		 * A sparse $MFT extent or a record straddling two extents,
+		 * possible with clusters smaller than records: let the
+		 * attribute code assemble this one record.
+		 */
+		br = ntfs_attr_pread(vol->mft_na, pos, vol->mft_record_size,
+				chunk->buf);
+		count = 1;
+	} else {
+		if (count > scan->chunk_records)
+			count = scan->chunk_records;
+		if (count > scan->nr_records - first)
+			count = scan->nr_records - first;
+		/* No point in reading a tail of unused records. */
+		for (last = first + count - 1; last > first; last--)
+			if (mft_scan_bit(scan, last))
+				break;
+		count = last - first + 1;
+		tag = ntfs_device_set_io_tag(vol->dev, NTFS_IO_MFT);
+		br = ntfs_pread(vol->dev,
+				(rl->lcn << vol->cluster_size_bits) + ofs,
+				count << vol->mft_record_size_bits, chunk->buf);
+		ntfs_device_set_io_tag(vol->dev, tag);
+	}
+	if (br != count << vol->mft_record_size_bits) {
+		if (br >= 0)
+			errno = EIO;
+		ntfs_log_perror("Failed to read mft records %lld-%lld",
+				(long long)first, (long long)(first + count - 1));
+		return -1;
+	}
+
+	NVolStatAdd(vol, mft_records, count);
+	chunk->first = first;
+	chunk->count = count;
+	scan->next = first + count;
+	return count;
+}
+
+/**
+ * ntfs_mft_scan_fixup_chunk - apply the multi sector fixups to a chunk
+ * @scan:	scan the chunk was read by
+ * @chunk:	chunk returned by ntfs_mft_scan_read_chunk()
+ *
+ * Records that fail the fixup are marked "BAAD" and are later rejected by
+ * ntfs_mft_scan_record_in_use(). Unused records inside the chunk are fixed
+ * up as well and may fail; that is harmless.
+ *
+ * Return the number of records that failed the fixup, or -1 on error.
+ */
+s64 ntfs_mft_scan_fixup_chunk(const ntfs_mft_scan *scan, ntfs_mft_chunk *chunk)
+{
+	return ntfs_mst_post_read_fixup_batch(chunk->buf, chunk->count,
+			scan->vol->mft_record_size, FALSE);
+}
+
+/**
+ * ntfs_mft_scan_record_in_use - check a fixed up record is worth parsing
+ * @scan:	scan the record was read by
+ * @m:		fixed up mft record
+ * @mft_no:	number of @m
+ *
+ * The record must be marked in use both in the $MFT $BITMAP and in its own
+ * header, and must have passed the multi sector fixup.
+ */
+BOOL ntfs_mft_scan_record_in_use(const ntfs_mft_scan *scan,
+		const MFT_RECORD *m, s64 mft_no)
+{
+	if (!mft_scan_bit(scan, mft_no))
+		return FALSE;
+	if (!ntfs_is_file_record(m->magic)) {
+		if (ntfs_is_baad_record(m->magic))
+			ntfs_log_error("Mft record %lld is corrupt (incomplete "
+					"multi sector transfer)\n",
+					(long long)mft_no);
+		return FALSE;
+	}
+	return (m->flags & MFT_RECORD_IN_USE) ? TRUE : FALSE;
+}
+
+/**
+ * ntfs_mft_scan_parse - build the lightweight view of an mft record
+ * @vol:	volume the record belongs to
+ * @m:		fixed up, in use mft record
+ * @mft_no:	number of @m
+ * @rec:	view to fill in
+ *
+ * Walk the attributes of @m once, bounds checking each of them, and remember
+ * where the resident $STANDARD_INFORMATION and $FILE_NAME values are and how
+ * big the unnamed $DATA attribute is. Only @m itself is looked at, so the
+ * function may be called concurrently on different records.
+ *
+ * Return 0 on success or -1 with errno set to EIO if @m is corrupt.
+ */
+int ntfs_mft_scan_parse(const ntfs_volume *vol, MFT_RECORD *m, s64 mft_no,
+		ntfs_mft_scan_record *rec)
+{
+	ATTR_RECORD *a;
+	u8 *end;
+	u32 len;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->mft_no = mft_no;
+	rec->seq_no = le16_to_cpu(m->sequence_number);
+	rec->flags = le16_to_cpu(m->flags);
+	rec->link_count = le16_to_cpu(m->link_count);
+	rec->base_mref = le64_to_cpu(m->base_mft_record);
+	rec->mrec = m;
+	rec->data_size = -1;
+
+	if (le32_to_cpu(m->bytes_in_use) > vol->mft_record_size ||
+	    le16_to_cpu(m->attrs_offset) >= le32_to_cpu(m->bytes_in_use))
+		goto corrupt;
+	end = (u8 *)m + le32_to_cpu(m->bytes_in_use);
+
+	for (a = (ATTR_RECORD *)((u8 *)m + le16_to_cpu(m->attrs_offset));
+	     (u8 *)a + sizeof(ATTR_TYPES) <= end;
+	     a = (ATTR_RECORD *)((u8 *)a + len)) {
+		if (a->type == AT_END)
+			return 0;
+		len = le32_to_cpu(a->length);
+		if ((u8 *)a + offsetof(ATTR_RECORD, resident_end) > end ||
+		    len < offsetof(ATTR_RECORD, resident_end) ||
+		    (u8 *)a + len > end)
+			goto corrupt;
+		if (!a->non_resident &&
+		    (u32)le16_to_cpu(a->value_offset) +
+		    le32_to_cpu(a->value_length) > len)
+			goto corrupt;
+
+		switch (a->type) {
+		case AT_STANDARD_INFORMATION:
+			if (!a->non_resident && le32_to_cpu(a->value_length) >=
+					MFT_SCAN_SI_V1_SIZE)
+				rec->si = (STANDARD_INFORMATION *)((u8 *)a +
+						le16_to_cpu(a->value_offset));
+			break;
+		case AT_ATTRIBUTE_LIST:
+			rec->has_attr_list = TRUE;
+			break;
+		case AT_FILE_NAME:
+			if (!a->non_resident &&
+			    rec->nr_names < NTFS_MFT_SCAN_MAX_NAMES &&
+			    le32_to_cpu(a->value_length) >=
+					offsetof(FILE_NAME_ATTR, file_name)) {
+				FILE_NAME_ATTR *fn = (FILE_NAME_ATTR *)((u8 *)a +
+						le16_to_cpu(a->value_offset));
+
+				if (offsetof(FILE_NAME_ATTR, file_name) +
+				    fn->file_name_length * sizeof(ntfschar) <=
+				    le32_to_cpu(a->value_length))
+					rec->names[rec->nr_names++] = fn;
+			}
+			break;
+		case AT_DATA:
+			if (a->name_length)
+				break;
+			if (!a->non_resident) {
+				rec->data_size = le32_to_cpu(a->value_length);
+				rec->allocated_size = (rec->data_size + 7) & ~7;
+			} else if (!a->lowest_vcn &&
+				   len >= offsetof(ATTR_RECORD, compressed_size)) {
+				rec->data_size = sle64_to_cpu(a->data_size);
+				rec->allocated_size =
+					sle64_to_cpu(a->allocated_size);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+corrupt:
+	ntfs_log_error("Mft record %lld is corrupt\n", (long long)mft_no);
+	errno = EIO;
+	return -1;
+}
+
+/**
+ * ntfs_mft_scan_next - return the next in use mft record of a scan
+ * @scan:	scan to advance
+ * @rec:	view of the record, valid until the next call
+ *
+ * Records that turn out to be corrupt are logged and skipped.
+ *
+ * Return 1 if @rec was filled in, 0 at the end of the mft, or -1 on error
+ * with errno set.
+ */
+int ntfs_mft_scan_next(ntfs_mft_scan *scan, ntfs_mft_scan_record *rec)
+{
+	const u32 size = scan->vol->mft_record_size;
+	MFT_RECORD *m;
+	s64 mft_no, ret;
+
+	for (;;) {
+		if (scan->pos >= scan->chunk.count) {
+			ret = ntfs_mft_scan_read_chunk(scan, &scan->chunk);
+			if (ret <= 0) {
+				scan->chunk.count = 0;
+				return (int)ret;
+			}
+			if (ntfs_mft_scan_fixup_chunk(scan, &scan->chunk) < 0)
+				return -1;
+			scan->pos = 0;
+		}
+		mft_no = scan->chunk.first + scan->pos;
+		m = (MFT_RECORD *)(scan->chunk.buf + scan->pos * size);
+		scan->pos++;
+		if (ntfs_mft_scan_record_in_use(scan, m, mft_no) &&
+		    !ntfs_mft_scan_parse(scan->vol, m, mft_no, rec))
+			return 1;
+	}
+}
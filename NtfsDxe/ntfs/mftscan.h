@@ -0,0 +1,112 @@
+/*
+ * mftscan.h - Exports for the sequential whole-MFT scan engine.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NTFS_MFTSCAN_H
+#define _NTFS_MFTSCAN_H
+
+#include "types.h"
+#include "layout.h"
+#include "volume.h"
+
+/* Default amount of $MFT read by one device request. */
+#define NTFS_MFT_SCAN_DEFAULT_CHUNK	(1024 * 1024)
+
+/* $FILE_NAME attributes remembered per record, enough for Win32 + DOS + links. */
+#define NTFS_MFT_SCAN_MAX_NAMES		8
+
+/**
+ * struct ntfs_mft_scan_record - lightweight parsed view of one mft record
+ * @mft_no:		number of the mft record
+ * @seq_no:		sequence number of the mft record
+ * @flags:		MFT_RECORD_IN_USE, MFT_RECORD_IS_DIRECTORY, ...
+ * @link_count:		number of hard links (base records only)
+ * @base_mref:		base record reference, 0 if this is a base record
+ * @mrec:		the fixed up record, valid until the next scan call
+ * @si:			resident $STANDARD_INFORMATION value or NULL
+ * @names:		resident $FILE_NAME values, in record order
+ * @nr_names:		number of entries used in @names
+ * @data_size:		size of the unnamed $DATA attribute, -1 if not present
+ *			in this record
+ * @allocated_size:	allocated size of the unnamed $DATA attribute
+ * @has_attr_list:	the record carries an $ATTRIBUTE_LIST, so @names and
+ *			the $DATA sizes may live in extension records
+ *
+ * All pointers point into the scan buffer, nothing is copied.
+ */
+typedef struct {
+	s64 mft_no;
+	u16 seq_no;
+	u16 flags;
+	u16 link_count;
+	MFT_REF base_mref;
+	MFT_RECORD *mrec;
+	STANDARD_INFORMATION *si;
+	FILE_NAME_ATTR *names[NTFS_MFT_SCAN_MAX_NAMES];
+	int nr_names;
+	s64 data_size;
+	s64 allocated_size;
+	BOOL has_attr_list;
+} ntfs_mft_scan_record;
+
+/**
+ * struct ntfs_mft_chunk - a run of consecutive mft records read in one go
+ * @first:	mft record number of the first record in @buf
+ * @count:	number of records in @buf
+ * @buf:	@count * vol->mft_record_size bytes, supplied by the caller
+ */
+typedef struct {
+	s64 first;
+	s64 count;
+	u8 *buf;
+} ntfs_mft_chunk;
+
+/**
+ * struct ntfs_mft_scan - state of a sequential $MFT scan
+ * @vol:		volume being scanned
+ * @bitmap:		copy of the $MFT $BITMAP
+ * @nr_records:		number of initialized mft records covered by @bitmap
+ * @next:		first record not yet handed out by the chunk reader
+ * @chunk_records:	maximum number of records read per chunk
+ * @chunk:		chunk used by ntfs_mft_scan_next()
+ * @pos:		next record of @chunk returned by ntfs_mft_scan_next()
+ */
+typedef struct {
+	ntfs_volume *vol;
+	u8 *bitmap;
+	s64 nr_records;
+	s64 next;
+	s64 chunk_records;
+	ntfs_mft_chunk chunk;
+	s64 pos;
+} ntfs_mft_scan;
+
+extern ntfs_mft_scan *ntfs_mft_scan_open(ntfs_volume *vol, s64 chunk_size);
+extern int ntfs_mft_scan_next(ntfs_mft_scan *scan, ntfs_mft_scan_record *rec);
+extern void ntfs_mft_scan_close(ntfs_mft_scan *scan);
+
+extern s64 ntfs_mft_scan_chunk_bytes(const ntfs_mft_scan *scan);
+extern s64 ntfs_mft_scan_read_chunk(ntfs_mft_scan *scan, ntfs_mft_chunk *chunk);
+extern s64 ntfs_mft_scan_fixup_chunk(const ntfs_mft_scan *scan,
+		ntfs_mft_chunk *chunk);
+extern BOOL ntfs_mft_scan_record_in_use(const ntfs_mft_scan *scan,
+		const MFT_RECORD *m, s64 mft_no);
+extern int ntfs_mft_scan_parse(const ntfs_volume *vol, MFT_RECORD *m,
+		s64 mft_no, ntfs_mft_scan_record *rec);
+
+#endif /* defined _NTFS_MFTSCAN_H */
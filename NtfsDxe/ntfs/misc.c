@@ -35,6 +35,9 @@
 #include "misc.h"
 #include "logging.h"
 
+/* Number of allocations made through the library, for the volume stats. */
+u64 ntfs_allocations;
+
 /**
  * ntfs_calloc
  * 
@@ -45,6 +48,7 @@ void *ntfs_calloc(size_t size)
 	void *p;
 	
 	p = calloc(1, size);
+	ntfs_allocations++;
 	if (!p)
 		ntfs_log_perror("Failed to calloc %l bytes", (long long)size);
 	return p;
@@ -55,6 +59,7 @@ void *ntfs_malloc(size_t size)
 	void *p;
 	
 	p = malloc(size);
+	ntfs_allocations++;
 	if (!p)
 		ntfs_log_perror("Failed to malloc %l bytes", (long long)size);
 	return p;
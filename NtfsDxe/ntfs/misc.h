@@ -23,6 +23,8 @@
 #ifndef _NTFS_MISC_H_
 #define _NTFS_MISC_H_
 
+extern u64 ntfs_allocations;
+
 void *ntfs_calloc(size_t size);
 void *ntfs_malloc(size_t size);
 
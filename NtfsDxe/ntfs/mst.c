@@ -134,6 +134,92 @@ int ntfs_mst_post_read_fixup(NTFS_RECORD *b, const u32 size)
 	return (ntfs_mst_post_read_fixup_warn(b,size,TRUE));
 }
 
+/**
+ * ntfs_mst_post_read_fixup_batch - deprotect many mst protected records
+ * @b:		pointer to the first of @count consecutive records
+ * @count:	number of records in @b
+ * @bksize:	size in bytes of each record
+ * @warn:	log each record that cannot be deprotected
+ *
+ * Batched equivalent of calling ntfs_mst_post_read_fixup_warn() on each of
+ * @count records of @bksize bytes laid out back to back, as returned by a
+ * multi record read. Every record of a batch has the same number of sectors,
+ * so the update sequence array layout is checked against a single expected
+ * value and the sector trailers of a record are compared against its usn
+ * without branching per sector. Only records that fail take the slow path.
+ *
+ * As with the single record version, a record whose trailers do not match
+ * its usn gets its magic set to "BAAD" (in memory only) and is left
+ * otherwise untouched; a record with an invalid update sequence array
+ * header (e.g. an unused, zeroed MFT record) is left untouched.
+ *
+ * Return the number of records that could not be deprotected, so 0 means
+ * every record in the batch is valid. Return -1 with errno set to EINVAL if
+ * the arguments are invalid. If some records failed, errno is set to EIO if
+ * any of them was marked "BAAD" and to EINVAL otherwise.
+ */
+s64 ntfs_mst_post_read_fixup_batch(void *b, const s64 count,
+		const u32 bksize, BOOL warn)
+{
+	const u16 sectors = (u16)(bksize >> NTFS_BLOCK_SIZE_BITS);
+	const u32 stride = NTFS_BLOCK_SIZE/sizeof(u16);
+	u8 *rec = (u8*)b;
+	s64 i, failed = 0, baad = 0;
+
+	ntfs_log_trace("Entering for %lld records of %u bytes\n",
+			(long long)count, (unsigned)bksize);
+
+	if (!b || count < 0 || !sectors || bksize & (NTFS_BLOCK_SIZE - 1)) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < count; i++, rec += bksize) {
+		NTFS_RECORD *r = (NTFS_RECORD*)rec;
+		u16 usa_ofs = le16_to_cpu(r->usa_ofs);
+		u16 *usa_pos, *data_pos;
+		u16 usn, diff;
+		u32 j;
+
+		/* One usn plus one saved word per sector, inside the record. */
+		if (le16_to_cpu(r->usa_count) != sectors + 1 || usa_ofs & 1 ||
+				(u32)usa_ofs + (sectors + 1) * sizeof(u16) > bksize) {
+			if (warn)
+				ntfs_log_error("Invalid update sequence array in "
+					"record %lld of batch: magic: 0x%08lx "
+					"usa_ofs: %d  usa_count: %d\n",
+					(long long)i,
+					(long)le32_to_cpu(*(le32*)r),
+					(int)usa_ofs,
+					(int)le16_to_cpu(r->usa_count));
+			failed++;
+			continue;
+		}
+		usa_pos = (u16*)rec + usa_ofs/sizeof(u16);
+		data_pos = (u16*)rec + stride - 1;
+		usn = *usa_pos;
+		/* Fold every sector trailer into one mismatch word. */
+		diff = 0;
+		for (j = 0; j < sectors; j++)
+			diff |= data_pos[j * stride] ^ usn;
+		if (diff) {
+			if (warn)
+				ntfs_log_error("Incomplete multi-sector transfer "
+					"in record %lld of batch: magic: "
+					"0x%08lx  usn: %d\n", (long long)i,
+					(long)le32_to_cpu(*(le32*)r), (int)usn);
+			r->magic = magic_BAAD;
+			failed++;
+			baad++;
+			continue;
+		}
+		for (j = 0; j < sectors; j++)
+			data_pos[j * stride] = usa_pos[j + 1];
+	}
+	if (failed)
+		errno = baad ? EIO : EINVAL;
+	return failed;
+}
+
 /**
  * ntfs_mst_pre_write_fixup - apply multi sector transfer protection
  * @b:		pointer to the data to protect
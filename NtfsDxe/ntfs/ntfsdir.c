@@ -51,19 +51,38 @@
 #define STATE(x)    (x)
 #define MAX_PATH	260
 
-void ntfsCloseDir (ntfs_dir_state *dir)
+/**
+ * PRIVATE: Free the directory entries in memory
+ */
+static void ntfs_readdir_free_entries (ntfs_dir_state *dir)
 {
-    // Sanity check
-    if (!dir || !dir->vd)
-        return;
-
-    // Free the directory entries (if any)
     while (dir->first) {
         ntfs_dir_entry *next = dir->first->next;
         ntfs_free(dir->first->name);
         ntfs_free(dir->first);
         dir->first = next;
     }
+    dir->last = NULL;
+    dir->current = NULL;
+}
+
+void ntfsCloseDir (ntfs_dir_state *dir)
+{
+    // Sanity check
+    if (!dir || !dir->vd)
+        return;
+
+    // Free the directory entries (if any)
+    ntfs_readdir_free_entries(dir);
+
+    // Free the references seen (if any)
+    ntfs_free(dir->seen);
+    dir->seen = NULL;
+    dir->seen_size = dir->seen_count = 0;
+
+    // Release the cursor (if any)
+    ntfs_dir_cursor_close(dir->cursor);
+    dir->cursor = NULL;
 
     // Close the directory (if open)
     if (dir->ni)
@@ -386,21 +405,71 @@ int ntfs_statvfs_r (struct _reent *r, const char *path, struct statvfs *buf)
 }
 
 /**
- * PRIVATE: check if a reference is in list!
+ * PRIVATE: Remember a reference listed under one of several names
+ *
+ * Returns 1 if the reference was listed before, 0 if it is new and -1 on error.
  */
-int ntfs_readdir_exists(ntfs_dir_state *dir, ntfs_dir_entry *entry)
+static int ntfs_readdir_seen (ntfs_dir_state *dir, u64 mref)
 {
-	ntfs_dir_entry *cursor = dir->first;
-	
-	while(cursor != NULL)
-	{
-		if (cursor->mref == entry->mref)
-			return 1;	// found!
+    u64 key = mref + 1;
+    u32 i;
+
+    // Grow the table when it is three quarters full
+    if ((dir->seen_count + 1) * 4 > dir->seen_size * 3) {
+        u32 size = dir->seen_size ? dir->seen_size * 2 : 64;
+        u64 *seen = (u64 *) ntfs_alloc(size * sizeof(u64));
+        if (!seen)
+            return -1;
+        memset(seen, 0, size * sizeof(u64));
+        for (i = 0; i < dir->seen_size; i++) {
+            u32 j;
+            if (!dir->seen[i])
+                continue;
+            j = (u32)(dir->seen[i] * 0x9E3779B97F4A7C15ULL >> 32) & (size - 1);
+            while (seen[j])
+                j = (j + 1) & (size - 1);
+            seen[j] = dir->seen[i];
+        }
+        ntfs_free(dir->seen);
+        dir->seen = seen;
+        dir->seen_size = size;
+    }
+
+    // Look the reference up, adding it if it is not there
+    i = (u32)(key * 0x9E3779B97F4A7C15ULL >> 32) & (dir->seen_size - 1);
+    while (dir->seen[i]) {
+        if (dir->seen[i] == key)
+            return 1;
+        i = (i + 1) & (dir->seen_size - 1);
+    }
+    dir->seen[i] = key;
+    dir->seen_count++;
 
-		cursor = cursor->next;	// move on next!
-	}
+    return 0;
+}
+
+/**
+ * PRIVATE: Count the names of an inode in a directory, DOS names aside
+ *
+ * Returns the number of names or -1 on error.
+ */
+static int ntfs_readdir_links (ntfs_inode *ni, u64 dir_no)
+{
+    ntfs_attr_search_ctx *ctx;
+    FILE_NAME_ATTR *fn;
+    int links = 0;
+
+    ctx = ntfs_attr_get_search_ctx(ni, NULL);
+    if (!ctx)
+        return -1;
+    while (!ntfs_attr_lookup(AT_FILE_NAME, AT_UNNAMED, 0, CASE_SENSITIVE, 0, NULL, 0, ctx)) {
+        fn = (FILE_NAME_ATTR *)((u8 *)ctx->attr + le16_to_cpu(ctx->attr->value_offset));
+        if (fn->file_name_type != FILE_NAME_DOS && MREF_LE(fn->parent_directory) == dir_no)
+            links++;
+    }
+    ntfs_attr_put_search_ctx(ctx);
 
-	return 0;	// element not in list!
+    return links;
 }
 
 /**
@@ -412,8 +481,7 @@ int ntfs_readdir_filler (ntfs_dir_state *dirState, const ntfschar *name, const i
     ntfs_dir_state *dir = STATE(dirState);
     ntfs_dir_entry *entry = NULL;
     char *entry_name = NULL;
-	MFT_REF lmref;
-	UINT8 f, i;
+    int names = 0;
 
     // Sanity check
     if (!dir || !dir->vd) {
@@ -421,16 +489,18 @@ int ntfs_readdir_filler (ntfs_dir_state *dirState, const ntfschar *name, const i
         return -1;
     }
 
-    // Ignore DOS file names
-    if (name_type == FILE_NAME_DOS) {
-		// accept name!
-		//        return 0;
-    }
+    // Stop here if this fetch has all it wants, the entry will come first next time
+    if (dir->cursor && dir->batch <= 0)
+        return 1;
 
-	if (*name >= 0x100) {
-		// unicode name.. UNSUPPORTED!
-		return 0;
-	}
+    // A DOS name always comes with the Win32 name of the same file, which is listed instead
+    if (name_type == FILE_NAME_DOS)
+        return 0;
+
+    if (*name >= 0x100) {
+        // unicode name.. UNSUPPORTED!
+        return 0;
+    }
 
     // Preliminary check that this entry can be enumerated (as described by the volume descriptor)
     if (MREF(mref) == FILE_root || MREF(mref) >= FILE_first_user || dir->vd->showSystemFiles) {
@@ -441,7 +511,7 @@ int ntfs_readdir_filler (ntfs_dir_state *dirState, const ntfschar *name, const i
             return -1;
         }
 
-		if(dir->first && dir->first->mref == FILE_root &&
+		if(dir->ni->mft_no == FILE_root &&
            MREF(mref) == FILE_root && strcmp(entry_name, "..") == 0)
         {	// root directory.. there are no parent inode
 			free(entry_name);
@@ -470,9 +540,22 @@ int ntfs_readdir_filler (ntfs_dir_state *dirState, const ntfschar *name, const i
                 return 0;
             }
 
+            // Only hard links within this directory show up more than once
+            names = le16_to_cpu(ni->mrec->link_count) > 1 &&
+                    ntfs_readdir_links(ni, dir->ni->mft_no) != 1;
+
             // Close the entry
             ntfs_inode_close(ni);
 
+            // Skip the names after the first one
+            if (names) {
+                int seen = ntfs_readdir_seen(dir, MREF(mref));
+                if (seen) {
+                    free(entry_name);
+                    return seen < 0 ? -1 : 0;
+                }
+            }
+
         }
 
         // Allocate a new directory entry
@@ -487,31 +570,44 @@ int ntfs_readdir_filler (ntfs_dir_state *dirState, const ntfschar *name, const i
         entry->next = NULL;
         entry->mref = MREF(mref);
 
-		if (ntfs_readdir_exists(dir, entry))
-		{	// skip link!
-			free(entry->name);
-			free(entry);
-			return 0;
-		}
-
         // Link the entry to the directory
+        dir->batch--;
         if (!dir->first) {
             dir->first = entry;
         } else {
-            ntfs_dir_entry *last = dir->first;
-            while (last->next) last = last->next;
-            last->next = entry;
+            dir->last->next = entry;
         }
+        dir->last = entry;
 
     }
 
 	    return 0;
 }
 
+/**
+ * PRIVATE: Read the next batch of entries from the cursor of a directory
+ */
+static int ntfs_readdir_batch (ntfs_dir_state *dir)
+{
+    int ret;
+
+    if (!dir->cursor)
+        return 0;
+
+    dir->batch = NTFS_DIR_BATCH;
+    ret = ntfs_dir_cursor_read(dir->cursor, dir, (ntfs_filldir_t)ntfs_readdir_filler);
+    if (ret > 0)
+        return 0;
+
+    // End of the directory or error, the cursor is not needed any more
+    ntfs_dir_cursor_close(dir->cursor);
+    dir->cursor = NULL;
+    return ret;
+}
+
 ntfs_dir_state *ntfs_diropen_r (struct _reent *r, ntfs_dir_state *dirState, const char *path)
 {
 	    ntfs_dir_state* dir = STATE(dirState);
-    s64 position = 0;
 
     ntfs_log_trace("dirState %p, path %s\n", dirState, path);
 
@@ -544,12 +640,16 @@ ntfs_dir_state *ntfs_diropen_r (struct _reent *r, ntfs_dir_state *dirState, cons
         return NULL;
     }
 
-    // Read the directory
-    dir->first = dir->current = NULL;
-    if (ntfs_readdir(dir->ni, &position, dirState, (ntfs_filldir_t)ntfs_readdir_filler)) {
+    // Read the first entries of the directory, the rest follows from ntfs_dirnext_r()
+    dir->first = dir->last = dir->current = NULL;
+    dir->released = 0;
+    dir->seen = NULL;
+    dir->seen_size = dir->seen_count = 0;
+    dir->cursor = ntfs_dir_cursor_open(dir->ni);
+    if (!dir->cursor || ntfs_readdir_batch(dir)) {
+        r->_errno = errno;
         ntfsCloseDir(dir);
         ntfsUnlock(dir->vd);
-        r->_errno = errno;
         return NULL;
     }
 
@@ -591,6 +691,23 @@ int ntfs_dirreset_r (struct _reent *r, ntfs_dir_state *dirState)
     // Lock
     ntfsLock(dir->vd);
 
+    // Read the first entries again if they were freed
+    if (dir->released) {
+        ntfs_readdir_free_entries(dir);
+        memset(dir->seen, 0, dir->seen_size * sizeof(u64));
+        dir->seen_count = 0;
+        dir->released = 0;
+        if (dir->cursor)
+            ntfs_dir_cursor_rewind(dir->cursor);
+        else
+            dir->cursor = ntfs_dir_cursor_open(dir->ni);
+        if (!dir->cursor || ntfs_readdir_batch(dir)) {
+            ntfsUnlock(dir->vd);
+            r->_errno = errno;
+            return -1;
+        }
+    }
+
     // Move to the first entry in the directory
     dir->current = dir->first;
 
@@ -606,7 +723,6 @@ int ntfs_dirreset_r (struct _reent *r, ntfs_dir_state *dirState)
 int ntfs_dirnext_r (struct _reent *r, ntfs_dir_state *dirState, char *filename, struct stat *filestat)
 {
 	    ntfs_dir_state* dir = STATE(dirState);
-    ntfs_inode *ni = NULL;
 
     ntfs_log_trace("dirState %p, filename %p, filestat %p\n", dirState, filename, filestat);
 
@@ -645,7 +761,20 @@ int ntfs_dirnext_r (struct _reent *r, ntfs_dir_state *dirState, char *filename,
     //    }
     //}
 
+    // Move on, replacing the entries in memory with the next batch when they are used up
     dir->current = dir->current->next;
+    if (!dir->current && dir->cursor) {
+        ntfs_readdir_free_entries(dir);
+        dir->released = 1;
+        while (!dir->first && dir->cursor) {
+            if (ntfs_readdir_batch(dir)) {
+                ntfsUnlock(dir->vd);
+                r->_errno = errno;
+                return -1;
+            }
+        }
+        dir->current = dir->first;
+    }
 
     // Update directory times
     ntfsUpdateTimes(dir->vd, dir->ni, NTFS_UPDATE_ATIME);
@@ -674,14 +803,19 @@ int ntfs_dirclose_r (struct _reent *r, ntfs_dir_state *dirState)
     // Close the directory
     ntfsCloseDir(dir);
 
-    // Remove the directory from the double-linked FILO list of open directories
-    dir->vd->openDirCount--;
-    if (dir->nextOpenDir)
-        dir->nextOpenDir->prevOpenDir = dir->prevOpenDir;
-    if (dir->prevOpenDir)
-        dir->prevOpenDir->nextOpenDir = dir->nextOpenDir;
-    else
-        dir->vd->firstOpenDir = dir->nextOpenDir;
+    // Remove the directory from the double-linked FILO list of open directories,
+    // if ntfs_diropen_r() got as far as inserting it
+    if (dir->prevOpenDir || dir->vd->firstOpenDir == dir) {
+        dir->vd->openDirCount--;
+        if (dir->nextOpenDir)
+            dir->nextOpenDir->prevOpenDir = dir->prevOpenDir;
+        if (dir->prevOpenDir)
+            dir->prevOpenDir->nextOpenDir = dir->nextOpenDir;
+        else
+            dir->vd->firstOpenDir = dir->nextOpenDir;
+        dir->prevOpenDir = NULL;
+        dir->nextOpenDir = NULL;
+    }
 
     // Unlock
     ntfsUnlock(dir->vd);
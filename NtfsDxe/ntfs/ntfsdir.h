@@ -40,17 +40,26 @@ typedef struct _ntfs_dir_entry {
     struct _ntfs_dir_entry *next;
 } ntfs_dir_entry;
 
+/* Number of entries read from the index each time the entries read so far run out */
+#define NTFS_DIR_BATCH  64
+
 /**
  * ntfs_dir_state - Directory state
  */
 struct _ntfs_dir_state {
     ntfs_vd *vd;                            /* Volume this directory belongs to */
     ntfs_inode *ni;                         /* Directory descriptor */
-    ntfs_dir_entry *first;                  /* The first entry in the directory */
+    ntfs_dir_entry *first;                  /* The first entry of the batch in memory */
+    ntfs_dir_entry *last;                   /* The last entry of the batch in memory */
     ntfs_dir_entry *current;                /* The current entry in the directory */
     struct _ntfs_dir_state *prevOpenDir;    /* The previous entry in a double-linked FILO list of open directories */
     struct _ntfs_dir_state *nextOpenDir;    /* The next entry in a double-linked FILO list of open directories */
-
+    ntfs_dir_cursor *cursor;                /* Where to read the next entries from, NULL once all are read */
+    int batch;                              /* Entries still wanted from the cursor in this fetch */
+    int released;                           /* Entries of earlier batches were freed, a reset reads them again */
+    u64 *seen;                              /* Hash table of the references of files with several names in the directory, 0 is free */
+    u32 seen_size;                          /* Slots in seen, a power of two */
+    u32 seen_count;                         /* References in seen */
 };
 
 typedef struct _ntfs_dir_state ntfs_dir_state;
@@ -58,6 +67,8 @@ typedef struct _ntfs_dir_state ntfs_dir_state;
 /* Directory state routines */
 void ntfsCloseDir (ntfs_dir_state *file);
 
+struct statvfs;
+
 /* Gekko devoptab directory routines for NTFS-based devices */
 extern int ntfs_stat_r (struct _reent *r, const char *path, struct stat *st);
 extern int ntfs_link_r (struct _reent *r, const char *existing, const char *newLink);
@@ -46,6 +46,7 @@
 
 #include "ntfsinternal.h"
 #include "ntfsfile.h"
+#include "extmap.h"
 
 #define STATE(x)    ((ntfs_file_state*)x)
 
@@ -225,7 +226,7 @@ int ntfs_open_r (struct _reent *r, void *fileStruct, const char *path, int flags
     // Unlock
     ntfsUnlock(file->vd);
 
-    return (int)fileStruct;
+    return 0;
 }
 
 int ntfs_close_r (struct _reent *r, UINTN fd)
@@ -407,6 +408,18 @@ off_t ntfs_seek_r (struct _reent *r, UINTN fd, off_t pos, int dir)
         case SEEK_SET: position = file->pos = MIN(MAX(pos, 0), file->len); break;
         case SEEK_CUR: position = file->pos = MIN(MAX(file->pos + pos, 0), file->len); break;
         case SEEK_END: position = file->pos = MIN(MAX(file->len + pos, 0), file->len); break;
+        case SEEK_DATA:
+        case SEEK_HOLE:
+            // Skip over the holes (or the data) without reading them
+            if (dir == SEEK_DATA)
+                position = ntfs_attr_seek_data(file->data_na, pos);
+            else
+                position = ntfs_attr_seek_hole(file->data_na, pos);
+            if (position < 0)
+                r->_errno = errno;
+            else
+                file->pos = position;
+            break;
     }
 
     // Unlock
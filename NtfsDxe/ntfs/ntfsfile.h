@@ -29,6 +29,12 @@
 #include "ntfsinternal.h"
 //#include <sys/reent.h>
 
+/* lseek() whences of Linux and Solaris, for the libcs which lack them */
+#ifndef SEEK_DATA
+#define SEEK_DATA   3
+#define SEEK_HOLE   4
+#endif
+
 /**
  * ntfs_file_state - File state
  */
@@ -217,6 +217,8 @@ int ntfsSync (ntfs_vd *vd, ntfs_inode *ni);
 int ntfsStat (ntfs_vd *vd, ntfs_inode *ni, struct stat *st);
 void ntfsUpdateTimes (ntfs_vd *vd, ntfs_inode *ni, ntfs_time_update_flags mask);
 
+struct _NTFS_VOLUME;
+
 const char *ntfsRealPath (const char *path);
 int ntfsUnicodeToLocal (const ntfschar *ins, const int ins_len, char **outs, int outs_len);
 int ntfsLocalToUnicode (const char *ins, ntfschar **outs);
@@ -41,6 +41,7 @@
 #include "ntfsdir.h"
 #include "gekko_io.h"
 #include "cache.h"
+#include "pathidx.h"
 #include "mem_allocate.h"
 
 // NTFS device driver devoptab
@@ -408,6 +409,77 @@ void ntfsInit (void)
 //    return 0;
 //}
 
+#ifndef NTFS_HOST_BUILD
+#if UEFI_PREFETCH_SIZE
+/* Prefetch the reads recorded in the boot profile of the volume, if any. */
+static void ntfsPrefetchProfile (ntfs_vd *vd)
+{
+    ntfs_inode *ni;
+    ntfs_attr *na;
+    void *profile;
+    s64 size, bytes;
+
+    ni = ntfs_pathname_to_inode(vd->vol, NULL, UEFI_PREFETCH_PROFILE);
+    if (!ni)
+        return;
+    na = ntfs_attr_open(ni, AT_DATA, AT_UNNAMED, 0);
+    if (!na) {
+        ntfs_inode_close(ni);
+        return;
+    }
+    size = na->data_size;
+    if (size > 0 && size <= UEFI_PREFETCH_PROFILE_SIZE) {
+        profile = ntfs_alloc(size);
+        if (profile) {
+            if (ntfs_attr_pread(na, 0, size, profile) == size) {
+                bytes = ntfs_device_prefetch(vd->dev, profile, size,
+                        UEFI_PREFETCH_SIZE, UEFI_PREFETCH_GAP);
+                if (bytes < 0)
+                    ntfs_log_perror("boot profile not prefetched\n");
+                else
+                    ntfs_log_debug("prefetched %lld bytes\n",
+                            (long long)bytes);
+            }
+            ntfs_free(profile);
+        }
+    }
+    ntfs_attr_close(na);
+    ntfs_inode_close(ni);
+}
+#endif /* UEFI_PREFETCH_SIZE */
+
+#if UEFI_PATH_INDEX_SIZE
+/* Attach the path index stored on the volume, if any. */
+static void ntfsLoadPathIndex (ntfs_vd *vd)
+{
+    ntfs_inode *ni;
+    ntfs_attr *na;
+    void *data;
+    s64 size;
+
+    ni = ntfs_pathname_to_inode(vd->vol, NULL, UEFI_PATH_INDEX);
+    if (!ni)
+        return;
+    na = ntfs_attr_open(ni, AT_DATA, AT_UNNAMED, 0);
+    if (!na) {
+        ntfs_inode_close(ni);
+        return;
+    }
+    size = na->data_size;
+    if (size > 0 && size <= UEFI_PATH_INDEX_SIZE) {
+        data = ntfs_alloc(size);
+        if (data) {
+            if (ntfs_attr_pread(na, 0, size, data) != size ||
+                ntfs_path_index_attach(vd->vol, data, size, true))
+                ntfs_free(data);
+        }
+    }
+    ntfs_attr_close(na);
+    ntfs_inode_close(ni);
+}
+#endif /* UEFI_PATH_INDEX_SIZE */
+
+/* Host builds mount volume images with ntfs_image_mount() instead. */
 ntfs_vd *ntfsMount (const char *name, struct _NTFS_VOLUME *interface, sec_t startSector, u32 cachePageCount, u32 cachePageSize, u32 flags)
 {
     ntfs_vd *vd = NULL;
@@ -527,6 +599,13 @@ ntfs_vd *ntfsMount (const char *name, struct _NTFS_VOLUME *interface, sec_t star
 	if (flags & NTFS_IGNORE_CASE)
 		ntfs_set_ignore_case(vd->vol);
 
+#if UEFI_PREFETCH_SIZE
+    ntfsPrefetchProfile(vd);
+#endif
+#if UEFI_PATH_INDEX_SIZE
+    ntfsLoadPathIndex(vd);
+#endif
+
     // Initialise the volume descriptor
     if (ntfsInitVolume(vd)) {
         ntfs_umount(vd->vol, true);
@@ -547,6 +626,7 @@ ntfs_vd *ntfsMount (const char *name, struct _NTFS_VOLUME *interface, sec_t star
 	Print(L"ntfsMount done.\n");
     return vd;
 }
+#endif /* NTFS_HOST_BUILD */
 
 void ntfsUnmount (const char *name, bool force)
 {
@@ -27,6 +27,7 @@
 #define CACHE_LOOKUP_SIZE 64	/* lookup cache, zero or >= 3 and not too big */
 #define CACHE_SECURID_SIZE 16    /* securid cache, zero or >= 3 and not too big */
 #define CACHE_LEGACY_SIZE 8    /* legacy cache size, zero or >= 3 and not too big */
+#define CACHE_DIRFILTER_SIZE 16	/* directory name filters, zero or >= 3 and not too big */
 
 #define FORCE_FORMAT_v1x 0	/* Insert security data as in NTFS v1.x */
 #define OWNERFROMACL 1		/* Get the owner from ACL (not Windows owner) */
@@ -39,6 +40,48 @@ enum {
 	DEFSECBASE = 10000
 };
 
+/*
+ *		Parameters for I/O tracing
+ */
+
+	/*
+	 * number of device requests kept by the UEFI device in its I/O
+	 * trace (see ntfs_device_trace_start()), 0 for no trace
+	 */
+#define UEFI_IO_TRACE_SIZE 0
+
+/*
+ *		Parameters for boot profile prefetch
+ */
+
+	/*
+	 * file holding the I/O trace of an earlier boot, read by the UEFI
+	 * driver at mount to prefetch the same reads
+	 */
+#define UEFI_PREFETCH_PROFILE "\\EFI\\ntfs.prefetch"
+	/* largest profile read */
+#define UEFI_PREFETCH_PROFILE_SIZE 0x100000
+	/*
+	 * most bytes of recorded reads prefetched, 0 for no prefetch. The
+	 * prefetched data stays allocated for as long as the volume is
+	 * mounted, so this is opt-in: 0x800000 suits a boot volume
+	 */
+#define UEFI_PREFETCH_SIZE 0
+	/* largest hole between two reads filled to merge them */
+#define UEFI_PREFETCH_GAP 0x10000
+
+/*
+ *		Parameters for the path index
+ */
+
+	/*
+	 * file holding a path index built by host/mkpathidx, loaded by the
+	 * UEFI driver at mount (see ntfs_path_index_attach())
+	 */
+#define UEFI_PATH_INDEX "\\EFI\\ntfs.paths"
+	/* largest path index loaded, 0 for no path index */
+#define UEFI_PATH_INDEX_SIZE 0x1000000
+
 /*
  *		Parameters for compression
  */
@@ -56,6 +99,30 @@ enum {
 
 #define DEFAULT_DMTIME 60 /* default 1mn for delay_mtime */
 
+/*
+ *		Parameters for directory enumeration
+ *
+ *	ntfs_readdir() reads consecutive in-use index blocks with one
+ *	request of up to this many bytes.
+ */
+
+#define NTFS_READDIR_CHUNK 0x40000
+
+/*
+ *		Parameters for directory name filters
+ *
+ *	A directory listed to its end, or small enough to be listed when a
+ *	lookup misses, gets a Bloom filter of its names, so that lookups of
+ *	missing names are answered without reading its index. With ten bits
+ *	and seven probes per name, about one missing name in a hundred still
+ *	goes to the index.
+ */
+
+#define NTFS_DIRFILTER_BITS 10		/* filter bits per name */
+#define NTFS_DIRFILTER_PROBES 7		/* bits set and tested per name */
+#define NTFS_DIRFILTER_SCAN 0x40000	/* largest index allocation listed
+					   to build a filter after a miss */
+
 /*
  *		Use of big write buffers
  *
@@ -0,0 +1,426 @@
+/**
+ * pathidx.c - Path index, to open a file without walking its directories.
+ *
+ * ntfs_pathname_to_inode() looks up each name of a path in the index of its
+ * directory, reading the record of every directory on the way and the index
+ * blocks down to the name. A path index, built from the whole $MFT by
+ * host/mkpathidx, maps full paths to mft references with one binary search
+ * in memory instead.
+ *
+ * The index may be older than the volume, so a hit is only used once the
+ * record it leads to is found to still hold the last name of the path under
+ * the parent directory of the index, with the sequence number of the index,
+ * and the same holds of every parent up to the root. Parents are checked
+ * once per mount, and again after any index of the volume changed, so that
+ * a hit usually costs the read of the record of the file, which opening it
+ * takes anyway. Misses and failed checks are left to the directory walk.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "types.h"
+#include "layout.h"
+#include "attrib.h"
+#include "inode.h"
+#include "volume.h"
+#include "index.h"
+#include "dir.h"
+#include "unistr.h"
+#include "pathidx.h"
+#include "logging.h"
+#include "misc.h"
+
+static __inline BOOL pix_test(const u8 *bitmap, u32 i)
+{
+	return (bitmap[i >> 3] >> (i & 7)) & 1;
+}
+
+static __inline void pix_set(u8 *bitmap, u32 i)
+{
+	bitmap[i >> 3] |= 1 << (i & 7);
+}
+
+static __inline u16 pix_upcase(const ntfs_volume *vol, ntfschar c)
+{
+	u16 u = le16_to_cpu(c);
+
+	if (u < vol->upcase_len)
+		u = le16_to_cpu(vol->upcase[u]);
+	return u;
+}
+
+/**
+ * ntfs_path_index_collate - order of two keys of a path index
+ * @vol:	volume whose upcase table is used
+ * @key1:	first key
+ * @key1_len:	length of @key1 in characters
+ * @key2:	second key
+ * @key2_len:	length of @key2 in characters
+ *
+ * Keys are compared character by character once upcased, then by length,
+ * so that keys which only differ by case are equal. This is the order in
+ * which host/mkpathidx writes the entries.
+ *
+ * Return -1 if @key1 collates before @key2, 0 if they are equal and 1 if
+ * @key1 collates after @key2.
+ */
+int ntfs_path_index_collate(const ntfs_volume *vol,
+		const ntfschar *key1, u32 key1_len,
+		const ntfschar *key2, u32 key2_len)
+{
+	u32 i, n;
+	u16 c1, c2;
+
+	n = key1_len < key2_len ? key1_len : key2_len;
+	for (i = 0; i < n; i++) {
+		c1 = pix_upcase(vol, key1[i]);
+		c2 = pix_upcase(vol, key2[i]);
+		if (c1 != c2)
+			return c1 < c2 ? -1 : 1;
+	}
+	if (key1_len != key2_len)
+		return key1_len < key2_len ? -1 : 1;
+	return 0;
+}
+
+/**
+ * ntfs_path_index_attach - use a path index for the lookups of a volume
+ * @vol:	volume the index was built for
+ * @data:	the index, as written by host/mkpathidx
+ * @size:	bytes at @data
+ * @owned:	free @data when the index is detached
+ *
+ * The index is used in place: @data must stay valid, and unchanged, until
+ * ntfs_path_index_detach() or the unmount. An index already attached to
+ * @vol is detached first.
+ *
+ * Return 0 on success, or -1 with errno set to EINVAL if @data is not a
+ * path index, or ENOMEM. On failure @data is left to the caller.
+ */
+int ntfs_path_index_attach(ntfs_volume *vol, const void *data, size_t size,
+		BOOL owned)
+{
+	const NTFS_PATH_INDEX_HEADER *h = data;
+	struct ntfs_path_index *pix;
+	u32 count, eoff, koff, ksize, restart, max_key;
+
+	if (!vol || !data || size < sizeof(*h)) {
+		errno = EINVAL;
+		return -1;
+	}
+	count = le32_to_cpu(h->count);
+	restart = le16_to_cpu(h->restart);
+	max_key = le32_to_cpu(h->max_key);
+	eoff = le32_to_cpu(h->entries_offset);
+	koff = le32_to_cpu(h->keys_offset);
+	ksize = le32_to_cpu(h->keys_size);
+	if (le32_to_cpu(h->magic) != NTFS_PATH_INDEX_MAGIC ||
+	    le16_to_cpu(h->version) != NTFS_PATH_INDEX_VERSION ||
+	    !restart || !count || !max_key || max_key > 0xffff ||
+	    MREF_LE(h->root) != FILE_root ||
+	    eoff < sizeof(*h) || (eoff & 7) || eoff > size ||
+	    count > (size - eoff) / sizeof(NTFS_PATH_INDEX_ENTRY) ||
+	    koff < eoff + (u64)count * sizeof(NTFS_PATH_INDEX_ENTRY) ||
+	    (koff & 1) || koff > size || ksize > size - koff || ksize < 4) {
+		ntfs_log_error("Invalid path index.\n");
+		errno = EINVAL;
+		return -1;
+	}
+
+	pix = ntfs_calloc(sizeof(*pix));
+	if (!pix)
+		return -1;
+	pix->key = ntfs_malloc((max_key + 1) * sizeof(ntfschar));
+	pix->verified = ntfs_calloc((count >> 3) + 1);
+	pix->stale = ntfs_calloc((count >> 3) + 1);
+	if (!pix->key || !pix->verified || !pix->stale) {
+		free(pix->key);
+		free(pix->verified);
+		free(pix->stale);
+		free(pix);
+		return -1;
+	}
+	pix->data = data;
+	pix->size = size;
+	pix->owned = owned;
+	pix->entries = (const NTFS_PATH_INDEX_ENTRY *)((const u8 *)data + eoff);
+	pix->keys = (const u8 *)data + koff;
+	pix->keys_size = ksize;
+	pix->count = count;
+	pix->restart = restart;
+	pix->max_key = max_key;
+	pix->root = le64_to_cpu(h->root);
+	pix->index_gen = ntfs_index_gen;
+
+	ntfs_path_index_detach(vol);
+	vol->path_index = pix;
+	return 0;
+}
+
+/**
+ * ntfs_path_index_detach - stop using the path index of a volume
+ * @vol:	volume to detach the index from
+ */
+void ntfs_path_index_detach(ntfs_volume *vol)
+{
+	struct ntfs_path_index *pix = vol->path_index;
+
+	if (!pix)
+		return;
+	if (pix->owned)
+		free((void *)pix->data);
+	free(pix->key);
+	free(pix->verified);
+	free(pix->stale);
+	free(pix);
+	vol->path_index = NULL;
+}
+
+/*
+ * Decode key @i into pix->key, which holds the first @prev_len characters of
+ * key @i - 1. Return the length of the key, or -1 if the index is corrupt.
+ */
+static int pix_key(struct ntfs_path_index *pix, u32 i, int prev_len)
+{
+	const u8 *p;
+	u32 off, shared, len;
+
+	off = le32_to_cpu(pix->entries[i].key);
+	if ((off & 1) || off > pix->keys_size - 4)
+		return -1;
+	p = pix->keys + off;
+	shared = le16_to_cpup(p);
+	len = le16_to_cpup(p + 2);
+	if (shared > (u32)prev_len || shared + len > pix->max_key ||
+	    len * sizeof(ntfschar) > pix->keys_size - off - 4)
+		return -1;
+	memcpy(pix->key + shared, p + 4, len * sizeof(ntfschar));
+	return shared + len;
+}
+
+/*
+ * Find the entry whose key collates equal to @name, leaving the key in
+ * pix->key. Return the entry, or -1 if there is none.
+ */
+static s64 pix_search(const ntfs_volume *vol, struct ntfs_path_index *pix,
+		const ntfschar *name, u32 len)
+{
+	u32 lo, hi, mid, i, end;
+	int klen, rc;
+
+	/* The last run of keys whose first key is not after @name... */
+	lo = 0;
+	hi = (pix->count + pix->restart - 1) / pix->restart;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		klen = pix_key(pix, mid * pix->restart, 0);
+		if (klen < 0)
+			goto corrupt;
+		rc = ntfs_path_index_collate(vol, name, len, pix->key, klen);
+		if (!rc)
+			return mid * pix->restart;
+		if (rc < 0)
+			hi = mid;
+		else
+			lo = mid;
+	}
+	/* ...holds @name if the index does. */
+	end = (lo + 1) * pix->restart;
+	if (end > pix->count)
+		end = pix->count;
+	klen = 0;
+	for (i = lo * pix->restart; i < end; i++) {
+		klen = pix_key(pix, i, klen);
+		if (klen < 0)
+			goto corrupt;
+		rc = ntfs_path_index_collate(vol, name, len, pix->key, klen);
+		if (!rc)
+			return i;
+		if (rc < 0)
+			break;
+	}
+	return -1;
+corrupt:
+	ntfs_log_debug("Corrupt key in path index.\n");
+	return -1;
+}
+
+/* Start of the last name of the first @len characters of pix->key. */
+static u32 pix_name_start(const struct ntfs_path_index *pix, u32 len)
+{
+	while (len && pix->key[len - 1] != const_cpu_to_le16(PATH_SEP))
+		len--;
+	return len;
+}
+
+/*
+ * Check that @ni still is the file of entry @i: the record is in use with
+ * the sequence number of the entry, and holds @name under the parent of the
+ * entry. Parents must also be directories.
+ */
+static BOOL pix_check(const struct ntfs_path_index *pix, ntfs_inode *ni,
+		u32 i, const ntfschar *name, u32 len, BOOL dir)
+{
+	ntfs_attr_search_ctx *ctx;
+	FILE_NAME_ATTR *fn;
+	MFT_REF mref, parent;
+	u32 p;
+	BOOL found = FALSE;
+
+	mref = le64_to_cpu(pix->entries[i].mref);
+	if (!(ni->mrec->flags & MFT_RECORD_IN_USE) ||
+	    le16_to_cpu(ni->mrec->sequence_number) != MSEQNO(mref) ||
+	    (dir && !(ni->mrec->flags & MFT_RECORD_IS_DIRECTORY)))
+		return FALSE;
+	p = le32_to_cpu(pix->entries[i].parent);
+	if (p == NTFS_PATH_INDEX_ROOT)
+		parent = pix->root;
+	else if (p < pix->count)
+		parent = le64_to_cpu(pix->entries[p].mref);
+	else
+		return FALSE;
+
+	ctx = ntfs_attr_get_search_ctx(ni, NULL);
+	if (!ctx)
+		return FALSE;
+	while (!found && !ntfs_attr_lookup(AT_FILE_NAME, AT_UNNAMED, 0,
+			CASE_SENSITIVE, 0, NULL, 0, ctx)) {
+		if (ctx->attr->non_resident ||
+		    le32_to_cpu(ctx->attr->value_length) <
+				sizeof(FILE_NAME_ATTR) + len * sizeof(ntfschar))
+			continue;
+		fn = (FILE_NAME_ATTR *)((u8 *)ctx->attr +
+				le16_to_cpu(ctx->attr->value_offset));
+		found = le64_to_cpu(fn->parent_directory) == parent &&
+			fn->file_name_length == len &&
+			!memcmp(fn->file_name, name, len * sizeof(ntfschar));
+	}
+	ntfs_attr_put_search_ctx(ctx);
+	return found;
+}
+
+/**
+ * ntfs_path_index_lookup - open a file from the path index of its volume
+ * @vol:	volume to look in
+ * @pathname:	path from the root, without leading separator
+ *
+ * Find @pathname in the path index attached to @vol and open its inode once
+ * it passed the checks described at the top of this file. Names compare as
+ * in ntfs_inode_lookup_by_name(): ignoring case unless the volume is mounted
+ * case sensitive. DOS names are not in the index.
+ *
+ * Return the inode, or NULL if @vol has no path index, @pathname is not in
+ * it or its entry turned out to be stale; errno is left unchanged, the
+ * caller is expected to walk the directories instead.
+ */
+ntfs_inode *ntfs_path_index_lookup(ntfs_volume *vol, const char *pathname)
+{
+	struct ntfs_path_index *pix = vol->path_index;
+	ntfs_inode *ni = NULL, *dir_ni;
+	ntfschar *uname = NULL;
+	s64 found;
+	u32 i, p, leaf, start, end;
+	int len, err = errno;
+	BOOL ok;
+
+	if (!pix || !*pathname)
+		return NULL;
+	len = ntfs_mbstoucs(pathname, &uname);
+	if (len <= 0 || (u32)len > pix->max_key)
+		goto out;
+	if (pix->index_gen != ntfs_index_gen) {
+		/* An index changed, a parent may have been renamed. */
+		memset(pix->verified, 0, (pix->count >> 3) + 1);
+		pix->index_gen = ntfs_index_gen;
+	}
+	found = pix_search(vol, pix, uname, len);
+	if (found < 0)
+		goto out;
+	i = leaf = (u32)found;
+	if (pix_test(pix->stale, i) || (NVolCaseSensitive(vol) &&
+			memcmp(uname, pix->key, len * sizeof(ntfschar))))
+		goto out;
+
+	/* The file first, with the record opening it reads anyway... */
+	ni = ntfs_inode_open(vol, MREF(le64_to_cpu(pix->entries[i].mref)));
+	if (!ni)
+		goto out;
+	start = pix_name_start(pix, len);
+	if (!pix_check(pix, ni, i, pix->key + start, len - start, FALSE)) {
+		pix_set(pix->stale, i);
+		goto close;
+	}
+	/* ...then its parents, up to the first one already verified. */
+	end = start;
+	while (!pix_test(pix->verified, i)) {
+		p = le32_to_cpu(pix->entries[i].parent);
+		if (!end) {
+			if (p != NTFS_PATH_INDEX_ROOT)
+				goto corrupt;
+			break;
+		}
+		if (p >= pix->count)
+			goto corrupt;
+		i = p;
+		end--;
+		if (pix_test(pix->verified, i))
+			break;
+		if (pix_test(pix->stale, i))
+			goto close;
+		start = pix_name_start(pix, end);
+		dir_ni = ntfs_inode_open(vol,
+				MREF(le64_to_cpu(pix->entries[i].mref)));
+		if (!dir_ni)
+			goto close;
+		ok = pix_check(pix, dir_ni, i, pix->key + start, end - start,
+				TRUE);
+		ntfs_inode_close(dir_ni);
+		if (!ok) {
+			pix_set(pix->stale, i);
+			goto close;
+		}
+		end = start;
+	}
+	for (i = leaf; i != NTFS_PATH_INDEX_ROOT &&
+			!pix_test(pix->verified, i);
+			i = le32_to_cpu(pix->entries[i].parent))
+		pix_set(pix->verified, i);
+	NVolStatAdd(vol, path_index_hits, 1);
+	goto out;
+corrupt:
+	ntfs_log_debug("Corrupt parent in path index.\n");
+close:
+	ntfs_inode_close(ni);
+	ni = NULL;
+out:
+	free(uname);
+	errno = err;
+	return ni;
+}
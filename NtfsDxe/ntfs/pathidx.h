@@ -0,0 +1,114 @@
+/*
+ * pathidx.h - Exports for the path index.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NTFS_PATHIDX_H
+#define _NTFS_PATHIDX_H
+
+#include "types.h"
+#include "layout.h"
+#include "inode.h"
+#include "volume.h"
+
+/*
+ * A path index as written by host/mkpathidx: this header, @count entries and
+ * then the keys, all little endian. The index is used in place, from a
+ * buffer or a mapping of the file.
+ *
+ * Entry i has key i, the path of the file from the root with '\' between
+ * the names, and the entries are sorted by ntfs_path_index_collate() of
+ * their keys. Keys keep the case of the names. Each key starts with two
+ * le16, the number of characters it shares with the previous key and the
+ * number of characters that follow; every @restart keys, starting with the
+ * first, a key shares nothing so that it can be read without the others.
+ *
+ * @journal_id and @usn locate the volume's change journal as it was when the
+ * $MFT was read for the index, so that mkpathidx -u can bring the index up
+ * to date from the journal; both are zero if the volume had no journal.
+ */
+#define NTFS_PATH_INDEX_MAGIC	0x5850544e	/* "NTPX" */
+#define NTFS_PATH_INDEX_VERSION	2
+
+/* Default number of keys between two keys stored in full. */
+#define NTFS_PATH_INDEX_RESTART	16
+
+/* Parent of the entries of the names in the root directory. */
+#define NTFS_PATH_INDEX_ROOT	0xffffffff
+
+#pragma pack(push, 1)
+typedef struct {
+	le32 magic;		/* NTFS_PATH_INDEX_MAGIC */
+	le16 version;		/* NTFS_PATH_INDEX_VERSION */
+	le16 restart;		/* Keys between two keys stored in full. */
+	le64 root;		/* Mft reference of the root directory. */
+	le32 count;		/* Entries. */
+	le32 max_key;		/* Characters in the longest key. */
+	le32 entries_offset;	/* Offset of the entries in the index. */
+	le32 keys_offset;	/* Offset of the keys in the index. */
+	le32 keys_size;		/* Bytes of keys. */
+	le32 reserved;
+	le64 journal_id;	/* $UsnJrnl the index was built at. */
+	sle64 usn;		/* First usn not reflected in the index. */
+} NTFS_PATH_INDEX_HEADER;
+
+typedef struct {
+	le64 mref;		/* Mft reference of the file. */
+	le32 parent;		/* Entry of the parent directory, or
+				   NTFS_PATH_INDEX_ROOT. */
+	le32 key;		/* Offset of the key from keys_offset. */
+} NTFS_PATH_INDEX_ENTRY;
+#pragma pack(pop)
+
+/**
+ * struct ntfs_path_index - a path index attached to a volume
+ *
+ * An entry is verified once its record and those of all its parents were
+ * found to still hold the names of its key; @verified is cleared whenever
+ * an index of the volume changes. An entry that failed the check is marked
+ * in @stale and no longer used.
+ */
+struct ntfs_path_index {
+	const u8 *data;			/* The index. */
+	size_t size;			/* Bytes at @data. */
+	BOOL owned;			/* @data is freed with the index. */
+	const NTFS_PATH_INDEX_ENTRY *entries;
+	const u8 *keys;
+	u32 keys_size;
+	u32 count;
+	u32 restart;
+	u32 max_key;
+	MFT_REF root;
+	ntfschar *key;			/* Key being decoded, max_key + 1. */
+	u8 *verified;			/* Bitmap of verified entries. */
+	u8 *stale;			/* Bitmap of stale entries. */
+	u32 index_gen;			/* ntfs_index_gen when @verified was
+					   last valid. */
+};
+
+extern int ntfs_path_index_collate(const ntfs_volume *vol,
+		const ntfschar *key1, u32 key1_len,
+		const ntfschar *key2, u32 key2_len);
+
+extern int ntfs_path_index_attach(ntfs_volume *vol, const void *data,
+		size_t size, BOOL owned);
+extern void ntfs_path_index_detach(ntfs_volume *vol);
+
+extern ntfs_inode *ntfs_path_index_lookup(ntfs_volume *vol,
+		const char *pathname);
+
+#endif /* defined _NTFS_PATHIDX_H */
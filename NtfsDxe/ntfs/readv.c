@@ -0,0 +1,320 @@
+/**
+ * readv.c - Vectored reads of attributes.
+ *
+ * ntfs_attr_pread() reads one range of one attribute, its runs in the order
+ * of the file. A loader pulling many small files, or scattered pieces of a
+ * large one, makes a device request per run and seeks back and forth
+ * between them. ntfs_attr_preadv() takes all the ranges at once, looks up
+ * where they lie through the extent map, and reads them in one sweep of
+ * increasing device positions, reading across the small gaps between
+ * neighbours instead of making a request for each.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "types.h"
+#include "attrib.h"
+#include "volume.h"
+#include "device.h"
+#include "extmap.h"
+#include "readv.h"
+#include "logging.h"
+#include "misc.h"
+
+/* Extents asked for at once while translating a range. */
+#define READV_EXTENTS	32
+
+/**
+ * struct readv_piece - part of a range, read as a unit
+ * @pos:	byte offset on the device, -1 if the piece has to be read
+ *		through ntfs_attr_pread() (compressed, resident, encrypted)
+ * @offset:	byte offset of the piece in its attribute
+ * @count:	bytes in the piece
+ * @dst:	where the bytes go
+ * @req:	index of the range of the piece
+ */
+struct readv_piece {
+	s64 pos;
+	s64 offset;
+	s64 count;
+	u8 *dst;
+	int req;
+};
+
+/* Append a piece to @*p, growing it. Return FALSE if out of memory. */
+static BOOL readv_add(struct readv_piece **p, int *n, int *size, s64 pos,
+		s64 offset, s64 count, u8 *dst, int req)
+{
+	struct readv_piece *q;
+
+	if (*n == *size) {
+		q = ntfs_malloc((*size * 2 + 64) * sizeof(*q));
+		if (!q) {
+			errno = ENOMEM;
+			return FALSE;
+		}
+		if (*n)
+			memcpy(q, *p, *n * sizeof(*q));
+		free(*p);
+		*p = q;
+		*size = *size * 2 + 64;
+	}
+	q = &(*p)[(*n)++];
+	q->pos = pos;
+	q->offset = offset;
+	q->count = count;
+	q->dst = dst;
+	q->req = req;
+	return TRUE;
+}
+
+/*
+ *		Sort pieces by position (heapsort, as ntfs_device_prefetch()
+ *	does, no libc qsort in the firmware)
+ */
+
+static void readv_sift(struct readv_piece *p, int i, int n)
+{
+	struct readv_piece tmp;
+	int child;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n && p[child + 1].pos > p[child].pos)
+			child++;
+		if (p[i].pos >= p[child].pos)
+			break;
+		tmp = p[i];
+		p[i] = p[child];
+		p[child] = tmp;
+		i = child;
+	}
+}
+
+static void readv_sort(struct readv_piece *p, int n)
+{
+	struct readv_piece tmp;
+	int i;
+
+	for (i = n / 2; i-- > 0; )
+		readv_sift(p, i, n);
+	while (n-- > 1) {
+		tmp = p[0];
+		p[0] = p[n];
+		p[n] = tmp;
+		readv_sift(p, 0, n);
+	}
+}
+
+/* Mark the range of @q failed, keeping the first error for the caller. */
+static void readv_fail(ntfs_readv_req *reqs, const struct readv_piece *q,
+		int *err)
+{
+	reqs[q->req].result = -1;
+	if (!*err)
+		*err = errno ? errno : EIO;
+}
+
+/* Read a piece on its own. */
+static void readv_piece_read(ntfs_volume *vol, ntfs_readv_req *reqs,
+		const struct readv_piece *q, int *err)
+{
+	s64 br;
+
+	if (q->pos < 0)
+		br = ntfs_attr_pread(reqs[q->req].na, q->offset, q->count,
+				q->dst);
+	else
+		br = ntfs_pread(vol->dev, q->pos, q->count, q->dst);
+	if (br != q->count) {
+		if (br >= 0)
+			errno = EIO;
+		readv_fail(reqs, q, err);
+	}
+}
+
+/*
+ * Split the ranges of @reqs into pieces by extent, zeroing the holes on the
+ * way. Return the number of pieces, or -1 if out of memory.
+ */
+static int readv_translate(ntfs_volume *vol, ntfs_readv_req *reqs, int count,
+		struct readv_piece **p, int *err)
+{
+	ntfs_extent ext[READV_EXTENTS];
+	ntfs_readv_req *r;
+	s64 off, end, len;
+	int i, j, n, np = 0, size = 0;
+	u8 *dst;
+
+	for (i = 0; i < count; i++) {
+		r = &reqs[i];
+		if (!r->na || r->na->ni->vol != vol || r->offset < 0 ||
+		    r->count < 0 || (!r->buf && r->count)) {
+			r->result = -1;
+			if (!*err)
+				*err = EINVAL;
+			continue;
+		}
+		end = r->na->data_size;
+		if (r->offset >= end) {
+			r->result = 0;
+			continue;
+		}
+		if (end - r->offset > r->count)
+			end = r->offset + r->count;
+		r->result = end - r->offset;
+		for (off = r->offset; off < end; ) {
+			n = ntfs_attr_get_extents(r->na, off, ext,
+					READV_EXTENTS);
+			if (n <= 0) {
+				if (!n)
+					errno = EIO;
+				r->result = -1;
+				if (!*err)
+					*err = errno;
+				break;
+			}
+			for (j = 0; j < n && off < end; j++) {
+				len = ext[j].offset + ext[j].length;
+				if (len > end)
+					len = end;
+				len -= off;
+				dst = (u8 *)r->buf + (off - r->offset);
+				if (ext[j].flags & (NTFS_EXTENT_HOLE |
+						NTFS_EXTENT_UNINIT))
+					memset(dst, 0, len);
+				else if (!readv_add(p, &np, &size,
+						(ext[j].flags &
+						NTFS_EXTENT_NOT_DIRECT) ?
+						-1 : ext[j].pos,
+						off, len, dst, i))
+					return -1;
+				off += len;
+			}
+		}
+	}
+	return np;
+}
+
+/**
+ * ntfs_attr_preadv - read many ranges of attributes in one sweep
+ * @vol:	volume of the attributes
+ * @reqs:	ranges to read, of any attributes opened on @vol
+ * @count:	number of entries in @reqs
+ * @gap:	largest hole between two device ranges read over to merge them
+ *
+ * Read each range of @reqs into its buffer, as ntfs_attr_pread() would,
+ * and set its result. The ranges are first mapped to the device through
+ * the extent map of their attributes. Holes and the parts past the
+ * initialized size are zeroed, compressed, resident and encrypted data are
+ * read through ntfs_attr_pread(). All the rest is sorted by position on
+ * the device, neighbours closer than @gap bytes are merged into requests of
+ * up to NTFS_READV_MAX_MERGE bytes, overlapping ranges are read once, and
+ * the requests are made in increasing positions, straight into the buffers
+ * when the pieces follow each other there as on the device. A merged
+ * request which fails is retried range by range, so that an unreadable gap
+ * does not fail the ranges around it, and without memory for merging every
+ * piece is read on its own.
+ *
+ * Return 0 if every range was read, or -1 with errno set to the first error
+ * met (EINVAL for an invalid range, ENOMEM) with the results of the failed
+ * ranges set to -1. The buffers of failed ranges hold partial data.
+ */
+int ntfs_attr_preadv(ntfs_volume *vol, ntfs_readv_req *reqs, int count,
+		u32 gap)
+{
+	struct readv_piece *p = NULL, *g, *q, *last;
+	ntfs_io_tag tag;
+	s64 start, end, qend, br;
+	u8 *buf = NULL;
+	BOOL direct;
+	int np, err = 0;
+
+	if (!vol || count < 0 || (count && !reqs)) {
+		errno = EINVAL;
+		return -1;
+	}
+	np = readv_translate(vol, reqs, count, &p, &err);
+	if (np < 0) {
+		free(p);
+		return -1;
+	}
+	readv_sort(p, np);
+
+	/* The pieces with no device position sort first. */
+	for (g = p; g < p + np && g->pos < 0; g++)
+		readv_piece_read(vol, reqs, g, &err);
+
+	tag = ntfs_device_set_io_tag(vol->dev, NTFS_IO_DATA);
+	for (; g < p + np; g = last + 1) {
+		start = g->pos;
+		end = g->pos + g->count;
+		direct = TRUE;
+		for (last = g; last + 1 < p + np; last++) {
+			q = last + 1;
+			qend = q->pos + q->count > end ? q->pos + q->count : end;
+			if (q->pos > end + gap ||
+			    qend - start > NTFS_READV_MAX_MERGE)
+				break;
+			/* Back to back on the device and in memory. */
+			if (q->pos != end || q->dst != last->dst + last->count)
+				direct = FALSE;
+			end = qend;
+		}
+		if (direct && last > g) {
+			br = ntfs_pread(vol->dev, start, end - start, g->dst);
+			for (q = g; q <= last && br != end - start; q++)
+				readv_piece_read(vol, reqs, q, &err);
+			continue;
+		}
+		if (!buf && last > g)
+			buf = ntfs_malloc(NTFS_READV_MAX_MERGE);
+		if (last == g || !buf) {
+			for (q = g; q <= last; q++)
+				readv_piece_read(vol, reqs, q, &err);
+			continue;
+		}
+		br = ntfs_pread(vol->dev, start, end - start, buf);
+		for (q = g; q <= last; q++) {
+			if (br == end - start)
+				memcpy(q->dst, buf + (q->pos - start),
+						q->count);
+			else
+				readv_piece_read(vol, reqs, q, &err);
+		}
+	}
+	ntfs_device_set_io_tag(vol->dev, tag);
+	free(buf);
+	free(p);
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * readv.h - Exports for vectored reads of attributes.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NTFS_READV_H
+#define _NTFS_READV_H
+
+#include "types.h"
+#include "attrib.h"
+#include "volume.h"
+
+/* Largest device request ntfs_attr_preadv() makes by merging ranges. */
+#define NTFS_READV_MAX_MERGE	(1024 * 1024)
+
+/**
+ * struct ntfs_readv_req - one range of a vectored read
+ * @na:		attribute to read, opened on the volume of the read
+ * @offset:	byte offset in @na of the first byte wanted
+ * @count:	number of bytes wanted
+ * @buf:	destination of the data
+ * @result:	set to the number of bytes read, fewer than @count at the
+ *		end of the data, or to -1 if the range could not be read
+ */
+typedef struct {
+	ntfs_attr *na;
+	s64 offset;
+	s64 count;
+	void *buf;
+	s64 result;
+} ntfs_readv_req;
+
+extern int ntfs_attr_preadv(ntfs_volume *vol, ntfs_readv_req *reqs,
+		int count, u32 gap);
+
+#endif /* defined _NTFS_READV_H */
@@ -137,9 +137,11 @@ static u64 ntfs_fix_file_name(ntfs_inode *dir_ni, ntfschar *uname,
 	INDEX_ENTRY *entry;
 	FILE_NAME_ATTR *found;
 	
-	struct _find {
+	/* Room for the name after the attribute, its file_name[] is empty */
+	union _find {
 		FILE_NAME_ATTR attr;
-		//ntfschar file_name[NTFS_MAX_NAME_LEN + 1];
+		u8 room[sizeof(FILE_NAME_ATTR)
+				+ (NTFS_MAX_NAME_LEN + 1) * sizeof(ntfschar)];
 	} find;
 
 	mref = (u64)-1; /* default return (not found) */
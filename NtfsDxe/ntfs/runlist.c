@@ -1097,7 +1097,9 @@ s64 ntfs_rl_pread(const ntfs_volume *vol, const runlist_element *rl,
 		const s64 pos, s64 count, void *b)
 {
 	s64 bytes_read, to_read, ofs, total;
-	int err = EIO;
+	const void *src;
+	BOOL borrow;
+	int err = EIO, eo;
 
 	if (!vol || !rl || pos < 0 || count < 0) {
 		errno = EINVAL;
@@ -1114,6 +1116,8 @@ s64 ntfs_rl_pread(const ntfs_volume *vol, const runlist_element *rl,
 		ofs += (rl->length << vol->cluster_size_bits);
 	/* Offset in the run at which to begin reading. */
 	ofs = pos - ofs;
+	/* Only mapped or prefetched devices can lend their contents. */
+	borrow = vol->dev->d_ops->borrow || vol->dev->d_prefetch;
 	for (total = 0LL; count; rl++, ofs = 0) {
 		if (!rl->length)
 			goto rl_err_out;
@@ -1133,6 +1137,21 @@ s64 ntfs_rl_pread(const ntfs_volume *vol, const runlist_element *rl,
 		/* It is a real lcn, read it from the volume. */
 		to_read = min(count, (rl->length << vol->cluster_size_bits) -
 				ofs);
+		/* A mapped device is copied from directly, run by run. */
+		if (borrow) {
+			eo = errno;
+			src = ntfs_device_borrow(vol->dev, (rl->lcn <<
+					vol->cluster_size_bits) + ofs, to_read);
+			if (src) {
+				memcpy(b, src, to_read);
+				total += to_read;
+				count -= to_read;
+				b = (u8*)b + to_read;
+				continue;
+			}
+			/* Not lent: read it, the failure is not an error. */
+			errno = eo;
+		}
 retry:
 		bytes_read = ntfs_pread(vol->dev, (rl->lcn <<
 				vol->cluster_size_bits) + ofs, to_read, b);
@@ -341,7 +341,7 @@ char *ntfs_sid_to_mbs(const SID *sid, char *sid_str, size_t sid_str_size)
 	if (!sid->identifier_authority.high_part)
 		i = snprintf(s, cnt, "%lu", (unsigned long)u);
 	else
-		i = snprintf(s, cnt, "0x%lx", (unsigned long long)u);
+		i = snprintf(s, cnt, "0x%llx", (unsigned long long)u);
 	if (i < 0 || i >= cnt)
 		goto err_out;
 	s += i;
@@ -3259,11 +3259,12 @@ int ntfs_set_mode(struct SECURITY_CONTEXT *scx, ntfs_inode *ni, mode_t mode)
 int ntfs_sd_add_everyone(ntfs_inode *ni)
 {
 	/* JPA SECURITY_DESCRIPTOR_ATTR *sd; */
-	SECURITY_DESCRIPTOR_RELATIVE *sd;
-	ACL *acl;
-	ACCESS_ALLOWED_ACE *ace;
-	SID *sid;
-	int ret, sd_len;
+	//SECURITY_DESCRIPTOR_RELATIVE *sd;
+	//ACL *acl;
+	//ACCESS_ALLOWED_ACE *ace;
+	//SID *sid;
+	int ret;
+	//int sd_len;
 	unsigned char SID_EVERYONE[80] = {
 	0x01, 0x00, 0x04, 0x80, 0x14, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
 	0x34, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x20, 0x00, 0x00, 0x00, 
@@ -3955,6 +3956,7 @@ le32 ntfs_inherited_id(struct SECURITY_CONTEXT *scx,
 	return (securid);
 }
 
+#if 0 /* not used without getgrgid() */
 /*
  *		Link a group to a member of group
  *
@@ -3996,6 +3998,7 @@ static int link_single_group(struct MAPPING *usermapping, struct passwd *user,
 	}*/
 	return (res);
 }
+#endif
 
 
 /*
@@ -4217,6 +4220,7 @@ int ntfs_build_mapping(struct SECURITY_CONTEXT *scx, const char *usermap_path,
 	if (!usermap_path) usermap_path = MAPPINGFILE;
 	if (usermap_path[0] == '/') {
 		//fd = open(usermap_path,O_RDONLY);
+		fd = -1;
 		if (fd > 0) {
 			firstitem = ntfs_read_mapping(basicread, (void*)&fd);
 			//close(fd);
@@ -65,6 +65,7 @@
 #include "device.h"
 #include "bootsect.h"
 #include "mem_allocate.h"
+#include "param.h"
 
 #define DEV_FD(dev) ((struct _uefi_fd *)dev->d_private)
 
@@ -78,11 +79,20 @@ static bool ntfs_device_uefi_io_writesectors(struct ntfs_device *dev, sec_t sect
 /**
  *
  */
+#if UEFI_IO_TRACE_SIZE
+/* Timestamps of the I/O trace, in time stamp counter ticks. */
+static u64 ntfs_device_uefi_io_clock(void)
+{
+	return AsmReadTsc();
+}
+#endif
+
 static int ntfs_device_uefi_io_open(struct ntfs_device *dev, int flags)
 {
 	NTFS_BOOT_SECTOR *boot;
 	EFI_DISK_IO_PROTOCOL *DiskIo;
 	NTFS_VOLUME *Volume;
+	ntfs_io_tag tag;
 
 	struct _uefi_fd *fd = DEV_FD(dev);
 	Volume = fd->interface;
@@ -124,6 +134,12 @@ static int ntfs_device_uefi_io_open(struct ntfs_device *dev, int flags)
         return -1;
     }
 
+#if UEFI_IO_TRACE_SIZE
+	// Trace the device from its first request; a failure only loses the trace
+	ntfs_device_trace_start(dev, UEFI_IO_TRACE_SIZE,
+			ntfs_device_uefi_io_clock, 0);
+#endif
+
     // Check that there is a valid NTFS boot sector at the start of the device
     boot = (NTFS_BOOT_SECTOR *) ntfs_alloc(MAX_SECTOR_SIZE);
     if(boot == NULL) {
@@ -134,6 +150,9 @@ static int ntfs_device_uefi_io_open(struct ntfs_device *dev, int flags)
 
 	 
 	
+	tag = ntfs_device_set_io_tag(dev, NTFS_IO_BOOT);
+	ntfs_device_trace(dev, 0, sizeof(NTFS_BOOT_SECTOR), 0);
+	ntfs_device_set_io_tag(dev, tag);
 	 if (DiskIo->ReadDisk(DiskIo, Volume->MediaId, 0, sizeof(NTFS_BOOT_SECTOR), boot) != EFI_SUCCESS) {
 		//AsciiPrint("DiskIo ptr %x\n\r", DiskIo);
 		//AsciiPrint("interface ptr %x\n\r", fd->interface);
@@ -145,6 +164,8 @@ static int ntfs_device_uefi_io_open(struct ntfs_device *dev, int flags)
         ntfs_free(boot);
         return -1;
 	}
+	dev->d_reads++;
+	dev->d_read_bytes += sizeof(NTFS_BOOT_SECTOR);
 
     if (!ntfs_boot_sector_is_ntfs(boot)) {
 		//AsciiPrint("ntfs_device_uefi_io_open...EINVALIDPART\n\r");
@@ -535,34 +556,27 @@ static bool ntfs_device_uefi_io_readsectors(struct ntfs_device *dev, sec_t secto
     }
     // Read the sectors from disc (or cache, if enabled)
 	if (fd->cache) {
-		//return _NTFS_cache_readSectors(fd->cache, sector, numSectors, buffer);
+		// Count the pages the cache served and read in with the device
+		//u64 hits = fd->cache->hits, misses = fd->cache->misses;
+		//bool ret = _NTFS_cache_readSectors(fd->cache, sector, numSectors, buffer);
+		//dev->d_cache_hits += fd->cache->hits - hits;
+		//dev->d_cache_misses += fd->cache->misses - misses;
+		//return ret;
 		ntfs_log_trace("ntfs_device_uefi_io_readsectors cache enabled?!?!");
 	}
     else
 	{
-		while(numSectors > 0)
+		// One request for the whole range; DiskIo splits it as the media needs
+		_sectorStart = sector * fd->sectorSize;
+		_bufferSize = numSectors * fd->sectorSize;
+
+		if (DiskIo->ReadDisk(DiskIo, fd->interface->MediaId, _sectorStart, _bufferSize, buffer) != EFI_SUCCESS)
 		{
-			//AsciiPrint("DiskIo.ReadDisk sectors %x\n\r", (UINTN) numSectors );
-			_sectorStart = sector * fd->sectorSize;
-			_bufferSize = fd->sectorSize;
-
-			if (DiskIo->ReadDisk(DiskIo, fd->interface->MediaId, _sectorStart, _bufferSize, buffer) != EFI_SUCCESS)
-			{
-				/*AsciiPrint("DiskIo %x\n\r", DiskIo);
-				AsciiPrint("MediaId %x\n\r", fd->interface->MediaId);
-				AsciiPrint("sector %x%x\n\r", (UINTN) sector * fd->sectorSize);
-				AsciiPrint("numSectors %x%x\n\r", (UINTN)  fd->sectorSize);
-				AsciiPrint("buffer %x\n\r", buffer);
-				AsciiPrint("ntfs_device_uefi_io_readsectors [DISKIO!READDISK] FAILED!!!\n\r");*/
-				ntfs_log_trace("failed I/O!");
-				return false;
-			}
-
-			numSectors--;	// decrease sector count
-			sector++;		// increase sector start
-			buffer = CALC_OFFSET(void *, buffer, fd->sectorSize);	// move ptr!
+			ntfs_log_trace("failed I/O!");
+			return false;
 		}
-
+		dev->d_reads++;
+		dev->d_read_bytes += _bufferSize;
 
 		//ReadDisk(DiskIo, fd->Volume->MediaId, fd->startSector * fd->sectorSize, sizeof(NTFS_BOOT_SECTOR), boot) 
 	}
@@ -593,26 +607,13 @@ static bool ntfs_device_uefi_io_writesectors(struct ntfs_device *dev, sec_t sect
 	}
     else
 	{
-		while(numSectors > 0)
+		// One request for the whole range, as for reads
+		_sectorStart = sector * fd->sectorSize;
+		_bufferSize = numSectors * fd->sectorSize;
+
+		if (DiskIo->WriteDisk(DiskIo, fd->interface->MediaId, _sectorStart, _bufferSize, buffer) != EFI_SUCCESS)
 		{
-			//AsciiPrint("DiskIo.ReadDisk sectors %x\n\r", (UINTN) numSectors );
-			_sectorStart = sector * fd->sectorSize;
-			_bufferSize = fd->sectorSize;
-
-			if (DiskIo->WriteDisk(DiskIo, fd->interface->MediaId, _sectorStart, _bufferSize, buffer) != EFI_SUCCESS)
-			{
-				//AsciiPrint("DiskIo %x\n\r", DiskIo);
-				//AsciiPrint("MediaId %x\n\r", fd->interface->MediaId);
-				//AsciiPrint("sector %x%x\n\r", (UINTN) sector * fd->sectorSize);
-				//AsciiPrint("numSectors %x%x\n\r", (UINTN)  fd->sectorSize);
-				//AsciiPrint("buffer %x\n\r", buffer);
-				//AsciiPrint("ntfs_device_uefi_io_writesectors [DISKIO!WRITEDISK] FAILED!!!\n\r");
-				return false;
-			}
-
-			numSectors--;	// decrease sector count
-			sector++;		// increase sector start
-			buffer = CALC_OFFSET(void *, buffer, fd->sectorSize);	// move ptr!
+			return false;
 		}
 	}
 
@@ -780,4 +781,5 @@ struct ntfs_device_operations ntfs_device_uefi_io_ops = {
     ntfs_device_uefi_io_sync,
     ntfs_device_uefi_io_stat,
     ntfs_device_uefi_io_ioctl,
+    NULL,	/* borrow: disk I/O has no mapped view */
 };
@@ -540,7 +540,7 @@ static int ntfs_utf16_to_utf8(const ntfschar *ins, const int ins_len,
 		}
 		else
 		{
-			ZeroMem(*outs, outs_len);
+			memset(*outs, 0, outs_len);
 		}
 	}
 
@@ -0,0 +1,291 @@
+/**
+ * usnjrnl.c - Change journal reader.
+ *
+ * Windows appends a record to $Extend\$UsnJrnl:$J for every change made to
+ * a file, numbered by its offset in $J (its usn). Whatever was derived from
+ * the volume at some usn (the path index of host/mkpathidx, for one) can be
+ * brought up to date by reading the records from that usn on and
+ * revisiting only the files they name, instead of the whole $MFT.
+ *
+ * Only the journal is read here; what the changes mean is left to the
+ * callers. Changes made by writers which do not keep the journal, this
+ * library included, are not seen.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "types.h"
+#include "layout.h"
+#include "attrib.h"
+#include "inode.h"
+#include "volume.h"
+#include "dir.h"
+#include "usnjrnl.h"
+#include "logging.h"
+#include "misc.h"
+
+static ntfschar usn_max_name[] = { const_cpu_to_le16('$'),
+		const_cpu_to_le16('M'), const_cpu_to_le16('a'),
+		const_cpu_to_le16('x') };
+
+static ntfschar usn_j_name[] = { const_cpu_to_le16('$'),
+		const_cpu_to_le16('J') };
+
+/**
+ * ntfs_usn_open - open the change journal of a volume
+ * @vol:	volume to read the journal of
+ * @chunk_size:	bytes of $J read by one request, 0 for the default
+ *
+ * The journal is read as it is at the open: records added later are not
+ * returned. Reading starts at the lowest valid usn, see ntfs_usn_seek() to
+ * start elsewhere.
+ *
+ * Return the reader on success or NULL on error with errno set, to ENOENT
+ * if the volume has no journal.
+ */
+ntfs_usn_journal *ntfs_usn_open(ntfs_volume *vol, u32 chunk_size)
+{
+	ntfs_usn_journal *j;
+	ntfs_inode *dir_ni;
+	ntfs_attr *na;
+	USN_JOURNAL_MAX max;
+	u64 inum;
+	s64 br;
+	int err;
+
+	if (!vol) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (!chunk_size)
+		chunk_size = NTFS_USN_DEFAULT_CHUNK;
+	chunk_size = (chunk_size + NTFS_USN_PAGE_SIZE - 1) &
+			~(NTFS_USN_PAGE_SIZE - 1);
+
+	j = ntfs_calloc(sizeof(*j));
+	if (!j)
+		return NULL;
+		/* do not use path_name_to inode - could reopen root */
+	dir_ni = ntfs_inode_open(vol, FILE_Extend);
+	if (!dir_ni)
+		goto err_out;
+	inum = ntfs_inode_lookup_by_mbsname(dir_ni, "$UsnJrnl");
+	ntfs_inode_close(dir_ni);
+	if (inum == (u64)-1)
+		goto err_out;
+	j->ni = ntfs_inode_open(vol, inum);
+	if (!j->ni)
+		goto err_out;
+
+	na = ntfs_attr_open(j->ni, AT_DATA, usn_max_name, 4);
+	if (!na)
+		goto err_out;
+	br = ntfs_attr_pread(na, 0, sizeof(max), &max);
+	ntfs_attr_close(na);
+	if (br != sizeof(max)) {
+		if (br >= 0)
+			errno = EIO;
+		goto err_out;
+	}
+	j->na = ntfs_attr_open(j->ni, AT_DATA, usn_j_name, 2);
+	if (!j->na)
+		goto err_out;
+	j->journal_id = le64_to_cpu(max.journal_id);
+	j->lowest_usn = sle64_to_cpu(max.lowest_valid_usn);
+	j->end_usn = j->na->data_size;
+	if (j->lowest_usn < 0 || j->lowest_usn > j->end_usn ||
+	    (j->lowest_usn & 7)) {
+		ntfs_log_error("Invalid $UsnJrnl:$Max.\n");
+		errno = EIO;
+		goto err_out;
+	}
+	j->next_usn = j->lowest_usn;
+	j->buf_size = chunk_size;
+	j->buf = ntfs_malloc(chunk_size);
+	if (!j->buf)
+		goto err_out;
+	return j;
+err_out:
+	err = errno;
+	if (err != ENOENT)
+		ntfs_log_perror("Failed to open $UsnJrnl");
+	ntfs_usn_close(j);
+	errno = err;
+	return NULL;
+}
+
+/**
+ * ntfs_usn_close - release a reader opened by ntfs_usn_open()
+ * @j:		reader to release, may be NULL
+ */
+void ntfs_usn_close(ntfs_usn_journal *j)
+{
+	if (!j)
+		return;
+	if (j->na)
+		ntfs_attr_close(j->na);
+	if (j->ni)
+		ntfs_inode_close(j->ni);
+	free(j->buf);
+	free(j);
+}
+
+/**
+ * ntfs_usn_seek - set the usn the journal is read from
+ * @j:		reader to move
+ * @usn:	usn of the first record wanted, usually the end_usn of an
+ *		earlier read of the same journal
+ *
+ * Return 0 on success, or -1 with errno set to ERANGE if the records from
+ * @usn on are no longer all held by the journal, or EINVAL if @usn cannot
+ * be a usn of the journal.
+ */
+int ntfs_usn_seek(ntfs_usn_journal *j, s64 usn)
+{
+	if (usn < j->lowest_usn) {
+		errno = ERANGE;
+		return -1;
+	}
+	if (usn > j->end_usn || (usn & 7)) {
+		errno = EINVAL;
+		return -1;
+	}
+	j->next_usn = usn;
+	return 0;
+}
+
+/* Make j->buf hold the page of @usn, and what follows as far as it fits. */
+static int usn_fill(ntfs_usn_journal *j, s64 usn)
+{
+	s64 pos, count, br;
+
+	if (usn >= j->buf_usn && usn < j->buf_usn + j->buf_len)
+		return 0;
+	pos = usn & ~(s64)(NTFS_USN_PAGE_SIZE - 1);
+	count = j->end_usn - pos;
+	if (count > j->buf_size)
+		count = j->buf_size;
+	br = ntfs_attr_pread(j->na, pos, count, j->buf);
+	if (br != count) {
+		if (br >= 0)
+			errno = EIO;
+		ntfs_log_perror("Failed to read $UsnJrnl:$J at %lld",
+				(long long)pos);
+		j->buf_len = 0;
+		return -1;
+	}
+	j->buf_usn = pos;
+	j->buf_len = count;
+	return 0;
+}
+
+/**
+ * ntfs_usn_next - read the next record of the journal
+ * @j:		reader to advance
+ * @rec:	destination of the record
+ *
+ * Records of versions other than 2 and 3, which hold no names, and the
+ * zeroes at the end of the pages and in the freed start of $J are skipped.
+ *
+ * Return 1 if @rec was filled in, 0 at the end of the journal, or -1 on
+ * error with errno set, to EIO if the journal is corrupt.
+ */
+int ntfs_usn_next(ntfs_usn_journal *j, ntfs_usn_record *rec)
+{
+	const USN_RECORD_V2 *r2;
+	const USN_RECORD_V3 *r3;
+	const u8 *p;
+	u32 left, length, name_ofs, name_len;
+	u16 major;
+
+	while (j->next_usn < j->end_usn) {
+		left = NTFS_USN_PAGE_SIZE -
+				(u32)(j->next_usn & (NTFS_USN_PAGE_SIZE - 1));
+		if (left > j->end_usn - j->next_usn)
+			left = (u32)(j->end_usn - j->next_usn);
+		if (left < sizeof(USN_RECORD_V2)) {
+			j->next_usn += left;
+			continue;
+		}
+		if (usn_fill(j, j->next_usn))
+			return -1;
+		p = j->buf + (j->next_usn - j->buf_usn);
+		length = le32_to_cpu(*(const le32 *)p);
+		if (!length) {
+			j->next_usn += left;
+			continue;
+		}
+		if (length < 8 || (length & 7) || length > left)
+			goto corrupt;
+		major = le16_to_cpu(*(const le16 *)(p + 4));
+		if (major == 2) {
+			r2 = (const USN_RECORD_V2 *)p;
+			if (length < sizeof(*r2))
+				goto corrupt;
+			rec->usn = sle64_to_cpu(r2->usn);
+			rec->mref = le64_to_cpu(r2->file_reference);
+			rec->parent_mref = le64_to_cpu(r2->parent_reference);
+			rec->timestamp = sle64_to_cpu(r2->timestamp);
+			rec->reason = r2->reason;
+			rec->file_attributes = r2->file_attributes;
+			name_ofs = le16_to_cpu(r2->file_name_offset);
+			name_len = le16_to_cpu(r2->file_name_length);
+		} else if (major == 3) {
+			r3 = (const USN_RECORD_V3 *)p;
+			if (length < sizeof(*r3))
+				goto corrupt;
+			rec->usn = sle64_to_cpu(r3->usn);
+			rec->mref = le64_to_cpu(*(const le64 *)r3->file_reference);
+			rec->parent_mref = le64_to_cpu(
+					*(const le64 *)r3->parent_reference);
+			rec->timestamp = sle64_to_cpu(r3->timestamp);
+			rec->reason = r3->reason;
+			rec->file_attributes = r3->file_attributes;
+			name_ofs = le16_to_cpu(r3->file_name_offset);
+			name_len = le16_to_cpu(r3->file_name_length);
+		} else {
+			j->next_usn += length;
+			continue;
+		}
+		if (rec->usn != j->next_usn || ((name_ofs | name_len) & 1) ||
+		    name_ofs > length || name_len > length - name_ofs)
+			goto corrupt;
+		rec->name = (const ntfschar *)(p + name_ofs);
+		rec->name_len = name_len / sizeof(ntfschar);
+		j->next_usn += length;
+		return 1;
+	}
+	return 0;
+corrupt:
+	ntfs_log_error("Corrupt $UsnJrnl:$J record at %lld.\n",
+			(long long)j->next_usn);
+	errno = EIO;
+	return -1;
+}
@@ -0,0 +1,90 @@
+/*
+ * usnjrnl.h - Exports for the change journal reader.
+ *
+ * This program/include file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program/include file is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in the main directory of the NTFS-3G
+ * distribution in the file COPYING); if not, write to the Free Software
+ * Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NTFS_USNJRNL_H
+#define _NTFS_USNJRNL_H
+
+#include "types.h"
+#include "layout.h"
+#include "inode.h"
+#include "attrib.h"
+#include "volume.h"
+
+/* Default amount of $J read by one device request. */
+#define NTFS_USN_DEFAULT_CHUNK	(64 * 1024)
+
+/* $J is written in pages which records never cross. */
+#define NTFS_USN_PAGE_SIZE	4096
+
+/**
+ * struct ntfs_usn_record - one change read from the journal
+ * @usn:		usn of the record, its offset in $J
+ * @mref:		mft reference of the file changed
+ * @parent_mref:	mft reference of the directory of @name
+ * @timestamp:		NTFS time of the change
+ * @reason:		USN_REASON_* of the changes, little endian
+ * @file_attributes:	FILE_ATTR_* of the file, little endian
+ * @name:		name of the file in @parent_mref, not terminated
+ * @name_len:		number of characters in @name
+ *
+ * @name points into the buffer of the reader, valid until the next call.
+ */
+typedef struct {
+	s64 usn;
+	MFT_REF mref;
+	MFT_REF parent_mref;
+	s64 timestamp;
+	le32 reason;
+	FILE_ATTR_FLAGS file_attributes;
+	const ntfschar *name;
+	u32 name_len;
+} ntfs_usn_record;
+
+/**
+ * struct ntfs_usn_journal - state of a read of the change journal
+ * @ni:			inode of FILE_Extend/$UsnJrnl
+ * @na:			its $J attribute
+ * @journal_id:		identifier of the journal, from $Max
+ * @lowest_usn:		first usn still held in $J
+ * @end_usn:		usn the next change will get, the size of $J
+ * @next_usn:		usn where ntfs_usn_next() goes on reading
+ * @buf:		part of $J last read
+ * @buf_usn:		usn of the first byte of @buf
+ * @buf_len:		bytes of $J in @buf
+ * @buf_size:		size of @buf, a multiple of NTFS_USN_PAGE_SIZE
+ */
+typedef struct {
+	ntfs_inode *ni;
+	ntfs_attr *na;
+	u64 journal_id;
+	s64 lowest_usn;
+	s64 end_usn;
+	s64 next_usn;
+	u8 *buf;
+	s64 buf_usn;
+	u32 buf_len;
+	u32 buf_size;
+} ntfs_usn_journal;
+
+extern ntfs_usn_journal *ntfs_usn_open(ntfs_volume *vol, u32 chunk_size);
+extern int ntfs_usn_seek(ntfs_usn_journal *j, s64 usn);
+extern int ntfs_usn_next(ntfs_usn_journal *j, ntfs_usn_record *rec);
+extern void ntfs_usn_close(ntfs_usn_journal *j);
+
+#endif /* defined _NTFS_USNJRNL_H */
@@ -65,7 +65,9 @@
 #include <ctype.h>
 #endif
 
+#ifndef LONG_MAX
 #define LONG_MAX 260
+#endif
 #define isprint(c) (c >= 32 && c <= 127) ? 1 : 0
 #include "utils.h"
 #include "types.h"
@@ -205,7 +207,7 @@ int ntfs_mbstoucs_libntfscompat(const char *ins,
 int utils_valid_device(const char *name, int force)
 {
 	unsigned long mnt_flags = 0;
-	struct stat st;
+	//struct stat st;
 
 #if defined(HAVE_WINDOWS_H) | defined(__CYGWIN32__) 
 	/* FIXME: This doesn't work for Cygwin, so just return success. */
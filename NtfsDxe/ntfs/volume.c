@@ -72,6 +72,7 @@
 #include "dir.h"
 #include "logging.h"
 #include "cache.h"
+#include "pathidx.h"
 #include "realpath.h"
 #include "misc.h"
 
@@ -126,7 +127,12 @@ static const char *access_denied_msg =
  */
 ntfs_volume *ntfs_volume_alloc(void)
 {
-	return (ntfs_volume *) ntfs_calloc(sizeof(ntfs_volume));
+	ntfs_volume *vol;
+
+	vol = (ntfs_volume *) ntfs_calloc(sizeof(ntfs_volume));
+	if (vol)
+		vol->stats_allocations = ntfs_allocations;
+	return vol;
 }
 
 static void ntfs_attr_free(ntfs_attr **na)
@@ -202,6 +208,8 @@ static int __ntfs_volume_release(ntfs_volume *v)
 	}
 
 	ntfs_free_lru_caches(v);
+	ntfs_attr_free_search_ctx_pool(v);
+	ntfs_path_index_detach(v);
 	free(v->vol_name);
 	free(v->upcase);
 	if (v->locase) free(v->locase);
@@ -240,6 +248,7 @@ static int ntfs_mft_load(ntfs_volume *vol)
 	MFT_RECORD *mb = NULL;
 	ntfs_attr_search_ctx *ctx = NULL;
 	ATTR_RECORD *a;
+	ntfs_io_tag tag;
 	int eo;
 
 	/* Manually setup an ntfs_inode. */
@@ -252,8 +261,10 @@ static int ntfs_mft_load(ntfs_volume *vol)
 	vol->mft_ni->mft_no = 0;
 	vol->mft_ni->mrec = mb;
 	/* Can't use any of the higher level functions yet! */
+	tag = ntfs_device_set_io_tag(vol->dev, NTFS_IO_MFT);
 	l = ntfs_mst_pread(vol->dev, vol->mft_lcn << vol->cluster_size_bits, 1,
 			vol->mft_record_size, mb);
+	ntfs_device_set_io_tag(vol->dev, tag);
 	if (l != 1) {
 		if (l != -1)
 			errno = EIO;
@@ -289,7 +300,9 @@ static int ntfs_mft_load(ntfs_volume *vol)
 	if (!vol->mft_ni->attr_list)
 		goto error_exit;
 	
+	tag = ntfs_device_set_io_tag(vol->dev, NTFS_IO_MFT);
 	l = ntfs_get_attribute_value(vol, ctx->attr, vol->mft_ni->attr_list);
+	ntfs_device_set_io_tag(vol->dev, tag);
 	if (!l) {
 		ntfs_log_error("Failed to get value of $MFT/$ATTR_LIST.\n");
 		goto io_error_exit;
@@ -473,6 +486,7 @@ ntfs_volume *ntfs_volume_startup(struct ntfs_device *dev,
 	s64 br;
 	ntfs_volume *vol;
 	NTFS_BOOT_SECTOR *bs;
+	ntfs_io_tag tag;
 	int eo;
 
 	//Print(L"ntfs_volume_startup: ok...\n");
@@ -539,7 +553,9 @@ ntfs_volume *ntfs_volume_startup(struct ntfs_device *dev,
 	vol->dev = dev;
 	
 	/* Now read the bootsector. */
+	tag = ntfs_device_set_io_tag(dev, NTFS_IO_BOOT);
 	br = ntfs_pread(dev, 0, sizeof(NTFS_BOOT_SECTOR), bs);
+	ntfs_device_set_io_tag(dev, tag);
 	
 	if (br != sizeof(NTFS_BOOT_SECTOR)) {
 		if (br != -1)
@@ -1258,6 +1274,7 @@ ntfs_volume *ntfs_device_mount(struct ntfs_device *dev, ntfs_mount_flags flags)
 			goto error_exit;
 	}
 
+	ntfs_create_dirfilter_cache(vol);
 	return vol;
 io_error_exit:
 	errno = EIO;
@@ -1351,14 +1368,14 @@ int ntfs_set_ignore_case(ntfs_volume *vol)
  * soon as the function returns.
  */
 ntfs_volume *ntfs_mount(const char *name ,
-		ntfs_mount_flags flags, void *ptr)
+		ntfs_mount_flags flags)
 {
 #ifndef NO_NTFS_DEVICE_DEFAULT_IO_OPS
 	struct ntfs_device *dev;
 	ntfs_volume *vol;
 
 	/* Allocate an ntfs_device structure. */
-	dev = ntfs_device_alloc(name, 0, &ntfs_device_default_io_ops, ptr);
+	dev = ntfs_device_alloc(name, 0, &ntfs_device_default_io_ops, NULL);
 	if (!dev)
 		return NULL;
 	/* Call ntfs_device_mount() to do the actual mount. */
@@ -1947,3 +1964,103 @@ err_out:
 		errno = err;
 	return err ? -1 : 0;
 }
+
+/*
+ *		Add the counters of an LRU cache to the volume stats
+ */
+
+static void ntfs_cache_stats(const struct CACHE_HEADER *cache,
+		ntfs_volume_stats *stats)
+{
+	if (cache) {
+		stats->cache_hits += cache->hits;
+		stats->cache_misses += cache->reads - cache->hits;
+	}
+}
+
+/**
+ * ntfs_volume_get_stats - gather the activity counters of a volume
+ * @vol:	volume to report on
+ * @stats:	where to store the counters
+ *
+ * Fill @stats with the activity of @vol since it was mounted or since the
+ * last ntfs_volume_reset_stats(). The allocation count is kept library wide,
+ * so it includes the allocations made on behalf of other volumes mounted
+ * at the same time.
+ */
+void ntfs_volume_get_stats(ntfs_volume *vol, ntfs_volume_stats *stats)
+{
+	*stats = vol->stats;
+	if (vol->dev) {
+		stats->dev_reads = vol->dev->d_reads;
+		stats->dev_read_bytes = vol->dev->d_read_bytes;
+		stats->cache_hits += vol->dev->d_cache_hits;
+		stats->cache_misses += vol->dev->d_cache_misses;
+		if (vol->dev->d_prefetch)
+			stats->prefetch_hits = vol->dev->d_prefetch->hits;
+	}
+#if CACHE_INODE_SIZE
+	ntfs_cache_stats(vol->xinode_cache, stats);
+#endif
+#if CACHE_NIDATA_SIZE
+	ntfs_cache_stats(vol->nidata_cache, stats);
+#endif
+#if CACHE_LOOKUP_SIZE
+	ntfs_cache_stats(vol->lookup_cache, stats);
+#endif
+#if CACHE_SECURID_SIZE
+	ntfs_cache_stats(vol->securid_cache, stats);
+#endif
+#if CACHE_LEGACY_SIZE
+	ntfs_cache_stats(vol->legacy_cache, stats);
+#endif
+#if CACHE_DIRFILTER_SIZE
+	ntfs_cache_stats(vol->dirfilter_cache, stats);
+#endif
+	stats->allocations = ntfs_allocations - vol->stats_allocations;
+}
+
+static void ntfs_cache_reset_stats(struct CACHE_HEADER *cache)
+{
+	if (cache) {
+		cache->reads = 0;
+		cache->writes = 0;
+		cache->hits = 0;
+	}
+}
+
+/**
+ * ntfs_volume_reset_stats - restart the activity counters of a volume
+ * @vol:	volume whose counters are reset
+ */
+void ntfs_volume_reset_stats(ntfs_volume *vol)
+{
+	memset(&vol->stats, 0, sizeof(vol->stats));
+	if (vol->dev) {
+		vol->dev->d_reads = 0;
+		vol->dev->d_read_bytes = 0;
+		vol->dev->d_cache_hits = 0;
+		vol->dev->d_cache_misses = 0;
+		if (vol->dev->d_prefetch)
+			vol->dev->d_prefetch->hits = 0;
+	}
+#if CACHE_INODE_SIZE
+	ntfs_cache_reset_stats(vol->xinode_cache);
+#endif
+#if CACHE_NIDATA_SIZE
+	ntfs_cache_reset_stats(vol->nidata_cache);
+#endif
+#if CACHE_LOOKUP_SIZE
+	ntfs_cache_reset_stats(vol->lookup_cache);
+#endif
+#if CACHE_SECURID_SIZE
+	ntfs_cache_reset_stats(vol->securid_cache);
+#endif
+#if CACHE_LEGACY_SIZE
+	ntfs_cache_reset_stats(vol->legacy_cache);
+#endif
+#if CACHE_DIRFILTER_SIZE
+	ntfs_cache_reset_stats(vol->dirfilter_cache);
+#endif
+	vol->stats_allocations = ntfs_allocations;
+}
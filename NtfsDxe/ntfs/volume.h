@@ -166,6 +166,34 @@ typedef enum {
 
 #define NTFS_BUF_SIZE 8192
 
+/**
+ * struct _ntfs_volume_stats - activity counters of a mounted volume.
+ *
+ * The metadata counters are kept in the volume and bumped with
+ * NVolStatAdd() where the work is done. Device reads are counted by the
+ * device (see struct ntfs_device), cache hits and misses by the LRU caches
+ * and the sector cache of the device, and allocations library wide; ntfs_volume_get_stats() gathers them all.
+ */
+typedef struct _ntfs_volume_stats {
+	u64 dev_reads;		/* Read requests issued to the device. */
+	u64 dev_read_bytes;	/* Bytes read from the device. */
+	u64 mft_records;	/* Mft records read. */
+	u64 index_blocks;	/* Index blocks read. */
+	u64 compression_blocks;	/* Compression blocks decompressed. */
+	u64 cache_hits;		/* Lookups satisfied by the LRU caches and
+				   the sector cache. */
+	u64 cache_misses;	/* Lookups they could not satisfy. */
+	u64 prefetch_hits;	/* Device requests served from prefetched
+				   data. */
+	u64 path_index_hits;	/* Paths opened from the path index. */
+	u64 allocations;	/* Library allocations since the counters
+				   were last reset. */
+} ntfs_volume_stats;
+
+/* Add @n to counter @field of @vol, which may be a const volume. */
+#define NVolStatAdd(vol, field, n) \
+	(((ntfs_volume *)(vol))->stats.field += (n))
+
 /**
  * struct _ntfs_volume - structure describing an open volume in memory.
  */
@@ -275,7 +303,17 @@ struct _ntfs_volume {
 #if CACHE_LEGACY_SIZE
 	struct CACHE_HEADER *legacy_cache;
 #endif
-
+#if CACHE_DIRFILTER_SIZE
+	struct CACHE_HEADER *dirfilter_cache;
+#endif
+	struct _ntfs_attr_search_ctx *search_ctx_pool; /* Released attribute
+				   search contexts kept for reuse. */
+	int search_ctx_pooled;	/* Number of contexts in @search_ctx_pool. */
+	struct ntfs_path_index *path_index; /* Path index used by
+				   ntfs_pathname_to_inode(), see pathidx.h. */
+	ntfs_volume_stats stats;	/* Activity counters, see above. */
+	u64 stats_allocations;	/* Value of ntfs_allocations when the
+				   counters were last reset. */
 };
 
 extern const char *ntfs_home;
@@ -309,5 +347,8 @@ extern int ntfs_set_shown_files(ntfs_volume *vol,
 extern int ntfs_set_locale(void);
 extern int ntfs_set_ignore_case(ntfs_volume *vol);
 
+extern void ntfs_volume_get_stats(ntfs_volume *vol, ntfs_volume_stats *stats);
+extern void ntfs_volume_reset_stats(ntfs_volume *vol);
+
 #endif /* defined _NTFS_VOLUME_H */
 